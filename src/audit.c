@@ -36,18 +36,52 @@
 #include "audit.h"
 #include "options_string.h"
 #include "mame-exec.h"
+#include "gmameui-audit-store.h"
 #include "gmameui-marshaller.h"
 
 #define BUFFER_SIZE 1000
 
+/* Maximum number of single romset audits run alongside the full audit to
+   get the status of the visible romsets quickly */
+#define AUDIT_PRIORITY_MAX_JOBS 4
+
+/* Which process a line of audit output came from; passed as the user data
+   to the io channel handlers */
+enum {
+	AUDIT_SOURCE_SINGLE,
+	AUDIT_SOURCE_FULL,
+	AUDIT_SOURCE_PRIORITY
+};
+
+static void
+process_audit_romset (gchar *line, gint settype, gint source);
+
+static void
+launch_priority_audits (GmameuiAudit *au);
+
 static void
-process_audit_romset (gchar *line, gint settype);
+end_audit_pass (GmameuiAudit *au);
 
 /* Audit class stuff */
 G_DEFINE_TYPE (GmameuiAudit, gmameui_audit, G_TYPE_OBJECT)
 
 struct _GmameuiAuditPrivate {
 	gchar *name;
+
+	/* Priority hints, used while a full audit is running */
+	gboolean full_audit_running;
+	GHashTable *audited;		/* Romsets already audited in this pass */
+	GQueue *priority_queue;		/* Romset names waiting to be audited */
+	GList *priority_pids;		/* Running single romset audits */
+	guint priority_outputs;		/* Priority audit pipes still being read */
+
+	/* Chip lines precede the romset line in the -verifyroms output, so
+	   are held here until the romset result is known. The full and
+	   priority audits of a pass share a table, which is emptied when the
+	   pass ends; audits started with mame_audit_start_single have their
+	   own */
+	GHashTable *pending_chips;	/* romname -> GList of AuditChipResult */
+	GHashTable *single_pending_chips;
 };
 
 /* Signals enumeration */
@@ -116,12 +150,25 @@ gmameui_audit_class_init (GmameuiAuditClass *klass)
 						);
 }
 
+static void
+free_chip_list (GList *chips)
+{
+	g_list_foreach (chips, (GFunc) gmameui_audit_chip_result_free, NULL);
+	g_list_free (chips);
+}
+
 static void
 gmameui_audit_init (GmameuiAudit *au)
 {
 	
 GMAMEUI_DEBUG ("Creating gmameui_audit object");	
 	au->priv = g_new0 (GmameuiAuditPrivate, 1);
+
+	au->priv->priority_queue = g_queue_new ();
+	au->priv->pending_chips = g_hash_table_new_full (g_str_hash, g_str_equal,
+							 g_free, (GDestroyNotify) free_chip_list);
+	au->priv->single_pending_chips = g_hash_table_new_full (g_str_hash, g_str_equal,
+								g_free, (GDestroyNotify) free_chip_list);
 	
 GMAMEUI_DEBUG ("Creating gmameui_audit object... done");
 }
@@ -138,6 +185,13 @@ gmameui_audit_finalize (GObject *obj)
 	
 	GmameuiAudit *au = GMAMEUI_AUDIT (obj);
 	
+	g_queue_foreach (au->priv->priority_queue, (GFunc) g_free, NULL);
+	g_queue_free (au->priv->priority_queue);
+	g_list_free (au->priv->priority_pids);
+	if (au->priv->audited)
+		g_hash_table_destroy (au->priv->audited);
+	g_hash_table_destroy (au->priv->pending_chips);
+	g_hash_table_destroy (au->priv->single_pending_chips);
 	
 	g_free (au->priv);
 	
@@ -258,7 +312,7 @@ handle_sample_audit_command_stdout_io (GIOChannel * ioc,
 				continue;
 			}
 
-			process_audit_romset (string->str, AUDIT_TYPE_SAMPLE);
+			process_audit_romset (string->str, AUDIT_TYPE_SAMPLE, GPOINTER_TO_INT (data));
 
 			while (gtk_events_pending ())
 				gtk_main_iteration ();
@@ -321,7 +375,7 @@ handle_audit_command_stdout_io (GIOChannel * ioc,
 				continue;
 			}
 
-			process_audit_romset (string->str, AUDIT_TYPE_ROM);
+			process_audit_romset (string->str, AUDIT_TYPE_ROM, GPOINTER_TO_INT (data));
 
 			while (gtk_events_pending ())
 				gtk_main_iteration ();
@@ -332,10 +386,35 @@ handle_audit_command_stdout_io (GIOChannel * ioc,
 	}
 	
 	if (!(condition & G_IO_IN) || broken_pipe == TRUE) {
+		/* Priority audits run alongside the full audit, which emits
+		   the completion signal; the next queued romset is started
+		   once the child process has exited */
+		if (GPOINTER_TO_INT (data) == AUDIT_SOURCE_PRIORITY) {
+			g_io_channel_shutdown (ioc, TRUE, NULL);
+			gui_prefs.audit->priv->priority_outputs--;
+			end_audit_pass (gui_prefs.audit);
+			return FALSE;
+		}
+
 		/* FIXME TODO Pipe finishes for auditing single rom before ROM_AUDITED signal can be emitted
 		   Test with the less complicated example before using this one */
 		GMAMEUI_DEBUG ("Audit completed");
 
+		/* The pass is completed once any priority audits still
+		   running have also finished */
+		if (GPOINTER_TO_INT (data) == AUDIT_SOURCE_FULL) {
+			GmameuiAuditPrivate *priv = gui_prefs.audit->priv;
+
+			priv->full_audit_running = FALSE;
+			g_queue_foreach (priv->priority_queue, (GFunc) g_free, NULL);
+			g_queue_clear (priv->priority_queue);
+			g_io_channel_shutdown (ioc, TRUE, NULL);
+			end_audit_pass (gui_prefs.audit);
+
+			return FALSE;
+		}
+
+		gmameui_audit_store_save (gui_prefs.audit_store);
 		g_signal_emit (gui_prefs.audit, signals[ROM_AUDIT_COMPLETE], 0, NULL);
 		g_io_channel_shutdown (ioc, TRUE, NULL);
 		
@@ -391,7 +470,7 @@ handle_audit_command_stderr_io (GIOChannel * ioc,
 				continue;
 			}
 
-			process_audit_romset (string->str, AUDIT_TYPE_SAMPLE);
+			process_audit_romset (string->str, AUDIT_TYPE_SAMPLE, GPOINTER_TO_INT (data));
 			
 		} while (g_io_channel_get_buffer_condition (ioc) & G_IO_IN);
 
@@ -406,15 +485,114 @@ handle_audit_command_stderr_io (GIOChannel * ioc,
 	return TRUE;
 }
 
+/* Process a line for an individual ROM or disk which has a problem, e.g.
+     0121  005     : 1346b.cpu-u25 (2048 bytes) - NOT FOUND
+   and hold the result until the romset line is found. The EXPECTED and
+   FOUND lines following an incorrect checksum are ignored */
+static GHashTable *
+get_pending_chips (gint source)
+{
+	if (source == AUDIT_SOURCE_SINGLE)
+		return gui_prefs.audit->priv->single_pending_chips;
+
+	return gui_prefs.audit->priv->pending_chips;
+}
+
+static void
+process_audit_chip (const gchar *line, gint source)
+{
+	GHashTable *pending;
+	gchar *romname, *chipname;
+	const gchar *sep, *status, *p;
+	AuditChipStatus chip_status;
+	GList *chips;
+	gpointer orig_key;
+
+	sep = strstr (line, ": ");
+	status = strstr (line, " - ");
+	if (!sep || !status || (status < sep))
+		return;
+
+	romname = g_strstrip (g_strndup (line, sep - line));
+	if (!*romname || strchr (romname, ' ')) {
+		g_free (romname);
+		return;
+	}
+
+	/* The chip name is followed by the size for ROMs, but not disks */
+	p = strstr (sep, " (");
+	if (!p || (p > status))
+		p = status;
+	chipname = g_strstrip (g_strndup (sep + 2, p - (sep + 2)));
+
+	status += 3;
+	if (strstr (status, "NO GOOD DUMP"))
+		chip_status = AUDIT_CHIP_NO_GOOD_DUMP;
+	else if (strstr (status, "NOT FOUND"))
+		chip_status = AUDIT_CHIP_NOT_FOUND;
+	else if (strstr (status, "CHECKSUM"))
+		chip_status = AUDIT_CHIP_BAD_CHECKSUM;
+	else if (strstr (status, "LENGTH"))
+		chip_status = AUDIT_CHIP_BAD_LENGTH;
+	else if (strstr (status, "REDUMP"))
+		chip_status = AUDIT_CHIP_NEEDS_REDUMP;
+	else
+		chip_status = AUDIT_CHIP_OTHER;
+
+	chips = NULL;
+	pending = get_pending_chips (source);
+	if (g_hash_table_lookup_extended (pending, romname, &orig_key, (gpointer *) &chips)) {
+		g_hash_table_steal (pending, romname);
+		g_free (orig_key);
+	}
+	chips = g_list_append (chips, gmameui_audit_chip_result_new (chipname, chip_status));
+	g_hash_table_insert (pending, romname, chips);
+
+	g_free (chipname);
+}
+
+/* Save the result of a romset or sampleset to the audit store. line has
+   already been split after the name, i.e. "romset\0name\0..." */
+static void
+record_romset_result (gchar *line, gint settype, gint source, gint result)
+{
+	MameExec *exec;
+	GHashTable *pending;
+	gchar *romname;
+	gpointer orig_key, chips;
+
+	romname = g_strdup (strstr (line, " ") + 1);
+	/* Samplesets that are not found have the name in quotes */
+	g_strdelimit (romname, "\"", ' ');
+	g_strstrip (romname);
+
+	chips = NULL;
+	pending = get_pending_chips (source);
+	if (g_hash_table_lookup_extended (pending, romname, &orig_key, &chips)) {
+		g_hash_table_steal (pending, romname);
+		g_free (orig_key);
+	}
+
+	exec = mame_exec_list_get_current_executable (main_gui.exec_list);
+
+	gmameui_audit_store_set_result (gui_prefs.audit_store, romname,
+					settype == AUDIT_TYPE_SAMPLE, result,
+					exec ? mame_exec_get_version (exec) : NULL,
+					chips);
+
+	g_free (romname);
+}
+
 /* This function processes a line from the output of the MAME audit functions
    verifyroms and verifysamples. This result is emitted as a signal so any
    interested client can handle it. This lets us run the audit as a separate
    process and handle the output on a line-by-line process. */
 static void
-process_audit_romset (gchar *line, gint settype) {
+process_audit_romset (gchar *line, gint settype, gint source) {
 	gchar *p;
 	gchar *tmp;
 	gint result;
+	GHashTable *audited;
 	
 	result = 0;
 	
@@ -456,6 +634,23 @@ process_audit_romset (gchar *line, gint settype) {
 			result = UNKNOWN;
 		}
 
+		/* Record the result, with the detail of any bad ROMs */
+		record_romset_result (tmp, settype, source, result);
+
+		/* While a full audit is running, the visible romsets may also
+		   have been audited separately; only report each romset once */
+		audited = gui_prefs.audit->priv->audited;
+		if ((settype == AUDIT_TYPE_ROM) && (source != AUDIT_SOURCE_SINGLE) && audited) {
+			gchar *romname = strstr (tmp, " ") + 1;
+
+			if (g_hash_table_lookup (audited, romname)) {
+				g_free (tmp);
+				return;
+			}
+
+			g_hash_table_insert (audited, g_strdup (romname), GINT_TO_POINTER (TRUE));
+		}
+
 		/* Emit signal for clients to handle as they see fit */
 		g_signal_emit (gui_prefs.audit, signals[ROMSET_AUDITED], 0, line, settype, result);
 
@@ -464,6 +659,9 @@ process_audit_romset (gchar *line, gint settype) {
 	} else {
 		/* Line is for a rom within a romset */
 		result = NOTROMSET;
+
+		if (settype == AUDIT_TYPE_ROM)
+			process_audit_chip (line, source);
 	}
 	 
 	g_free (tmp);
@@ -569,6 +767,16 @@ mame_audit_start_full (void)
 		g_object_set (tmprom, "has-roms", NOT_AVAIL, NULL);
 	}
 	
+	/* Start a new pass, auditing any romsets hinted by the gamelist (i.e.
+	   those on screen) first */
+	if (gui_prefs.audit->priv->audited)
+		g_hash_table_destroy (gui_prefs.audit->priv->audited);
+	gui_prefs.audit->priv->audited = g_hash_table_new_full (g_str_hash, g_str_equal,
+								 g_free, NULL);
+	gui_prefs.audit->priv->full_audit_running = TRUE;
+
+	launch_priority_audits (gui_prefs.audit);
+
 	rompath_option = create_rompath_options_string (exec);
 
 	/* FIXME TODO  2>/dev/null will send stderr to /dev/null, so we won't need to add g_io_watch to it */
@@ -580,7 +788,7 @@ mame_audit_start_full (void)
 	mame_executable_set_up_io_channel(child_stdout,
 			  G_IO_IN|G_IO_PRI|G_IO_ERR|G_IO_HUP|G_IO_NVAL,
 			  handle_audit_command_stdout_io,
-			  NULL);
+			  GINT_TO_POINTER (AUDIT_SOURCE_FULL));
 
 	/* Add a function to watch for stderr 
 	mame_executable_set_up_io_channel(child_stderr,
@@ -622,8 +830,150 @@ mame_audit_start_full (void)
 void
 mame_audit_stop_full_audit (GmameuiAudit *au)
 {
+	GList *node;
+
+	g_queue_foreach (au->priv->priority_queue, (GFunc) g_free, NULL);
+	g_queue_clear (au->priv->priority_queue);
+
+	for (node = au->priv->priority_pids; node != NULL; node = g_list_next (node))
+		kill (GPOINTER_TO_INT (node->data), SIGTERM);
+
 	if (command_pid > 0)
 		kill (command_pid, SIGTERM);
 	if (command_sample_pid > 0)
 		kill (command_sample_pid, SIGTERM);
 }
+
+static void
+spawned_priority_audit_complete (GPid child_pid, gint status, gpointer user_data)
+{
+	GmameuiAudit *au = (gpointer) user_data;
+
+	au->priv->priority_pids = g_list_remove (au->priv->priority_pids,
+						 GINT_TO_POINTER (child_pid));
+	g_spawn_close_pid (child_pid);
+
+	if (au->priv->full_audit_running)
+		launch_priority_audits (au);
+	else
+		end_audit_pass (au);
+}
+
+/* Ends the pass once the full audit and the priority audits started
+   alongside it have all finished; until then, output still to be read may
+   refer to the audited romsets and the pending chip results */
+static void
+end_audit_pass (GmameuiAudit *au)
+{
+	if (au->priv->full_audit_running ||
+	    (au->priv->priority_pids != NULL) ||
+	    (au->priv->priority_outputs > 0) ||
+	    (au->priv->audited == NULL))
+		return;
+
+	GMAMEUI_DEBUG ("Audit pass completed");
+
+	g_hash_table_destroy (au->priv->audited);
+	au->priv->audited = NULL;
+
+	/* Results for romsets whose audit was stopped part way through */
+	g_hash_table_remove_all (au->priv->pending_chips);
+
+	gmameui_audit_store_save (gui_prefs.audit_store);
+	g_signal_emit (au, signals[ROM_AUDIT_COMPLETE], 0, NULL);
+}
+
+/* Start single romset audits for the queued priority romsets, keeping no more
+   than AUDIT_PRIORITY_MAX_JOBS running at once. Each runs a separate
+   -verifyroms process, which returns in a fraction of the time it takes the
+   full audit to reach the romset */
+static void
+launch_priority_audits (GmameuiAudit *au)
+{
+	MameExec *exec;
+	const gchar *option_name;
+	gchar *rompath_option;
+	gchar *romname;
+
+	if (g_queue_is_empty (au->priv->priority_queue))
+		return;
+
+	exec = mame_exec_list_get_current_executable (main_gui.exec_list);
+	g_return_if_fail (exec != NULL);
+
+	option_name = mame_get_option_name (exec, "verifyroms");
+	g_return_if_fail (option_name != NULL);
+
+	rompath_option = create_rompath_options_string (exec);
+
+	while ((g_list_length (au->priv->priority_pids) < AUDIT_PRIORITY_MAX_JOBS) &&
+	       (romname = g_queue_pop_head (au->priv->priority_queue)) != NULL) {
+		gchar *command;
+		pid_t pid = 0;
+		int out;
+
+		/* The full audit may have reached the romset in the meantime */
+		if (g_hash_table_lookup (au->priv->audited, romname)) {
+			g_free (romname);
+			continue;
+		}
+
+		command = g_strdup_printf ("%s -%s %s %s", mame_exec_get_path (exec),
+					   option_name, rompath_option, romname);
+
+		/* Chip errors are reported on stdout, so stderr is inherited
+		   rather than piped */
+		mame_exec_launch_command (command, &pid, &out, NULL);
+
+		if (pid > 0) {
+			mame_executable_set_up_io_channel (out,
+							   G_IO_IN|G_IO_PRI|G_IO_ERR|G_IO_HUP|G_IO_NVAL,
+							   handle_audit_command_stdout_io,
+							   GINT_TO_POINTER (AUDIT_SOURCE_PRIORITY));
+			g_child_watch_add (pid, (GChildWatchFunc) spawned_priority_audit_complete, au);
+			au->priv->priority_outputs++;
+
+			au->priv->priority_pids = g_list_prepend (au->priv->priority_pids,
+								  GINT_TO_POINTER (pid));
+		}
+
+		g_free (command);
+		g_free (romname);
+	}
+
+	g_free (rompath_option);
+}
+
+/**
+ * mame_audit_set_priority_romsets:
+ * @au: the audit object
+ * @romnames: list of romset names, most important first
+ *
+ * Hint which romsets should be audited ahead of the rest, e.g. those visible
+ * in the gamelist. The list replaces any previous hints, since only the
+ * current screen matters. If a full audit is running, audits of the hinted
+ * romsets are started straight away; otherwise the hints are kept for the
+ * next full audit.
+ */
+void
+mame_audit_set_priority_romsets (GmameuiAudit *au, GList *romnames)
+{
+	GList *node;
+
+	g_return_if_fail (GMAMEUI_IS_AUDIT (au));
+
+	g_queue_foreach (au->priv->priority_queue, (GFunc) g_free, NULL);
+	g_queue_clear (au->priv->priority_queue);
+
+	for (node = romnames; node != NULL; node = g_list_next (node)) {
+		const gchar *romname = node->data;
+
+		if (au->priv->audited && g_hash_table_lookup (au->priv->audited, romname))
+			continue;
+
+		g_queue_push_tail (au->priv->priority_queue, g_strdup (romname));
+	}
+
+	if (au->priv->full_audit_running)
+		launch_priority_audits (au);
+}
@@ -70,6 +70,7 @@ GmameuiAudit* gmameui_audit_new (void);
 void   mame_audit_start_full           (void);
 void   mame_audit_start_single         (gchar *romname);
 void   mame_audit_stop_full_audit      (GmameuiAudit *au);
+void   mame_audit_set_priority_romsets (GmameuiAudit *au, GList *romnames);
 const gchar* get_romset_name_from_audit_line (gchar *line);
 
 G_END_DECLS
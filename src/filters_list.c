@@ -22,6 +22,7 @@
 #include "common.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <gtk/gtk.h>
 
 #include "filters_list.h"
@@ -39,6 +40,8 @@ struct _GMAMEUIFiltersListPrivate
 	
 	GList *groups;  /* All the filter categories */
 
+	GList *expr_filters;	/* Filters only used in compound filters */
+
 };
 
 /* Used when searching the tree model for a group */
@@ -48,6 +51,14 @@ typedef struct {
 	gboolean     found;
 } FindGroup;
 
+/* Used when searching the tree model for a filter by name */
+typedef struct {
+	const gchar   *group;	/* NULL to match the name in any group */
+	const gchar   *name;
+	GMAMEUIFilter *filter;	/* The first filter found */
+	gint count;		/* Number of filters found */
+} FindFilter;
+
 typedef struct _folder_filter folder_filter;
 
 struct _folder_filter {
@@ -128,6 +139,9 @@ GMAMEUI_DEBUG ("Freeing filters list");
 	/* Clear the list of filters TODO - Clear each node first? */
 	g_list_free (fl->priv->groups);
 
+	g_list_foreach (fl->priv->expr_filters, (GFunc) g_object_unref, NULL);
+	g_list_free (fl->priv->expr_filters);
+
 	gtk_tree_store_clear (GTK_TREE_STORE (fl->priv->store));
 	g_object_unref (fl->priv->store);
 	g_object_unref (fl->priv->filter);
@@ -300,6 +314,13 @@ GMAMEUI_DEBUG ("Creating filters list");
 		{ FAVORITE, FILTER_CUSTOM_FAVORITES, _("Favorites"), TRUE, NULL, 0, TRUE, "gmameui-emblem-favorite", _("Custom") },
 		{ TIMESPLAYED, FILTER_CUSTOM_PLAYED, _("Played"), FALSE, NULL, 0, TRUE, NULL, _("Custom") },
 	};
+
+	/* Availability is chosen with the filter bar rather than the list, but
+	   compound filters can combine it with the other filters */
+	folder_filter expr_only_filters [] = {
+		{ HAS_ROMS, FILTER_AVAILABLE, _("Available"), FALSE, NULL, NOT_AVAIL, TRUE, NULL, _("Available") },
+		{ HAS_ROMS, FILTER_UNAVAILABLE, _("Unavailable"), TRUE, NULL, NOT_AVAIL, TRUE, NULL, _("Available") },
+	};
 	
 	GMAMEUIFilter *folder_filter, *avail_folder_filter;
 
@@ -335,6 +356,20 @@ GMAMEUI_DEBUG ("Creating filters list");
 		g_object_unref (folder_filter);
 	}
 
+	for (i = 0; i < G_N_ELEMENTS (expr_only_filters); i++) {
+		folder_filter = gmameui_filter_new ();
+		g_object_set (folder_filter,
+			      "name", expr_only_filters[i].name,
+			      "folderid", expr_only_filters[i].filterid,
+			      "type", expr_only_filters[i].type,
+			      "is", expr_only_filters[i].is,
+			      "value", expr_only_filters[i].text_value,
+			      "int_value", expr_only_filters[i].int_value,
+			      "update_list", expr_only_filters[i].update_list,
+			      NULL);
+		fl->priv->expr_filters = g_list_append (fl->priv->expr_filters, folder_filter);
+	}
+
 	/* Select the Correct filter as the default upon startup */
 	filters_list_select (fl, avail_folder_filter);
 	/* FIXME TODO Causes a segfault: g_object_unref (avail_folder_filter); */
@@ -765,6 +800,132 @@ filters_list_get_group (GMAMEUIFiltersList *fl,
 	}
 }
 
+static gboolean
+filters_list_find_filter_foreach (GtkTreeModel *model,
+				  GtkTreePath  *path,
+				  GtkTreeIter  *iter,
+				  FindFilter   *ff)
+{
+	GMAMEUIFilter *filter;
+	GtkTreeIter parent;
+	gchar *name, *group;
+	gboolean found;
+
+	/* Filters are only at the second level, below their group */
+	if (gtk_tree_path_get_depth (path) != 2)
+		return FALSE;
+
+	gtk_tree_model_get (model, iter,
+			    GMAMEUI_FILTER_LIST_MODEL_COLUMN_NAME, &name,
+			    GMAMEUI_FILTER_LIST_MODEL_COLUMN_FILTER, &filter,
+			    -1);
+
+	found = (filter != NULL) && (name != NULL) &&
+		(g_ascii_strcasecmp (name, ff->name) == 0);
+
+	if (found && ff->group) {
+		gtk_tree_model_iter_parent (model, &parent, iter);
+		gtk_tree_model_get (model, &parent,
+				    GMAMEUI_FILTER_LIST_MODEL_COLUMN_NAME, &group,
+				    -1);
+		found = (g_ascii_strcasecmp (group, ff->group) == 0);
+		g_free (group);
+	}
+
+	/* The store keeps its own reference to the filter */
+	if (found) {
+		if (ff->filter == NULL)
+			ff->filter = filter;
+		ff->count++;
+	}
+
+	if (filter != NULL)
+		g_object_unref (filter);
+	g_free (name);
+
+	/* Keep going to find out whether the name is in another group */
+	return FALSE;
+}
+
+/* Returns the first filter with the name, and sets count to the number of
+   filters that have it */
+static GMAMEUIFilter *
+filters_list_find_filter_in_group (GMAMEUIFiltersList *fl,
+				   const gchar *group,
+				   const gchar *name,
+				   gint *count)
+{
+	FindFilter ff;
+	GList *l;
+
+	ff.group = group;
+	ff.name = name;
+	ff.filter = NULL;
+	ff.count = 0;
+
+	gtk_tree_model_foreach (GTK_TREE_MODEL (fl->priv->store),
+				(GtkTreeModelForeachFunc) filters_list_find_filter_foreach,
+				&ff);
+
+	for (l = fl->priv->expr_filters; l; l = l->next) {
+		gchar *filter_name;
+		gboolean found;
+
+		g_object_get (l->data, "name", &filter_name, NULL);
+		found = (g_ascii_strcasecmp (filter_name, name) == 0) &&
+			((group == NULL) || (g_ascii_strcasecmp (group, _("Available")) == 0));
+		g_free (filter_name);
+
+		if (found) {
+			if (ff.filter == NULL)
+				ff.filter = l->data;
+			ff.count++;
+		}
+	}
+
+	*count = ff.count;
+
+	return ff.filter;
+}
+
+/* Returns the filter with the name, which must be written as "Group:Name"
+   where the name alone is in more than one group, or NULL if there is no
+   such filter. ambiguous, if not NULL, is set when the name alone is in
+   more than one group. Used to look up the filters named in compound
+   filters */
+GMAMEUIFilter *
+gmameui_filters_list_find_filter (GMAMEUIFiltersList *fl,
+				  const gchar *name,
+				  gboolean *ambiguous)
+{
+	GMAMEUIFilter *filter;
+	gchar **parts;
+	gint count;
+
+	g_return_val_if_fail (fl != NULL, NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	if (ambiguous)
+		*ambiguous = FALSE;
+
+	filter = filters_list_find_filter_in_group (fl, NULL, name, &count);
+	if (count > 1) {
+		if (ambiguous)
+			*ambiguous = TRUE;
+		return NULL;
+	}
+	if (filter || (strchr (name, ':') == NULL))
+		return filter;
+
+	parts = g_strsplit (name, ":", 2);
+	g_strstrip (parts[0]);
+	g_strstrip (parts[1]);
+	filter = filters_list_find_filter_in_group (fl, parts[0], parts[1], &count);
+	g_strfreev (parts);
+
+	return filter;
+}
+
 typedef struct _FilterPath {
 	GMAMEUIFilter    *filter;
 	GtkTreePath      *path;
@@ -882,7 +1043,8 @@ filters_list_selection_changed_cb (GtkTreeSelection *selection,
 
 	GMAMEUI_DEBUG ("About to recreate gamelist after filter selected");
 
-	mame_gamelist_view_update_filter (main_gui.displayed_list);
+	/* Choosing a filter from the list replaces any compound filter */
+	mame_gamelist_view_set_filter_expr (main_gui.displayed_list, NULL);
 	
 	GMAMEUI_DEBUG ("Done recreating gamelist after filter selected");
 	
@@ -59,6 +59,10 @@ struct _GMAMEUIFiltersListClass
 GType gmameui_filters_list_get_type (void);
 
 GtkWidget *gmameui_filters_list_new (void);
+
+GMAMEUIFilter *gmameui_filters_list_find_filter (GMAMEUIFiltersList *fl,
+                                                 const gchar *name,
+                                                 gboolean *ambiguous);
 		
 /* Model */
 typedef enum {
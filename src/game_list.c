@@ -74,7 +74,9 @@ struct _MameGamelistPrivate {
 	GList *drivers;
 	GList *categories;
 	GList *versions;
-	GList *not_checked_list;	/* Only used if def QUICK_CHECK_ENABLED */
+
+	GHashTable *clones;	/* Parent romname -> GList of its clones, built
+				   the first time it is asked for */
 };
 
 
@@ -147,12 +149,6 @@ GMAMEUI_DEBUG ("  Freeing roms... done");
 		g_list_free (gl->priv->drivers);
 	}
 
-#ifdef QUICK_CHECK_ENABLED
-	if (gl->priv->not_checked_list) {
-		g_list_foreach (gl->priv->not_checked_list, (GFunc) rom_entry_free, NULL);
-		g_list_free (gl->priv->not_checked_list);
-	}
-#endif
 	if (gl->priv->categories) {
 		g_list_foreach (gl->priv->categories, (GFunc) g_free, NULL);
 		g_list_free (gl->priv->categories);
@@ -162,6 +158,9 @@ GMAMEUI_DEBUG ("  Freeing roms... done");
 		g_list_foreach (gl->priv->versions, (GFunc) g_free, NULL);
 		g_list_free (gl->priv->versions);
 	}
+
+	if (gl->priv->clones)
+		g_hash_table_destroy (gl->priv->clones);
 	
 	g_free (gl->priv);
 	
@@ -293,6 +292,12 @@ void mame_gamelist_add (MameGamelist *gl, MameRomEntry *rom)
 
 	gl->priv->num_games++;
 
+	/* The clones index is built again when next asked for */
+	if (gl->priv->clones) {
+		g_hash_table_destroy (gl->priv->clones);
+		gl->priv->clones = NULL;
+	}
+
 	if (mame_rom_entry_has_samples (rom))
 		gl->priv->num_sample_games++;
 
@@ -754,6 +759,43 @@ get_rom_from_gamelist_by_name (MameGamelist *gl, gchar *romname)
 	return tmprom;
 }
 
+/* Returns the clones of the parent romset, in gamelist order. The list
+   belongs to the gamelist */
+GList *
+mame_gamelist_get_clones (MameGamelist *gl, const gchar *romname)
+{
+	GList *listpointer;
+
+	g_return_val_if_fail ((gl != NULL), NULL);
+	g_return_val_if_fail ((romname != NULL), NULL);
+
+	if (gl->priv->clones == NULL) {
+		gl->priv->clones = g_hash_table_new_full (g_str_hash, g_str_equal,
+							  NULL, (GDestroyNotify) g_list_free);
+
+		/* Prepended from the end of the gamelist, so each list of
+		   clones is in gamelist order */
+		for (listpointer = g_list_last (gl->priv->roms);
+		     listpointer != NULL;
+		     listpointer = g_list_previous (listpointer)) {
+			MameRomEntry *rom = (MameRomEntry *) listpointer->data;
+			const gchar *parent;
+			GList *clones;
+
+			if (!mame_rom_entry_is_clone (rom))
+				continue;
+
+			parent = mame_rom_entry_get_parent_romname (rom);
+			clones = g_hash_table_lookup (gl->priv->clones, parent);
+			g_hash_table_steal (gl->priv->clones, parent);
+			g_hash_table_insert (gl->priv->clones, (gpointer) parent,
+					     g_list_prepend (clones, rom));
+		}
+	}
+
+	return g_hash_table_lookup (gl->priv->clones, romname);
+}
+
 GList *
 mame_gamelist_get_roms_for_driver (MameGamelist *gl, gchar *driver)
 {
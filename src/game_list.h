@@ -84,6 +84,9 @@ void mame_gamelist_add_manufacturer (MameGamelist *gl, gchar *manufacturer);
 GList *
 mame_gamelist_get_roms_for_driver (MameGamelist *gl, gchar *driver);
 
+GList *
+mame_gamelist_get_clones (MameGamelist *gl, const gchar *romname);
+
 /**
 * Loads the game list from the gamelist file.
 */
@@ -0,0 +1,1141 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#define _LARGEFILE_SOURCE
+#define _FILE_OFFSET_BITS 64	/* Needed for compiling using libarchive on i386 */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+#include <archive.h>
+#include <archive_entry.h>
+
+#include "gmameui-archive.h"
+#include "gmameui-zip-cache.h"
+#include "gui.h"	/* For main_gui.gui_prefs */
+
+/* Files larger than this aren't read from 7z archives or directories */
+#define ARCHIVE_MAX_EXTRACT_SIZE	(256 * 1024 * 1024)
+
+struct _GmameuiArchive {
+	gint ref_count;
+	GmameuiArchiveType type;
+	gchar *path;
+	time_t mtime;
+	goffset size;
+	GArray *entries;	/* ArchiveEntry */
+	GHashTable *by_name;	/* Lowercase name -> ArchiveEntry */
+	ZipDirectory *zipdir;	/* Zip archives only; owns the entry names */
+	GMutex *crc_mutex;	/* Protects the CRCs read after the listing */
+	time_t *mtimes;		/* Directories only - each file's mtime when listed */
+};
+
+/* Each container type is handled by a backend, which fills in the list of
+   entries and extracts the nth entry. Listing only reads the names and
+   sizes; backends whose listing has no CRCs read them when first asked */
+typedef struct {
+	const gchar *extension;		/* NULL for directories */
+	gboolean (*read) (GmameuiArchive *archive);
+	guchar * (*extract) (GmameuiArchive *archive, guint n);
+	void (*read_crc) (GmameuiArchive *archive, guint n);
+	gboolean cached;		/* Whether the listing is kept in the archive cache */
+} ArchiveBackend;
+
+static gboolean zip_backend_read (GmameuiArchive *archive);
+static guchar *zip_backend_extract (GmameuiArchive *archive, guint n);
+static gboolean sevenzip_backend_read (GmameuiArchive *archive);
+static guchar *sevenzip_backend_extract (GmameuiArchive *archive, guint n);
+static void sevenzip_backend_read_crc (GmameuiArchive *archive, guint n);
+static gboolean dir_backend_read (GmameuiArchive *archive);
+static guchar *dir_backend_extract (GmameuiArchive *archive, guint n);
+static void dir_backend_read_crc (GmameuiArchive *archive, guint n);
+
+/* Zip listings are already cached by the zip cache, so aren't cached
+   again here */
+static const ArchiveBackend backends[NUM_GMAMEUI_ARCHIVE_TYPES] = {
+	{ ".zip", zip_backend_read, zip_backend_extract, NULL, FALSE },
+	{ ".7z", sevenzip_backend_read, sevenzip_backend_extract, sevenzip_backend_read_crc, TRUE },
+	{ NULL, dir_backend_read, dir_backend_extract, dir_backend_read_crc, TRUE },
+};
+
+static GStaticMutex archive_cache_mutex = G_STATIC_MUTEX_INIT;
+static GHashTable *archive_cache = NULL;	/* Path -> GmameuiArchive */
+
+/* A ROM path as it was when it was last read */
+typedef struct {
+	gchar *path;
+	time_t mtime;		/* 0 if the path should be read again at the next check */
+	GHashTable *romsets;	/* Romset name -> GmameuiArchiveType */
+} RomPathListing;
+
+/* Seconds between checking whether the ROM paths have changed */
+#define ROM_PATHS_CHECK_INTERVAL 2.0
+
+static GStaticMutex romset_index_mutex = G_STATIC_MUTEX_INIT;
+static GPtrArray *rom_path_listings = NULL;	/* RomPathListing, in ROM path order */
+static GHashTable *romset_index = NULL;		/* Romset name -> path */
+static GTimer *romset_index_timer = NULL;	/* Time since the ROM paths were checked */
+static GValueArray *rom_paths = NULL;		/* Copied from the preferences in the main thread */
+
+#ifdef GMAMEUI_BENCHMARK
+static guint romset_index_stats = 0;		/* stat and opendir calls made by the index */
+#define COUNT_INDEX_STAT() (romset_index_stats++)
+#else
+#define COUNT_INDEX_STAT()
+#endif
+
+static void rom_path_listings_free (void);
+
+static GmameuiArchive *
+archive_new (GmameuiArchiveType type, const gchar *path, struct stat *st)
+{
+	GmameuiArchive *archive;
+
+	archive = g_new0 (GmameuiArchive, 1);
+	archive->ref_count = 1;
+	archive->type = type;
+	archive->path = g_strdup (path);
+	archive->mtime = st->st_mtime;
+	archive->size = st->st_size;
+	archive->entries = g_array_new (FALSE, TRUE, sizeof (ArchiveEntry));
+	archive->by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	archive->crc_mutex = g_mutex_new ();
+
+	return archive;
+}
+
+static void
+archive_free (GmameuiArchive *archive)
+{
+	guint i;
+
+	/* Zip entry names belong to the zip directory */
+	if (archive->zipdir == NULL) {
+		for (i = 0; i < archive->entries->len; i++)
+			g_free ((gchar *) g_array_index (archive->entries, ArchiveEntry, i).name);
+	}
+	gmameui_zip_directory_unref (archive->zipdir);
+
+	g_array_free (archive->entries, TRUE);
+	g_hash_table_destroy (archive->by_name);
+	g_mutex_free (archive->crc_mutex);
+	g_free (archive->mtimes);
+	g_free (archive->path);
+	g_free (archive);
+}
+
+static void
+archive_add_entry (GmameuiArchive *archive, const gchar *name, guint32 crc, gboolean has_crc,
+		   guint64 size)
+{
+	ArchiveEntry entry;
+
+	entry.name = name;
+	entry.crc = crc;
+	entry.has_crc = has_crc;
+	entry.size = size;
+
+	g_array_append_val (archive->entries, entry);
+}
+
+/* Records the CRC of data just read, or checks it against the CRC already
+   read. Returns FALSE if it doesn't match */
+static gboolean
+archive_check_crc (GmameuiArchive *archive, guint n, const guchar *data, guint64 len)
+{
+	ArchiveEntry *entry;
+	guint32 crc;
+	gboolean ok = TRUE;
+
+	entry = &g_array_index (archive->entries, ArchiveEntry, n);
+	crc = crc32 (crc32 (0L, Z_NULL, 0), data, len);
+
+	g_mutex_lock (archive->crc_mutex);
+	if (entry->has_crc) {
+		ok = (entry->crc == crc);
+	} else {
+		entry->crc = crc;
+		entry->has_crc = TRUE;
+	}
+	g_mutex_unlock (archive->crc_mutex);
+
+	return ok;
+}
+
+/* Zip backend - the listing comes from the zip's central directory */
+static gboolean
+zip_backend_read (GmameuiArchive *archive)
+{
+	guint i;
+
+	archive->zipdir = gmameui_zip_cache_lookup (archive->path);
+	if (archive->zipdir == NULL)
+		return FALSE;
+
+	for (i = 0; i < gmameui_zip_directory_get_num_entries (archive->zipdir); i++) {
+		const ZipCacheEntry *entry;
+
+		entry = gmameui_zip_directory_get_nth_entry (archive->zipdir, i);
+		archive_add_entry (archive, entry->name, entry->crc, TRUE, entry->size);
+	}
+
+	return TRUE;
+}
+
+static guchar *
+zip_backend_extract (GmameuiArchive *archive, guint n)
+{
+	return gmameui_zip_directory_extract (archive->zipdir,
+					      gmameui_zip_directory_get_nth_entry (archive->zipdir, n));
+}
+
+/* 7z backend - libarchive doesn't return the CRCs from the 7z headers, so
+   the listing only has the names and sizes. Skipping over the data while
+   listing doesn't decompress it */
+static struct archive *
+sevenzip_open (const gchar *path)
+{
+	struct archive *a;
+
+#if ARCHIVE_VERSION_NUMBER >= 3000000
+	a = archive_read_new ();
+	archive_read_support_format_7zip (a);
+
+	if (archive_read_open_filename (a, path, 10240) != ARCHIVE_OK) {
+		GMAMEUI_DEBUG ("Error opening the archive %s - %s", path, archive_error_string (a));
+		archive_read_free (a);
+		return NULL;
+	}
+#else
+	GMAMEUI_DEBUG ("Can't read %s - libarchive is too old to support 7z", path);
+	a = NULL;
+#endif
+
+	return a;
+}
+
+static void
+sevenzip_close (struct archive *a)
+{
+#if ARCHIVE_VERSION_NUMBER >= 3000000
+	archive_read_close (a);
+	archive_read_free (a);
+#endif
+}
+
+static gboolean
+sevenzip_backend_read (GmameuiArchive *archive)
+{
+	struct archive *a;
+	struct archive_entry *entry;
+	int r;
+
+	a = sevenzip_open (archive->path);
+	if (a == NULL)
+		return FALSE;
+
+	while ((r = archive_read_next_header (a, &entry)) == ARCHIVE_OK) {
+		if (archive_entry_filetype (entry) != AE_IFREG)
+			continue;
+
+		archive_add_entry (archive, g_strdup (archive_entry_pathname (entry)), 0, FALSE,
+				   archive_entry_size (entry));
+	}
+
+	if (r != ARCHIVE_EOF)
+		GMAMEUI_DEBUG ("Error listing %s - %s", archive->path, archive_error_string (a));
+
+	sevenzip_close (a);
+
+	return (r == ARCHIVE_EOF);
+}
+
+/* Reads the CRCs of every file not yet read in a single pass, since the
+   files in a solid block can only be reached by decompressing those
+   before them. Called with the CRC mutex held */
+static void
+sevenzip_backend_read_crc (GmameuiArchive *archive, guint n)
+{
+	struct archive *a;
+	struct archive_entry *entry;
+	guchar buf[65536];
+	guint i = 0;
+
+	a = sevenzip_open (archive->path);
+	if (a == NULL)
+		return;
+
+	while (archive_read_next_header (a, &entry) == ARCHIVE_OK) {
+		ArchiveEntry *listed;
+		guint32 crc;
+		ssize_t len;
+
+		if (archive_entry_filetype (entry) != AE_IFREG)
+			continue;
+
+		if (i >= archive->entries->len)
+			break;
+
+		listed = &g_array_index (archive->entries, ArchiveEntry, i++);
+		if (listed->has_crc)
+			continue;
+
+		crc = crc32 (0L, Z_NULL, 0);
+		while ((len = archive_read_data (a, buf, sizeof (buf))) > 0)
+			crc = crc32 (crc, buf, len);
+
+		if (len < 0) {
+			GMAMEUI_DEBUG ("Error reading %s - %s", archive->path, archive_error_string (a));
+			break;
+		}
+
+		listed->crc = crc;
+		listed->has_crc = TRUE;
+	}
+
+	sevenzip_close (a);
+}
+
+/* Decompresses up to the file and no further, recording its CRC */
+static guchar *
+sevenzip_backend_extract (GmameuiArchive *archive, guint n)
+{
+	struct archive *a;
+	struct archive_entry *entry;
+	const ArchiveEntry *wanted;
+	guchar *data = NULL;
+	guint i = 0;
+
+	wanted = &g_array_index (archive->entries, ArchiveEntry, n);
+	if (wanted->size > ARCHIVE_MAX_EXTRACT_SIZE)
+		return NULL;
+
+	a = sevenzip_open (archive->path);
+	if (a == NULL)
+		return NULL;
+
+	/* Entries are in the same order as when the archive was listed */
+	while (archive_read_next_header (a, &entry) == ARCHIVE_OK) {
+		if (archive_entry_filetype (entry) != AE_IFREG)
+			continue;
+
+		if (i++ == n) {
+			guint64 total = 0;
+			ssize_t len = 0;
+
+			/* libarchive may return less than asked for at a time */
+			data = g_malloc (wanted->size ? wanted->size : 1);
+			while ((total < wanted->size) &&
+			       ((len = archive_read_data (a, data + total, wanted->size - total)) > 0))
+				total += len;
+
+			if ((total != wanted->size) || !archive_check_crc (archive, n, data, total)) {
+				GMAMEUI_DEBUG ("Could not extract %s from %s", wanted->name, archive->path);
+				g_free (data);
+				data = NULL;
+			}
+			break;
+		}
+	}
+
+	sevenzip_close (a);
+
+	return data;
+}
+
+/* Directory backend - the listing only stats each file. A file is only
+   read for its CRC when asked, and is checked against its size and mtime
+   from the listing, since changing a file doesn't change the directory */
+static gboolean
+dir_backend_read (GmameuiArchive *archive)
+{
+	GDir *dir;
+	const gchar *name;
+	GArray *mtimes;
+
+	dir = g_dir_open (archive->path, 0, NULL);
+	if (dir == NULL)
+		return FALSE;
+
+	mtimes = g_array_new (FALSE, FALSE, sizeof (time_t));
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		gchar *filename;
+		struct stat st;
+		gboolean is_file;
+
+		filename = g_build_filename (archive->path, name, NULL);
+		is_file = (g_stat (filename, &st) == 0) && S_ISREG (st.st_mode);
+		g_free (filename);
+
+		if (!is_file)
+			continue;
+
+		archive_add_entry (archive, g_strdup (name), 0, FALSE, st.st_size);
+		g_array_append_val (mtimes, st.st_mtime);
+	}
+
+	g_dir_close (dir);
+
+	archive->mtimes = (time_t *) g_array_free (mtimes, FALSE);
+
+	return TRUE;
+}
+
+/* Returns the file's contents, or NULL if it has changed since the
+   directory was listed, in which case the listing is dropped */
+static gchar *
+dir_read_file (GmameuiArchive *archive, guint n, gsize *len)
+{
+	const ArchiveEntry *entry;
+	gchar *filename;
+	gchar *data = NULL;
+	struct stat st;
+
+	entry = &g_array_index (archive->entries, ArchiveEntry, n);
+	filename = g_build_filename (archive->path, entry->name, NULL);
+
+	if ((g_stat (filename, &st) != 0) ||
+	    ((guint64) st.st_size != entry->size) || (st.st_mtime != archive->mtimes[n])) {
+		GMAMEUI_DEBUG ("%s in %s has changed since it was listed", entry->name, archive->path);
+		gmameui_archive_invalidate (archive->path);
+	} else if (!g_file_get_contents (filename, &data, len, NULL) || (*len != entry->size)) {
+		g_free (data);
+		data = NULL;
+	}
+
+	g_free (filename);
+
+	return data;
+}
+
+/* Called with the CRC mutex held */
+static void
+dir_backend_read_crc (GmameuiArchive *archive, guint n)
+{
+	ArchiveEntry *entry;
+	gchar *data;
+	gsize len;
+
+	entry = &g_array_index (archive->entries, ArchiveEntry, n);
+	if (entry->size > ARCHIVE_MAX_EXTRACT_SIZE)
+		return;
+
+	data = dir_read_file (archive, n, &len);
+	if (data) {
+		entry->crc = crc32 (crc32 (0L, Z_NULL, 0), (guchar *) data, len);
+		entry->has_crc = TRUE;
+		g_free (data);
+	}
+}
+
+static guchar *
+dir_backend_extract (GmameuiArchive *archive, guint n)
+{
+	const ArchiveEntry *entry;
+	gchar *data;
+	gsize len;
+
+	entry = &g_array_index (archive->entries, ArchiveEntry, n);
+	if (entry->size > ARCHIVE_MAX_EXTRACT_SIZE)
+		return NULL;
+
+	data = dir_read_file (archive, n, &len);
+	if (data && !archive_check_crc (archive, n, (guchar *) data, len)) {
+		GMAMEUI_DEBUG ("%s in %s has changed since its CRC was read", entry->name, archive->path);
+		gmameui_archive_invalidate (archive->path);
+		g_free (data);
+		data = NULL;
+	}
+
+	return (guchar *) data;
+}
+
+static GmameuiArchiveType
+get_archive_type_for_path (const gchar *path, struct stat *st)
+{
+	const gchar *ext;
+
+	if (S_ISDIR (st->st_mode))
+		return GMAMEUI_ARCHIVE_DIR;
+
+	ext = strrchr (path, '.');
+	if (ext && (g_ascii_strcasecmp (ext, backends[GMAMEUI_ARCHIVE_7Z].extension) == 0))
+		return GMAMEUI_ARCHIVE_7Z;
+
+	return GMAMEUI_ARCHIVE_ZIP;
+}
+
+static GmameuiArchive *
+archive_read (const gchar *path, struct stat *st)
+{
+	GmameuiArchive *archive;
+	guint i;
+
+	archive = archive_new (get_archive_type_for_path (path, st), path, st);
+
+	if (!backends[archive->type].read (archive)) {
+		archive_free (archive);
+		return NULL;
+	}
+
+	for (i = 0; i < archive->entries->len; i++) {
+		ArchiveEntry *entry = &g_array_index (archive->entries, ArchiveEntry, i);
+
+		g_hash_table_insert (archive->by_name, g_ascii_strdown (entry->name, -1), entry);
+	}
+
+	return archive;
+}
+
+/**
+ * gmameui_archive_open:
+ * @path: full path to a zip or 7z file, or a directory
+ *
+ * Returns the listing of the archive, reading it only if it is not already
+ * cached or has changed since it was read. If @path doesn't exist, the
+ * same name with each of the other archive types is tried, so that
+ * "snap.zip" also finds "snap.7z" or a "snap" directory. Returns NULL if no
+ * archive is found. The result must be released with gmameui_archive_unref.
+ */
+GmameuiArchive *
+gmameui_archive_open (const gchar *path)
+{
+	GmameuiArchive *archive;
+	struct stat st;
+
+	g_return_val_if_fail (path != NULL, NULL);
+
+	if (g_stat (path, &st) != 0) {
+		const gchar *ext;
+		gchar *base;
+		guint i;
+
+		gmameui_archive_invalidate (path);
+
+		/* Only try the alternatives for a known archive extension */
+		ext = strrchr (path, '.');
+		if ((ext == NULL) ||
+		    ((g_ascii_strcasecmp (ext, backends[GMAMEUI_ARCHIVE_ZIP].extension) != 0) &&
+		     (g_ascii_strcasecmp (ext, backends[GMAMEUI_ARCHIVE_7Z].extension) != 0)))
+			return NULL;
+
+		base = g_strndup (path, ext - path);
+		archive = NULL;
+		for (i = 0; (archive == NULL) && (i < NUM_GMAMEUI_ARCHIVE_TYPES); i++) {
+			gchar *alt;
+
+			if (backends[i].extension && g_ascii_strcasecmp (backends[i].extension, ext) == 0)
+				continue;
+
+			alt = g_strconcat (base, backends[i].extension, NULL);
+			if (g_stat (alt, &st) == 0)
+				archive = gmameui_archive_open (alt);
+			g_free (alt);
+		}
+		g_free (base);
+
+		return archive;
+	}
+
+	if (!backends[get_archive_type_for_path (path, &st)].cached)
+		return archive_read (path, &st);
+
+	g_static_mutex_lock (&archive_cache_mutex);
+
+	if (!archive_cache)
+		archive_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       NULL, (GDestroyNotify) gmameui_archive_unref);
+
+	archive = g_hash_table_lookup (archive_cache, path);
+	if (archive && ((archive->mtime != st.st_mtime) || (archive->size != st.st_size))) {
+		g_hash_table_remove (archive_cache, path);
+		archive = NULL;
+	}
+
+	if (archive)
+		g_atomic_int_inc (&archive->ref_count);
+
+	g_static_mutex_unlock (&archive_cache_mutex);
+
+	if (archive)
+		return archive;
+
+	/* Read outside the lock, as for the zip cache */
+	archive = archive_read (path, &st);
+	if (!archive)
+		return NULL;
+
+	g_static_mutex_lock (&archive_cache_mutex);
+	g_atomic_int_inc (&archive->ref_count);
+	g_hash_table_replace (archive_cache, archive->path, archive);
+	g_static_mutex_unlock (&archive_cache_mutex);
+
+	return archive;
+}
+
+/* Returns the archive holding the romset, in whichever form it is in the
+   ROM paths */
+GmameuiArchive *
+gmameui_archive_open_romset (const gchar *romname)
+{
+	GmameuiArchive *archive;
+	gchar *path;
+
+	g_return_val_if_fail (romname != NULL, NULL);
+
+	path = gmameui_archive_find_romset (romname);
+	if (path == NULL)
+		return NULL;
+
+	archive = gmameui_archive_open (path);
+	g_free (path);
+
+	return archive;
+}
+
+GmameuiArchive *
+gmameui_archive_ref (GmameuiArchive *archive)
+{
+	g_return_val_if_fail (archive != NULL, NULL);
+
+	g_atomic_int_inc (&archive->ref_count);
+
+	return archive;
+}
+
+void
+gmameui_archive_unref (GmameuiArchive *archive)
+{
+	if (!archive)
+		return;
+
+	if (g_atomic_int_dec_and_test (&archive->ref_count))
+		archive_free (archive);
+}
+
+GmameuiArchiveType
+gmameui_archive_get_archive_type (GmameuiArchive *archive)
+{
+	g_return_val_if_fail (archive != NULL, GMAMEUI_ARCHIVE_ZIP);
+
+	return archive->type;
+}
+
+const gchar *
+gmameui_archive_get_path (GmameuiArchive *archive)
+{
+	g_return_val_if_fail (archive != NULL, NULL);
+
+	return archive->path;
+}
+
+/* Bytes the archive takes on disk. For a directory, the total size of
+   its files */
+guint64
+gmameui_archive_get_size (GmameuiArchive *archive)
+{
+	guint64 size;
+	guint i;
+
+	g_return_val_if_fail (archive != NULL, 0);
+
+	if (archive->type != GMAMEUI_ARCHIVE_DIR)
+		return (guint64) archive->size;
+
+	size = 0;
+	for (i = 0; i < archive->entries->len; i++)
+		size += g_array_index (archive->entries, ArchiveEntry, i).size;
+
+	return size;
+}
+
+guint
+gmameui_archive_get_num_entries (GmameuiArchive *archive)
+{
+	g_return_val_if_fail (archive != NULL, 0);
+
+	return archive->entries->len;
+}
+
+const ArchiveEntry *
+gmameui_archive_get_nth_entry (GmameuiArchive *archive, guint n)
+{
+	g_return_val_if_fail (archive != NULL, NULL);
+	g_return_val_if_fail (n < archive->entries->len, NULL);
+
+	return &g_array_index (archive->entries, ArchiveEntry, n);
+}
+
+/* Names are compared ignoring case, as MAME does */
+const ArchiveEntry *
+gmameui_archive_find (GmameuiArchive *archive, const gchar *name)
+{
+	const ArchiveEntry *entry;
+	gchar *key;
+
+	g_return_val_if_fail (archive != NULL, NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	key = g_ascii_strdown (name, -1);
+	entry = g_hash_table_lookup (archive->by_name, key);
+	g_free (key);
+
+	return entry;
+}
+
+/* Returns the CRC of the file. For 7z archives and directories this reads
+   the file, and for 7z the other files whose CRCs haven't been read, so
+   shouldn't be called from the main thread. Returns FALSE if the file
+   couldn't be read */
+gboolean
+gmameui_archive_get_crc (GmameuiArchive *archive, const ArchiveEntry *entry, guint32 *crc)
+{
+	guint n;
+	gboolean ok;
+
+	g_return_val_if_fail (archive != NULL, FALSE);
+	g_return_val_if_fail (entry != NULL, FALSE);
+	g_return_val_if_fail (crc != NULL, FALSE);
+
+	n = entry - (const ArchiveEntry *) archive->entries->data;
+	g_return_val_if_fail (n < archive->entries->len, FALSE);
+
+	g_mutex_lock (archive->crc_mutex);
+	if (!entry->has_crc && backends[archive->type].read_crc)
+		backends[archive->type].read_crc (archive, n);
+	ok = entry->has_crc;
+	*crc = entry->crc;
+	g_mutex_unlock (archive->crc_mutex);
+
+	return ok;
+}
+
+/* Returns a newly allocated buffer of entry->size bytes, or NULL if the
+   file could not be read or its CRC is wrong */
+guchar *
+gmameui_archive_extract (GmameuiArchive *archive, const ArchiveEntry *entry)
+{
+	guint n;
+
+	g_return_val_if_fail (archive != NULL, NULL);
+	g_return_val_if_fail (entry != NULL, NULL);
+
+	n = entry - (const ArchiveEntry *) archive->entries->data;
+	g_return_val_if_fail (n < archive->entries->len, NULL);
+
+	return backends[archive->type].extract (archive, n);
+}
+
+void
+gmameui_archive_invalidate (const gchar *path)
+{
+	g_return_if_fail (path != NULL);
+
+	g_static_mutex_lock (&archive_cache_mutex);
+	if (archive_cache)
+		g_hash_table_remove (archive_cache, path);
+	g_static_mutex_unlock (&archive_cache_mutex);
+
+	gmameui_zip_cache_invalidate (path);
+}
+
+void
+gmameui_archive_cache_clear (void)
+{
+	g_static_mutex_lock (&archive_cache_mutex);
+	if (archive_cache) {
+		g_hash_table_destroy (archive_cache);
+		archive_cache = NULL;
+	}
+	g_static_mutex_unlock (&archive_cache_mutex);
+
+	g_static_mutex_lock (&romset_index_mutex);
+	rom_path_listings_free ();
+	g_static_mutex_unlock (&romset_index_mutex);
+}
+
+/* Lists the <name>.zip, <name>.7z and <name> directories in a ROM path.
+   Zips take precedence over 7z over directories, as they do in MAME */
+static RomPathListing *
+rom_path_listing_new (const gchar *rompath, time_t mtime)
+{
+	RomPathListing *listing;
+	DIR *dir;
+	struct dirent *dent;
+
+	listing = g_new0 (RomPathListing, 1);
+	listing->path = g_strdup (rompath);
+	listing->romsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	/* A change made within the same second as the listing wouldn't change
+	   the mtime, so such paths are read again at the next check */
+	listing->mtime = (mtime < time (NULL) - 1) ? mtime : 0;
+
+	COUNT_INDEX_STAT ();
+	dir = opendir (rompath);
+	if (!dir) {
+		GMAMEUI_DEBUG ("Could not open ROM path %s", rompath);
+		return listing;
+	}
+
+	while ((dent = readdir (dir)) != NULL) {
+		GmameuiArchiveType type;
+		const gchar *ext;
+		gchar *romname;
+		gpointer prev;
+
+		if (dent->d_name[0] == '.')
+			continue;
+
+		ext = strrchr (dent->d_name, '.');
+		if (ext && g_ascii_strcasecmp (ext, backends[GMAMEUI_ARCHIVE_ZIP].extension) == 0)
+			type = GMAMEUI_ARCHIVE_ZIP;
+		else if (ext && g_ascii_strcasecmp (ext, backends[GMAMEUI_ARCHIVE_7Z].extension) == 0)
+			type = GMAMEUI_ARCHIVE_7Z;
+		else {
+			gboolean is_dir;
+
+			/* Only stat the entry if readdir can't tell us it is a directory */
+#if defined (_DIRENT_HAVE_D_TYPE) && defined (DT_DIR)
+			if (dent->d_type != DT_UNKNOWN && dent->d_type != DT_LNK)
+				is_dir = (dent->d_type == DT_DIR);
+			else
+#endif
+			{
+				gchar *path = g_build_filename (rompath, dent->d_name, NULL);
+				COUNT_INDEX_STAT ();
+				is_dir = g_file_test (path, G_FILE_TEST_IS_DIR);
+				g_free (path);
+			}
+
+			if (!is_dir)
+				continue;
+
+			type = GMAMEUI_ARCHIVE_DIR;
+			ext = NULL;
+		}
+
+		romname = ext ? g_strndup (dent->d_name, ext - dent->d_name) : g_strdup (dent->d_name);
+
+		if (g_hash_table_lookup_extended (listing->romsets, romname, NULL, &prev) &&
+		    (GPOINTER_TO_INT (prev) <= type)) {
+			g_free (romname);
+			continue;
+		}
+
+		g_hash_table_replace (listing->romsets, romname, GINT_TO_POINTER (type));
+	}
+
+	closedir (dir);
+
+	return listing;
+}
+
+static void
+rom_path_listing_free (RomPathListing *listing)
+{
+	if (listing == NULL)
+		return;
+
+	g_hash_table_destroy (listing->romsets);
+	g_free (listing->path);
+	g_free (listing);
+}
+
+/* Must be called with romset_index_mutex held */
+static void
+rom_path_listings_free (void)
+{
+	if (rom_path_listings) {
+		g_ptr_array_foreach (rom_path_listings, (GFunc) rom_path_listing_free, NULL);
+		g_ptr_array_free (rom_path_listings, TRUE);
+		rom_path_listings = NULL;
+	}
+
+	if (romset_index) {
+		g_hash_table_destroy (romset_index);
+		romset_index = NULL;
+	}
+}
+
+/* Merges the listings into the index. Earlier ROM paths take precedence,
+   as they do in MAME */
+static GHashTable *
+romset_index_new (GPtrArray *listings)
+{
+	GHashTable *index;
+	guint i;
+
+	index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	for (i = 0; i < listings->len; i++) {
+		RomPathListing *listing = g_ptr_array_index (listings, i);
+		GHashTableIter iter;
+		gpointer key, value;
+
+		g_hash_table_iter_init (&iter, listing->romsets);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			GmameuiArchiveType type = GPOINTER_TO_INT (value);
+			gchar *filename;
+
+			if (g_hash_table_lookup (index, key))
+				continue;
+
+			filename = g_strconcat ((gchar *) key, backends[type].extension, NULL);
+			g_hash_table_insert (index, g_strdup (key),
+					     g_build_filename (listing->path, filename, NULL));
+			g_free (filename);
+		}
+	}
+
+	return index;
+}
+
+/* Reads any ROM path that has been added or whose mtime has changed since
+   it was last read, and rebuilds the index if anything changed. Adding,
+   removing or renaming a romset changes the mtime of its ROM path. Unless
+   check_now is set, the paths are only checked every few seconds. Must be
+   called with romset_index_mutex held */
+static void
+romset_index_update (gboolean check_now)
+{
+	GPtrArray *listings;
+	GValueArray *va_rom_paths;
+	gboolean changed;
+	guint i;
+
+	if (!romset_index_timer)
+		romset_index_timer = g_timer_new ();
+	else if (!check_now && romset_index &&
+		 (g_timer_elapsed (romset_index_timer, NULL) < ROM_PATHS_CHECK_INTERVAL))
+		return;
+
+	listings = g_ptr_array_new ();
+	changed = (romset_index == NULL);
+
+	/* Worker threads find romsets too, so the preferences aren't read here */
+	va_rom_paths = rom_paths;
+	for (i = 0; va_rom_paths && (i < va_rom_paths->n_values); i++) {
+		RomPathListing *listing = NULL;
+		const gchar *rompath;
+		struct stat st;
+		time_t mtime = 0;
+
+		rompath = g_value_get_string (g_value_array_get_nth (va_rom_paths, i));
+
+		COUNT_INDEX_STAT ();
+		if (g_stat (rompath, &st) == 0)
+			mtime = st.st_mtime;
+
+		/* Keep the previous listing of the path if it hasn't changed */
+		if (rom_path_listings && (i < rom_path_listings->len)) {
+			listing = g_ptr_array_index (rom_path_listings, i);
+			if (listing && (listing->mtime != 0) && (listing->mtime == mtime) &&
+			    (g_ascii_strcasecmp (listing->path, rompath) == 0))
+				g_ptr_array_index (rom_path_listings, i) = NULL;
+			else
+				listing = NULL;
+		}
+
+		if (listing == NULL) {
+			listing = rom_path_listing_new (rompath, mtime);
+			changed = TRUE;
+		}
+
+		g_ptr_array_add (listings, listing);
+	}
+
+	/* ROM paths removed since the last check */
+	if (rom_path_listings && (rom_path_listings->len != listings->len))
+		changed = TRUE;
+
+	if (changed) {
+		rom_path_listings_free ();
+		romset_index = romset_index_new (listings);
+	} else {
+		g_ptr_array_foreach (rom_path_listings, (GFunc) rom_path_listing_free, NULL);
+		g_ptr_array_free (rom_path_listings, TRUE);
+	}
+	rom_path_listings = listings;
+
+	g_timer_start (romset_index_timer);
+}
+
+/**
+ * gmameui_archive_index_rom_paths:
+ *
+ * Brings the index of romsets present in the ROM paths up to date. Only
+ * the ROM paths that have changed since they were last read are read
+ * again, so finding a romset afterwards doesn't touch the disk. Must be
+ * called from the main thread, which reads the ROM paths from the
+ * preferences for the other threads.
+ */
+void
+gmameui_archive_index_rom_paths (void)
+{
+	static gboolean watching = FALSE;
+	GValueArray *va_rom_paths;
+
+	/* Only called from the main thread, so the preferences can be read */
+	if (!watching) {
+		g_signal_connect_swapped (main_gui.gui_prefs, "notify::rom-paths",
+					  G_CALLBACK (gmameui_archive_index_rom_paths), NULL);
+		watching = TRUE;
+	}
+
+	g_object_get (main_gui.gui_prefs, "rom-paths", &va_rom_paths, NULL);
+
+	g_static_mutex_lock (&romset_index_mutex);
+	if (rom_paths)
+		g_value_array_free (rom_paths);
+	rom_paths = va_rom_paths;
+	romset_index_update (TRUE);
+	g_static_mutex_unlock (&romset_index_mutex);
+}
+
+/* Returns a copy of the ROM paths, which can be used from any thread. The
+   result must be freed with g_value_array_free */
+GValueArray *
+gmameui_archive_get_rom_paths (void)
+{
+	GValueArray *va_rom_paths;
+
+	g_static_mutex_lock (&romset_index_mutex);
+	va_rom_paths = rom_paths ? g_value_array_copy (rom_paths) : NULL;
+	g_static_mutex_unlock (&romset_index_mutex);
+
+	return va_rom_paths;
+}
+
+/* Returns the full path of the romset's archive, or NULL if it isn't in the
+   ROM paths. The result must be freed */
+gchar *
+gmameui_archive_find_romset (const gchar *romname)
+{
+	gchar *path;
+
+	g_return_val_if_fail (romname != NULL, NULL);
+
+	g_static_mutex_lock (&romset_index_mutex);
+	romset_index_update (FALSE);
+	path = g_strdup (g_hash_table_lookup (romset_index, romname));
+	g_static_mutex_unlock (&romset_index_mutex);
+
+	return path;
+}
+
+gboolean
+gmameui_archive_romset_exists (const gchar *romname)
+{
+	gboolean exists;
+
+	g_return_val_if_fail (romname != NULL, FALSE);
+
+	g_static_mutex_lock (&romset_index_mutex);
+	romset_index_update (FALSE);
+	exists = (g_hash_table_lookup (romset_index, romname) != NULL);
+	g_static_mutex_unlock (&romset_index_mutex);
+
+	return exists;
+}
+
+/* Calls func with the name and path of each romset in the ROM paths */
+void
+gmameui_archive_foreach_romset (GHFunc func, gpointer user_data)
+{
+	g_return_if_fail (func != NULL);
+
+	g_static_mutex_lock (&romset_index_mutex);
+	romset_index_update (FALSE);
+	g_hash_table_foreach (romset_index, func, user_data);
+	g_static_mutex_unlock (&romset_index_mutex);
+}
+
+#ifdef GMAMEUI_BENCHMARK
+/* Finds each romset by testing for <path>/<romset>.zip in each ROM path,
+   as the romset's location used to be found, and then through the index
+   read from scratch. Prints the stat calls and time taken by each */
+void
+gmameui_archive_benchmark_rom_paths (GList *romnames)
+{
+	GValueArray *va_rom_paths;
+	GTimer *timer;
+	GList *ptr;
+	guint probe_stats = 0, probe_found = 0, index_found = 0;
+	gdouble probe_time, index_time;
+
+	timer = g_timer_new ();
+
+	for (ptr = romnames; ptr; ptr = g_list_next (ptr)) {
+		guint i;
+
+		g_object_get (main_gui.gui_prefs, "rom-paths", &va_rom_paths, NULL);
+		for (i = 0; va_rom_paths && (i < va_rom_paths->n_values); i++) {
+			gchar *filename;
+			gchar *path;
+			gboolean found;
+
+			filename = g_strdup_printf ("%s.zip", (gchar *) ptr->data);
+			path = g_build_filename (g_value_get_string (g_value_array_get_nth (va_rom_paths, i)),
+						 filename, NULL);
+			probe_stats++;
+			found = g_file_test (path, G_FILE_TEST_EXISTS);
+			g_free (path);
+			g_free (filename);
+
+			if (found) {
+				probe_found++;
+				break;
+			}
+		}
+		if (va_rom_paths)
+			g_value_array_free (va_rom_paths);
+	}
+	probe_time = g_timer_elapsed (timer, NULL);
+
+	g_static_mutex_lock (&romset_index_mutex);
+	rom_path_listings_free ();
+	g_static_mutex_unlock (&romset_index_mutex);
+	romset_index_stats = 0;
+
+	g_timer_start (timer);
+	for (ptr = romnames; ptr; ptr = g_list_next (ptr)) {
+		if (gmameui_archive_romset_exists ((gchar *) ptr->data))
+			index_found++;
+	}
+	index_time = g_timer_elapsed (timer, NULL);
+
+	g_print ("ROM path benchmark for %d romsets - probing: %d found, %d stats, %.3f seconds; "
+		 "index: %d found, %d stats, %.3f seconds\n",
+		 g_list_length (romnames),
+		 probe_found, probe_stats, probe_time,
+		 index_found, romset_index_stats, index_time);
+
+	g_timer_destroy (timer);
+}
+#endif
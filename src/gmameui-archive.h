@@ -0,0 +1,115 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_ARCHIVE_H__
+#define __GMAMEUI_ARCHIVE_H__
+
+#include "common.h"
+
+G_BEGIN_DECLS
+
+/* Containers MAME can load a romset from, in the order they are looked for */
+typedef enum {
+	GMAMEUI_ARCHIVE_ZIP,
+	GMAMEUI_ARCHIVE_7Z,
+	GMAMEUI_ARCHIVE_DIR,
+	NUM_GMAMEUI_ARCHIVE_TYPES
+} GmameuiArchiveType;
+
+/* A file within an archive. Only zips list the CRCs, so for other
+   archives the CRC is read by gmameui_archive_get_crc */
+typedef struct {
+	const gchar *name;
+	guint32 crc;		/* Only valid if has_crc is set */
+	gboolean has_crc;
+	guint64 size;
+} ArchiveEntry;
+
+/* The listing of an archive. Archives are shared, so must be released with
+   gmameui_archive_unref when no longer needed */
+typedef struct _GmameuiArchive GmameuiArchive;
+
+GmameuiArchive *
+gmameui_archive_open (const gchar *path);
+
+GmameuiArchive *
+gmameui_archive_open_romset (const gchar *romname);
+
+GmameuiArchive *
+gmameui_archive_ref (GmameuiArchive *archive);
+
+void
+gmameui_archive_unref (GmameuiArchive *archive);
+
+GmameuiArchiveType
+gmameui_archive_get_archive_type (GmameuiArchive *archive);
+
+const gchar *
+gmameui_archive_get_path (GmameuiArchive *archive);
+
+guint64
+gmameui_archive_get_size (GmameuiArchive *archive);
+
+guint
+gmameui_archive_get_num_entries (GmameuiArchive *archive);
+
+const ArchiveEntry *
+gmameui_archive_get_nth_entry (GmameuiArchive *archive, guint n);
+
+const ArchiveEntry *
+gmameui_archive_find (GmameuiArchive *archive, const gchar *name);
+
+gboolean
+gmameui_archive_get_crc (GmameuiArchive *archive, const ArchiveEntry *entry, guint32 *crc);
+
+guchar *
+gmameui_archive_extract (GmameuiArchive *archive, const ArchiveEntry *entry);
+
+void
+gmameui_archive_invalidate (const gchar *path);
+
+void
+gmameui_archive_cache_clear (void);
+
+/* Romsets present in the ROM paths. Each path is read once, and again
+   only once its mtime has changed */
+void
+gmameui_archive_index_rom_paths (void);
+
+GValueArray *
+gmameui_archive_get_rom_paths (void);
+
+gchar *
+gmameui_archive_find_romset (const gchar *romname);
+
+gboolean
+gmameui_archive_romset_exists (const gchar *romname);
+
+void
+gmameui_archive_foreach_romset (GHFunc func, gpointer user_data);
+
+#ifdef GMAMEUI_BENCHMARK
+void
+gmameui_archive_benchmark_rom_paths (GList *romnames);
+#endif
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_ARCHIVE_H__ */
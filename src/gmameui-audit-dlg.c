@@ -28,6 +28,7 @@
 #include "audit.h"
 #include "gmameui-gamelist-view.h"
 #include "gmameui-audit-dlg.h"
+#include "gmameui-fixdat.h"
 
 struct _MameAuditDialogPrivate {
 	GtkBuilder *builder;
@@ -45,6 +46,7 @@ struct _MameAuditDialogPrivate {
 	
 	GtkWidget *close_audit_button;
 	GtkWidget *stop_audit_button;
+	GtkWidget *fixdat_button;
 
 	/* Audit running count labels */
 	GtkWidget *correct_roms_value;
@@ -84,6 +86,8 @@ struct _MameAuditDialogPrivate {
 
 G_DEFINE_TYPE (MameAuditDialog, mame_audit_dialog, GTK_TYPE_DIALOG)
 
+#define RESPONSE_FIXDAT 1
+
 /* Function prototypes */
 static gboolean
 progress_timeout                        (gpointer user_data);
@@ -249,6 +253,10 @@ mame_audit_dialog_init (MameAuditDialog *dialog)
 	priv->timer = gdk_threads_add_timeout (100, progress_timeout, priv->pbar);
 	
 	/* Buttons */
+	priv->fixdat_button = gtk_dialog_add_button (GTK_DIALOG (dialog),
+	                                             _("Export _Fixdat..."),
+	                                             RESPONSE_FIXDAT);
+
 	priv->stop_audit_button = gtk_dialog_add_button (GTK_DIALOG (dialog),
 	                                                 GTK_STOCK_STOP,
 	                                                 GTK_RESPONSE_REJECT);
@@ -258,6 +266,7 @@ mame_audit_dialog_init (MameAuditDialog *dialog)
 	                                                  GTK_RESPONSE_CLOSE);
 	
 	gtk_widget_set_sensitive (priv->close_audit_button, FALSE);
+	gtk_widget_set_sensitive (priv->fixdat_button, FALSE);
 		
 	/* Signal emitted whenever the audit process processes a romset or sampleset line */
 	priv->romset_sigid = g_signal_connect (gui_prefs.audit, "romset-audited",
@@ -294,6 +303,45 @@ mame_audit_dialog_new (GtkWindow *parent)
 
 }
 
+/* Saves the missing and bad ROMs found by the audit as a Logiqx DAT */
+static void
+export_fixdat (GtkDialog *dialog)
+{
+	GtkWidget *chooser;
+	GError *error = NULL;
+
+	chooser = gtk_file_chooser_dialog_new (_("Export Fixdat"),
+					       GTK_WINDOW (dialog),
+					       GTK_FILE_CHOOSER_ACTION_SAVE,
+					       GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+					       GTK_STOCK_SAVE, GTK_RESPONSE_ACCEPT,
+					       NULL);
+	gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (chooser), TRUE);
+	gtk_file_chooser_set_current_name (GTK_FILE_CHOOSER (chooser), "fixdat.dat");
+
+	if (gtk_dialog_run (GTK_DIALOG (chooser)) == GTK_RESPONSE_ACCEPT) {
+		gchar *filename;
+		guint num_romsets;
+
+		filename = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (chooser));
+		if (gmameui_fixdat_write (gui_prefs.audit_store, gui_prefs.gl,
+					  mame_exec_list_get_current_executable (main_gui.exec_list),
+					  filename, &num_romsets, &error)) {
+			gchar *msg;
+
+			msg = g_strdup_printf (_("Fixdat for %d romsets saved"), num_romsets);
+			update_text_buffer (MAME_AUDIT_DIALOG (dialog), msg);
+			g_free (msg);
+		} else {
+			gmameui_message (ERROR, GTK_WINDOW (dialog), "%s", error->message);
+			g_error_free (error);
+		}
+		g_free (filename);
+	}
+
+	gtk_widget_destroy (chooser);
+}
+
 static void
 mame_audit_dialog_response (GtkDialog *dialog, gint response)
 {
@@ -303,6 +351,12 @@ mame_audit_dialog_response (GtkDialog *dialog, gint response)
 					    MAME_TYPE_AUDIT_DIALOG,
 					    MameAuditDialogPrivate);
 	
+	/* The audit has finished - the dialog stays open */
+	if (response == RESPONSE_FIXDAT) {
+		export_fixdat (dialog);
+		return;
+	}
+
 	/* Stop the progress bar pulsing if it is in progress */
 	if (priv->timer > 0) {
 		g_source_remove (priv->timer);
@@ -531,6 +585,7 @@ gmameui_audit_window_update_complete (MameAuditDialog *dlg)
 	
 	gtk_widget_set_sensitive (dlg->priv->stop_audit_button, FALSE);
 	gtk_widget_set_sensitive (dlg->priv->close_audit_button, TRUE);
+	gtk_widget_set_sensitive (dlg->priv->fixdat_button, TRUE);
 
 }
 
@@ -0,0 +1,528 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/* Persistent store of audit results. The file is a compact binary format,
+   all integers little-endian, strings as a guint16 length then the bytes:
+
+     "GMAS" guint32 format
+     guint32 number of versions, then each version string
+     guint32 number of records, then each record:
+       string romname
+       guint8 ROM status, guint8 sample status
+       guint64 audit time
+       guint16 index of the version string
+       guint16 number of chips, then each chip:
+         string name, guint8 status
+
+   The file is always rewritten in full to a temporary file which is then
+   renamed over the old one, so a crash leaves either the old or new store */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>	/* For fsync */
+#include <glib/gstdio.h>
+
+#include "gmameui-audit-store.h"
+
+#define AUDIT_STORE_MAGIC "GMAS"
+#define AUDIT_STORE_FORMAT 1
+
+struct _GmameuiAuditStore {
+	gchar *filename;
+	GHashTable *records;	/* romname -> AuditRecord */
+	GHashTable *versions;	/* Interned version strings */
+	gboolean dirty;
+};
+
+AuditChipResult *
+gmameui_audit_chip_result_new (const gchar *name, AuditChipStatus status)
+{
+	AuditChipResult *chip;
+
+	g_return_val_if_fail (name != NULL, NULL);
+
+	chip = g_new0 (AuditChipResult, 1);
+	chip->name = g_strdup (name);
+	chip->status = status;
+
+	return chip;
+}
+
+void
+gmameui_audit_chip_result_free (AuditChipResult *chip)
+{
+	if (!chip)
+		return;
+
+	g_free (chip->name);
+	g_free (chip);
+}
+
+static void
+audit_record_free_chips (AuditRecord *record)
+{
+	g_list_foreach (record->chips, (GFunc) gmameui_audit_chip_result_free, NULL);
+	g_list_free (record->chips);
+	record->chips = NULL;
+}
+
+static void
+audit_record_free (AuditRecord *record)
+{
+	audit_record_free_chips (record);
+	g_free (record);
+}
+
+static AuditRecord *
+audit_store_get_record (GmameuiAuditStore *store, const gchar *romname)
+{
+	AuditRecord *record;
+
+	record = g_hash_table_lookup (store->records, romname);
+	if (!record) {
+		record = g_new0 (AuditRecord, 1);
+		record->rom_status = UNKNOWN;
+		record->sample_status = UNKNOWN;
+		g_hash_table_insert (store->records, g_strdup (romname), record);
+	}
+
+	return record;
+}
+
+static const gchar *
+audit_store_intern_version (GmameuiAuditStore *store, const gchar *version)
+{
+	gchar *interned;
+
+	if (!version)
+		version = "";
+
+	interned = g_hash_table_lookup (store->versions, version);
+	if (!interned) {
+		interned = g_strdup (version);
+		g_hash_table_insert (store->versions, interned, interned);
+	}
+
+	return interned;
+}
+
+GmameuiAuditStore *
+gmameui_audit_store_new (const gchar *filename)
+{
+	GmameuiAuditStore *store;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	store = g_new0 (GmameuiAuditStore, 1);
+	store->filename = g_strdup (filename);
+	store->records = g_hash_table_new_full (g_str_hash, g_str_equal,
+						g_free, (GDestroyNotify) audit_record_free);
+	store->versions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	return store;
+}
+
+void
+gmameui_audit_store_free (GmameuiAuditStore *store)
+{
+	if (!store)
+		return;
+
+	g_hash_table_destroy (store->records);
+	g_hash_table_destroy (store->versions);
+	g_free (store->filename);
+	g_free (store);
+}
+
+/* Reading - each function returns FALSE if the data is truncated */
+static gboolean
+read_uint (const guchar **p, const guchar *end, guint bytes, guint64 *value)
+{
+	guint i;
+
+	if ((gsize) (end - *p) < bytes)
+		return FALSE;
+
+	*value = 0;
+	for (i = 0; i < bytes; i++)
+		*value |= ((guint64) (*p)[i]) << (8 * i);
+	*p += bytes;
+
+	return TRUE;
+}
+
+static gboolean
+read_string (const guchar **p, const guchar *end, gchar **str)
+{
+	guint64 len;
+
+	if (!read_uint (p, end, 2, &len) || (guint64) (end - *p) < len)
+		return FALSE;
+
+	*str = g_strndup ((const gchar *) *p, len);
+	*p += len;
+
+	return TRUE;
+}
+
+gboolean
+gmameui_audit_store_load (GmameuiAuditStore *store)
+{
+	gchar *contents;
+	gsize length;
+	const guchar *p, *end;
+	GPtrArray *versions;
+	guint64 format, num_versions, num_records, i;
+	gboolean ok;
+	GError *error = NULL;
+
+	g_return_val_if_fail (store != NULL, FALSE);
+
+	if (!g_file_get_contents (store->filename, &contents, &length, &error)) {
+		GMAMEUI_DEBUG ("Could not load audit store: %s", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	p = (const guchar *) contents;
+	end = p + length;
+	versions = g_ptr_array_new ();
+	ok = FALSE;
+
+	if ((length < 4) || (memcmp (p, AUDIT_STORE_MAGIC, 4) != 0))
+		goto out;
+	p += 4;
+
+	if (!read_uint (&p, end, 4, &format) || (format != AUDIT_STORE_FORMAT))
+		goto out;
+
+	if (!read_uint (&p, end, 4, &num_versions))
+		goto out;
+	for (i = 0; i < num_versions; i++) {
+		gchar *version;
+
+		if (!read_string (&p, end, &version))
+			goto out;
+		g_ptr_array_add (versions, (gpointer) audit_store_intern_version (store, version));
+		g_free (version);
+	}
+
+	if (!read_uint (&p, end, 4, &num_records))
+		goto out;
+	for (i = 0; i < num_records; i++) {
+		AuditRecord *record;
+		gchar *romname;
+		guint64 rom_status, sample_status, audit_time, version, num_chips, j;
+
+		if (!read_string (&p, end, &romname))
+			goto out;
+
+		if (!read_uint (&p, end, 1, &rom_status) ||
+		    !read_uint (&p, end, 1, &sample_status) ||
+		    !read_uint (&p, end, 8, &audit_time) ||
+		    !read_uint (&p, end, 2, &version) ||
+		    !read_uint (&p, end, 2, &num_chips) ||
+		    (rom_status >= NUMBER_STATUS) || (sample_status >= NUMBER_STATUS) ||
+		    (version >= versions->len)) {
+			g_free (romname);
+			goto out;
+		}
+
+		record = audit_store_get_record (store, romname);
+		g_free (romname);
+
+		audit_record_free_chips (record);
+		record->rom_status = rom_status;
+		record->sample_status = sample_status;
+		record->audit_time = audit_time;
+		record->version = g_ptr_array_index (versions, version);
+
+		for (j = 0; j < num_chips; j++) {
+			gchar *chipname;
+			guint64 chip_status;
+
+			if (!read_string (&p, end, &chipname))
+				goto out;
+			if (!read_uint (&p, end, 1, &chip_status) || (chip_status >= NUM_AUDIT_CHIP_STATUS)) {
+				g_free (chipname);
+				goto out;
+			}
+
+			record->chips = g_list_prepend (record->chips,
+							gmameui_audit_chip_result_new (chipname, chip_status));
+			g_free (chipname);
+		}
+		record->chips = g_list_reverse (record->chips);
+	}
+
+	ok = TRUE;
+
+out:
+	if (!ok) {
+		GMAMEUI_DEBUG ("Audit store %s is corrupt, discarding it", store->filename);
+		g_hash_table_remove_all (store->records);
+	} else
+		GMAMEUI_DEBUG ("Loaded %d audit results", g_hash_table_size (store->records));
+
+	store->dirty = FALSE;
+
+	g_ptr_array_free (versions, TRUE);
+	g_free (contents);
+
+	return ok;
+}
+
+/* Writing */
+static void
+write_uint (GByteArray *buf, guint bytes, guint64 value)
+{
+	guint8 b[8];
+	guint i;
+
+	for (i = 0; i < bytes; i++)
+		b[i] = (value >> (8 * i)) & 0xff;
+
+	g_byte_array_append (buf, b, bytes);
+}
+
+static void
+write_string (GByteArray *buf, const gchar *str)
+{
+	gsize len = MIN (strlen (str), G_MAXUINT16);
+
+	write_uint (buf, 2, len);
+	g_byte_array_append (buf, (const guint8 *) str, len);
+}
+
+typedef struct {
+	GByteArray *buf;
+	GHashTable *version_index;
+} AuditStoreWriter;
+
+static void
+write_version (gpointer key, gpointer value, gpointer user_data)
+{
+	AuditStoreWriter *writer = user_data;
+
+	g_hash_table_insert (writer->version_index, key,
+			     GUINT_TO_POINTER (g_hash_table_size (writer->version_index)));
+	write_string (writer->buf, key);
+}
+
+static void
+write_record (gpointer key, gpointer value, gpointer user_data)
+{
+	AuditStoreWriter *writer = user_data;
+	AuditRecord *record = value;
+	GList *node;
+	guint num_chips;
+	guint i;
+
+	/* The count is 16 bits, so any chips past it are not written */
+	num_chips = MIN (g_list_length (record->chips), G_MAXUINT16);
+
+	write_string (writer->buf, key);
+	write_uint (writer->buf, 1, record->rom_status);
+	write_uint (writer->buf, 1, record->sample_status);
+	write_uint (writer->buf, 8, record->audit_time);
+	write_uint (writer->buf, 2,
+		    GPOINTER_TO_UINT (g_hash_table_lookup (writer->version_index, record->version)));
+	write_uint (writer->buf, 2, num_chips);
+
+	for (node = record->chips, i = 0; i < num_chips; node = g_list_next (node), i++) {
+		AuditChipResult *chip = node->data;
+
+		write_string (writer->buf, chip->name);
+		write_uint (writer->buf, 1, chip->status);
+	}
+}
+
+gboolean
+gmameui_audit_store_save (GmameuiAuditStore *store)
+{
+	AuditStoreWriter writer;
+	gchar *tmpfilename;
+	FILE *f;
+	gboolean ok;
+
+	g_return_val_if_fail (store != NULL, FALSE);
+
+	if (!store->dirty)
+		return TRUE;
+
+	writer.buf = g_byte_array_new ();
+	writer.version_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	g_byte_array_append (writer.buf, (const guint8 *) AUDIT_STORE_MAGIC, 4);
+	write_uint (writer.buf, 4, AUDIT_STORE_FORMAT);
+	write_uint (writer.buf, 4, g_hash_table_size (store->versions));
+	g_hash_table_foreach (store->versions, write_version, &writer);
+	write_uint (writer.buf, 4, g_hash_table_size (store->records));
+	g_hash_table_foreach (store->records, write_record, &writer);
+
+	/* Write to a temporary file, then replace the old store */
+	tmpfilename = g_strdup_printf ("%s.tmp", store->filename);
+	ok = FALSE;
+
+	f = g_fopen (tmpfilename, "wb");
+	if (f) {
+		ok = (fwrite (writer.buf->data, 1, writer.buf->len, f) == writer.buf->len);
+		ok = (fflush (f) == 0) && ok;
+		ok = (fsync (fileno (f)) == 0) && ok;
+		ok = (fclose (f) == 0) && ok;
+
+		if (ok)
+			ok = (g_rename (tmpfilename, store->filename) == 0);
+		if (!ok)
+			g_unlink (tmpfilename);
+	}
+
+	if (ok) {
+		GMAMEUI_DEBUG ("Saved %d audit results", g_hash_table_size (store->records));
+		store->dirty = FALSE;
+	} else
+		GMAMEUI_DEBUG ("Could not save audit store %s", store->filename);
+
+	g_free (tmpfilename);
+	g_hash_table_destroy (writer.version_index);
+	g_byte_array_free (writer.buf, TRUE);
+
+	return ok;
+}
+
+/**
+ * gmameui_audit_store_set_result:
+ * @store: the audit store
+ * @romname: the romset (or sampleset) audited
+ * @is_sample: TRUE if this is the result of a sample audit
+ * @status: the audit result
+ * @version: the version of MAME that performed the audit
+ * @chips: list of AuditChipResult for the romset; the store takes ownership
+ *
+ * Record the result of auditing a romset. The per-chip detail is only kept
+ * for ROM audits which found a problem.
+ */
+void
+gmameui_audit_store_set_result (GmameuiAuditStore *store,
+				const gchar *romname,
+				gboolean is_sample,
+				RomStatus status,
+				const gchar *version,
+				GList *chips)
+{
+	AuditRecord *record;
+
+	g_return_if_fail (store != NULL);
+	g_return_if_fail (romname != NULL);
+
+	record = audit_store_get_record (store, romname);
+
+	if (is_sample) {
+		record->sample_status = status;
+	} else {
+		record->rom_status = status;
+		audit_record_free_chips (record);
+
+		if ((status == INCORRECT) || (status == BEST_AVAIL)) {
+			record->chips = chips;
+			chips = NULL;
+		}
+	}
+
+	record->audit_time = (gint64) time (NULL);
+	record->version = audit_store_intern_version (store, version);
+	store->dirty = TRUE;
+
+	g_list_foreach (chips, (GFunc) gmameui_audit_chip_result_free, NULL);
+	g_list_free (chips);
+}
+
+const AuditRecord *
+gmameui_audit_store_lookup (GmameuiAuditStore *store, const gchar *romname)
+{
+	g_return_val_if_fail (store != NULL, NULL);
+	g_return_val_if_fail (romname != NULL, NULL);
+
+	return g_hash_table_lookup (store->records, romname);
+}
+
+/* Set the ROM and sample status of the romsets in the gamelist from the
+   stored results, e.g. at startup */
+void
+gmameui_audit_store_apply (GmameuiAuditStore *store, MameGamelist *gl)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_return_if_fail (store != NULL);
+	g_return_if_fail (gl != NULL);
+
+	g_hash_table_iter_init (&iter, store->records);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		AuditRecord *record = value;
+		MameRomEntry *rom;
+
+		rom = get_rom_from_gamelist_by_name (gl, key);
+		if (!rom)
+			continue;
+
+		if (record->rom_status != UNKNOWN)
+			g_object_set (rom, "has-roms", record->rom_status, NULL);
+		if (record->sample_status != UNKNOWN)
+			g_object_set (rom, "has-samples", record->sample_status, NULL);
+	}
+}
+
+/* Returns a newly allocated description of the last audit of the romset,
+   listing any problem ROMs, or NULL if the romset has not been audited */
+gchar *
+gmameui_audit_store_describe (GmameuiAuditStore *store, const gchar *romname)
+{
+	const AuditRecord *record;
+	GString *str;
+	GList *node;
+	gchar date[64];
+	time_t audit_time;
+
+	record = gmameui_audit_store_lookup (store, romname);
+	if (!record)
+		return NULL;
+
+	audit_time = (time_t) record->audit_time;
+	strftime (date, sizeof (date), "%c", localtime (&audit_time));
+
+	str = g_string_new (NULL);
+	if (record->version && *record->version)
+		g_string_append_printf (str, _("Audited %s with MAME %s"), date, record->version);
+	else
+		g_string_append_printf (str, _("Audited %s"), date);
+
+	for (node = record->chips; node != NULL; node = g_list_next (node)) {
+		AuditChipResult *chip = node->data;
+
+		g_string_append_printf (str, "\n%s: %s", chip->name,
+					_(audit_chip_status_string_value[chip->status]));
+	}
+
+	return g_string_free (str, FALSE);
+}
@@ -0,0 +1,105 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_AUDIT_STORE_H__
+#define __GMAMEUI_AUDIT_STORE_H__
+
+#include "common.h"
+#include "rom_entry.h"
+#include "game_list.h"
+
+G_BEGIN_DECLS
+
+/* Status of an individual ROM or disk within a romset, as reported by
+   MAME's -verifyroms */
+typedef enum {
+	AUDIT_CHIP_NOT_FOUND,
+	AUDIT_CHIP_BAD_CHECKSUM,
+	AUDIT_CHIP_BAD_LENGTH,
+	AUDIT_CHIP_NO_GOOD_DUMP,
+	AUDIT_CHIP_NEEDS_REDUMP,
+	AUDIT_CHIP_OTHER,
+	NUM_AUDIT_CHIP_STATUS
+} AuditChipStatus;
+
+static const gchar* audit_chip_status_string_value[NUM_AUDIT_CHIP_STATUS] = {
+	N_("Not found"),
+	N_("Incorrect checksum"),
+	N_("Incorrect length"),
+	N_("No good dump known"),
+	N_("Needs redump"),
+	N_("Problem")
+};
+
+typedef struct {
+	gchar *name;
+	AuditChipStatus status;
+} AuditChipResult;
+
+/* Audit result for a romset; the ROM and sample results are kept separately
+   since they come from different MAME commands */
+typedef struct {
+	RomStatus rom_status;
+	RomStatus sample_status;
+	gint64 audit_time;		/* Seconds since the epoch */
+	const gchar *version;		/* MAME version that performed the audit */
+	GList *chips;			/* AuditChipResult, only for sets with problems */
+} AuditRecord;
+
+typedef struct _GmameuiAuditStore GmameuiAuditStore;
+
+AuditChipResult *
+gmameui_audit_chip_result_new (const gchar *name, AuditChipStatus status);
+
+void
+gmameui_audit_chip_result_free (AuditChipResult *chip);
+
+GmameuiAuditStore *
+gmameui_audit_store_new (const gchar *filename);
+
+void
+gmameui_audit_store_free (GmameuiAuditStore *store);
+
+gboolean
+gmameui_audit_store_load (GmameuiAuditStore *store);
+
+gboolean
+gmameui_audit_store_save (GmameuiAuditStore *store);
+
+void
+gmameui_audit_store_set_result (GmameuiAuditStore *store,
+				const gchar *romname,
+				gboolean is_sample,
+				RomStatus status,
+				const gchar *version,
+				GList *chips);
+
+const AuditRecord *
+gmameui_audit_store_lookup (GmameuiAuditStore *store, const gchar *romname);
+
+void
+gmameui_audit_store_apply (GmameuiAuditStore *store, MameGamelist *gl);
+
+gchar *
+gmameui_audit_store_describe (GmameuiAuditStore *store, const gchar *romname);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_AUDIT_STORE_H__ */
@@ -0,0 +1,86 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/* Standalone benchmarks, built by make check. They are kept out of the
+   application so that nothing is timed, or thrown away, at startup:
+
+     gmameui-benchmark search [romsets]  - gamelist search, on a synthetic
+                                           gamelist (100000 romsets)
+     gmameui-benchmark rom-paths         - finding the romsets of the saved
+                                           gamelist in the ROM paths */
+
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gmameui.h"
+#include "gui.h"
+#include "game_list.h"
+#include "gmameui-archive.h"
+#include "gmameui-search-index.h"
+
+static int
+benchmark_rom_paths (void)
+{
+	GList *romnames = NULL;
+	GList *ptr;
+
+	main_gui.gui_prefs = mame_gui_prefs_new ();
+	gui_prefs.gl = mame_gamelist_new ();
+
+	if (!mame_gamelist_load (gui_prefs.gl)) {
+		g_printerr ("No gamelist found - run GMAMEUI to build one first\n");
+		return 1;
+	}
+
+	gmameui_archive_index_rom_paths ();
+
+	for (ptr = mame_gamelist_get_roms_glist (gui_prefs.gl); ptr; ptr = g_list_next (ptr))
+		romnames = g_list_prepend (romnames, (gpointer) mame_rom_entry_get_romname (ptr->data));
+
+	gmameui_archive_benchmark_rom_paths (romnames);
+
+	g_list_free (romnames);
+	g_object_unref (gui_prefs.gl);
+	g_object_unref (main_gui.gui_prefs);
+
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	if (!g_thread_supported ())
+		g_thread_init (NULL);
+	g_type_init ();
+
+	if ((argc >= 2) && (strcmp (argv[1], "search") == 0)) {
+		gmameui_search_index_benchmark ((argc >= 3) ? (guint) atoi (argv[2]) : 100000);
+		return 0;
+	}
+
+	if ((argc >= 2) && (strcmp (argv[1], "rom-paths") == 0))
+		return benchmark_rom_paths ();
+
+	g_printerr ("Usage: %s search [romsets] | rom-paths\n", argv[0]);
+
+	return 1;
+}
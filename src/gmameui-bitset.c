@@ -0,0 +1,178 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include <string.h>
+
+#include "gmameui-bitset.h"
+
+GmameuiBitset *
+gmameui_bitset_new (guint size)
+{
+	GmameuiBitset *bitset;
+
+	bitset = g_new0 (GmameuiBitset, 1);
+	bitset->size = size;
+	bitset->num_words = (size + GMAMEUI_BITSET_WORD_BITS - 1) / GMAMEUI_BITSET_WORD_BITS;
+	bitset->words = g_new0 (gulong, MAX (bitset->num_words, 1));
+
+	return bitset;
+}
+
+GmameuiBitset *
+gmameui_bitset_dup (const GmameuiBitset *bitset)
+{
+	GmameuiBitset *copy;
+
+	g_return_val_if_fail (bitset != NULL, NULL);
+
+	copy = gmameui_bitset_new (bitset->size);
+	gmameui_bitset_copy (copy, bitset);
+
+	return copy;
+}
+
+void
+gmameui_bitset_free (GmameuiBitset *bitset)
+{
+	if (bitset == NULL)
+		return;
+
+	g_free (bitset->words);
+	g_free (bitset);
+}
+
+void
+gmameui_bitset_set (GmameuiBitset *bitset, guint bit, gboolean value)
+{
+	gulong mask;
+
+	g_return_if_fail (bitset != NULL);
+	g_return_if_fail (bit < bitset->size);
+
+	mask = 1UL << (bit % GMAMEUI_BITSET_WORD_BITS);
+
+	if (value)
+		bitset->words[bit / GMAMEUI_BITSET_WORD_BITS] |= mask;
+	else
+		bitset->words[bit / GMAMEUI_BITSET_WORD_BITS] &= ~mask;
+}
+
+/* Clears the bits in the last word past the size */
+static void
+clear_tail (GmameuiBitset *bitset)
+{
+	guint used = bitset->size % GMAMEUI_BITSET_WORD_BITS;
+
+	if (used != 0)
+		bitset->words[bitset->num_words - 1] &= (1UL << used) - 1;
+}
+
+void
+gmameui_bitset_fill (GmameuiBitset *bitset, gboolean value)
+{
+	g_return_if_fail (bitset != NULL);
+
+	memset (bitset->words, value ? 0xff : 0, bitset->num_words * sizeof (gulong));
+	clear_tail (bitset);
+}
+
+void
+gmameui_bitset_copy (GmameuiBitset *dest, const GmameuiBitset *src)
+{
+	g_return_if_fail (dest != NULL);
+	g_return_if_fail (src != NULL);
+	g_return_if_fail (dest->size == src->size);
+
+	memcpy (dest->words, src->words, dest->num_words * sizeof (gulong));
+}
+
+void
+gmameui_bitset_and (GmameuiBitset *dest, const GmameuiBitset *src)
+{
+	guint i;
+
+	g_return_if_fail (dest != NULL);
+	g_return_if_fail (src != NULL);
+	g_return_if_fail (dest->size == src->size);
+
+	for (i = 0; i < dest->num_words; i++)
+		dest->words[i] &= src->words[i];
+}
+
+void
+gmameui_bitset_or (GmameuiBitset *dest, const GmameuiBitset *src)
+{
+	guint i;
+
+	g_return_if_fail (dest != NULL);
+	g_return_if_fail (src != NULL);
+	g_return_if_fail (dest->size == src->size);
+
+	for (i = 0; i < dest->num_words; i++)
+		dest->words[i] |= src->words[i];
+}
+
+void
+gmameui_bitset_and_not (GmameuiBitset *dest, const GmameuiBitset *src)
+{
+	guint i;
+
+	g_return_if_fail (dest != NULL);
+	g_return_if_fail (src != NULL);
+	g_return_if_fail (dest->size == src->size);
+
+	for (i = 0; i < dest->num_words; i++)
+		dest->words[i] &= ~src->words[i];
+}
+
+void
+gmameui_bitset_invert (GmameuiBitset *bitset)
+{
+	guint i;
+
+	g_return_if_fail (bitset != NULL);
+
+	for (i = 0; i < bitset->num_words; i++)
+		bitset->words[i] = ~bitset->words[i];
+	clear_tail (bitset);
+}
+
+guint
+gmameui_bitset_count (const GmameuiBitset *bitset)
+{
+	guint count = 0;
+	guint i;
+
+	g_return_val_if_fail (bitset != NULL, 0);
+
+	for (i = 0; i < bitset->num_words; i++) {
+		gulong word = bitset->words[i];
+
+		/* Clears the lowest set bit each time round */
+		while (word) {
+			word &= word - 1;
+			count++;
+		}
+	}
+
+	return count;
+}
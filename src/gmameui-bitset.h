@@ -0,0 +1,79 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_BITSET_H__
+#define __GMAMEUI_BITSET_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A fixed size set of bits, one per romset in the gamelist. Bits past the
+   size are always clear, so sets can be combined and counted a word at a
+   time */
+typedef struct {
+	guint size;		/* Number of bits */
+	guint num_words;
+	gulong *words;
+} GmameuiBitset;
+
+#define GMAMEUI_BITSET_WORD_BITS (sizeof (gulong) * 8)
+
+GmameuiBitset *
+gmameui_bitset_new (guint size);
+
+GmameuiBitset *
+gmameui_bitset_dup (const GmameuiBitset *bitset);
+
+void
+gmameui_bitset_free (GmameuiBitset *bitset);
+
+/* The bit of a romset. Not checked against the size, since it is called
+   for every row */
+#define gmameui_bitset_get(bitset, bit) \
+	(((bitset)->words[(bit) / GMAMEUI_BITSET_WORD_BITS] >> ((bit) % GMAMEUI_BITSET_WORD_BITS)) & 1UL)
+
+void
+gmameui_bitset_set (GmameuiBitset *bitset, guint bit, gboolean value);
+
+void
+gmameui_bitset_fill (GmameuiBitset *bitset, gboolean value);
+
+void
+gmameui_bitset_copy (GmameuiBitset *dest, const GmameuiBitset *src);
+
+void
+gmameui_bitset_and (GmameuiBitset *dest, const GmameuiBitset *src);
+
+void
+gmameui_bitset_or (GmameuiBitset *dest, const GmameuiBitset *src);
+
+void
+gmameui_bitset_and_not (GmameuiBitset *dest, const GmameuiBitset *src);
+
+void
+gmameui_bitset_invert (GmameuiBitset *bitset);
+
+guint
+gmameui_bitset_count (const GmameuiBitset *bitset);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_BITSET_H__ */
@@ -0,0 +1,772 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/* Verification of CHD (compressed hunks of data) disk images. Running
+   -verifyroms against a disk romset makes MAME decompress and hash the
+   entire image, which can take minutes for a single hard disk or CD. The
+   v3, v4 and v5 headers already contain the SHA1 that -listxml reports for
+   the disk, so comparing the header is enough to tell whether the user has
+   the right image.
+
+   The optional deep verify re-reads the image on a separate thread,
+   limited to a number of KB per second so the GUI and any running game are
+   not starved of I/O. */
+
+#define _LARGEFILE_SOURCE
+#define _FILE_OFFSET_BITS 64	/* CHD images are frequently larger than 2GB */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "gmameui-chd.h"
+#include "gmameui-archive.h"
+
+#define CHD_TAG "MComprHD"
+#define CHD_TAG_LEN 8
+
+#define CHD_V3_HEADER_SIZE 120
+#define CHD_V4_HEADER_SIZE 108
+#define CHD_V5_HEADER_SIZE 124
+#define CHD_MAX_HEADER_SIZE CHD_V5_HEADER_SIZE
+
+#define CHD_V34_FLAG_HAS_PARENT 0x00000001
+
+/* v3 and v4 compression types - only zlib can be decoded here */
+#define CHD_V34_COMPRESSION_NONE 0
+#define CHD_V34_COMPRESSION_ZLIB 1
+#define CHD_V34_COMPRESSION_ZLIB_PLUS 2
+
+/* v3 and v4 map entries are 16 bytes each, and follow the header */
+#define CHD_V34_MAP_ENTRY_SIZE 16
+#define CHD_V34_MAP_TYPE_MASK 0x0f
+#define CHD_V34_MAP_NO_CRC 0x10
+
+enum {
+	CHD_V34_MAP_INVALID,
+	CHD_V34_MAP_COMPRESSED,
+	CHD_V34_MAP_UNCOMPRESSED,
+	CHD_V34_MAP_MINI,
+	CHD_V34_MAP_SELF_HUNK,
+	CHD_V34_MAP_PARENT_HUNK
+};
+
+#define CHD_SHA1_BYTES 20
+#define CHD_READ_CHUNK (1024 * 1024)
+
+/* Number of CHDs deep verified at the same time. The others wait in the
+   pool's queue */
+#define CHD_VERIFY_THREADS 2
+
+struct _ChdDeepVerify {
+	gchar *filename;
+	gchar *expected_sha1;
+	guint max_kb_per_sec;   /* 0 means unlimited */
+
+	ChdDeepVerifyFunc func;
+	gpointer user_data;
+
+	volatile gint cancelled;
+	ChdResult result;
+};
+
+/* The deep verifies share one pool of threads and one read limit, so
+   queuing more disks doesn't raise the rate they are read at */
+static GThreadPool *chd_verify_pool = NULL;
+static GStaticMutex chd_throttle_mutex = G_STATIC_MUTEX_INIT;
+static GTimer *chd_throttle_timer = NULL;	/* Started when a verify starts with none running */
+static guint64 chd_throttle_bytes = 0;		/* Read by all the verifies since then */
+static guint chd_throttle_running = 0;
+
+/* State used while re-reading an image during a deep verify */
+typedef struct {
+	ChdDeepVerify *verify;
+	FILE *file;
+	guint64 file_size;
+	ChdHeader header;
+
+	GTimer *timer;
+	guint64 bytes_read;
+
+	guint8 *map;
+	guint8 *compressed;
+	gsize compressed_size;
+} ChdVerifyContext;
+
+static guint32
+chd_get_be32 (const guint8 *data)
+{
+	return ((guint32) data[0] << 24) | ((guint32) data[1] << 16) |
+	       ((guint32) data[2] << 8) | (guint32) data[3];
+}
+
+static guint64
+chd_get_be64 (const guint8 *data)
+{
+	return ((guint64) chd_get_be32 (data) << 32) | (guint64) chd_get_be32 (data + 4);
+}
+
+static void
+chd_sha1_to_string (const guint8 *sha1, gchar *str)
+{
+	gint i;
+
+	for (i = 0; i < CHD_SHA1_BYTES; i++)
+		g_snprintf (str + (i * 2), 3, "%02x", sha1[i]);
+	str[CHD_SHA1_STRING_LEN] = '\0';
+}
+
+static gboolean
+chd_sha1_is_empty (const guint8 *sha1)
+{
+	gint i;
+
+	for (i = 0; i < CHD_SHA1_BYTES; i++) {
+		if (sha1[i] != 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static const gchar* chd_result_string_value[NUM_CHD_RESULTS] = {
+	N_("OK"),
+	N_("Not found"),
+	N_("Not a valid CHD"),
+	N_("Unsupported CHD version"),
+	N_("Incorrect SHA1"),
+	N_("No good dump known"),
+	N_("Read error"),
+	N_("Data does not match SHA1"),
+	N_("Cancelled")
+};
+
+const gchar *
+gmameui_chd_result_to_string (ChdResult result)
+{
+	g_return_val_if_fail (result < NUM_CHD_RESULTS, NULL);
+
+	return _(chd_result_string_value[result]);
+}
+
+/* Read the header of the CHD at filename. Only the first 124 bytes of the
+   file are read, regardless of the size of the image */
+ChdResult
+gmameui_chd_read_header (const gchar *filename, ChdHeader *header)
+{
+	FILE *file;
+	guint8 raw[CHD_MAX_HEADER_SIZE];
+	gsize len;
+	guint32 header_len;
+
+	g_return_val_if_fail (filename != NULL, CHD_RESULT_NOT_FOUND);
+	g_return_val_if_fail (header != NULL, CHD_RESULT_BAD_HEADER);
+
+	memset (header, 0, sizeof (ChdHeader));
+
+	file = fopen (filename, "rb");
+	if (!file) {
+		GMAMEUI_DEBUG ("Could not open CHD %s", filename);
+		return CHD_RESULT_NOT_FOUND;
+	}
+
+	len = fread (raw, 1, CHD_MAX_HEADER_SIZE, file);
+	fclose (file);
+
+	if ((len < 16) || (memcmp (raw, CHD_TAG, CHD_TAG_LEN) != 0)) {
+		GMAMEUI_DEBUG ("%s is not a CHD file", filename);
+		return CHD_RESULT_BAD_HEADER;
+	}
+
+	header_len = chd_get_be32 (raw + 8);
+	header->version = chd_get_be32 (raw + 12);
+
+	switch (header->version) {
+		case 3:
+			if ((len < CHD_V3_HEADER_SIZE) || (header_len < CHD_V3_HEADER_SIZE))
+				return CHD_RESULT_BAD_HEADER;
+
+			header->has_parent = (chd_get_be32 (raw + 16) & CHD_V34_FLAG_HAS_PARENT) != 0;
+			header->compression = chd_get_be32 (raw + 20);
+			header->compressed = header->compression != CHD_V34_COMPRESSION_NONE;
+			header->total_hunks = chd_get_be32 (raw + 24);
+			header->logical_bytes = chd_get_be64 (raw + 28);
+			header->meta_offset = chd_get_be64 (raw + 36);
+			header->hunk_bytes = chd_get_be32 (raw + 76);
+			header->map_offset = header_len;
+			/* v3 has no separate raw SHA1 - the SHA1 only covers the data */
+			chd_sha1_to_string (raw + 80, header->sha1);
+			chd_sha1_to_string (raw + 80, header->raw_sha1);
+			chd_sha1_to_string (raw + 100, header->parent_sha1);
+			break;
+		case 4:
+			if ((len < CHD_V4_HEADER_SIZE) || (header_len < CHD_V4_HEADER_SIZE))
+				return CHD_RESULT_BAD_HEADER;
+
+			header->has_parent = (chd_get_be32 (raw + 16) & CHD_V34_FLAG_HAS_PARENT) != 0;
+			header->compression = chd_get_be32 (raw + 20);
+			header->compressed = header->compression != CHD_V34_COMPRESSION_NONE;
+			header->total_hunks = chd_get_be32 (raw + 24);
+			header->logical_bytes = chd_get_be64 (raw + 28);
+			header->meta_offset = chd_get_be64 (raw + 36);
+			header->hunk_bytes = chd_get_be32 (raw + 44);
+			header->map_offset = header_len;
+			chd_sha1_to_string (raw + 48, header->sha1);
+			chd_sha1_to_string (raw + 68, header->parent_sha1);
+			chd_sha1_to_string (raw + 88, header->raw_sha1);
+			break;
+		case 5:
+			if ((len < CHD_V5_HEADER_SIZE) || (header_len < CHD_V5_HEADER_SIZE))
+				return CHD_RESULT_BAD_HEADER;
+
+			/* The first of the four compressor tags is zero for an
+			   uncompressed image */
+			header->compression = chd_get_be32 (raw + 16);
+			header->compressed = header->compression != 0;
+			header->logical_bytes = chd_get_be64 (raw + 32);
+			header->map_offset = chd_get_be64 (raw + 40);
+			header->meta_offset = chd_get_be64 (raw + 48);
+			header->hunk_bytes = chd_get_be32 (raw + 56);
+			header->has_parent = !chd_sha1_is_empty (raw + 104);
+			if (header->hunk_bytes == 0)
+				return CHD_RESULT_BAD_HEADER;
+			header->total_hunks = (guint32) ((header->logical_bytes + header->hunk_bytes - 1) / header->hunk_bytes);
+			chd_sha1_to_string (raw + 64, header->raw_sha1);
+			chd_sha1_to_string (raw + 84, header->sha1);
+			chd_sha1_to_string (raw + 104, header->parent_sha1);
+			break;
+		default:
+			GMAMEUI_DEBUG ("CHD %s is version %d, only versions 3 to 5 are supported",
+				       filename, header->version);
+			return CHD_RESULT_UNSUPPORTED;
+	}
+
+	return CHD_RESULT_OK;
+}
+
+/* Compare the SHA1 stored in the CHD header against the SHA1 of the disk
+   from -listxml */
+ChdResult
+gmameui_chd_verify_disk (const gchar *filename, const gchar *expected_sha1)
+{
+	ChdHeader header;
+	ChdResult result;
+
+	g_return_val_if_fail (filename != NULL, CHD_RESULT_NOT_FOUND);
+
+	result = gmameui_chd_read_header (filename, &header);
+	if (result != CHD_RESULT_OK)
+		return result;
+
+	/* Disks flagged as nodump have no SHA1 in -listxml, so the best we
+	   can say is that an image is present */
+	if (expected_sha1 == NULL)
+		return CHD_RESULT_NODUMP;
+
+	if (g_ascii_strcasecmp (header.sha1, expected_sha1) != 0) {
+		GMAMEUI_DEBUG ("CHD %s has SHA1 %s, expected %s",
+			       filename, header.sha1, expected_sha1);
+		return CHD_RESULT_SHA1_MISMATCH;
+	}
+
+	return CHD_RESULT_OK;
+}
+
+/* Find the .chd for a disk in a romset. MAME looks for disks in a directory
+   named after the romset in each of the ROM paths, and for merged disks in
+   the parent's directory as well. Returns NULL if the disk is not found */
+gchar *
+gmameui_chd_get_disk_filename (MameRomEntry *romset, individual_rom *disk)
+{
+	GValueArray *va_rom_paths;
+	gchar *filename;
+	guint i;
+
+	g_return_val_if_fail (romset != NULL, NULL);
+	g_return_val_if_fail (disk != NULL, NULL);
+	g_return_val_if_fail (disk->name != NULL, NULL);
+
+	filename = NULL;
+
+	/* Disks are verified from worker threads */
+	va_rom_paths = gmameui_archive_get_rom_paths ();
+	g_return_val_if_fail (va_rom_paths != NULL, NULL);
+
+	for (i = 0; (i < va_rom_paths->n_values) && (filename == NULL); i++) {
+		const gchar *rompath;
+		gchar *diskname;
+		gchar *path;
+
+		rompath = g_value_get_string (g_value_array_get_nth (va_rom_paths, i));
+
+		diskname = g_strdup_printf ("%s.chd", disk->name);
+		path = g_build_filename (rompath, mame_rom_entry_get_romname (romset), diskname, NULL);
+		g_free (diskname);
+
+		if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+			filename = path;
+			break;
+		}
+		g_free (path);
+
+		if ((disk->merge != NULL) && (mame_rom_entry_is_clone (romset))) {
+			diskname = g_strdup_printf ("%s.chd", disk->merge);
+			path = g_build_filename (rompath, mame_rom_entry_get_parent_romname (romset), diskname, NULL);
+			g_free (diskname);
+
+			if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+				filename = path;
+			else
+				g_free (path);
+		}
+	}
+
+	g_value_array_free (va_rom_paths);
+
+	return filename;
+}
+
+ChdResult
+gmameui_chd_verify_romset_disk (MameRomEntry *romset, individual_rom *disk)
+{
+	gchar *filename;
+	ChdResult result;
+
+	g_return_val_if_fail (romset != NULL, CHD_RESULT_NOT_FOUND);
+	g_return_val_if_fail (disk != NULL, CHD_RESULT_NOT_FOUND);
+
+	filename = gmameui_chd_get_disk_filename (romset, disk);
+	if (filename == NULL)
+		return CHD_RESULT_NOT_FOUND;
+
+	result = gmameui_chd_verify_disk (filename, disk->sha1);
+
+	GMAMEUI_DEBUG ("Verified disk %s in romset %s: %s", disk->name,
+		       mame_rom_entry_get_romname (romset), gmameui_chd_result_to_string (result));
+
+	g_free (filename);
+
+	return result;
+}
+
+/* Sleep for as long as is needed to keep the bytes read by all the running
+   deep verifies under the limit set for the deep verify */
+static void
+chd_throttle (ChdVerifyContext *ctx, gsize len)
+{
+	gdouble expected, elapsed;
+
+	if (ctx->verify->max_kb_per_sec == 0)
+		return;
+
+	g_static_mutex_lock (&chd_throttle_mutex);
+	chd_throttle_bytes += len;
+	expected = (gdouble) chd_throttle_bytes / ((gdouble) ctx->verify->max_kb_per_sec * 1024.0);
+	elapsed = g_timer_elapsed (chd_throttle_timer, NULL);
+	g_static_mutex_unlock (&chd_throttle_mutex);
+
+	if (expected > elapsed)
+		g_usleep ((gulong) ((expected - elapsed) * G_USEC_PER_SEC));
+}
+
+static gboolean
+chd_read_at (ChdVerifyContext *ctx, guint64 offset, guint8 *buffer, gsize len)
+{
+	if ((offset > ctx->file_size) || (len > ctx->file_size - offset)) {
+		GMAMEUI_DEBUG ("CHD %s is truncated - cannot read %" G_GSIZE_FORMAT " bytes at %" G_GUINT64_FORMAT,
+			       ctx->verify->filename, len, offset);
+		return FALSE;
+	}
+
+	if (fseeko (ctx->file, (off_t) offset, SEEK_SET) != 0)
+		return FALSE;
+
+	if (fread (buffer, 1, len, ctx->file) != len)
+		return FALSE;
+
+	ctx->bytes_read += len;
+	chd_throttle (ctx, len);
+
+	return TRUE;
+}
+
+static gboolean
+chd_inflate_hunk (const guint8 *src, gsize src_len, guint8 *dest, gsize dest_len)
+{
+	z_stream stream;
+	gint zerr;
+
+	memset (&stream, 0, sizeof (stream));
+
+	/* The hunks are raw deflate streams, without a zlib header */
+	if (inflateInit2 (&stream, -MAX_WBITS) != Z_OK)
+		return FALSE;
+
+	stream.next_in = (Bytef *) src;
+	stream.avail_in = src_len;
+	stream.next_out = dest;
+	stream.avail_out = dest_len;
+
+	zerr = inflate (&stream, Z_SYNC_FLUSH);
+	inflateEnd (&stream);
+
+	return ((zerr == Z_OK) || (zerr == Z_STREAM_END)) && (stream.total_out == dest_len);
+}
+
+/* Decode a single v3/v4 hunk into buffer, which must be hunk_bytes long */
+static ChdResult
+chd_v34_read_hunk (ChdVerifyContext *ctx, guint32 hunknum, guint8 *buffer, gboolean follow_self)
+{
+	const guint8 *entry;
+	guint64 offset;
+	guint32 crc, length;
+	guint8 flags;
+	guint32 i;
+
+	entry = ctx->map + ((gsize) hunknum * CHD_V34_MAP_ENTRY_SIZE);
+	offset = chd_get_be64 (entry);
+	crc = chd_get_be32 (entry + 8);
+	length = ((guint32) entry[12] << 8) | (guint32) entry[13] | ((guint32) entry[14] << 16);
+	flags = entry[15];
+
+	switch (flags & CHD_V34_MAP_TYPE_MASK) {
+		case CHD_V34_MAP_COMPRESSED:
+			/* Hunks compressed with the A/V codec can't be decoded
+			   here, which doesn't make the data wrong */
+			if ((ctx->header.compression != CHD_V34_COMPRESSION_ZLIB) &&
+			    (ctx->header.compression != CHD_V34_COMPRESSION_ZLIB_PLUS))
+				return CHD_RESULT_UNSUPPORTED;
+			if (length > ctx->compressed_size) {
+				ctx->compressed = g_realloc (ctx->compressed, length);
+				ctx->compressed_size = length;
+			}
+			if (!chd_read_at (ctx, offset, ctx->compressed, length))
+				return CHD_RESULT_READ_ERROR;
+			if (!chd_inflate_hunk (ctx->compressed, length, buffer, ctx->header.hunk_bytes))
+				return CHD_RESULT_DATA_MISMATCH;
+			break;
+		case CHD_V34_MAP_UNCOMPRESSED:
+			if (!chd_read_at (ctx, offset, buffer, ctx->header.hunk_bytes))
+				return CHD_RESULT_READ_ERROR;
+			break;
+		case CHD_V34_MAP_MINI:
+			/* The eight bytes of the offset field are repeated
+			   throughout the hunk */
+			for (i = 0; i < ctx->header.hunk_bytes; i++)
+				buffer[i] = entry[i % 8];
+			break;
+		case CHD_V34_MAP_SELF_HUNK:
+			/* Duplicate of an earlier hunk in the same image */
+			if ((!follow_self) || (offset >= ctx->header.total_hunks))
+				return CHD_RESULT_BAD_HEADER;
+			return chd_v34_read_hunk (ctx, (guint32) offset, buffer, FALSE);
+		case CHD_V34_MAP_PARENT_HUNK:
+			/* Data lives in the parent image, which we don't have */
+			return CHD_RESULT_UNSUPPORTED;
+		default:
+			return CHD_RESULT_BAD_HEADER;
+	}
+
+	if (!(flags & CHD_V34_MAP_NO_CRC) &&
+	    (crc32 (0, buffer, ctx->header.hunk_bytes) != crc)) {
+		GMAMEUI_DEBUG ("CHD %s hunk %d has an incorrect CRC", ctx->verify->filename, hunknum);
+		return CHD_RESULT_DATA_MISMATCH;
+	}
+
+	return CHD_RESULT_OK;
+}
+
+/* Decode a single hunk of an uncompressed v5 image */
+static ChdResult
+chd_v5_read_raw_hunk (ChdVerifyContext *ctx, guint32 hunknum, guint8 *buffer)
+{
+	guint64 offset;
+
+	offset = (guint64) chd_get_be32 (ctx->map + ((gsize) hunknum * 4)) * ctx->header.hunk_bytes;
+
+	if (offset == 0) {
+		/* Hunks that were never written read as zero, unless they
+		   come from the parent */
+		if (ctx->header.has_parent)
+			return CHD_RESULT_UNSUPPORTED;
+		memset (buffer, 0, ctx->header.hunk_bytes);
+		return CHD_RESULT_OK;
+	}
+
+	if (!chd_read_at (ctx, offset, buffer, ctx->header.hunk_bytes))
+		return CHD_RESULT_READ_ERROR;
+
+	return CHD_RESULT_OK;
+}
+
+/* Rebuild the raw data from every hunk and compare its SHA1 against the
+   raw SHA1 in the header. Returns CHD_RESULT_UNSUPPORTED if the image uses
+   a codec or parent we can't decode */
+static ChdResult
+chd_verify_hunks (ChdVerifyContext *ctx)
+{
+	GChecksum *checksum;
+	guint8 *buffer;
+	guint64 remaining;
+	gsize map_size;
+	guint32 i;
+	ChdResult result;
+
+	if (ctx->header.version == 5) {
+		if (ctx->header.compressed)
+			return CHD_RESULT_UNSUPPORTED;
+		map_size = (gsize) ctx->header.total_hunks * 4;
+	} else {
+		if (ctx->header.has_parent)
+			return CHD_RESULT_UNSUPPORTED;
+		map_size = (gsize) ctx->header.total_hunks * CHD_V34_MAP_ENTRY_SIZE;
+	}
+
+	if ((ctx->header.hunk_bytes == 0) || (map_size > ctx->file_size))
+		return CHD_RESULT_BAD_HEADER;
+
+	ctx->map = g_malloc (map_size);
+	if (!chd_read_at (ctx, ctx->header.map_offset, ctx->map, map_size))
+		return CHD_RESULT_READ_ERROR;
+
+	buffer = g_malloc (ctx->header.hunk_bytes);
+	checksum = g_checksum_new (G_CHECKSUM_SHA1);
+	remaining = ctx->header.logical_bytes;
+	result = CHD_RESULT_OK;
+
+	for (i = 0; (i < ctx->header.total_hunks) && (remaining > 0); i++) {
+		gsize len;
+
+		if (g_atomic_int_get (&ctx->verify->cancelled)) {
+			result = CHD_RESULT_CANCELLED;
+			break;
+		}
+
+		if (ctx->header.version == 5)
+			result = chd_v5_read_raw_hunk (ctx, i, buffer);
+		else
+			result = chd_v34_read_hunk (ctx, i, buffer, TRUE);
+
+		if (result != CHD_RESULT_OK)
+			break;
+
+		/* The last hunk is padded beyond the logical size */
+		len = (gsize) MIN (remaining, (guint64) ctx->header.hunk_bytes);
+		g_checksum_update (checksum, buffer, len);
+		remaining -= len;
+	}
+
+	if ((result == CHD_RESULT_OK) &&
+	    (g_ascii_strcasecmp (g_checksum_get_string (checksum), ctx->header.raw_sha1) != 0)) {
+		GMAMEUI_DEBUG ("CHD %s data has SHA1 %s, header says %s", ctx->verify->filename,
+			       g_checksum_get_string (checksum), ctx->header.raw_sha1);
+		result = CHD_RESULT_DATA_MISMATCH;
+	}
+
+	g_checksum_free (checksum);
+	g_free (buffer);
+
+	return result;
+}
+
+/* For images we can't decode (v3/v4 codecs other than zlib, v5 codecs
+   other than none, or hunks from a parent image), read every byte of the
+   file so that bad sectors and truncated downloads are still reported */
+static ChdResult
+chd_verify_readable (ChdVerifyContext *ctx)
+{
+	guint8 *buffer;
+	guint64 offset;
+	ChdResult result;
+
+	if ((ctx->header.map_offset >= ctx->file_size) ||
+	    (ctx->header.meta_offset >= ctx->file_size))
+		return CHD_RESULT_READ_ERROR;
+
+	buffer = g_malloc (CHD_READ_CHUNK);
+	result = CHD_RESULT_OK;
+
+	for (offset = 0; offset < ctx->file_size; offset += CHD_READ_CHUNK) {
+		gsize len;
+
+		if (g_atomic_int_get (&ctx->verify->cancelled)) {
+			result = CHD_RESULT_CANCELLED;
+			break;
+		}
+
+		len = (gsize) MIN ((guint64) CHD_READ_CHUNK, ctx->file_size - offset);
+		if (!chd_read_at (ctx, offset, buffer, len)) {
+			result = CHD_RESULT_READ_ERROR;
+			break;
+		}
+	}
+
+	g_free (buffer);
+
+	return result;
+}
+
+static ChdResult
+chd_deep_verify_file (ChdDeepVerify *verify)
+{
+	ChdVerifyContext ctx;
+	ChdResult result;
+
+	memset (&ctx, 0, sizeof (ChdVerifyContext));
+	ctx.verify = verify;
+
+	/* Check the header first - there is no point reading the whole image
+	   if it's the wrong one */
+	result = gmameui_chd_verify_disk (verify->filename, verify->expected_sha1);
+	if ((result != CHD_RESULT_OK) && (result != CHD_RESULT_NODUMP))
+		return result;
+
+	gmameui_chd_read_header (verify->filename, &ctx.header);
+
+	ctx.file = fopen (verify->filename, "rb");
+	if (!ctx.file)
+		return CHD_RESULT_NOT_FOUND;
+
+	if (fseeko (ctx.file, 0, SEEK_END) != 0) {
+		fclose (ctx.file);
+		return CHD_RESULT_READ_ERROR;
+	}
+	ctx.file_size = (guint64) ftello (ctx.file);
+
+	ctx.timer = g_timer_new ();
+
+	result = chd_verify_hunks (&ctx);
+	if (result == CHD_RESULT_UNSUPPORTED) {
+		GMAMEUI_DEBUG ("Cannot decode the data in CHD %s, checking it can be read instead",
+			       verify->filename);
+		result = chd_verify_readable (&ctx);
+	}
+
+	GMAMEUI_DEBUG ("Deep verify of %s read %" G_GUINT64_FORMAT " bytes in %0.2f seconds: %s",
+		       verify->filename, ctx.bytes_read, g_timer_elapsed (ctx.timer, NULL),
+		       gmameui_chd_result_to_string (result));
+
+	g_timer_destroy (ctx.timer);
+	g_free (ctx.map);
+	g_free (ctx.compressed);
+	fclose (ctx.file);
+
+	return result;
+}
+
+/* Runs in the main loop once the worker thread has finished */
+static gboolean
+chd_deep_verify_done (gpointer user_data)
+{
+	ChdDeepVerify *verify = (ChdDeepVerify *) user_data;
+
+	if (verify->func)
+		verify->func (verify->filename, verify->result, verify->user_data);
+
+	g_free (verify->filename);
+	g_free (verify->expected_sha1);
+	g_free (verify);
+
+	return FALSE;
+}
+
+/* Runs in the pool for each queued verify */
+static void
+chd_deep_verify_thread (gpointer data, gpointer user_data)
+{
+	ChdDeepVerify *verify = (ChdDeepVerify *) data;
+
+	/* Cancelled while it was queued */
+	if (g_atomic_int_get (&verify->cancelled)) {
+		verify->result = CHD_RESULT_CANCELLED;
+		g_idle_add (chd_deep_verify_done, verify);
+		return;
+	}
+
+	g_static_mutex_lock (&chd_throttle_mutex);
+	if (chd_throttle_running++ == 0) {
+		g_timer_start (chd_throttle_timer);
+		chd_throttle_bytes = 0;
+	}
+	g_static_mutex_unlock (&chd_throttle_mutex);
+
+	verify->result = chd_deep_verify_file (verify);
+
+	g_static_mutex_lock (&chd_throttle_mutex);
+	chd_throttle_running--;
+	g_static_mutex_unlock (&chd_throttle_mutex);
+
+	g_idle_add (chd_deep_verify_done, verify);
+}
+
+/* Queue a deep verify of the CHD at filename. At most CHD_VERIFY_THREADS
+   disks are read at once, and the reads of all of them together are
+   limited to max_kb_per_sec (0 for no limit). func is called in the main
+   loop when the verify finishes, including when it was cancelled; the
+   returned handle is only valid until then. Only called from the main
+   thread */
+ChdDeepVerify *
+gmameui_chd_deep_verify (const gchar *filename,
+			 const gchar *expected_sha1,
+			 guint max_kb_per_sec,
+			 ChdDeepVerifyFunc func,
+			 gpointer user_data)
+{
+	ChdDeepVerify *verify;
+	GError *error = NULL;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	verify = g_new0 (ChdDeepVerify, 1);
+	verify->filename = g_strdup (filename);
+	verify->expected_sha1 = g_strdup (expected_sha1);
+	verify->max_kb_per_sec = max_kb_per_sec;
+	verify->func = func;
+	verify->user_data = user_data;
+
+	if (chd_throttle_timer == NULL)
+		chd_throttle_timer = g_timer_new ();
+	if (chd_verify_pool == NULL)
+		chd_verify_pool = g_thread_pool_new (chd_deep_verify_thread, NULL,
+						     CHD_VERIFY_THREADS, FALSE, &error);
+
+	if (chd_verify_pool)
+		g_thread_pool_push (chd_verify_pool, verify, &error);
+
+	if (error) {
+		GMAMEUI_DEBUG ("Could not start deep verify of %s - %s", filename, error->message);
+		g_error_free (error);
+
+		verify->result = CHD_RESULT_READ_ERROR;
+		g_idle_add (chd_deep_verify_done, verify);
+	}
+
+	return verify;
+}
+
+void
+gmameui_chd_deep_verify_cancel (ChdDeepVerify *verify)
+{
+	g_return_if_fail (verify != NULL);
+
+	g_atomic_int_set (&verify->cancelled, TRUE);
+}
@@ -0,0 +1,96 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_CHD_H__
+#define __GMAMEUI_CHD_H__
+
+#include "common.h"
+#include "rom_entry.h"
+
+G_BEGIN_DECLS
+
+/* Length of a SHA1 checksum stored as a hex string, excluding the trailing NUL */
+#define CHD_SHA1_STRING_LEN 40
+
+typedef enum {
+	CHD_RESULT_OK,
+	CHD_RESULT_NOT_FOUND,		/* No .chd file in any of the ROM paths */
+	CHD_RESULT_BAD_HEADER,		/* Not a CHD, or the header is truncated */
+	CHD_RESULT_UNSUPPORTED,		/* CHD version other than v3 - v5 */
+	CHD_RESULT_SHA1_MISMATCH,	/* Header SHA1 differs from the -listxml SHA1 */
+	CHD_RESULT_NODUMP,		/* -listxml has no SHA1 for the disk */
+	CHD_RESULT_READ_ERROR,		/* I/O error, or data missing from the file */
+	CHD_RESULT_DATA_MISMATCH,	/* Deep verify - data does not match the header SHA1 */
+	CHD_RESULT_CANCELLED,
+	NUM_CHD_RESULTS
+} ChdResult;
+
+/* Information read from the header of a CHD file. Only the fields needed
+   to verify the image are kept */
+typedef struct {
+	guint32 version;
+	guint32 hunk_bytes;
+	guint32 total_hunks;
+	guint64 logical_bytes;
+	guint64 map_offset;
+	guint64 meta_offset;
+	guint32 compression;	/* v3/v4 codec, or the first v5 compressor tag */
+	gboolean compressed;
+	gboolean has_parent;
+	gchar sha1[CHD_SHA1_STRING_LEN + 1];		/* SHA1 of data and metadata - as listed by -listxml */
+	gchar raw_sha1[CHD_SHA1_STRING_LEN + 1];	/* SHA1 of data only (v3 stores this in sha1) */
+	gchar parent_sha1[CHD_SHA1_STRING_LEN + 1];
+} ChdHeader;
+
+typedef struct _ChdDeepVerify ChdDeepVerify;
+
+/* Called in the main loop when a deep verify completes */
+typedef void (*ChdDeepVerifyFunc) (const gchar *filename,
+				   ChdResult result,
+				   gpointer user_data);
+
+const gchar *
+gmameui_chd_result_to_string (ChdResult result);
+
+ChdResult
+gmameui_chd_read_header (const gchar *filename, ChdHeader *header);
+
+ChdResult
+gmameui_chd_verify_disk (const gchar *filename, const gchar *expected_sha1);
+
+gchar *
+gmameui_chd_get_disk_filename (MameRomEntry *romset, individual_rom *disk);
+
+ChdResult
+gmameui_chd_verify_romset_disk (MameRomEntry *romset, individual_rom *disk);
+
+ChdDeepVerify *
+gmameui_chd_deep_verify (const gchar *filename,
+			 const gchar *expected_sha1,
+			 guint max_kb_per_sec,
+			 ChdDeepVerifyFunc func,
+			 gpointer user_data);
+
+void
+gmameui_chd_deep_verify_cancel (ChdDeepVerify *verify);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_CHD_H__ */
@@ -0,0 +1,225 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include "gmameui-filter-builder-dlg.h"
+#include "gmameui-filter-expr.h"
+#include "gmameui-gamelist-view.h"
+#include "filters_list.h"
+#include "gui.h"	/* main_gui */
+
+struct _GMAMEUIFilterBuilderDialogPrivate {
+	GtkWidget *entry;
+	GtkWidget *status_lbl;
+};
+
+#define RESPONSE_CLEAR 1
+
+/* The expression last entered, shown again when the dialog is reopened */
+static gchar *last_expression;
+
+G_DEFINE_TYPE (GMAMEUIFilterBuilderDialog, gmameui_filter_builder_dialog, GTK_TYPE_DIALOG)
+
+/* Function prototypes */
+static void
+gmameui_filter_builder_dialog_response         (GtkDialog *dialog, gint response);
+static void
+gmameui_filter_builder_dialog_destroy          (GtkObject *object);
+
+static void
+gmameui_filter_builder_dialog_class_init (GMAMEUIFilterBuilderDialogClass *class)
+{
+	GtkObjectClass *gtkobject_class = GTK_OBJECT_CLASS (class);
+	GtkDialogClass *gtkdialog_class = GTK_DIALOG_CLASS (class);
+
+	gtkobject_class->destroy = gmameui_filter_builder_dialog_destroy;
+	gtkdialog_class->response = gmameui_filter_builder_dialog_response;
+
+	g_type_class_add_private (class,
+				  sizeof (GMAMEUIFilterBuilderDialogPrivate));
+}
+
+static GMAMEUIFilter *
+lookup_filter (const gchar *name, gpointer user_data, GError **error)
+{
+	GMAMEUIFilter *filter;
+	gboolean ambiguous;
+
+	filter = gmameui_filters_list_find_filter (main_gui.filters_list, name, &ambiguous);
+	if (ambiguous)
+		g_set_error (error, GMAMEUI_FILTER_EXPR_ERROR,
+			     GMAMEUI_FILTER_EXPR_ERROR_AMBIGUOUS_FILTER,
+			     _("More than one group has a filter named \"%s\" - use \"Group:%s\""),
+			     name, name);
+
+	return filter;
+}
+
+/* Applies the expression to the gamelist as it is typed. Expressions that
+   don't parse leave the gamelist as it was */
+static void
+on_expression_changed (GtkEntry *entry, gpointer user_data)
+{
+	GMAMEUIFilterBuilderDialog *dialog;
+	GmameuiFilterExpr *expr;
+	GError *error = NULL;
+	gchar *text, *status;
+
+	dialog = GMAMEUI_FILTER_BUILDER_DIALOG (user_data);
+
+	text = g_strstrip (g_strdup (gtk_entry_get_text (entry)));
+
+	if (*text == '\0') {
+		mame_gamelist_view_set_filter_expr (main_gui.displayed_list, NULL);
+		gtk_label_set_text (GTK_LABEL (dialog->priv->status_lbl), "");
+		g_free (text);
+		return;
+	}
+
+	expr = gmameui_filter_expr_parse (text, lookup_filter, NULL, &error);
+	if (expr == NULL) {
+		gtk_label_set_text (GTK_LABEL (dialog->priv->status_lbl), error->message);
+		g_error_free (error);
+		g_free (text);
+		return;
+	}
+
+	mame_gamelist_view_set_filter_expr (main_gui.displayed_list, expr);
+	gmameui_filter_expr_unref (expr);
+
+	/* visible_games is updated with the status bar */
+	status = g_strdup_printf (_("%d romsets match"), visible_games);
+	gtk_label_set_text (GTK_LABEL (dialog->priv->status_lbl), status);
+	g_free (status);
+
+	g_free (text);
+}
+
+static void
+gmameui_filter_builder_dialog_init (GMAMEUIFilterBuilderDialog *dialog)
+{
+	GMAMEUIFilterBuilderDialogPrivate *priv;
+	GtkWidget *vbox;
+	GtkWidget *label;
+	gchar *markup;
+
+	priv = G_TYPE_INSTANCE_GET_PRIVATE (dialog,
+					    GMAMEUI_TYPE_FILTER_BUILDER_DIALOG,
+					    GMAMEUIFilterBuilderDialogPrivate);
+
+	dialog->priv = priv;
+
+	vbox = gtk_vbox_new (FALSE, 6);
+	gtk_container_set_border_width (GTK_CONTAINER (vbox), 6);
+
+	label = gtk_label_new (_("Combine the filters in the filter list with AND, OR, NOT and "
+				 "brackets. Where a filter's name is in more than one group, "
+				 "write the group first, as in Imperfect:Sound."));
+	gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+	gtk_misc_set_alignment (GTK_MISC (label), 0, 0.5);
+	gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 0);
+
+	label = gtk_label_new (NULL);
+	markup = g_markup_printf_escaped ("<span style=\"italic\">%s</span>",
+					  _("Available AND Correct AND NOT Clones AND (Vector OR Trackball)"));
+	gtk_label_set_markup (GTK_LABEL (label), markup);
+	g_free (markup);
+	gtk_misc_set_alignment (GTK_MISC (label), 0, 0.5);
+	gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 0);
+
+	priv->entry = gtk_entry_new ();
+	gtk_entry_set_activates_default (GTK_ENTRY (priv->entry), TRUE);
+	gtk_box_pack_start (GTK_BOX (vbox), priv->entry, FALSE, FALSE, 0);
+
+	priv->status_lbl = gtk_label_new (NULL);
+	gtk_label_set_line_wrap (GTK_LABEL (priv->status_lbl), TRUE);
+	gtk_misc_set_alignment (GTK_MISC (priv->status_lbl), 0, 0.5);
+	gtk_box_pack_start (GTK_BOX (vbox), priv->status_lbl, FALSE, FALSE, 0);
+
+	gtk_widget_show_all (vbox);
+	gtk_box_pack_start (GTK_BOX (GTK_DIALOG (dialog)->vbox), vbox, TRUE, TRUE, 0);
+
+	if (last_expression)
+		gtk_entry_set_text (GTK_ENTRY (priv->entry), last_expression);
+
+	/* Connected after the text is restored, since that filter is already
+	   shown */
+	g_signal_connect (priv->entry, "changed",
+			  G_CALLBACK (on_expression_changed), dialog);
+}
+
+GtkWidget *
+gmameui_filter_builder_dialog_new (GtkWindow *parent)
+{
+	GtkWidget *dialog;
+
+	dialog = g_object_new (GMAMEUI_TYPE_FILTER_BUILDER_DIALOG,
+			       "title", _("Compound Filter"),
+			       "default-width", 480,
+			       NULL);
+
+	gtk_dialog_add_button (GTK_DIALOG (dialog),
+			       GTK_STOCK_CLEAR, RESPONSE_CLEAR);
+	gtk_dialog_add_button (GTK_DIALOG (dialog),
+			       GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE);
+	gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_CLOSE);
+
+	if (parent)
+		gtk_window_set_transient_for (GTK_WINDOW (dialog), parent);
+
+	return dialog;
+}
+
+static void
+gmameui_filter_builder_dialog_response (GtkDialog *dialog, gint response)
+{
+	GMAMEUIFilterBuilderDialogPrivate *priv;
+
+	priv = GMAMEUI_FILTER_BUILDER_DIALOG (dialog)->priv;
+
+	switch (response)
+	{
+		case RESPONSE_CLEAR:
+			/* Goes back to the filter selected in the filter list */
+			gtk_entry_set_text (GTK_ENTRY (priv->entry), "");
+			break;
+		case GTK_RESPONSE_CLOSE:
+		case GTK_RESPONSE_DELETE_EVENT:
+			/* The compound filter stays in use once the dialog is closed */
+			g_free (last_expression);
+			last_expression = g_strdup (gtk_entry_get_text (GTK_ENTRY (priv->entry)));
+
+			gtk_widget_destroy (GTK_WIDGET (dialog));
+			break;
+		default:
+			g_assert_not_reached ();
+	}
+}
+
+static void
+gmameui_filter_builder_dialog_destroy (GtkObject *object)
+{
+GMAMEUI_DEBUG ("Destroying gmameui filter builder dialog...");
+
+	GTK_OBJECT_CLASS (gmameui_filter_builder_dialog_parent_class)->destroy (object);
+
+GMAMEUI_DEBUG ("Destroying gmameui filter builder dialog... done");
+}
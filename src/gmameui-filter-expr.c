@@ -0,0 +1,424 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include <string.h>
+
+#include "gmameui-filter-expr.h"
+
+typedef enum {
+	TOKEN_END,
+	TOKEN_NAME,
+	TOKEN_AND,
+	TOKEN_OR,
+	TOKEN_NOT,
+	TOKEN_OPEN,
+	TOKEN_CLOSE,
+	TOKEN_ERROR
+} TokenType;
+
+/* Recursive descent parser - OR binds loosest, then AND, then NOT */
+typedef struct {
+	const gchar *pos;	/* Next character to read */
+	const gchar *token_start;
+
+	TokenType token;
+	gchar *name;		/* Word or quoted name of a TOKEN_NAME */
+	gboolean quoted;
+
+	GmameuiFilterLookupFunc lookup;
+	gpointer user_data;
+	GError **error;
+} Parser;
+
+#define SPECIAL_CHARS "()&|!\""
+
+GQuark
+gmameui_filter_expr_error_quark (void)
+{
+	return g_quark_from_static_string ("gmameui-filter-expr-error-quark");
+}
+
+static GmameuiFilterExpr *
+filter_expr_new (GmameuiFilterExprOp op)
+{
+	GmameuiFilterExpr *expr;
+
+	expr = g_new0 (GmameuiFilterExpr, 1);
+	expr->op = op;
+	expr->ref_count = 1;
+
+	return expr;
+}
+
+GmameuiFilterExpr *
+gmameui_filter_expr_new_filter (GMAMEUIFilter *filter)
+{
+	GmameuiFilterExpr *expr;
+
+	g_return_val_if_fail (GMAMEUI_IS_FILTER (filter), NULL);
+
+	expr = filter_expr_new (FILTER_EXPR_FILTER);
+	expr->filter = g_object_ref (filter);
+
+	return expr;
+}
+
+/* Takes the reference to the operand */
+GmameuiFilterExpr *
+gmameui_filter_expr_new_not (GmameuiFilterExpr *operand)
+{
+	GmameuiFilterExpr *expr;
+
+	g_return_val_if_fail (operand != NULL, NULL);
+
+	expr = filter_expr_new (FILTER_EXPR_NOT);
+	expr->left = operand;
+
+	return expr;
+}
+
+/* Takes the references to the operands */
+GmameuiFilterExpr *
+gmameui_filter_expr_new_binary (GmameuiFilterExprOp op,
+				GmameuiFilterExpr *left,
+				GmameuiFilterExpr *right)
+{
+	GmameuiFilterExpr *expr;
+
+	g_return_val_if_fail ((op == FILTER_EXPR_AND) || (op == FILTER_EXPR_OR), NULL);
+	g_return_val_if_fail (left != NULL, NULL);
+	g_return_val_if_fail (right != NULL, NULL);
+
+	expr = filter_expr_new (op);
+	expr->left = left;
+	expr->right = right;
+
+	return expr;
+}
+
+GmameuiFilterExpr *
+gmameui_filter_expr_ref (GmameuiFilterExpr *expr)
+{
+	g_return_val_if_fail (expr != NULL, NULL);
+
+	expr->ref_count++;
+
+	return expr;
+}
+
+void
+gmameui_filter_expr_unref (GmameuiFilterExpr *expr)
+{
+	g_return_if_fail (expr != NULL);
+
+	if (--expr->ref_count > 0)
+		return;
+
+	if (expr->filter)
+		g_object_unref (expr->filter);
+	if (expr->left)
+		gmameui_filter_expr_unref (expr->left);
+	if (expr->right)
+		gmameui_filter_expr_unref (expr->right);
+	g_free (expr);
+}
+
+/* Whether any filter in the expression is of the type */
+gboolean
+gmameui_filter_expr_uses_type (GmameuiFilterExpr *expr, gint type)
+{
+	gint filter_type;
+
+	g_return_val_if_fail (expr != NULL, FALSE);
+
+	switch (expr->op) {
+		case FILTER_EXPR_FILTER:
+			g_object_get (expr->filter, "type", &filter_type, NULL);
+			return (filter_type == type);
+		case FILTER_EXPR_NOT:
+			return gmameui_filter_expr_uses_type (expr->left, type);
+		default:
+			return gmameui_filter_expr_uses_type (expr->left, type) ||
+			       gmameui_filter_expr_uses_type (expr->right, type);
+	}
+}
+
+static void
+next_token (Parser *parser)
+{
+	const gchar *start;
+
+	g_free (parser->name);
+	parser->name = NULL;
+	parser->quoted = FALSE;
+
+	while (g_ascii_isspace (*parser->pos))
+		parser->pos++;
+	parser->token_start = parser->pos;
+
+	switch (*parser->pos) {
+		case '\0':
+			parser->token = TOKEN_END;
+			return;
+		case '(':
+			parser->token = TOKEN_OPEN;
+			parser->pos++;
+			return;
+		case ')':
+			parser->token = TOKEN_CLOSE;
+			parser->pos++;
+			return;
+		case '&':
+			parser->token = TOKEN_AND;
+			parser->pos++;
+			return;
+		case '|':
+			parser->token = TOKEN_OR;
+			parser->pos++;
+			return;
+		case '!':
+			parser->token = TOKEN_NOT;
+			parser->pos++;
+			return;
+		case '"':
+			start = ++parser->pos;
+			while ((*parser->pos != '\0') && (*parser->pos != '"'))
+				parser->pos++;
+
+			if (*parser->pos == '\0') {
+				g_set_error (parser->error, GMAMEUI_FILTER_EXPR_ERROR,
+					     GMAMEUI_FILTER_EXPR_ERROR_SYNTAX,
+					     _("A quoted name is missing its closing quote"));
+				parser->token = TOKEN_ERROR;
+				return;
+			}
+
+			parser->name = g_strndup (start, parser->pos - start);
+			parser->quoted = TRUE;
+			parser->token = TOKEN_NAME;
+			parser->pos++;
+			return;
+	}
+
+	start = parser->pos;
+	while ((*parser->pos != '\0') && !g_ascii_isspace (*parser->pos) &&
+	       (strchr (SPECIAL_CHARS, *parser->pos) == NULL))
+		parser->pos++;
+
+	parser->name = g_strndup (start, parser->pos - start);
+
+	/* Operators are only recognised in upper case, so that filter names
+	   containing the words can still be written without quotes */
+	if (strcmp (parser->name, "AND") == 0)
+		parser->token = TOKEN_AND;
+	else if (strcmp (parser->name, "OR") == 0)
+		parser->token = TOKEN_OR;
+	else if (strcmp (parser->name, "NOT") == 0)
+		parser->token = TOKEN_NOT;
+	else
+		parser->token = TOKEN_NAME;
+}
+
+static void
+set_unexpected_error (Parser *parser)
+{
+	if (parser->token == TOKEN_ERROR)
+		return;
+
+	if (parser->token == TOKEN_END)
+		g_set_error (parser->error, GMAMEUI_FILTER_EXPR_ERROR,
+			     GMAMEUI_FILTER_EXPR_ERROR_SYNTAX,
+			     _("The expression ends where a filter name was expected"));
+	else
+		g_set_error (parser->error, GMAMEUI_FILTER_EXPR_ERROR,
+			     GMAMEUI_FILTER_EXPR_ERROR_SYNTAX,
+			     _("Expected a filter name at \"%s\""), parser->token_start);
+}
+
+static GmameuiFilterExpr *parse_or (Parser *parser);
+
+/* A filter name, or an expression in brackets. Unquoted words following
+   each other make up a single name */
+static GmameuiFilterExpr *
+parse_primary (Parser *parser)
+{
+	GmameuiFilterExpr *expr;
+	GMAMEUIFilter *filter;
+	GString *name;
+	GError *lookup_error = NULL;
+
+	if (parser->token == TOKEN_OPEN) {
+		next_token (parser);
+		expr = parse_or (parser);
+		if (expr == NULL)
+			return NULL;
+
+		if (parser->token != TOKEN_CLOSE) {
+			if (parser->token != TOKEN_ERROR)
+				g_set_error (parser->error, GMAMEUI_FILTER_EXPR_ERROR,
+					     GMAMEUI_FILTER_EXPR_ERROR_SYNTAX,
+					     _("A bracket is missing its closing bracket"));
+			gmameui_filter_expr_unref (expr);
+			return NULL;
+		}
+		next_token (parser);
+
+		return expr;
+	}
+
+	if (parser->token != TOKEN_NAME) {
+		set_unexpected_error (parser);
+		return NULL;
+	}
+
+	name = g_string_new (parser->name);
+	if (!parser->quoted) {
+		next_token (parser);
+		while ((parser->token == TOKEN_NAME) && !parser->quoted) {
+			g_string_append_c (name, ' ');
+			g_string_append (name, parser->name);
+			next_token (parser);
+		}
+	} else {
+		next_token (parser);
+	}
+
+	/* The token after the name couldn't be read, and the error has
+	   already been set */
+	if (parser->token == TOKEN_ERROR) {
+		g_string_free (name, TRUE);
+		return NULL;
+	}
+
+	filter = parser->lookup (name->str, parser->user_data, &lookup_error);
+	if (filter == NULL) {
+		if (lookup_error)
+			g_propagate_error (parser->error, lookup_error);
+		else
+			g_set_error (parser->error, GMAMEUI_FILTER_EXPR_ERROR,
+				     GMAMEUI_FILTER_EXPR_ERROR_UNKNOWN_FILTER,
+				     _("There is no filter named \"%s\""), name->str);
+		g_string_free (name, TRUE);
+		return NULL;
+	}
+	g_string_free (name, TRUE);
+
+	return gmameui_filter_expr_new_filter (filter);
+}
+
+static GmameuiFilterExpr *
+parse_not (Parser *parser)
+{
+	GmameuiFilterExpr *operand;
+
+	if (parser->token != TOKEN_NOT)
+		return parse_primary (parser);
+
+	next_token (parser);
+	operand = parse_not (parser);
+	if (operand == NULL)
+		return NULL;
+
+	return gmameui_filter_expr_new_not (operand);
+}
+
+static GmameuiFilterExpr *
+parse_and (Parser *parser)
+{
+	GmameuiFilterExpr *left, *right;
+
+	left = parse_not (parser);
+
+	while (left && (parser->token == TOKEN_AND)) {
+		next_token (parser);
+		right = parse_not (parser);
+		if (right == NULL) {
+			gmameui_filter_expr_unref (left);
+			return NULL;
+		}
+		left = gmameui_filter_expr_new_binary (FILTER_EXPR_AND, left, right);
+	}
+
+	return left;
+}
+
+static GmameuiFilterExpr *
+parse_or (Parser *parser)
+{
+	GmameuiFilterExpr *left, *right;
+
+	left = parse_and (parser);
+
+	while (left && (parser->token == TOKEN_OR)) {
+		next_token (parser);
+		right = parse_and (parser);
+		if (right == NULL) {
+			gmameui_filter_expr_unref (left);
+			return NULL;
+		}
+		left = gmameui_filter_expr_new_binary (FILTER_EXPR_OR, left, right);
+	}
+
+	return left;
+}
+
+/* Returns NULL and sets error if the text is not a valid expression, or
+   names a filter the lookup function doesn't know */
+GmameuiFilterExpr *
+gmameui_filter_expr_parse (const gchar *text,
+			   GmameuiFilterLookupFunc lookup,
+			   gpointer user_data,
+			   GError **error)
+{
+	GmameuiFilterExpr *expr;
+	Parser parser;
+
+	g_return_val_if_fail (text != NULL, NULL);
+	g_return_val_if_fail (lookup != NULL, NULL);
+
+	memset (&parser, 0, sizeof (Parser));
+	parser.pos = text;
+	parser.lookup = lookup;
+	parser.user_data = user_data;
+	parser.error = error;
+
+	next_token (&parser);
+	expr = parse_or (&parser);
+
+	if (expr && (parser.token != TOKEN_END)) {
+		/* A token that couldn't be read has already set the error */
+		if (parser.token == TOKEN_CLOSE)
+			g_set_error (error, GMAMEUI_FILTER_EXPR_ERROR,
+				     GMAMEUI_FILTER_EXPR_ERROR_SYNTAX,
+				     _("A closing bracket has no opening bracket"));
+		else if (parser.token != TOKEN_ERROR)
+			g_set_error (error, GMAMEUI_FILTER_EXPR_ERROR,
+				     GMAMEUI_FILTER_EXPR_ERROR_SYNTAX,
+				     _("Expected AND or OR at \"%s\""), parser.token_start);
+		gmameui_filter_expr_unref (expr);
+		expr = NULL;
+	}
+
+	g_free (parser.name);
+
+	return expr;
+}
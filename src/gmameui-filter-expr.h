@@ -0,0 +1,98 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_FILTER_EXPR_H__
+#define __GMAMEUI_FILTER_EXPR_H__
+
+#include "common.h"
+#include "filter.h"
+
+G_BEGIN_DECLS
+
+/* A filter combining the filters in the filter list with AND, OR and NOT,
+   such as
+     Correct AND NOT Clones AND (Vector OR Category:Shooter / Flying Vertical)
+   A filter is named by its name in the filter list, or by its group and
+   name separated by a colon where the name alone is not unique. Names can
+   also be quoted */
+typedef enum {
+	FILTER_EXPR_FILTER,
+	FILTER_EXPR_NOT,
+	FILTER_EXPR_AND,
+	FILTER_EXPR_OR
+} GmameuiFilterExprOp;
+
+typedef struct _GmameuiFilterExpr GmameuiFilterExpr;
+
+struct _GmameuiFilterExpr {
+	GmameuiFilterExprOp op;
+	GMAMEUIFilter *filter;		/* For FILTER_EXPR_FILTER */
+	GmameuiFilterExpr *left;	/* Operand of NOT, or the operands of AND and OR */
+	GmameuiFilterExpr *right;
+
+	gint ref_count;
+};
+
+/* Returns the filter with the name, or NULL if there is none. The error
+   may be set to say why, otherwise the filter is reported as unknown */
+typedef GMAMEUIFilter * (*GmameuiFilterLookupFunc) (const gchar *name,
+						    gpointer user_data,
+						    GError **error);
+
+#define GMAMEUI_FILTER_EXPR_ERROR gmameui_filter_expr_error_quark ()
+
+typedef enum {
+	GMAMEUI_FILTER_EXPR_ERROR_SYNTAX,
+	GMAMEUI_FILTER_EXPR_ERROR_UNKNOWN_FILTER,
+	GMAMEUI_FILTER_EXPR_ERROR_AMBIGUOUS_FILTER
+} GmameuiFilterExprError;
+
+GQuark
+gmameui_filter_expr_error_quark (void);
+
+GmameuiFilterExpr *
+gmameui_filter_expr_new_filter (GMAMEUIFilter *filter);
+
+GmameuiFilterExpr *
+gmameui_filter_expr_new_not (GmameuiFilterExpr *operand);
+
+GmameuiFilterExpr *
+gmameui_filter_expr_new_binary (GmameuiFilterExprOp op,
+				GmameuiFilterExpr *left,
+				GmameuiFilterExpr *right);
+
+GmameuiFilterExpr *
+gmameui_filter_expr_ref (GmameuiFilterExpr *expr);
+
+void
+gmameui_filter_expr_unref (GmameuiFilterExpr *expr);
+
+GmameuiFilterExpr *
+gmameui_filter_expr_parse (const gchar *text,
+			   GmameuiFilterLookupFunc lookup,
+			   gpointer user_data,
+			   GError **error);
+
+gboolean
+gmameui_filter_expr_uses_type (GmameuiFilterExpr *expr, gint type);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_FILTER_EXPR_H__ */
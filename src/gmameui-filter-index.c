@@ -0,0 +1,580 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include <stdlib.h>
+
+#include "gmameui-filter-index.h"
+#include "gmameui.h"	/* For the filter types */
+
+/* The filter types that are indexed, with the columns the search entry
+   queries. Those with a property are read with g_object_get (), the others
+   with the MameRomEntry accessors. Drivers, manufacturers, romnames and
+   years have far more values than are ever asked for, so their bitsets are
+   only built the first time a filter or search asks for them */
+static const struct {
+	gint type;
+	const gchar *property;
+	gboolean lazy;
+} indexed_types[] = {
+	{ DRIVER, NULL, TRUE },
+	{ MAMEVER, NULL, FALSE },
+	{ CATEGORY, NULL, FALSE },
+	{ CLONE, NULL, FALSE },
+	{ FAVORITE, NULL, FALSE },
+	{ VECTOR, NULL, FALSE },
+	{ IS_BIOS, NULL, FALSE },
+	{ HAS_ROMS, NULL, FALSE },
+	{ HAS_SAMPLES, NULL, FALSE },
+	{ CONTROL, "control-type", FALSE },
+	{ DRIVER_STATUS, "driver-status", FALSE },
+	{ COLOR_STATUS, "driver-status-colour", FALSE },
+	{ SOUND_STATUS, "driver-status-sound", FALSE },
+	{ GRAPHIC_STATUS, "driver-status-graphics", FALSE },
+	{ TIMESPLAYED, "times-played", FALSE },
+	{ CHANNELS, "num-channels", FALSE },
+	{ YEAR, NULL, TRUE },
+	{ MANU, NULL, TRUE },
+	{ ROMNAME, NULL, TRUE },
+	{ NUMPLAYERS, "num-players", FALSE },
+	{ NUMBUTTONS, "num-buttons", FALSE },
+};
+
+#define NUM_INDEXED_TYPES G_N_ELEMENTS (indexed_types)
+
+/* Value of a text filter that no romset has. Text values are quarks and
+   unknown years are -1, so neither can be G_MININT */
+#define NO_VALUE G_MININT
+
+struct _GmameuiFilterIndex {
+	guint num_romsets;
+	gint *values[NUM_INDEXED_TYPES];	/* Per type, the value of each romset */
+	GHashTable *classes[NUM_INDEXED_TYPES];	/* Per type, value -> GmameuiBitset
+						   of the romsets with that value */
+	GmameuiBitset *empty;			/* Returned for values no romset has */
+};
+
+/* What a filter in the filter list matches */
+typedef struct {
+	guint slot;		/* In indexed_types */
+	gint value;
+	gboolean is;		/* FALSE if it matches the romsets without the value */
+} FilterCriteria;
+
+static gint
+get_slot (gint type)
+{
+	guint i;
+
+	for (i = 0; i < NUM_INDEXED_TYPES; i++) {
+		if (indexed_types[i].type == type)
+			return i;
+	}
+
+	return -1;
+}
+
+/* Text values are compared without case, as quarks of the lower case
+   text. Romsets without the text have the value 0 */
+static gint
+get_text_value (const gchar *text)
+{
+	gchar *folded;
+	GQuark quark;
+
+	if (text == NULL)
+		return 0;
+
+	folded = g_ascii_strdown (text, -1);
+	quark = g_quark_from_string (folded);
+	g_free (folded);
+
+	return (gint) quark;
+}
+
+/* Years are compared as numbers. Years that are partly unknown, such as
+   198?, have the value -1 */
+static gint
+get_year_value (const gchar *year)
+{
+	guint i;
+
+	if (year == NULL)
+		return -1;
+
+	for (i = 0; i < 4; i++) {
+		if (!g_ascii_isdigit (year[i]))
+			return -1;
+	}
+
+	return atoi (year);
+}
+
+static gint
+get_romset_value (MameRomEntry *rom, guint slot)
+{
+	gint value;
+
+	if (indexed_types[slot].property) {
+		g_object_get (rom, indexed_types[slot].property, &value, NULL);
+		return value;
+	}
+
+	switch (indexed_types[slot].type) {
+		case DRIVER:
+			return get_text_value (mame_rom_entry_get_driver (rom));
+		case MAMEVER:
+			return get_text_value (mame_rom_entry_get_version_added (rom));
+		case CATEGORY:
+			return get_text_value (mame_rom_entry_get_category (rom));
+		case CLONE:
+			return mame_rom_entry_is_clone (rom);
+		case FAVORITE:
+			return mame_rom_entry_is_favourite (rom);
+		case VECTOR:
+			return mame_rom_entry_is_vector (rom);
+		case IS_BIOS:
+			return mame_rom_entry_is_bios (rom);
+		case HAS_ROMS:
+			return mame_rom_entry_get_rom_status (rom);
+		case HAS_SAMPLES:
+			return mame_rom_entry_has_samples (rom);
+		case YEAR:
+			return get_year_value (mame_rom_entry_get_year (rom));
+		case MANU:
+			return get_text_value (mame_rom_entry_get_manufacturer (rom));
+		case ROMNAME:
+			return get_text_value (mame_rom_entry_get_romname (rom));
+		default:
+			g_assert_not_reached ();
+			return 0;
+	}
+}
+
+/* Returns the romsets with the value, building the bitset if no romset
+   had the value when the index was built. Values that no romset has aren't
+   kept, since a search builds a lookup for every prefix typed */
+static GmameuiBitset *
+get_class (GmameuiFilterIndex *index, guint slot, gint value)
+{
+	GmameuiBitset *class;
+	gboolean found = FALSE;
+	guint i;
+
+	if (value == NO_VALUE)
+		return index->empty;
+
+	class = g_hash_table_lookup (index->classes[slot], GINT_TO_POINTER (value));
+	if (class)
+		return class;
+
+	for (i = 0; (i < index->num_romsets) && !found; i++)
+		found = (index->values[slot][i] == value);
+	if (!found)
+		return index->empty;
+
+	class = gmameui_bitset_new (index->num_romsets);
+	for (i = 0; i < index->num_romsets; i++) {
+		if (index->values[slot][i] == value)
+			gmameui_bitset_set (class, i, TRUE);
+	}
+	g_hash_table_insert (index->classes[slot], GINT_TO_POINTER (value), class);
+
+	return class;
+}
+
+/* Returns FALSE if the filter type is not one that is indexed */
+static gboolean
+get_criteria (GMAMEUIFilter *filter, FilterCriteria *criteria)
+{
+	gchar *text;
+	gint type, int_value;
+	gint slot;
+
+	g_object_get (filter,
+		      "is", &criteria->is,
+		      "type", &type,
+		      "value", &text,
+		      "int_value", &int_value,
+		      NULL);
+
+	slot = get_slot (type);
+	if (slot < 0) {
+		GMAMEUI_DEBUG ("Trying to filter, but filter type %d is not handled", type);
+		g_free (text);
+		return FALSE;
+	}
+	criteria->slot = slot;
+
+	switch (type) {
+		case DRIVER:
+		case MAMEVER:
+		case CATEGORY:
+			if (text) {
+				gchar *folded = g_ascii_strdown (text, -1);
+
+				criteria->value = (gint) g_quark_try_string (folded);
+				g_free (folded);
+			}
+			if ((text == NULL) || (criteria->value == 0))
+				criteria->value = NO_VALUE;
+			break;
+		case CLONE:
+			/* The Originals filter is the one with is set */
+			criteria->value = FALSE;
+			break;
+		case FAVORITE:
+		case VECTOR:
+		case IS_BIOS:
+			criteria->value = TRUE;
+			break;
+		default:
+			criteria->value = int_value;
+	}
+
+	g_free (text);
+
+	return TRUE;
+}
+
+GmameuiFilterIndex *
+gmameui_filter_index_new (void)
+{
+	GmameuiFilterIndex *index;
+	guint i;
+
+	index = g_new0 (GmameuiFilterIndex, 1);
+	for (i = 0; i < NUM_INDEXED_TYPES; i++)
+		index->classes[i] = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+							   NULL, (GDestroyNotify) gmameui_bitset_free);
+
+	return index;
+}
+
+void
+gmameui_filter_index_free (GmameuiFilterIndex *index)
+{
+	guint i;
+
+	g_return_if_fail (index != NULL);
+
+	for (i = 0; i < NUM_INDEXED_TYPES; i++) {
+		g_hash_table_destroy (index->classes[i]);
+		g_free (index->values[i]);
+	}
+	if (index->empty)
+		gmameui_bitset_free (index->empty);
+	g_free (index);
+}
+
+/* Reads the filter values of every romset, and sorts the romsets into a
+   bitset for each value */
+void
+gmameui_filter_index_build (GmameuiFilterIndex *index, GPtrArray *romsets)
+{
+	guint i, slot;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (romsets != NULL);
+
+	index->num_romsets = romsets->len;
+
+	if (index->empty)
+		gmameui_bitset_free (index->empty);
+	index->empty = gmameui_bitset_new (index->num_romsets);
+
+	for (slot = 0; slot < NUM_INDEXED_TYPES; slot++) {
+		g_hash_table_remove_all (index->classes[slot]);
+		g_free (index->values[slot]);
+		index->values[slot] = g_new (gint, index->num_romsets);
+	}
+
+	for (i = 0; i < index->num_romsets; i++) {
+		MameRomEntry *rom = g_ptr_array_index (romsets, i);
+
+		for (slot = 0; slot < NUM_INDEXED_TYPES; slot++) {
+			GmameuiBitset *class;
+			gint value;
+
+			value = get_romset_value (rom, slot);
+			index->values[slot][i] = value;
+
+			if (indexed_types[slot].lazy)
+				continue;
+
+			class = g_hash_table_lookup (index->classes[slot], GINT_TO_POINTER (value));
+			if (class == NULL) {
+				class = gmameui_bitset_new (index->num_romsets);
+				g_hash_table_insert (index->classes[slot], GINT_TO_POINTER (value), class);
+			}
+			gmameui_bitset_set (class, i, TRUE);
+		}
+	}
+}
+
+/* Moves a romset whose details have changed into the bitsets of its new
+   values */
+void
+gmameui_filter_index_update_romset (GmameuiFilterIndex *index,
+				    guint romset,
+				    MameRomEntry *rom)
+{
+	guint slot;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (romset < index->num_romsets);
+	g_return_if_fail (rom != NULL);
+
+	for (slot = 0; slot < NUM_INDEXED_TYPES; slot++) {
+		GmameuiBitset *class;
+		gint old_value, value;
+
+		old_value = index->values[slot][romset];
+		value = get_romset_value (rom, slot);
+		if (value == old_value)
+			continue;
+
+		class = g_hash_table_lookup (index->classes[slot], GINT_TO_POINTER (old_value));
+		if (class)
+			gmameui_bitset_set (class, romset, FALSE);
+
+		class = g_hash_table_lookup (index->classes[slot], GINT_TO_POINTER (value));
+		if ((class == NULL) && !indexed_types[slot].lazy) {
+			class = gmameui_bitset_new (index->num_romsets);
+			g_hash_table_insert (index->classes[slot], GINT_TO_POINTER (value), class);
+		}
+		if (class)
+			gmameui_bitset_set (class, romset, TRUE);
+
+		index->values[slot][romset] = value;
+	}
+}
+
+/* Sets the bits of the romsets passing the filter on its own */
+static void
+get_filter_members (GmameuiFilterIndex *index,
+		    GMAMEUIFilter *filter,
+		    GmameuiBitset *members)
+{
+	FilterCriteria criteria;
+
+	if (!get_criteria (filter, &criteria)) {
+		gmameui_bitset_fill (members, FALSE);
+		return;
+	}
+
+	gmameui_bitset_copy (members, get_class (index, criteria.slot, criteria.value));
+	if (!criteria.is)
+		gmameui_bitset_invert (members);
+}
+
+static gboolean
+is_filter_member (GmameuiFilterIndex *index,
+		  GMAMEUIFilter *filter,
+		  guint romset)
+{
+	FilterCriteria criteria;
+
+	if (!get_criteria (filter, &criteria))
+		return FALSE;
+
+	return ((index->values[criteria.slot][romset] == criteria.value) == criteria.is);
+}
+
+/* Combines the bitsets of the filters in the expression a word at a time */
+static void
+get_expr_members (GmameuiFilterIndex *index,
+		  GmameuiFilterExpr *expr,
+		  GmameuiBitset *members)
+{
+	GmameuiBitset *right;
+
+	switch (expr->op) {
+		case FILTER_EXPR_FILTER:
+			get_filter_members (index, expr->filter, members);
+			break;
+		case FILTER_EXPR_NOT:
+			get_expr_members (index, expr->left, members);
+			gmameui_bitset_invert (members);
+			break;
+		case FILTER_EXPR_AND:
+		case FILTER_EXPR_OR:
+			get_expr_members (index, expr->left, members);
+
+			right = gmameui_bitset_new (members->size);
+			get_expr_members (index, expr->right, right);
+			if (expr->op == FILTER_EXPR_AND)
+				gmameui_bitset_and (members, right);
+			else
+				gmameui_bitset_or (members, right);
+			gmameui_bitset_free (right);
+			break;
+	}
+}
+
+static gboolean
+is_expr_member (GmameuiFilterIndex *index,
+		GmameuiFilterExpr *expr,
+		guint romset)
+{
+	switch (expr->op) {
+		case FILTER_EXPR_FILTER:
+			return is_filter_member (index, expr->filter, romset);
+		case FILTER_EXPR_NOT:
+			return !is_expr_member (index, expr->left, romset);
+		case FILTER_EXPR_AND:
+			return is_expr_member (index, expr->left, romset) &&
+			       is_expr_member (index, expr->right, romset);
+		default:
+			return is_expr_member (index, expr->left, romset) ||
+			       is_expr_member (index, expr->right, romset);
+	}
+}
+
+/* Sets the bits of the romsets shown for the filter expression and the ROM
+   filter setting - 1 to show only the available romsets, 2 the
+   unavailable. BIOS romsets are only shown by expressions using the BIOS
+   filter. With no expression, every romset other than the BIOSes is
+   shown */
+void
+gmameui_filter_index_get_members (GmameuiFilterIndex *index,
+				  GmameuiFilterExpr *expr,
+				  gint rom_filter_opt,
+				  GmameuiBitset *members)
+{
+	GmameuiBitset *not_avail;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (members != NULL);
+	g_return_if_fail (members->size == index->num_romsets);
+
+	if (expr)
+		get_expr_members (index, expr, members);
+	else
+		gmameui_bitset_fill (members, TRUE);
+
+	if ((expr == NULL) || !gmameui_filter_expr_uses_type (expr, IS_BIOS))
+		gmameui_bitset_and_not (members, get_class (index, get_slot (IS_BIOS), TRUE));
+
+	not_avail = get_class (index, get_slot (HAS_ROMS), NOT_AVAIL);
+	if (rom_filter_opt == 1)
+		gmameui_bitset_and_not (members, not_avail);
+	else if (rom_filter_opt == 2)
+		gmameui_bitset_and (members, not_avail);
+}
+
+/* Whether a single romset is shown, as for
+   gmameui_filter_index_get_members () */
+gboolean
+gmameui_filter_index_is_member (GmameuiFilterIndex *index,
+				GmameuiFilterExpr *expr,
+				gint rom_filter_opt,
+				guint romset)
+{
+	gboolean is_member;
+	gint rom_status;
+
+	g_return_val_if_fail (index != NULL, FALSE);
+	g_return_val_if_fail (romset < index->num_romsets, FALSE);
+
+	is_member = expr ? is_expr_member (index, expr, romset) : TRUE;
+
+	if (((expr == NULL) || !gmameui_filter_expr_uses_type (expr, IS_BIOS)) &&
+	    index->values[get_slot (IS_BIOS)][romset])
+		is_member = FALSE;
+
+	rom_status = index->values[get_slot (HAS_ROMS)][romset];
+	if (rom_filter_opt == 1)
+		is_member = is_member && (rom_status != NOT_AVAIL);
+	else if (rom_filter_opt == 2)
+		is_member = is_member && (rom_status == NOT_AVAIL);
+
+	return is_member;
+}
+
+/* Value of the text in the text columns, or one that no romset has if the
+   text was never indexed. Text is compared without case */
+gint
+gmameui_filter_index_lookup_text (const gchar *text)
+{
+	gchar *folded;
+	GQuark quark;
+
+	g_return_val_if_fail (text != NULL, NO_VALUE);
+
+	folded = g_ascii_strdown (text, -1);
+	quark = g_quark_try_string (folded);
+	g_free (folded);
+
+	return (quark != 0) ? (gint) quark : NO_VALUE;
+}
+
+/* Sets the bits of the romsets whose value in the column is between min
+   and max, inclusive. A single value uses its bitset; a range scans the
+   column's values */
+void
+gmameui_filter_index_get_range_members (GmameuiFilterIndex *index,
+					gint column,
+					gint min,
+					gint max,
+					GmameuiBitset *members)
+{
+	gint slot;
+	guint i;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (members != NULL);
+	g_return_if_fail (members->size == index->num_romsets);
+
+	slot = get_slot (column);
+	g_return_if_fail (slot >= 0);
+
+	if (min == max) {
+		gmameui_bitset_copy (members, get_class (index, slot, min));
+		return;
+	}
+
+	gmameui_bitset_fill (members, FALSE);
+	for (i = 0; i < index->num_romsets; i++) {
+		gint value = index->values[slot][i];
+
+		if ((value >= min) && (value <= max))
+			gmameui_bitset_set (members, i, TRUE);
+	}
+}
+
+/* Value of a romset in the column, as indexed. Text columns have the
+   value given by gmameui_filter_index_lookup_text () */
+gint
+gmameui_filter_index_get_value (GmameuiFilterIndex *index,
+				gint column,
+				guint romset)
+{
+	gint slot;
+
+	g_return_val_if_fail (index != NULL, NO_VALUE);
+	g_return_val_if_fail (romset < index->num_romsets, NO_VALUE);
+
+	slot = get_slot (column);
+	g_return_val_if_fail (slot >= 0, NO_VALUE);
+
+	return index->values[slot][romset];
+}
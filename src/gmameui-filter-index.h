@@ -0,0 +1,81 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_FILTER_INDEX_H__
+#define __GMAMEUI_FILTER_INDEX_H__
+
+#include "common.h"
+#include "gmameui-filter-expr.h"
+#include "rom_entry.h"
+#include "gmameui-bitset.h"
+
+G_BEGIN_DECLS
+
+/* Which romsets pass each filter in the filter list, kept as a bitset per
+   filter value so that choosing a filter only copies a bitset rather than
+   testing every romset. Filter expressions combine the bitsets a word at
+   a time. Romsets are numbered by their position in the array given to
+   gmameui_filter_index_build () */
+typedef struct _GmameuiFilterIndex GmameuiFilterIndex;
+
+GmameuiFilterIndex *
+gmameui_filter_index_new (void);
+
+void
+gmameui_filter_index_free (GmameuiFilterIndex *index);
+
+void
+gmameui_filter_index_build (GmameuiFilterIndex *index, GPtrArray *romsets);
+
+void
+gmameui_filter_index_update_romset (GmameuiFilterIndex *index,
+				    guint romset,
+				    MameRomEntry *rom);
+
+void
+gmameui_filter_index_get_members (GmameuiFilterIndex *index,
+				  GmameuiFilterExpr *expr,
+				  gint rom_filter_opt,
+				  GmameuiBitset *members);
+
+gboolean
+gmameui_filter_index_is_member (GmameuiFilterIndex *index,
+				GmameuiFilterExpr *expr,
+				gint rom_filter_opt,
+				guint romset);
+
+gint
+gmameui_filter_index_lookup_text (const gchar *text);
+
+void
+gmameui_filter_index_get_range_members (GmameuiFilterIndex *index,
+					gint column,
+					gint min,
+					gint max,
+					GmameuiBitset *members);
+
+gint
+gmameui_filter_index_get_value (GmameuiFilterIndex *index,
+				gint column,
+				guint romset);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_FILTER_INDEX_H__ */
@@ -0,0 +1,370 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/* Writes a Logiqx format DAT listing only the ROMs the last audit found to
+   be missing or bad, for ROM management tools to build the romsets from.
+   The DAT is written a romset at a time, straight from the audit store */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <glib/gstdio.h>
+
+#include "gmameui-fixdat.h"
+#include "gmameui-listoutput.h"
+
+static void
+write_escaped (FILE *f, const gchar *text)
+{
+	const gchar *p;
+
+	for (p = text; *p; p++) {
+		switch (*p) {
+			case '&':
+				fputs ("&amp;", f);
+				break;
+			case '<':
+				fputs ("&lt;", f);
+				break;
+			case '>':
+				fputs ("&gt;", f);
+				break;
+			case '"':
+				fputs ("&quot;", f);
+				break;
+			default:
+				fputc (*p, f);
+		}
+	}
+}
+
+static void
+write_attribute (FILE *f, const gchar *name, const gchar *value)
+{
+	if ((value == NULL) || (*value == '\0'))
+		return;
+
+	fprintf (f, " %s=\"", name);
+	write_escaped (f, value);
+	fputc ('"', f);
+}
+
+/* Whether the chip can be fixed by finding a good copy of it */
+static gboolean
+chip_is_fixable (AuditChipResult *chip)
+{
+	return (chip->status == AUDIT_CHIP_NOT_FOUND) ||
+	       (chip->status == AUDIT_CHIP_BAD_CHECKSUM) ||
+	       (chip->status == AUDIT_CHIP_BAD_LENGTH);
+}
+
+static individual_rom *
+find_rom (GList *roms, const gchar *name)
+{
+	for (; roms; roms = g_list_next (roms)) {
+		individual_rom *rom = (individual_rom *) roms->data;
+
+		if (g_ascii_strcasecmp (rom->name, name) == 0)
+			return rom;
+	}
+
+	return NULL;
+}
+
+/* Whether the ROM has a known dump, so it can be looked for */
+static gboolean
+rom_is_dumped (individual_rom *rom)
+{
+	return !(rom->status && (g_ascii_strcasecmp (rom->status, "nodump") == 0));
+}
+
+/* The -listxml ROM information isn't stored in the gamelist file, so it is
+   only known once it has been read this session */
+static gboolean
+has_rom_details (MameRomEntry *romset)
+{
+	return (mame_rom_entry_get_roms (romset) != NULL) ||
+	       (mame_rom_entry_get_disks (romset) != NULL);
+}
+
+/* The audit record of a romset the fixdat needs to list, or NULL */
+static const AuditRecord *
+lookup_fixable_record (GmameuiAuditStore *store, MameRomEntry *romset)
+{
+	const AuditRecord *record;
+
+	record = gmameui_audit_store_lookup (store, mame_rom_entry_get_romname (romset));
+	if ((record == NULL) ||
+	    ((record->rom_status != INCORRECT) && (record->rom_status != NOT_AVAIL)))
+		return NULL;
+
+	return record;
+}
+
+/* Reads the ROM information with -listxml unless every romset the fixdat
+   lists already has it, then checks that each bad chip can be written with
+   its size, CRC and SHA1. Nothing is written if it can't, rather than
+   leaving a fixdat that ROM managers can't build from */
+static gboolean
+load_rom_details (GmameuiAuditStore *store, MameGamelist *gl, MameExec *exec,
+		  GError **error)
+{
+	GList *ptr, *chips;
+	gboolean missing = FALSE;
+
+	for (ptr = mame_gamelist_get_roms_glist (gl); ptr && !missing; ptr = g_list_next (ptr)) {
+		MameRomEntry *romset = (MameRomEntry *) ptr->data;
+
+		missing = (lookup_fixable_record (store, romset) != NULL) &&
+			  !has_rom_details (romset);
+	}
+
+	if (missing) {
+		GMAMEUIListOutput *parser;
+		gboolean ok;
+
+		if (exec == NULL) {
+			g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+				     _("No MAME executable to read the ROM information from"));
+			return FALSE;
+		}
+
+		parser = gmameui_listoutput_new ();
+		ok = gmameui_listoutput_generate_rom_hash (parser, exec);
+		g_object_unref (parser);
+
+		if (!ok) {
+			g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_IO,
+				     _("Could not read the ROM information from %s"),
+				     mame_exec_get_path (exec));
+			return FALSE;
+		}
+	}
+
+	for (ptr = mame_gamelist_get_roms_glist (gl); ptr; ptr = g_list_next (ptr)) {
+		MameRomEntry *romset = (MameRomEntry *) ptr->data;
+		const AuditRecord *record;
+
+		if ((record = lookup_fixable_record (store, romset)) == NULL)
+			continue;
+
+		for (chips = record->chips; chips; chips = g_list_next (chips)) {
+			AuditChipResult *chip = (AuditChipResult *) chips->data;
+			individual_rom *rom;
+			gboolean complete;
+
+			if (!chip_is_fixable (chip))
+				continue;
+
+			if ((rom = find_rom (mame_rom_entry_get_roms (romset), chip->name)) != NULL)
+				complete = !rom_is_dumped (rom) ||
+					   ((rom->uncomp_size > 0) && rom->crc && rom->sha1);
+			else if ((rom = find_rom (mame_rom_entry_get_disks (romset), chip->name)) != NULL)
+				complete = !rom_is_dumped (rom) || (rom->sha1 != NULL);
+			else
+				complete = FALSE;
+
+			if (!complete) {
+				g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+					     _("No ROM information for %s in romset %s"),
+					     chip->name, mame_rom_entry_get_romname (romset));
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+write_rom (FILE *f, individual_rom *rom)
+{
+	fputs ("\t\t<rom", f);
+	write_attribute (f, "name", rom->name);
+	if (rom->uncomp_size > 0)
+		fprintf (f, " size=\"%d\"", rom->uncomp_size);
+	write_attribute (f, "crc", rom->crc);
+	write_attribute (f, "sha1", rom->sha1);
+	fputs ("/>\n", f);
+}
+
+static void
+write_disk (FILE *f, individual_rom *disk)
+{
+	fputs ("\t\t<disk", f);
+	write_attribute (f, "name", disk->name);
+	write_attribute (f, "sha1", disk->sha1);
+	fputs ("/>\n", f);
+}
+
+static void
+write_game_start (FILE *f, MameRomEntry *romset)
+{
+	fputs ("\t<game", f);
+	write_attribute (f, "name", mame_rom_entry_get_romname (romset));
+	if (mame_rom_entry_is_clone (romset)) {
+		write_attribute (f, "cloneof", mame_rom_entry_get_parent_romname (romset));
+		write_attribute (f, "romof", mame_rom_entry_get_parent_romname (romset));
+	}
+	fputs (">\n\t\t<description>", f);
+	write_escaped (f, mame_rom_entry_get_gamename (romset));
+	fputs ("</description>\n", f);
+}
+
+/* Writes the romset's missing and bad ROMs. A romset that wasn't found at
+   all needs every ROM that has a known dump. Returns FALSE if there was
+   nothing to write */
+static gboolean
+write_romset (FILE *f, MameRomEntry *romset, const AuditRecord *record)
+{
+	GList *roms, *disks, *ptr;
+	gboolean started = FALSE;
+
+	roms = mame_rom_entry_get_roms (romset);
+	disks = mame_rom_entry_get_disks (romset);
+
+	if ((record->rom_status == NOT_AVAIL) && (record->chips == NULL)) {
+		for (ptr = roms; ptr; ptr = g_list_next (ptr)) {
+			individual_rom *rom = (individual_rom *) ptr->data;
+
+			if (!rom_is_dumped (rom))
+				continue;
+
+			if (!started) {
+				write_game_start (f, romset);
+				started = TRUE;
+			}
+			write_rom (f, rom);
+		}
+		for (ptr = disks; ptr; ptr = g_list_next (ptr)) {
+			if (!started) {
+				write_game_start (f, romset);
+				started = TRUE;
+			}
+			write_disk (f, (individual_rom *) ptr->data);
+		}
+	} else {
+		for (ptr = record->chips; ptr; ptr = g_list_next (ptr)) {
+			AuditChipResult *chip = (AuditChipResult *) ptr->data;
+			individual_rom *rom;
+
+			if (!chip_is_fixable (chip))
+				continue;
+
+			/* load_rom_details has checked each chip is listed */
+			if ((rom = find_rom (roms, chip->name)) == NULL)
+				rom = find_rom (disks, chip->name);
+			if (!rom_is_dumped (rom))
+				continue;
+
+			if (!started) {
+				write_game_start (f, romset);
+				started = TRUE;
+			}
+
+			if (rom->crc)
+				write_rom (f, rom);
+			else
+				write_disk (f, rom);
+		}
+	}
+
+	if (started)
+		fputs ("\t</game>\n", f);
+
+	return started;
+}
+
+/* Writes a fixdat for the romsets whose last audit found missing or bad
+   ROMs, reading the ROM information with the executable if needed. Returns
+   FALSE and sets the error if the file couldn't be written */
+gboolean
+gmameui_fixdat_write (GmameuiAuditStore *store,
+		      MameGamelist *gl,
+		      MameExec *exec,
+		      const gchar *filename,
+		      guint *num_romsets,
+		      GError **error)
+{
+	GList *ptr;
+	FILE *f;
+	gchar date[16];
+	time_t now;
+	guint count = 0;
+	gboolean ok;
+
+	g_return_val_if_fail (store != NULL, FALSE);
+	g_return_val_if_fail (gl != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	if (!load_rom_details (store, gl, exec, error))
+		return FALSE;
+
+	f = g_fopen (filename, "w");
+	if (f == NULL) {
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+			     _("Could not write to %s: %s"), filename, g_strerror (errno));
+		return FALSE;
+	}
+
+	now = time (NULL);
+	strftime (date, sizeof (date), "%Y%m%d", localtime (&now));
+
+	fputs ("<?xml version=\"1.0\"?>\n"
+	       "<!DOCTYPE datafile PUBLIC \"-//Logiqx//DTD ROM Management Datafile//EN\" "
+	       "\"http://www.logiqx.com/Dats/datafile.dtd\">\n"
+	       "<datafile>\n"
+	       "\t<header>\n"
+	       "\t\t<name>GMAMEUI fixdat</name>\n"
+	       "\t\t<description>Missing and incorrect ROMs</description>\n", f);
+	fprintf (f, "\t\t<version>%s</version>\n", date);
+	fputs ("\t\t<author>GMAMEUI</author>\n"
+	       "\t</header>\n", f);
+
+	for (ptr = mame_gamelist_get_roms_glist (gl); ptr; ptr = g_list_next (ptr)) {
+		MameRomEntry *romset = (MameRomEntry *) ptr->data;
+		const AuditRecord *record;
+
+		if ((record = lookup_fixable_record (store, romset)) == NULL)
+			continue;
+
+		if (write_romset (f, romset, record))
+			count++;
+	}
+
+	fputs ("</datafile>\n", f);
+
+	ok = (ferror (f) == 0);
+	if (fclose (f) != 0)
+		ok = FALSE;
+
+	if (!ok)
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_IO,
+			     _("Could not write to %s"), filename);
+
+	GMAMEUI_DEBUG ("Wrote fixdat for %d romsets to %s", count, filename);
+
+	if (num_romsets)
+		*num_romsets = count;
+
+	return ok;
+}
@@ -0,0 +1,41 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_FIXDAT_H__
+#define __GMAMEUI_FIXDAT_H__
+
+#include "common.h"
+#include "game_list.h"
+#include "mame-exec.h"
+#include "gmameui-audit-store.h"
+
+G_BEGIN_DECLS
+
+gboolean
+gmameui_fixdat_write (GmameuiAuditStore *store,
+		      MameGamelist *gl,
+		      MameExec *exec,
+		      const gchar *filename,
+		      guint *num_romsets,
+		      GError **error);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_FIXDAT_H__ */
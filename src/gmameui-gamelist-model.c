@@ -0,0 +1,1873 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include <string.h>
+
+#include "gmameui-gamelist-model.h"
+#include "gmameui-filter-index.h"
+#include "gmameui-search-index.h"
+#include "gmameui.h"	/* For the column ids */
+#include "gui.h"	/* For gmameui_icon_mgr_get_pixbuf_for_status */
+
+/* Value of row_of for a romset that isn't shown */
+#define NO_ROW G_MAXUINT
+
+/* The romsets in ascending order of a column. It is kept until the
+   gamelist changes, so that sorting on the column again, either way
+   round, only copies the order */
+typedef struct {
+	guint *order;		/* Every romset, with equal values in gamelist order */
+	guint *ranks;		/* Per romset, the position of its value among the
+				   column's distinct values */
+} SortColumn;
+
+/* The clones shown under a parent that the view has expanded, in sort
+   order. They are made when the row is expanded and freed when it is
+   collapsed; the clones of the other parents are only counted */
+typedef struct {
+	guint *rows;
+	guint num_rows;
+} ChildRows;
+
+/* Iters point to the romset, with user_data set to its position in
+   romsets. A romset's position is also kept in its MameRomEntry, in the
+   user_data of the iter returned by mame_rom_entry_get_position () */
+struct _MameGamelistModelPrivate {
+	GPtrArray *romsets;	/* MameRomEntry from the gamelist, in its order */
+	GmameuiFilterIndex *index;	/* Romsets passing each filter */
+	GmameuiBitset *filtered;	/* Romsets passing the selected filter */
+	GmameuiSearchIndex *search_index;
+	GmameuiBitset *searched;	/* Romsets matching the search query */
+
+	guint *order;		/* Every romset, in sort order */
+	guint *order_pos;	/* Per romset, its position in order */
+	SortColumn *sort_columns[NUMBER_COLUMN];	/* NULL until sorted on */
+
+	guint *rows;		/* The romsets shown, in sort order */
+	guint *row_of;		/* Per romset, its row or NO_ROW */
+	guint num_rows;
+
+	/* While the rows are refiltered, the rows that have been updated are
+	   in next and those still to do are in rows, from old_pos on. The
+	   view may ask about either while it is told of the changes */
+	guint *next;
+	gboolean refiltering;
+	guint split;		/* Number of rows updated */
+	guint old_pos;		/* First row in rows still to update */
+	guint order_done;	/* Number of romsets in order updated */
+
+	gint sort_column;
+	GtkSortType sort_order;
+
+	MameSearchQuery *query;	/* From the search entry */
+
+	/* In the tree, the top level only has the parents and the clones whose
+	   parent isn't in the gamelist. A parent is shown if it or any of its
+	   clones is, and its clones shown are its children */
+	gboolean tree;
+	guint *parent_of;	/* Per romset, its parent or NO_ROW */
+	guint *family_start;	/* Per romset, where its clones start in family */
+	guint *family;		/* The clones of each parent, in sort order */
+	guint *visible_clones;	/* Per parent, the number of its clones shown */
+	GHashTable *expanded;	/* Parent -> ChildRows of the rows expanded */
+
+	GmameuiFilterExpr *expr;	/* Filters selected in the filter list */
+	gint rom_filter_opt;	/* current-rom-filter setting */
+
+	/* Status icons shared by the romsets without an icon of their own */
+	GdkPixbuf *status_icons[NUMBER_STATUS];
+
+	gint stamp;
+};
+
+static void mame_gamelist_model_tree_model_init (GtkTreeModelIface *iface);
+static void mame_gamelist_model_tree_sortable_init (GtkTreeSortableIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (MameGamelistModel, mame_gamelist_model, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+						mame_gamelist_model_tree_model_init)
+			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_SORTABLE,
+						mame_gamelist_model_tree_sortable_init))
+
+static MameRomEntry *
+get_romset (MameGamelistModel *model, guint romset)
+{
+	return (MameRomEntry *) g_ptr_array_index (model->priv->romsets, romset);
+}
+
+static guint
+get_num_rows (MameGamelistModelPrivate *priv)
+{
+	if (priv->refiltering)
+		return priv->split + (priv->num_rows - priv->old_pos);
+
+	return priv->num_rows;
+}
+
+static guint
+get_romset_at_row (MameGamelistModelPrivate *priv, guint row)
+{
+	if (priv->refiltering) {
+		if (row < priv->split)
+			return priv->next[row];
+
+		return priv->rows[row - priv->split + priv->old_pos];
+	}
+
+	return priv->rows[row];
+}
+
+static guint
+get_row_of_romset (MameGamelistModelPrivate *priv, guint romset)
+{
+	guint row = priv->row_of[romset];
+
+	/* Romsets not yet reached by a refilter are still at their old row */
+	if (priv->refiltering && (row != NO_ROW) && (priv->order_pos[romset] >= priv->order_done))
+		return row - priv->old_pos + priv->split;
+
+	return row;
+}
+
+static guint
+get_romset_index (MameGamelistModel *model, MameRomEntry *rom)
+{
+	GtkTreeIter position;
+	guint romset;
+
+	position = mame_rom_entry_get_position (rom);
+	romset = GPOINTER_TO_UINT (position.user_data);
+
+	g_return_val_if_fail (romset < model->priv->romsets->len, NO_ROW);
+	g_return_val_if_fail (get_romset (model, romset) == rom, NO_ROW);
+
+	return romset;
+}
+
+static void
+set_iter (MameGamelistModel *model, GtkTreeIter *iter, guint romset)
+{
+	iter->stamp = model->priv->stamp;
+	iter->user_data = GUINT_TO_POINTER (romset);
+	iter->user_data2 = NULL;
+	iter->user_data3 = NULL;
+}
+
+/* Sets the bits of the romsets matching a single search term */
+static void
+get_term_members (MameGamelistModel *model,
+		  MameSearchTerm *term,
+		  GmameuiBitset *members)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	gint value;
+
+	switch (term->type) {
+		case SEARCH_TERM_TEXT:
+			gmameui_search_index_search (priv->search_index, term->text, members);
+			break;
+		case SEARCH_TERM_NAME:
+			value = gmameui_filter_index_lookup_text (term->text);
+			gmameui_filter_index_get_range_members (priv->index, term->column,
+								value, value, members);
+			break;
+		case SEARCH_TERM_RANGE:
+			gmameui_filter_index_get_range_members (priv->index, term->column,
+								term->min, term->max, members);
+			break;
+		default:
+			gmameui_bitset_fill (members, FALSE);
+	}
+}
+
+static gboolean
+term_matches (MameGamelistModel *model, MameSearchTerm *term, guint romset)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	gint value;
+
+	switch (term->type) {
+		case SEARCH_TERM_TEXT:
+			return gmameui_search_index_matches (priv->search_index, term->text, romset);
+		case SEARCH_TERM_NAME:
+			value = gmameui_filter_index_get_value (priv->index, term->column, romset);
+			return (value == gmameui_filter_index_lookup_text (term->text));
+		case SEARCH_TERM_RANGE:
+			value = gmameui_filter_index_get_value (priv->index, term->column, romset);
+			return (value >= term->min) && (value <= term->max);
+		default:
+			return FALSE;
+	}
+}
+
+/* Combines the romsets matching each term of the search query */
+static void
+update_searched (MameGamelistModel *model)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	GmameuiBitset *term_members;
+	guint i;
+
+	gmameui_bitset_fill (priv->searched, TRUE);
+
+	if ((priv->query == NULL) || (priv->query->terms->len == 0))
+		return;
+
+	term_members = gmameui_bitset_new (priv->searched->size);
+	for (i = 0; i < priv->query->terms->len; i++) {
+		MameSearchTerm *term = &g_array_index (priv->query->terms, MameSearchTerm, i);
+
+		get_term_members (model, term, term_members);
+		if (term->negate)
+			gmameui_bitset_and_not (priv->searched, term_members);
+		else
+			gmameui_bitset_and (priv->searched, term_members);
+	}
+	gmameui_bitset_free (term_members);
+}
+
+/* Whether a single romset matches the search query, as for
+   update_searched () */
+static gboolean
+romset_matches_search (MameGamelistModel *model, guint romset)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	guint i;
+
+	if (priv->query == NULL)
+		return TRUE;
+
+	for (i = 0; i < priv->query->terms->len; i++) {
+		MameSearchTerm *term = &g_array_index (priv->query->terms, MameSearchTerm, i);
+
+		if (term_matches (model, term, romset) == term->negate)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+romset_is_visible (MameGamelistModel *model, guint romset)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+
+	return gmameui_bitset_get (priv->filtered, romset) &&
+	       gmameui_bitset_get (priv->searched, romset);
+}
+
+static void
+child_rows_free (ChildRows *children)
+{
+	g_free (children->rows);
+	g_free (children);
+}
+
+/* Whether the romset is a clone shown under its parent */
+static gboolean
+is_child (MameGamelistModelPrivate *priv, guint romset)
+{
+	return priv->tree && (priv->parent_of[romset] != NO_ROW);
+}
+
+/* Whether the romset is a row at the top level */
+static gboolean
+romset_is_shown (MameGamelistModel *model, guint romset)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+
+	if (!priv->tree)
+		return romset_is_visible (model, romset);
+
+	if (priv->parent_of[romset] != NO_ROW)
+		return FALSE;
+
+	return romset_is_visible (model, romset) || (priv->visible_clones[romset] > 0);
+}
+
+static ChildRows *
+get_child_rows (MameGamelistModelPrivate *priv, guint parent)
+{
+	return g_hash_table_lookup (priv->expanded, GUINT_TO_POINTER (parent));
+}
+
+static guint
+get_num_children (MameGamelistModelPrivate *priv, guint parent)
+{
+	ChildRows *children;
+
+	if (!priv->tree || (priv->parent_of[parent] != NO_ROW))
+		return 0;
+
+	children = get_child_rows (priv, parent);
+
+	return children ? children->num_rows : priv->visible_clones[parent];
+}
+
+/* Returns the nth clone shown under the parent, or NO_ROW. The clones of
+   a parent that isn't expanded are counted from the family */
+static guint
+get_nth_child (MameGamelistModel *model, guint parent, guint n)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	ChildRows *children;
+	guint i;
+
+	if (!priv->tree || (priv->parent_of[parent] != NO_ROW))
+		return NO_ROW;
+
+	children = get_child_rows (priv, parent);
+	if (children)
+		return (n < children->num_rows) ? children->rows[n] : NO_ROW;
+
+	for (i = priv->family_start[parent]; i < priv->family_start[parent + 1]; i++) {
+		if (!romset_is_visible (model, priv->family[i]))
+			continue;
+		if (n-- == 0)
+			return priv->family[i];
+	}
+
+	return NO_ROW;
+}
+
+/* Returns the row of a clone under its parent, or NO_ROW */
+static guint
+get_child_row (MameGamelistModel *model, guint clone)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	ChildRows *children;
+	guint parent, row, i;
+
+	parent = priv->parent_of[clone];
+
+	children = get_child_rows (priv, parent);
+	if (children) {
+		for (i = 0; i < children->num_rows; i++) {
+			if (children->rows[i] == clone)
+				return i;
+		}
+		return NO_ROW;
+	}
+
+	if (!romset_is_visible (model, clone))
+		return NO_ROW;
+
+	for (i = priv->family_start[parent], row = 0; priv->family[i] != clone; i++) {
+		if (romset_is_visible (model, priv->family[i]))
+			row++;
+	}
+
+	return row;
+}
+
+/* Returns the clone shown after this one under their parent, or NO_ROW */
+static guint
+get_next_child (MameGamelistModel *model, guint clone)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	ChildRows *children;
+	guint parent, row, i;
+
+	parent = priv->parent_of[clone];
+
+	children = get_child_rows (priv, parent);
+	if (children) {
+		row = get_child_row (model, clone);
+		if ((row == NO_ROW) || (row + 1 >= children->num_rows))
+			return NO_ROW;
+		return children->rows[row + 1];
+	}
+
+	for (i = priv->family_start[parent]; priv->family[i] != clone; i++)
+		;
+	for (i++; i < priv->family_start[parent + 1]; i++) {
+		if (romset_is_visible (model, priv->family[i]))
+			return priv->family[i];
+	}
+
+	return NO_ROW;
+}
+
+/* Finds the parent of each clone through the gamelist's clone index, and
+   makes room in family for each parent's clones */
+static void
+build_families (MameGamelistModel *model, MameGamelist *gl)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	guint n, i;
+
+	n = priv->romsets->len;
+
+	g_free (priv->parent_of);
+	g_free (priv->family_start);
+	g_free (priv->family);
+	g_free (priv->visible_clones);
+
+	priv->parent_of = g_new (guint, n);
+	priv->family_start = g_new0 (guint, n + 1);
+	priv->visible_clones = g_new0 (guint, n);
+
+	for (i = 0; i < n; i++)
+		priv->parent_of[i] = NO_ROW;
+
+	for (i = 0; (i < n) && gl; i++) {
+		MameRomEntry *rom = get_romset (model, i);
+		GList *clones;
+
+		if (mame_rom_entry_is_clone (rom))
+			continue;
+
+		for (clones = mame_gamelist_get_clones (gl, mame_rom_entry_get_romname (rom));
+		     clones;
+		     clones = g_list_next (clones)) {
+			guint clone = get_romset_index (model, clones->data);
+
+			if (clone != NO_ROW)
+				priv->parent_of[clone] = i;
+		}
+	}
+
+	/* Count the clones of each parent, then add up where each starts */
+	for (i = 0; i < n; i++) {
+		if (priv->parent_of[i] != NO_ROW)
+			priv->family_start[priv->parent_of[i] + 1]++;
+	}
+	for (i = 0; i < n; i++)
+		priv->family_start[i + 1] += priv->family_start[i];
+
+	priv->family = g_new (guint, priv->family_start[n]);
+}
+
+/* Puts the clones of each parent in sort order */
+static void
+sort_families (MameGamelistModel *model)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	guint *fill;
+	guint n, i;
+
+	n = priv->romsets->len;
+	if ((priv->family == NULL) || (n == 0))
+		return;
+
+	fill = g_memdup (priv->family_start, n * sizeof (guint));
+	for (i = 0; i < n; i++) {
+		guint romset = priv->order[i];
+		guint parent = priv->parent_of[romset];
+
+		if (parent != NO_ROW)
+			priv->family[fill[parent]++] = romset;
+	}
+	g_free (fill);
+}
+
+static void
+count_visible_clones (MameGamelistModel *model)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	guint i;
+
+	memset (priv->visible_clones, 0, priv->romsets->len * sizeof (guint));
+	for (i = 0; i < priv->romsets->len; i++) {
+		if ((priv->parent_of[i] != NO_ROW) && romset_is_visible (model, i))
+			priv->visible_clones[priv->parent_of[i]]++;
+	}
+}
+
+/* Tells the view which clones are now shown under a parent that stays at
+   the top level, and whether it now has any. Only an expanded parent has
+   its clones removed and added one by one */
+static void
+update_children (MameGamelistModel *model, guint parent, gboolean had_children)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	ChildRows *children;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	guint parent_row;
+
+	parent_row = get_row_of_romset (priv, parent);
+
+	children = get_child_rows (priv, parent);
+	if (children) {
+		guint pos = 0, i;
+
+		for (i = priv->family_start[parent]; i < priv->family_start[parent + 1]; i++) {
+			guint clone = priv->family[i];
+			gboolean was_visible, is_visible;
+
+			was_visible = (pos < children->num_rows) && (children->rows[pos] == clone);
+			is_visible = romset_is_visible (model, clone);
+
+			if (was_visible && is_visible) {
+				pos++;
+			} else if (was_visible) {
+				children->num_rows--;
+				g_memmove (&children->rows[pos], &children->rows[pos + 1],
+					   (children->num_rows - pos) * sizeof (guint));
+
+				path = gtk_tree_path_new_from_indices (parent_row, pos, -1);
+				gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+				gtk_tree_path_free (path);
+			} else if (is_visible) {
+				g_memmove (&children->rows[pos + 1], &children->rows[pos],
+					   (children->num_rows - pos) * sizeof (guint));
+				children->rows[pos] = clone;
+				children->num_rows++;
+
+				path = gtk_tree_path_new_from_indices (parent_row, pos, -1);
+				set_iter (model, &iter, clone);
+				gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+				gtk_tree_path_free (path);
+				pos++;
+			}
+		}
+	}
+
+	if ((get_num_children (priv, parent) > 0) != had_children) {
+		path = gtk_tree_path_new_from_indices (parent_row, -1);
+		set_iter (model, &iter, parent);
+		gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model), path, &iter);
+		gtk_tree_path_free (path);
+	}
+
+	/* The view collapses a row when its last child is removed */
+	if (children && (children->num_rows == 0))
+		g_hash_table_remove (priv->expanded, GUINT_TO_POINTER (parent));
+}
+
+/* Text shown in a column */
+static const gchar *
+get_column_text (MameRomEntry *rom, gint column)
+{
+	switch (column) {
+		case GAMENAME:
+			return mame_rom_entry_get_list_name (rom);
+		case HAS_SAMPLES:
+			if (!mame_rom_entry_has_samples (rom))
+				return NULL;
+			return (mame_rom_entry_get_sample_status (rom) == CORRECT) ? _("Yes") : _("No");
+		case ROMNAME:
+			return mame_rom_entry_get_romname (rom);
+		case MANU:
+			return mame_rom_entry_get_manufacturer (rom);
+		case YEAR:
+			return mame_rom_entry_get_year (rom);
+		case CLONE:
+			return mame_rom_entry_get_parent_romname (rom);
+		case DRIVER:
+			return mame_rom_entry_get_driver (rom);
+		case MAMEVER:
+			return mame_rom_entry_get_version_added (rom);
+		case CATEGORY:
+			return mame_rom_entry_get_category (rom);
+		default:
+			return NULL;
+	}
+}
+
+static gint
+get_times_played (MameRomEntry *rom)
+{
+	gint timesplayed;
+
+	g_object_get (rom, "times-played", &timesplayed, NULL);
+
+	return timesplayed;
+}
+
+/* GtkTreeModel implementation */
+static GtkTreeModelFlags
+gamelist_model_get_flags (GtkTreeModel *tree_model)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (tree_model);
+
+	if (model->priv->tree)
+		return GTK_TREE_MODEL_ITERS_PERSIST;
+
+	return GTK_TREE_MODEL_LIST_ONLY | GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint
+gamelist_model_get_n_columns (GtkTreeModel *tree_model)
+{
+	return NUMBER_COLUMN + 4;
+}
+
+static GType
+gamelist_model_get_column_type (GtkTreeModel *tree_model, gint index)
+{
+	switch (index) {
+		case TIMESPLAYED:
+			return G_TYPE_INT;
+		case ROMENTRY:
+			return G_TYPE_POINTER;
+		case TEXTSTYLE:
+			return PANGO_TYPE_STYLE;
+		case FILTERED:
+			return G_TYPE_BOOLEAN;
+		case PIXBUF:
+			return GDK_TYPE_PIXBUF;
+		default:
+			g_return_val_if_fail ((index >= 0) && (index < NUMBER_COLUMN), G_TYPE_INVALID);
+			return G_TYPE_STRING;
+	}
+}
+
+static gboolean
+gamelist_model_get_iter (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (tree_model);
+	gint *indices;
+	gint depth;
+	guint romset;
+
+	depth = gtk_tree_path_get_depth (path);
+	if ((depth < 1) || (depth > 2))
+		return FALSE;
+
+	indices = gtk_tree_path_get_indices (path);
+	if ((indices[0] < 0) || (indices[0] >= (gint) get_num_rows (model->priv)))
+		return FALSE;
+
+	romset = get_romset_at_row (model->priv, indices[0]);
+
+	if (depth == 2) {
+		if (indices[1] < 0)
+			return FALSE;
+
+		romset = get_nth_child (model, romset, indices[1]);
+		if (romset == NO_ROW)
+			return FALSE;
+	}
+
+	set_iter (model, iter, romset);
+
+	return TRUE;
+}
+
+static GtkTreePath *
+gamelist_model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (tree_model);
+	guint romset, row, child_row;
+
+	g_return_val_if_fail (iter->stamp == model->priv->stamp, NULL);
+
+	romset = GPOINTER_TO_UINT (iter->user_data);
+
+	if (is_child (model->priv, romset)) {
+		row = get_row_of_romset (model->priv, model->priv->parent_of[romset]);
+		child_row = get_child_row (model, romset);
+		g_return_val_if_fail ((row != NO_ROW) && (child_row != NO_ROW), NULL);
+
+		return gtk_tree_path_new_from_indices (row, child_row, -1);
+	}
+
+	row = get_row_of_romset (model->priv, romset);
+	g_return_val_if_fail (row != NO_ROW, NULL);
+
+	return gtk_tree_path_new_from_indices (row, -1);
+}
+
+static void
+gamelist_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (tree_model);
+	MameRomEntry *rom;
+	GdkPixbuf *pixbuf;
+	RomStatus status;
+	guint romset;
+
+	g_return_if_fail (iter->stamp == model->priv->stamp);
+
+	g_value_init (value, gamelist_model_get_column_type (tree_model, column));
+
+	romset = GPOINTER_TO_UINT (iter->user_data);
+	rom = get_romset (model, romset);
+
+	switch (column) {
+		case TIMESPLAYED:
+			g_value_set_int (value, get_times_played (rom));
+			break;
+		case ROMENTRY:
+			g_value_set_pointer (value, rom);
+			break;
+		case TEXTSTYLE:
+			/* Clones are shown in italics */
+			g_value_set_enum (value, mame_rom_entry_is_clone (rom) ?
+					  PANGO_STYLE_ITALIC : PANGO_STYLE_NORMAL);
+			break;
+		case FILTERED:
+			g_value_set_boolean (value, gmameui_bitset_get (model->priv->filtered, romset));
+			break;
+		case PIXBUF:
+			/* Romsets without an icon of their own, which are only
+			   loaded once they are scrolled to, show their status */
+			pixbuf = mame_rom_entry_get_icon (rom);
+			if (pixbuf == NULL) {
+				status = mame_rom_entry_get_rom_status (rom);
+				if (model->priv->status_icons[status] == NULL)
+					model->priv->status_icons[status] = gmameui_icon_mgr_get_pixbuf_for_status (status);
+				pixbuf = model->priv->status_icons[status];
+			}
+			g_value_set_object (value, pixbuf);
+			break;
+		default:
+			g_value_set_string (value, get_column_text (rom, column));
+	}
+}
+
+static gboolean
+gamelist_model_iter_next (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (tree_model);
+	guint romset, row;
+
+	g_return_val_if_fail (iter->stamp == model->priv->stamp, FALSE);
+
+	romset = GPOINTER_TO_UINT (iter->user_data);
+
+	if (is_child (model->priv, romset)) {
+		romset = get_next_child (model, romset);
+		if (romset == NO_ROW)
+			return FALSE;
+
+		set_iter (model, iter, romset);
+		return TRUE;
+	}
+
+	row = get_row_of_romset (model->priv, romset);
+	if ((row == NO_ROW) || (row + 1 >= get_num_rows (model->priv)))
+		return FALSE;
+
+	set_iter (model, iter, get_romset_at_row (model->priv, row + 1));
+
+	return TRUE;
+}
+
+static gboolean
+gamelist_model_iter_nth_child (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (tree_model);
+	guint romset;
+
+	if (parent != NULL) {
+		if (n < 0)
+			return FALSE;
+
+		romset = get_nth_child (model, GPOINTER_TO_UINT (parent->user_data), n);
+		if (romset == NO_ROW)
+			return FALSE;
+
+		set_iter (model, iter, romset);
+		return TRUE;
+	}
+
+	if ((n < 0) || (n >= (gint) get_num_rows (model->priv)))
+		return FALSE;
+
+	set_iter (model, iter, get_romset_at_row (model->priv, n));
+
+	return TRUE;
+}
+
+static gboolean
+gamelist_model_iter_children (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+	return gamelist_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+static gboolean
+gamelist_model_iter_has_child (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (tree_model);
+
+	return get_num_children (model->priv, GPOINTER_TO_UINT (iter->user_data)) > 0;
+}
+
+static gint
+gamelist_model_iter_n_children (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (tree_model);
+
+	if (iter != NULL)
+		return get_num_children (model->priv, GPOINTER_TO_UINT (iter->user_data));
+
+	return get_num_rows (model->priv);
+}
+
+static gboolean
+gamelist_model_iter_parent (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (tree_model);
+	guint romset;
+
+	romset = GPOINTER_TO_UINT (child->user_data);
+	if (!is_child (model->priv, romset))
+		return FALSE;
+
+	set_iter (model, iter, model->priv->parent_of[romset]);
+
+	return TRUE;
+}
+
+static void
+mame_gamelist_model_tree_model_init (GtkTreeModelIface *iface)
+{
+	iface->get_flags = gamelist_model_get_flags;
+	iface->get_n_columns = gamelist_model_get_n_columns;
+	iface->get_column_type = gamelist_model_get_column_type;
+	iface->get_iter = gamelist_model_get_iter;
+	iface->get_path = gamelist_model_get_path;
+	iface->get_value = gamelist_model_get_value;
+	iface->iter_next = gamelist_model_iter_next;
+	iface->iter_children = gamelist_model_iter_children;
+	iface->iter_has_child = gamelist_model_iter_has_child;
+	iface->iter_n_children = gamelist_model_iter_n_children;
+	iface->iter_nth_child = gamelist_model_iter_nth_child;
+	iface->iter_parent = gamelist_model_iter_parent;
+}
+
+/* Sorting. The sort keys of the column are read once for each romset,
+   rather than at every comparison */
+typedef struct {
+	gchar **keys;		/* Collation keys for text columns */
+	gint *values;		/* Values for numeric columns */
+} SortData;
+
+static gint
+compare_keys (SortData *data, guint romset_a, guint romset_b)
+{
+	if (data->keys)
+		return strcmp (data->keys[romset_a], data->keys[romset_b]);
+
+	return (data->values[romset_a] > data->values[romset_b]) -
+	       (data->values[romset_a] < data->values[romset_b]);
+}
+
+static gint
+compare_romsets (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	guint romset_a = *(const guint *) a;
+	guint romset_b = *(const guint *) b;
+	gint result;
+
+	result = compare_keys ((SortData *) user_data, romset_a, romset_b);
+
+	/* Keep romsets with the same value in gamelist order */
+	if (result == 0)
+		result = (romset_a > romset_b) - (romset_a < romset_b);
+
+	return result;
+}
+
+static void
+sort_column_free (SortColumn *sort_column)
+{
+	g_free (sort_column->order);
+	g_free (sort_column->ranks);
+	g_free (sort_column);
+}
+
+/* Drops the order of a column whose values have changed */
+static void
+invalidate_sort_column (MameGamelistModel *model, gint column)
+{
+	if (model->priv->sort_columns[column] == NULL)
+		return;
+
+	sort_column_free (model->priv->sort_columns[column]);
+	model->priv->sort_columns[column] = NULL;
+}
+
+static void
+invalidate_sort_columns (MameGamelistModel *model)
+{
+	gint column;
+
+	for (column = 0; column < NUMBER_COLUMN; column++)
+		invalidate_sort_column (model, column);
+}
+
+/* Returns the ascending order of the column, sorting the romsets the first
+   time the column is sorted on */
+static SortColumn *
+get_sort_column (MameGamelistModel *model, gint column)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	SortColumn *sort_column;
+	SortData data;
+	guint n, i, rank;
+
+	if (priv->sort_columns[column])
+		return priv->sort_columns[column];
+
+	n = priv->romsets->len;
+
+	sort_column = g_new (SortColumn, 1);
+	sort_column->order = g_new (guint, n);
+	sort_column->ranks = g_new (guint, n);
+
+	data.keys = NULL;
+	data.values = NULL;
+
+	if (column == TIMESPLAYED) {
+		data.values = g_new (gint, n);
+		for (i = 0; i < n; i++)
+			data.values[i] = get_times_played (get_romset (model, i));
+	} else {
+		data.keys = g_new (gchar *, n);
+		for (i = 0; i < n; i++) {
+			const gchar *text = get_column_text (get_romset (model, i), column);
+
+			data.keys[i] = g_utf8_collate_key (text ? text : "", -1);
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		sort_column->order[i] = i;
+	g_qsort_with_data (sort_column->order, n, sizeof (guint), compare_romsets, &data);
+
+	for (i = 0, rank = 0; i < n; i++) {
+		if ((i > 0) &&
+		    (compare_keys (&data, sort_column->order[i - 1], sort_column->order[i]) != 0))
+			rank++;
+		sort_column->ranks[sort_column->order[i]] = rank;
+	}
+
+	if (data.keys) {
+		for (i = 0; i < n; i++)
+			g_free (data.keys[i]);
+		g_free (data.keys);
+	}
+	g_free (data.values);
+
+	priv->sort_columns[column] = sort_column;
+
+	return sort_column;
+}
+
+/* Puts every romset in order for the sort column. Unsorted romsets are
+   left in gamelist order. The column's ascending order is copied, or read
+   backwards for a descending sort */
+static void
+sort_romsets (MameGamelistModel *model)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	SortColumn *sort_column;
+	guint n, i;
+
+	n = priv->romsets->len;
+
+	if ((priv->sort_column < 0) || (n == 0)) {
+		for (i = 0; i < n; i++)
+			priv->order[i] = i;
+	} else if (priv->sort_order == GTK_SORT_ASCENDING) {
+		sort_column = get_sort_column (model, priv->sort_column);
+		memcpy (priv->order, sort_column->order, n * sizeof (guint));
+	} else {
+		guint start, end, pos = 0;
+
+		sort_column = get_sort_column (model, priv->sort_column);
+
+		/* Reverse the runs of equal values, but keep the romsets in
+		   each run in gamelist order */
+		for (end = n; end > 0; end = start) {
+			guint rank = sort_column->ranks[sort_column->order[end - 1]];
+
+			for (start = end - 1;
+			     (start > 0) && (sort_column->ranks[sort_column->order[start - 1]] == rank);
+			     start--)
+				;
+
+			memcpy (&priv->order[pos], &sort_column->order[start],
+				(end - start) * sizeof (guint));
+			pos += end - start;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		priv->order_pos[priv->order[i]] = i;
+
+	sort_families (model);
+}
+
+/* Re-sorts the romsets and tells the view where each row moved to */
+/* Puts the clones under an expanded parent back in sort order */
+static void
+resort_children (gpointer key, ChildRows *children, MameGamelistModel *model)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	gint *new_order;
+	guint *rows;
+	guint parent, row, i;
+
+	parent = GPOINTER_TO_UINT (key);
+	new_order = g_new (gint, children->num_rows);
+	rows = g_new (guint, children->num_rows);
+
+	/* A family only has a handful of clones, so each is just looked for */
+	for (i = priv->family_start[parent], row = 0; i < priv->family_start[parent + 1]; i++) {
+		guint clone = priv->family[i];
+		guint old_row;
+
+		for (old_row = 0; old_row < children->num_rows; old_row++) {
+			if (children->rows[old_row] == clone)
+				break;
+		}
+		if (old_row == children->num_rows)
+			continue;
+
+		new_order[row] = old_row;
+		rows[row] = clone;
+		row++;
+	}
+
+	g_free (children->rows);
+	children->rows = rows;
+
+	path = gtk_tree_path_new_from_indices (get_row_of_romset (priv, parent), -1);
+	set_iter (model, &iter, parent);
+	gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model), path, &iter, new_order);
+	gtk_tree_path_free (path);
+
+	g_free (new_order);
+}
+
+static void
+resort (MameGamelistModel *model)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	GtkTreePath *path;
+	gint *new_order;
+	guint *swap;
+	guint i, row;
+
+	sort_romsets (model);
+
+	if (priv->num_rows == 0)
+		return;
+
+	new_order = g_new (gint, priv->num_rows);
+
+	for (i = 0, row = 0; i < priv->romsets->len; i++) {
+		guint romset = priv->order[i];
+
+		if (priv->row_of[romset] == NO_ROW)
+			continue;
+
+		new_order[row] = priv->row_of[romset];
+		priv->next[row] = romset;
+		priv->row_of[romset] = row;
+		row++;
+	}
+
+	swap = priv->rows;
+	priv->rows = priv->next;
+	priv->next = swap;
+
+	path = gtk_tree_path_new ();
+	gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model), path, NULL, new_order);
+	gtk_tree_path_free (path);
+
+	g_free (new_order);
+
+	if (priv->tree)
+		g_hash_table_foreach (priv->expanded, (GHFunc) resort_children, model);
+}
+
+/* GtkTreeSortable implementation */
+static gboolean
+gamelist_model_get_sort_column_id (GtkTreeSortable *sortable, gint *sort_column_id, GtkSortType *order)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (sortable);
+
+	if (sort_column_id)
+		*sort_column_id = model->priv->sort_column;
+	if (order)
+		*order = model->priv->sort_order;
+
+	return (model->priv->sort_column != GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID) &&
+	       (model->priv->sort_column != GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID);
+}
+
+static void
+gamelist_model_set_sort_column_id (GtkTreeSortable *sortable, gint sort_column_id, GtkSortType order)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (sortable);
+
+	/* Only the visible columns can be sorted on */
+	g_return_if_fail (sort_column_id < NUMBER_COLUMN);
+
+	if ((model->priv->sort_column == sort_column_id) && (model->priv->sort_order == order))
+		return;
+
+	model->priv->sort_column = sort_column_id;
+	model->priv->sort_order = order;
+
+	resort (model);
+
+	gtk_tree_sortable_sort_column_changed (sortable);
+}
+
+static gboolean
+gamelist_model_has_default_sort_func (GtkTreeSortable *sortable)
+{
+	return FALSE;
+}
+
+static void
+mame_gamelist_model_tree_sortable_init (GtkTreeSortableIface *iface)
+{
+	iface->get_sort_column_id = gamelist_model_get_sort_column_id;
+	iface->set_sort_column_id = gamelist_model_set_sort_column_id;
+	iface->has_default_sort_func = gamelist_model_has_default_sort_func;
+}
+
+/* Works through the romsets in sort order, telling the view about each
+   row that is removed or added. The romsets still shown keep their
+   relative order, so nothing else moves. In the tree, the clones under
+   each parent left at the top level are then updated the same way */
+static void
+update_rows (MameGamelistModel *model)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	GmameuiBitset *kept = NULL;
+	guint *had_clones = NULL;
+	guint *swap;
+	guint i;
+
+	if (priv->tree) {
+		kept = gmameui_bitset_new (priv->romsets->len);
+		had_clones = g_memdup (priv->visible_clones, priv->romsets->len * sizeof (guint));
+		count_visible_clones (model);
+	}
+
+	priv->refiltering = TRUE;
+	priv->split = 0;
+	priv->old_pos = 0;
+	priv->order_done = 0;
+
+	for (i = 0; i < priv->romsets->len; i++) {
+		guint romset = priv->order[i];
+		gboolean was_visible, is_visible;
+		GtkTreePath *path;
+		GtkTreeIter iter;
+
+		was_visible = (priv->row_of[romset] != NO_ROW);
+		is_visible = romset_is_shown (model, romset);
+
+		if (was_visible)
+			priv->old_pos++;
+
+		if (is_visible) {
+			priv->next[priv->split] = romset;
+			priv->row_of[romset] = priv->split++;
+		} else {
+			priv->row_of[romset] = NO_ROW;
+		}
+
+		priv->order_done = i + 1;
+
+		if (was_visible && !is_visible) {
+			path = gtk_tree_path_new_from_indices (priv->split, -1);
+			gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+			gtk_tree_path_free (path);
+
+			if (priv->tree)
+				g_hash_table_remove (priv->expanded, GUINT_TO_POINTER (romset));
+		} else if (!was_visible && is_visible) {
+			path = gtk_tree_path_new_from_indices (priv->split - 1, -1);
+			set_iter (model, &iter, romset);
+			gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+			gtk_tree_path_free (path);
+		} else if (was_visible && kept) {
+			gmameui_bitset_set (kept, romset, TRUE);
+		}
+	}
+
+	swap = priv->rows;
+	priv->rows = priv->next;
+	priv->next = swap;
+	priv->num_rows = priv->split;
+
+	priv->refiltering = FALSE;
+
+	if (!priv->tree)
+		return;
+
+	/* A row just added has no children yet as far as the view knows */
+	for (i = 0; i < priv->num_rows; i++) {
+		guint romset = priv->rows[i];
+		ChildRows *children;
+		gboolean had_children = FALSE;
+
+		if (gmameui_bitset_get (kept, romset)) {
+			children = get_child_rows (priv, romset);
+			had_children = children ? (children->num_rows > 0) : (had_clones[romset] > 0);
+		}
+
+		update_children (model, romset, had_children);
+	}
+
+	gmameui_bitset_free (kept);
+	g_free (had_clones);
+}
+
+/* Replaces the romsets with those in the gamelist. Views should be
+   detached first, since every row is removed and added again */
+void
+mame_gamelist_model_set_gamelist (MameGamelistModel *model, MameGamelist *gl)
+{
+	MameGamelistModelPrivate *priv;
+	GList *ptr;
+	guint n, i;
+
+	g_return_if_fail (MAME_IS_GAMELIST_MODEL (model));
+
+	priv = model->priv;
+
+	/* Removed from the end, so the paths of the other rows don't change */
+	while (priv->num_rows > 0) {
+		GtkTreePath *path;
+
+		priv->num_rows--;
+		priv->row_of[priv->rows[priv->num_rows]] = NO_ROW;
+
+		path = gtk_tree_path_new_from_indices (priv->num_rows, -1);
+		gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+		gtk_tree_path_free (path);
+	}
+	g_hash_table_remove_all (priv->expanded);
+
+	g_ptr_array_set_size (priv->romsets, 0);
+	if (gl) {
+		for (ptr = mame_gamelist_get_roms_glist (gl); ptr; ptr = g_list_next (ptr))
+			g_ptr_array_add (priv->romsets, ptr->data);
+	}
+
+	n = priv->romsets->len;
+
+	gmameui_bitset_free (priv->filtered);
+	gmameui_bitset_free (priv->searched);
+	invalidate_sort_columns (model);
+	g_free (priv->order);
+	g_free (priv->order_pos);
+	g_free (priv->rows);
+	g_free (priv->row_of);
+	g_free (priv->next);
+
+	priv->filtered = gmameui_bitset_new (n);
+	priv->searched = gmameui_bitset_new (n);
+	priv->order = g_new (guint, n);
+	priv->order_pos = g_new (guint, n);
+	priv->rows = g_new (guint, n);
+	priv->row_of = g_new (guint, n);
+	priv->next = g_new (guint, n);
+
+	priv->stamp++;
+
+	for (i = 0; i < n; i++) {
+		GtkTreeIter position;
+
+		set_iter (model, &position, i);
+		mame_rom_entry_set_position (get_romset (model, i), position);
+
+		priv->row_of[i] = NO_ROW;
+	}
+
+	build_families (model, gl);
+
+	gmameui_filter_index_build (priv->index, priv->romsets);
+	gmameui_filter_index_get_members (priv->index, priv->expr,
+					  priv->rom_filter_opt, priv->filtered);
+
+	gmameui_search_index_build (priv->search_index, priv->romsets);
+	update_searched (model);
+
+	sort_romsets (model);
+	update_rows (model);
+}
+
+/* Shows the romsets passing the filter expression and the ROM filter
+   setting. The romsets passing each filter are kept up to date as romsets
+   change, so this combines the filters' bitsets rather than testing every
+   romset */
+void
+mame_gamelist_model_set_filter_expr (MameGamelistModel *model,
+				     GmameuiFilterExpr *expr,
+				     gint rom_filter_opt)
+{
+	MameGamelistModelPrivate *priv;
+
+	g_return_if_fail (MAME_IS_GAMELIST_MODEL (model));
+
+	priv = model->priv;
+
+	if (expr)
+		gmameui_filter_expr_ref (expr);
+	if (priv->expr)
+		gmameui_filter_expr_unref (priv->expr);
+	priv->expr = expr;
+	priv->rom_filter_opt = rom_filter_opt;
+
+	gmameui_filter_index_get_members (priv->index, priv->expr,
+					  priv->rom_filter_opt, priv->filtered);
+
+	update_rows (model);
+}
+
+/* Shows the romsets passing a single filter */
+void
+mame_gamelist_model_set_filter (MameGamelistModel *model,
+				GMAMEUIFilter *filter,
+				gint rom_filter_opt)
+{
+	GmameuiFilterExpr *expr;
+
+	g_return_if_fail (MAME_IS_GAMELIST_MODEL (model));
+
+	expr = filter ? gmameui_filter_expr_new_filter (filter) : NULL;
+	mame_gamelist_model_set_filter_expr (model, expr, rom_filter_opt);
+	if (expr)
+		gmameui_filter_expr_unref (expr);
+}
+
+/* Shows the romsets matching every term of the search query. Text terms
+   are found with the search index, and fields with the filter index, so no
+   romset is tested on its own and this is quick enough to call on each
+   keystroke. The filter is not applied again */
+void
+mame_gamelist_model_set_search_query (MameGamelistModel *model, MameSearchQuery *query)
+{
+	MameGamelistModelPrivate *priv;
+
+	g_return_if_fail (MAME_IS_GAMELIST_MODEL (model));
+
+	priv = model->priv;
+
+	if (query)
+		mame_search_query_ref (query);
+	if (priv->query)
+		mame_search_query_unref (priv->query);
+	priv->query = query;
+
+	update_searched (model);
+	update_rows (model);
+}
+
+/* Removes a romset's row from the top level */
+static void
+remove_top_row (MameGamelistModel *model, guint romset)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	GtkTreePath *path;
+	guint row, i;
+
+	row = priv->row_of[romset];
+
+	priv->num_rows--;
+	g_memmove (&priv->rows[row], &priv->rows[row + 1],
+		   (priv->num_rows - row) * sizeof (guint));
+	for (i = row; i < priv->num_rows; i++)
+		priv->row_of[priv->rows[i]] = i;
+	priv->row_of[romset] = NO_ROW;
+
+	path = gtk_tree_path_new_from_indices (row, -1);
+	gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+	gtk_tree_path_free (path);
+
+	if (priv->tree)
+		g_hash_table_remove (priv->expanded, GUINT_TO_POINTER (romset));
+}
+
+/* Adds a row for the romset at the top level, in sort order */
+static void
+insert_top_row (MameGamelistModel *model, guint romset)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	guint low = 0, high = priv->num_rows;
+	guint row, i;
+
+	/* Find the first row after the romset in sort order */
+	while (low < high) {
+		guint mid = (low + high) / 2;
+
+		if (priv->order_pos[priv->rows[mid]] < priv->order_pos[romset])
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	row = low;
+
+	g_memmove (&priv->rows[row + 1], &priv->rows[row],
+		   (priv->num_rows - row) * sizeof (guint));
+	priv->rows[row] = romset;
+	priv->num_rows++;
+	for (i = row; i < priv->num_rows; i++)
+		priv->row_of[priv->rows[i]] = i;
+
+	path = gtk_tree_path_new_from_indices (row, -1);
+	set_iter (model, &iter, romset);
+	gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+	gtk_tree_path_free (path);
+}
+
+/* Shows or hides a romset at the top level, or redraws its row. Returns
+   whether it was shown before */
+static gboolean
+update_top_row (MameGamelistModel *model, guint romset)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	guint row;
+	gboolean was_shown, is_visible;
+
+	is_visible = romset_is_shown (model, romset);
+	row = priv->row_of[romset];
+	was_shown = (row != NO_ROW);
+
+	if ((row != NO_ROW) && is_visible) {
+		path = gtk_tree_path_new_from_indices (row, -1);
+		set_iter (model, &iter, romset);
+		gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+		gtk_tree_path_free (path);
+	} else if (row != NO_ROW) {
+		remove_top_row (model, romset);
+	} else if (is_visible) {
+		insert_top_row (model, romset);
+	}
+
+	return was_shown;
+}
+
+/* Compares two romsets as sort_romsets orders them - by the value in the
+   sort column, with equal values in gamelist order */
+static gint
+compare_in_sort_order (MameGamelistModel *model, guint romset_a, guint romset_b)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	gint result;
+
+	if (priv->sort_column == TIMESPLAYED) {
+		gint a = get_times_played (get_romset (model, romset_a));
+		gint b = get_times_played (get_romset (model, romset_b));
+
+		result = (a > b) - (a < b);
+	} else {
+		const gchar *text_a = get_column_text (get_romset (model, romset_a), priv->sort_column);
+		const gchar *text_b = get_column_text (get_romset (model, romset_b), priv->sort_column);
+
+		result = g_utf8_collate (text_a ? text_a : "", text_b ? text_b : "");
+	}
+
+	if (priv->sort_order == GTK_SORT_DESCENDING)
+		result = -result;
+
+	if (result == 0)
+		result = (romset_a > romset_b) - (romset_a < romset_b);
+
+	return result;
+}
+
+/* Moves a romset whose value in the sort column has changed to its new
+   place in the sort order. If it has a row, the row is removed and added
+   again at its new place, rather than the whole model being re-sorted */
+static void
+resort_romset (MameGamelistModel *model, guint romset)
+{
+	MameGamelistModelPrivate *priv = model->priv;
+	ChildRows *children;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	guint old_pos, new_pos, low, high;
+	guint parent, start, end, n, i;
+
+	n = priv->romsets->len;
+	old_pos = priv->order_pos[romset];
+
+	/* The other romsets are still in order, so the new place is found
+	   by a binary search once the romset is taken out */
+	g_memmove (&priv->order[old_pos], &priv->order[old_pos + 1],
+		   (n - old_pos - 1) * sizeof (guint));
+
+	low = 0;
+	high = n - 1;
+	while (low < high) {
+		guint mid = (low + high) / 2;
+
+		if (compare_in_sort_order (model, priv->order[mid], romset) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	new_pos = low;
+
+	g_memmove (&priv->order[new_pos + 1], &priv->order[new_pos],
+		   (n - 1 - new_pos) * sizeof (guint));
+	priv->order[new_pos] = romset;
+
+	for (i = MIN (old_pos, new_pos); i <= MAX (old_pos, new_pos); i++)
+		priv->order_pos[priv->order[i]] = i;
+
+	if (new_pos == old_pos)
+		return;
+
+	parent = priv->tree ? priv->parent_of[romset] : NO_ROW;
+
+	if (parent == NO_ROW) {
+		if (priv->row_of[romset] == NO_ROW)
+			return;
+
+		remove_top_row (model, romset);
+		insert_top_row (model, romset);
+
+		/* The row was added again without its children */
+		if (get_num_children (priv, romset) > 0) {
+			path = gtk_tree_path_new_from_indices (priv->row_of[romset], -1);
+			set_iter (model, &iter, romset);
+			gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model), path, &iter);
+			gtk_tree_path_free (path);
+		}
+		return;
+	}
+
+	/* Keep the parent's clones in sort order */
+	start = priv->family_start[parent];
+	end = priv->family_start[parent + 1];
+
+	for (i = start; priv->family[i] != romset; i++)
+		;
+	g_memmove (&priv->family[i], &priv->family[i + 1], (end - i - 1) * sizeof (guint));
+	for (i = start; (i < end - 1) && (priv->order_pos[priv->family[i]] < new_pos); i++)
+		;
+	g_memmove (&priv->family[i + 1], &priv->family[i], (end - 1 - i) * sizeof (guint));
+	priv->family[i] = romset;
+
+	/* And the clones shown under it, if it is expanded */
+	children = get_child_rows (priv, parent);
+	if (children == NULL)
+		return;
+
+	for (i = 0; (i < children->num_rows) && (children->rows[i] != romset); i++)
+		;
+	if (i == children->num_rows)
+		return;
+
+	children->num_rows--;
+	g_memmove (&children->rows[i], &children->rows[i + 1],
+		   (children->num_rows - i) * sizeof (guint));
+
+	path = gtk_tree_path_new_from_indices (priv->row_of[parent], i, -1);
+	gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+	gtk_tree_path_free (path);
+
+	for (i = 0; (i < children->num_rows) && (priv->order_pos[children->rows[i]] < new_pos); i++)
+		;
+	g_memmove (&children->rows[i + 1], &children->rows[i],
+		   (children->num_rows - i) * sizeof (guint));
+	children->rows[i] = romset;
+	children->num_rows++;
+
+	path = gtk_tree_path_new_from_indices (priv->row_of[parent], i, -1);
+	set_iter (model, &iter, romset);
+	gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+	gtk_tree_path_free (path);
+}
+
+/* Moves a romset whose details have changed into the filters it now
+   passes, and shows or hides it, or redraws its row */
+void
+mame_gamelist_model_update_romset (MameGamelistModel *model, MameRomEntry *rom)
+{
+	MameGamelistModelPrivate *priv;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	guint romset, parent;
+	gboolean was_visible, is_visible;
+	gboolean had_children;
+
+	g_return_if_fail (MAME_IS_GAMELIST_MODEL (model));
+	g_return_if_fail (rom != NULL);
+
+	priv = model->priv;
+
+	romset = get_romset_index (model, rom);
+	if (romset == NO_ROW)
+		return;
+
+	was_visible = romset_is_visible (model, romset);
+
+	gmameui_filter_index_update_romset (priv->index, romset, rom);
+	gmameui_bitset_set (priv->filtered, romset,
+			    gmameui_filter_index_is_member (priv->index, priv->expr,
+							    priv->rom_filter_opt, romset));
+	gmameui_bitset_set (priv->searched, romset, romset_matches_search (model, romset));
+
+	/* Playing or auditing a romset changes these columns; the others
+	   come from the gamelist. If the rows are sorted on one of them, the
+	   romset is moved to its new place */
+	invalidate_sort_column (model, TIMESPLAYED);
+	invalidate_sort_column (model, HAS_SAMPLES);
+	if ((priv->sort_column == TIMESPLAYED) || (priv->sort_column == HAS_SAMPLES))
+		resort_romset (model, romset);
+
+	if (!is_child (priv, romset)) {
+		update_top_row (model, romset);
+		return;
+	}
+
+	/* A clone in the tree can also show or hide its parent */
+	is_visible = romset_is_visible (model, romset);
+	parent = priv->parent_of[romset];
+	had_children = get_num_children (priv, parent) > 0;
+
+	if (is_visible && !was_visible)
+		priv->visible_clones[parent]++;
+	else if (was_visible && !is_visible)
+		priv->visible_clones[parent]--;
+
+	if (!update_top_row (model, parent))
+		had_children = FALSE;
+
+	if (priv->row_of[parent] == NO_ROW)
+		return;
+
+	update_children (model, parent, had_children);
+
+	if (was_visible && is_visible) {
+		path = gtk_tree_path_new_from_indices (priv->row_of[parent],
+						       get_child_row (model, romset), -1);
+		set_iter (model, &iter, romset);
+		gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+		gtk_tree_path_free (path);
+	}
+}
+
+/* Returns FALSE if the romset is not shown */
+gboolean
+mame_gamelist_model_get_iter_for_romset (MameGamelistModel *model,
+					 MameRomEntry *rom,
+					 GtkTreeIter *iter)
+{
+	guint romset;
+
+	g_return_val_if_fail (MAME_IS_GAMELIST_MODEL (model), FALSE);
+	g_return_val_if_fail (rom != NULL, FALSE);
+	g_return_val_if_fail (iter != NULL, FALSE);
+
+	romset = get_romset_index (model, rom);
+	if (romset == NO_ROW)
+		return FALSE;
+
+	if (is_child (model->priv, romset)) {
+		if (!romset_is_visible (model, romset))
+			return FALSE;
+	} else if (model->priv->row_of[romset] == NO_ROW) {
+		return FALSE;
+	}
+
+	set_iter (model, iter, romset);
+
+	return TRUE;
+}
+
+/* Returns the number of romsets shown, including the clones in the tree */
+guint
+mame_gamelist_model_get_num_visible (MameGamelistModel *model)
+{
+	GmameuiBitset *visible;
+	guint num_visible;
+
+	g_return_val_if_fail (MAME_IS_GAMELIST_MODEL (model), 0);
+
+	if (!model->priv->tree)
+		return model->priv->num_rows;
+
+	visible = gmameui_bitset_dup (model->priv->filtered);
+	gmameui_bitset_and (visible, model->priv->searched);
+	num_visible = gmameui_bitset_count (visible);
+	gmameui_bitset_free (visible);
+
+	return num_visible;
+}
+
+gboolean
+mame_gamelist_model_get_tree_mode (MameGamelistModel *model)
+{
+	g_return_val_if_fail (MAME_IS_GAMELIST_MODEL (model), FALSE);
+
+	return model->priv->tree;
+}
+
+/* Shows the clones under their parents rather than as rows of their own.
+   Views should be detached first, since every row is removed and added
+   again */
+void
+mame_gamelist_model_set_tree_mode (MameGamelistModel *model, gboolean tree)
+{
+	MameGamelistModelPrivate *priv;
+
+	g_return_if_fail (MAME_IS_GAMELIST_MODEL (model));
+
+	priv = model->priv;
+
+	if (priv->tree == tree)
+		return;
+
+	while (priv->num_rows > 0) {
+		GtkTreePath *path;
+
+		priv->num_rows--;
+		priv->row_of[priv->rows[priv->num_rows]] = NO_ROW;
+
+		path = gtk_tree_path_new_from_indices (priv->num_rows, -1);
+		gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+		gtk_tree_path_free (path);
+	}
+	g_hash_table_remove_all (priv->expanded);
+
+	priv->tree = tree;
+	priv->stamp++;
+
+	if (priv->tree && priv->visible_clones)
+		memset (priv->visible_clones, 0, priv->romsets->len * sizeof (guint));
+
+	update_rows (model);
+}
+
+/* Makes the rows of the clones shown under a parent the view has expanded */
+void
+mame_gamelist_model_row_expanded (MameGamelistModel *model, GtkTreeIter *iter)
+{
+	MameGamelistModelPrivate *priv;
+	ChildRows *children;
+	guint parent, i;
+
+	g_return_if_fail (MAME_IS_GAMELIST_MODEL (model));
+	g_return_if_fail (iter != NULL);
+
+	priv = model->priv;
+	g_return_if_fail (iter->stamp == priv->stamp);
+
+	parent = GPOINTER_TO_UINT (iter->user_data);
+	if (!priv->tree || get_child_rows (priv, parent))
+		return;
+
+	children = g_new0 (ChildRows, 1);
+	children->rows = g_new (guint, priv->family_start[parent + 1] - priv->family_start[parent]);
+
+	for (i = priv->family_start[parent]; i < priv->family_start[parent + 1]; i++) {
+		if (romset_is_visible (model, priv->family[i]))
+			children->rows[children->num_rows++] = priv->family[i];
+	}
+
+	g_hash_table_insert (priv->expanded, GUINT_TO_POINTER (parent), children);
+}
+
+/* Frees the rows of the clones under a parent the view has collapsed */
+void
+mame_gamelist_model_row_collapsed (MameGamelistModel *model, GtkTreeIter *iter)
+{
+	g_return_if_fail (MAME_IS_GAMELIST_MODEL (model));
+	g_return_if_fail (iter != NULL);
+	g_return_if_fail (iter->stamp == model->priv->stamp);
+
+	g_hash_table_remove (model->priv->expanded, iter->user_data);
+}
+
+static void
+mame_gamelist_model_finalize (GObject *object)
+{
+	MameGamelistModel *model = MAME_GAMELIST_MODEL (object);
+	gint i;
+
+	g_ptr_array_free (model->priv->romsets, TRUE);
+	gmameui_filter_index_free (model->priv->index);
+	gmameui_bitset_free (model->priv->filtered);
+	gmameui_search_index_free (model->priv->search_index);
+	gmameui_bitset_free (model->priv->searched);
+	if (model->priv->expr)
+		gmameui_filter_expr_unref (model->priv->expr);
+	invalidate_sort_columns (model);
+	g_free (model->priv->order);
+	g_free (model->priv->order_pos);
+	g_free (model->priv->rows);
+	g_free (model->priv->row_of);
+	g_free (model->priv->next);
+	g_free (model->priv->parent_of);
+	g_free (model->priv->family_start);
+	g_free (model->priv->family);
+	g_free (model->priv->visible_clones);
+	g_hash_table_destroy (model->priv->expanded);
+	if (model->priv->query)
+		mame_search_query_unref (model->priv->query);
+
+	for (i = 0; i < NUMBER_STATUS; i++) {
+		if (model->priv->status_icons[i])
+			g_object_unref (model->priv->status_icons[i]);
+	}
+
+	G_OBJECT_CLASS (mame_gamelist_model_parent_class)->finalize (object);
+}
+
+static void
+mame_gamelist_model_class_init (MameGamelistModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (MameGamelistModelPrivate));
+
+	object_class->finalize = mame_gamelist_model_finalize;
+}
+
+static void
+mame_gamelist_model_init (MameGamelistModel *model)
+{
+	model->priv = G_TYPE_INSTANCE_GET_PRIVATE (model,
+						   MAME_TYPE_GAMELIST_MODEL,
+						   MameGamelistModelPrivate);
+
+	model->priv->romsets = g_ptr_array_new ();
+	model->priv->index = gmameui_filter_index_new ();
+	model->priv->filtered = gmameui_bitset_new (0);
+	model->priv->search_index = gmameui_search_index_new ();
+	model->priv->searched = gmameui_bitset_new (0);
+	model->priv->family_start = g_new0 (guint, 1);
+	model->priv->expanded = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+						       (GDestroyNotify) child_rows_free);
+	model->priv->sort_column = GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID;
+	model->priv->sort_order = GTK_SORT_ASCENDING;
+	model->priv->stamp = g_random_int ();
+}
+
+MameGamelistModel *
+mame_gamelist_model_new (void)
+{
+	return g_object_new (MAME_TYPE_GAMELIST_MODEL, NULL);
+}
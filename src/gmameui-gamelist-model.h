@@ -0,0 +1,85 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_GAMELIST_MODEL_H__
+#define __GMAMEUI_GAMELIST_MODEL_H__
+
+#include <gtk/gtk.h>
+
+#include "game_list.h"
+#include "rom_entry.h"
+#include "gmameui-filter-expr.h"
+#include "gmameui-search-entry.h"
+
+G_BEGIN_DECLS
+
+#define MAME_TYPE_GAMELIST_MODEL        (mame_gamelist_model_get_type ())
+#define MAME_GAMELIST_MODEL(o)          (G_TYPE_CHECK_INSTANCE_CAST ((o), MAME_TYPE_GAMELIST_MODEL, MameGamelistModel))
+#define MAME_GAMELIST_MODEL_CLASS(k)    (G_TYPE_CHECK_CLASS_CAST((k), MAME_TYPE_GAMELIST_MODEL, MameGamelistModelClass))
+#define MAME_IS_GAMELIST_MODEL(o)       (G_TYPE_CHECK_INSTANCE_TYPE ((o), MAME_TYPE_GAMELIST_MODEL))
+#define MAME_IS_GAMELIST_MODEL_CLASS(k) (G_TYPE_CHECK_CLASS_TYPE ((k), MAME_TYPE_GAMELIST_MODEL))
+#define MAME_GAMELIST_MODEL_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), MAME_TYPE_GAMELIST_MODEL, MameGamelistModelClass))
+
+typedef struct _MameGamelistModel        MameGamelistModel;
+typedef struct _MameGamelistModelClass   MameGamelistModelClass;
+typedef struct _MameGamelistModelPrivate MameGamelistModelPrivate;
+
+/* List model reading the romsets straight from the MameGamelist, with the
+   columns of the gamelist view. Rather than copying the romsets into a
+   store, it keeps an array of the romsets in sort order and an array of
+   those shown by the filter and search query. In tree mode, the clones
+   are shown under their parents, and their rows are only made when the
+   parent is expanded */
+struct _MameGamelistModel {
+	GObject parent;
+
+	MameGamelistModelPrivate *priv;
+};
+
+struct _MameGamelistModelClass {
+	GObjectClass parent_class;
+};
+
+GType mame_gamelist_model_get_type (void);
+MameGamelistModel *mame_gamelist_model_new (void);
+
+void mame_gamelist_model_set_gamelist (MameGamelistModel *model, MameGamelist *gl);
+void mame_gamelist_model_set_filter (MameGamelistModel *model,
+                                     GMAMEUIFilter *filter,
+                                     gint rom_filter_opt);
+void mame_gamelist_model_set_filter_expr (MameGamelistModel *model,
+                                          GmameuiFilterExpr *expr,
+                                          gint rom_filter_opt);
+void mame_gamelist_model_set_search_query (MameGamelistModel *model, MameSearchQuery *query);
+void mame_gamelist_model_update_romset (MameGamelistModel *model, MameRomEntry *rom);
+
+gboolean mame_gamelist_model_get_tree_mode (MameGamelistModel *model);
+void mame_gamelist_model_set_tree_mode (MameGamelistModel *model, gboolean tree);
+void mame_gamelist_model_row_expanded (MameGamelistModel *model, GtkTreeIter *iter);
+void mame_gamelist_model_row_collapsed (MameGamelistModel *model, GtkTreeIter *iter);
+
+gboolean mame_gamelist_model_get_iter_for_romset (MameGamelistModel *model,
+                                                  MameRomEntry *rom,
+                                                  GtkTreeIter *iter);
+guint mame_gamelist_model_get_num_visible (MameGamelistModel *model);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_GAMELIST_MODEL_H__ */
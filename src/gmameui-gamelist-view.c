@@ -27,6 +27,7 @@
 #include <string.h> /* For strcasestr */
 
 #include "gmameui-gamelist-view.h"
+#include "gmameui-gamelist-model.h"
 #include "game_list.h"
 #include "rom_entry.h"
 #include "gui.h"	/* For main_gui struct */
@@ -37,12 +38,11 @@
 static const int ROM_ICON_SIZE = 24;
 
 struct _MameGamelistViewPrivate {
-	GtkTreeModel *liststore;	/* The representation of the model in List mode */
+	MameGamelistModel *model;	/* Reads the romsets from the gamelist, and
+					   filters and sorts them */
 
-	GtkTreeModel *curr_model;       /* A pointer to either the base liststore or treestore */
-
-	GtkTreeModel *sort_model;       /* Implementation of GtkTreeModelSort */
-	GtkTreeModel *filter_model;     /* Implementation of GtkTreeModelFilter */
+	GmameuiFilterExpr *filter_expr;	/* Compound filter used instead of the
+					   filter selected in the filter list */
 
 	guint timeout_icon;
 };
@@ -63,17 +63,25 @@ column_title (int column_num);
 static void
 on_row_selected (GtkTreeSelection *selection,
 		 gpointer          data);
+static void
+on_row_expanded (GtkTreeView *treeview,
+		 GtkTreeIter *iter,
+		 GtkTreePath *path,
+		 gpointer     user_data);
+static void
+on_row_collapsed (GtkTreeView *treeview,
+		  GtkTreeIter *iter,
+		  GtkTreePath *path,
+		  gpointer     user_data);
 
 static void
 set_list_sortable_column     (MameGamelistView *gamelist_view);
 static void
+set_status_bar_game_count    (MameGamelistView *gamelist_view);
+static void
 create_tree_model            (MameGamelistView *gamelist_view);
 static void
 populate_model_from_gamelist (MameGamelistView *gamelist_view, MameGamelist *gl);
-static gboolean
-filter_func                  (GtkTreeModel *model,
-			      GtkTreeIter  *iter,
-			      GtkEntry     *entry );
 
 /* Callbacks */
 static gboolean
@@ -96,23 +104,6 @@ foreach_find_random_rom_in_store      (GtkTreeModel *model,
 				       GtkTreePath  *path,
 				       GtkTreeIter  *iter,
 				       gpointer      user_data);
-static gboolean
-foreach_find_rom_in_store             (GtkTreeModel *model,
-				       GtkTreePath  *path,
-				       GtkTreeIter  *iter,
-				       gpointer      user_data);
-
-static gboolean
-foreach_update_prefix_in_store (GtkTreeModel *model,
-				GtkTreePath  *path,
-				GtkTreeIter  *iter,
-				gpointer      user_data);
-
-static gboolean
-foreach_update_filter (GtkTreeModel *model,
-		       GtkTreePath  *path,
-		       GtkTreeIter  *iter,
-		       gpointer      user_data);
 
 /* Callbacks handling when the preferences change */
 static void
@@ -191,21 +182,7 @@ mame_gamelist_view_init (MameGamelistView *gamelist_view)
 	gamelist_view->priv = priv;
 	
 	/* Initialise private variables */
-	priv->liststore = (GtkTreeModel *) gtk_list_store_new (NUMBER_COLUMN + 4,
-							       G_TYPE_STRING,     /* Name */
-							       G_TYPE_STRING,     /* Has samples */
-							       G_TYPE_STRING,     /* ROM name */
-							       G_TYPE_INT,	  /* Times played */
-							       G_TYPE_STRING,     /* Manu */
-							       G_TYPE_STRING,     /* Year */
-							       G_TYPE_STRING,     /* Clone of */
-							       G_TYPE_STRING,     /* Driver */
-							       G_TYPE_STRING,     /* Ver added */
-							       G_TYPE_STRING,     /* Category */
-							       G_TYPE_POINTER,    /* Rom Entry */
-							       PANGO_TYPE_STYLE,
-							       G_TYPE_BOOLEAN,
-							       GDK_TYPE_PIXBUF);  /* Pixbuf */
+	priv->model = mame_gamelist_model_new ();
 	
 	/* Build the UI and connect signals here */
 
@@ -329,6 +306,12 @@ mame_gamelist_view_init (MameGamelistView *gamelist_view)
 	g_signal_connect (G_OBJECT (select), "changed",
 			  G_CALLBACK (on_row_selected), NULL);
 
+	/* Callback - The clones under a parent are shown or hidden */
+	g_signal_connect (G_OBJECT (gamelist_view), "row-expanded",
+			  G_CALLBACK (on_row_expanded), NULL);
+	g_signal_connect (G_OBJECT (gamelist_view), "row-collapsed",
+			  G_CALLBACK (on_row_collapsed), NULL);
+
 	/* Callback - Click on the list */
 	g_signal_connect (G_OBJECT (gamelist_view), "button-press-event",
 			  G_CALLBACK (on_list_clicked), NULL);
@@ -380,10 +363,9 @@ mame_gamelist_view_finalize (GObject *object)
 GMAMEUI_DEBUG ("Destroying mame gamelist view...");	
 	gamelist_view = MAME_GAMELIST_VIEW (object);
 	
-	/* Clear the model */
-	gtk_list_store_clear (GTK_LIST_STORE (gamelist_view->priv->curr_model));
-	
-	/* FIXME TODO Need to destroy the models */
+	g_object_unref (gamelist_view->priv->model);
+	if (gamelist_view->priv->filter_expr)
+		gmameui_filter_expr_unref (gamelist_view->priv->filter_expr);
 		
 	g_object_unref (gamelist_view->priv);
 	
@@ -395,192 +377,6 @@ GMAMEUI_DEBUG ("Destroying mame gamelist view... done");
 }
 /* End boilerplate functions */
 
-/* Determines whether a romset should be filtered (hidden from view)
-   based on the filter option passed in */
-static gboolean
-game_filtered (MameRomEntry * rom, gint rom_filter_opt)
-{
-	/* gchar **manufacturer; */
-	
-	gboolean is;
-	Columns_type type;
-	gchar *value;
-	gint int_value;
-	gboolean retval;
-
-	/* ROM information */
-	gboolean is_bios;
-	gboolean is_favourite;
-	gboolean is_clone;
-	gboolean is_vector;
-	
-	g_return_val_if_fail (selected_filter != NULL, FALSE);
-	g_return_val_if_fail (rom != NULL, FALSE);
-	
-	retval = FALSE;
-
-	g_object_get (selected_filter,
-		      "is", &is,
-		      "type", &type,
-		      "value", &value,
-		      "int_value", &int_value,
-		      NULL);
-
-	is_bios = mame_rom_entry_is_bios (rom);
-
-	/* Only display a BIOS rom if the BIOS filter is explicitly stated */
-	if (is_bios) { 
-		if (type == IS_BIOS) {
-			retval = ( (is && is_bios) ||
-				 (!is && !is_bios));
-		} else
-			retval = FALSE;
-	} else {
-		switch (type) {
-			
-			gchar *driver, *ver_added, *category;
-			DriverStatus driver_status;
-			DriverStatus driver_status_colour;
-			DriverStatus driver_status_sound;
-			DriverStatus driver_status_graphics;
-			gint timesplayed, num_channels;
-			RomStatus rom_status;
-			ControlType control;
-			
-			case DRIVER:
-				g_object_get (rom, "driver", &driver, NULL);
-				retval = ((is && !g_strcasecmp (driver,value)) ||
-					 (!is && g_strcasecmp (driver,value)));
-				g_free (driver);
-				break;
-			case CLONE:
-				is_clone = mame_rom_entry_is_clone (rom);
-				retval = ((is && !is_clone) || (!is && is_clone));
-				break;
-			case CONTROL:
-				g_object_get (rom, "control-type", &control, NULL);
-				retval = ((is && (control == (ControlType) int_value))  ||
-					 (!is && !(control == (ControlType) int_value)));
-				break;
-			case MAMEVER:				
-				g_object_get (rom, "version-added", &ver_added, NULL);
-				if (ver_added)
-					retval = (g_ascii_strcasecmp (ver_added, value) == 0);
-				g_free (ver_added);
-				break;
-			case CATEGORY:
-				g_object_get (rom, "category", &category, NULL);
-				if (category)
-					retval = (g_ascii_strcasecmp (category, value) == 0);
-				g_free (category);
-				break;
-			case FAVORITE:
-				is_favourite = mame_rom_entry_is_favourite (rom);
-				retval = ( (is && is_favourite) ||
-					 (!is && !is_favourite));
-				break;
-			case VECTOR:
-				is_vector = mame_rom_entry_is_vector (rom);
-				retval = ( (is && is_vector) ||
-					 (!is && !is_vector));
-				break;
-			case DRIVER_STATUS:
-				/* This is a summary of imperfect colour, sound, graphic
-				   and emulation */
-				g_object_get (rom, "driver-status", &driver_status, NULL);
-				retval = ( (is && driver_status == (DriverStatus)int_value) ||
-					 (!is && !driver_status == (DriverStatus)int_value));
-				break;
-			case COLOR_STATUS:
-				g_object_get (rom, "driver-status-colour", &driver_status_colour, NULL);
-				retval = ( (is && (driver_status_colour == (DriverStatus)int_value))  ||
-					 (!is && ! (driver_status_colour == (DriverStatus)int_value)));
-				break;
-			case SOUND_STATUS:
-				g_object_get (rom, "driver-status-sound", &driver_status_sound, NULL);
-				retval = ( (is && (driver_status_sound == (DriverStatus)int_value))  ||
-					 (!is && ! (driver_status_sound == (DriverStatus)int_value)));
-				break;
-			case GRAPHIC_STATUS:
-				g_object_get (rom, "driver-status-graphics", &driver_status_graphics, NULL);
-				retval = ( (is && (driver_status_graphics == (DriverStatus)int_value))  ||
-					 (!is && ! (driver_status_graphics == (DriverStatus)int_value)));
-				break;
-			case HAS_ROMS:
-				rom_status = mame_rom_entry_get_rom_status (rom);
-				retval = ((is && (rom_status == (RomStatus) int_value))  ||
-					 (!is && !(rom_status == (RomStatus) int_value)));
-				break;
-			case HAS_SAMPLES:
-				retval = ( (is && (mame_rom_entry_has_samples (rom) == int_value))  ||
-					 (!is && ! (mame_rom_entry_has_samples (rom) == int_value)));
-				break;
-			case TIMESPLAYED:
-				g_object_get (rom, "times-played", &timesplayed, NULL);
-				retval = ( (is && (timesplayed == int_value)) ||
-					 (!is && ! (timesplayed == int_value)));
-				break;
-			case CHANNELS:
-				g_object_get (rom, "num-channels", &num_channels, NULL);
-				retval = ( (is && (num_channels == int_value)) ||
-					 (!is && (num_channels != int_value)));
-				break;
-			/* We are not currently supporting the YEAR and MANUFACTURER filters
-			   since it makes the LHS filter list too long 
-		
-			case YEAR:
-				retval = ( (is && (rom->year == value)) ||
-					 (!is && (rom->year != value)));
-				break;
-				* comparing parsed text and text *
-			case MANU:
-				manufacturer = rom_entry_get_manufacturers (rom);
-				* we have now one or two clean manufacturer (s) we still need to differentiates sub companies*
-				if (manufacturer[1] != NULL) {
-					if ( (is && !g_strncasecmp (manufacturer[0], value, 5)) ||
-					     (!is && g_strncasecmp (manufacturer[0], value, 5)) ||
-					     (is && !g_strncasecmp (manufacturer[1], value, 5)) ||
-					     (!is && g_strncasecmp (manufacturer[1], value, 5))
-					     ) {
-						g_strfreev (manufacturer);
-						retval = TRUE;
-
-					}
-				} else {
-					if ( (is && !g_strncasecmp (manufacturer[0], value, 5)) ||
-					     (!is && g_strncasecmp (manufacturer[0], value, 5))
-					     ) {
-						g_strfreev (manufacturer);
-						retval = TRUE;
-					}
-				}
-				g_strfreev (manufacturer);
-				break;*/
-			default:
-				GMAMEUI_DEBUG ("Trying to filter, but filter type %d is not handled", type);
-				retval = FALSE;
-			}
-	}
-	g_free (value);
-	
-	/* Final additional check whether the ROM should be displayed based on the ROM
-	   filter settings and whether the ROM is available or unavailable */
-	if (retval) {
-		if (rom_filter_opt == 1) {
-			/* Only show Available */
-			retval = (mame_rom_entry_get_rom_status (rom) != NOT_AVAIL) ? TRUE : FALSE;
-		} else if (rom_filter_opt == 2) {
-			/* Only show Unavailable */
-			retval = (mame_rom_entry_get_rom_status (rom) == NOT_AVAIL) ? TRUE : FALSE;
-		} else {
-		/* No need to process for All ROMs */
-
-		}
-	}
-
-	return retval;
-}
-
 static guint timeoutid;
 static gint ColumnHide_selected;
 
@@ -644,13 +440,27 @@ mame_gamelist_view_change_views (MameGamelistView *gamelist_view)
 {
 	gint curr_mode;
 	gint prev_mode;
+	gboolean clones_tree;
 	int i;
 	
 	/* Get the mode and previous mode */
 	g_object_get (main_gui.gui_prefs,
 		      "current-mode", &curr_mode,
 		      "previous-mode", &prev_mode,
+		      "clones-tree", &clones_tree,
 		      NULL);
+
+	/* Every row is removed and added again, so the view is detached
+	   rather than told about each one */
+	if (clones_tree != mame_gamelist_model_get_tree_mode (gamelist_view->priv->model)) {
+		gtk_tree_view_set_model (GTK_TREE_VIEW (gamelist_view), NULL);
+		mame_gamelist_model_set_tree_mode (gamelist_view->priv->model, clones_tree);
+		gtk_tree_view_set_model (GTK_TREE_VIEW (gamelist_view),
+					 GTK_TREE_MODEL (gamelist_view->priv->model));
+
+		set_status_bar_game_count (gamelist_view);
+		mame_gamelist_view_scroll_to_selected_game (gamelist_view);
+	}
 	
 	if (curr_mode == DETAILS) {
 		GValueArray *va_shown = NULL;
@@ -695,17 +505,12 @@ mame_gamelist_view_select_random_game (MameGamelistView *gamelist_view, gint i)
 				(gpointer *) i);
 }
 
-/* FIXME TODO Merge with the other code that performs a gtk_tree_store_set */
+/* Reloads the icon of a romset whose details have changed, and updates
+   its row in the gamelist */
 void
 mame_gamelist_view_update_game_in_list (MameGamelistView *gamelist_view, MameRomEntry *tmprom)
 {
-	const gchar *my_hassamples;
 	GdkPixbuf *pixbuf;
-	ListMode current_mode;
-	gint rom_filter_opt;
-	PangoStyle pangostyle;
-	const gchar *name_in_list;
-	GtkTreeIter iter;
 	gchar *iconzipfile;
 	gchar *icondir;
 	gboolean prefercustomicons;
@@ -713,75 +518,17 @@ mame_gamelist_view_update_game_in_list (MameGamelistView *gamelist_view, MameRom
 	g_return_if_fail (tmprom != NULL);
 
 	g_object_get (main_gui.gui_prefs,
-		      "current-mode", &current_mode,
-		      "current-rom-filter", &rom_filter_opt,	      
 		      "dir-icons", &icondir,
 		      "prefercustomicons", &prefercustomicons,
 		      NULL);
 	
 	iconzipfile = g_build_filename (icondir, "icons.zip", NULL);
 	
-	name_in_list = mame_rom_entry_get_list_name (tmprom);
-
-	/* Has Samples */
-	if (!mame_rom_entry_has_samples (tmprom))
-		my_hassamples = "";
-	else {
-		my_hassamples = (mame_rom_entry_get_sample_status (tmprom) == CORRECT) ? _("Yes") : _("No");
-	}
-
-	/* Mark if clone */
-	if (mame_rom_entry_is_clone (tmprom))
-		pangostyle = PANGO_STYLE_ITALIC;
-	else
-		pangostyle = PANGO_STYLE_NORMAL;
-
-	gchar *romname;
-	gint timesplayed;
-	gchar *manu;
-	gchar *year;
-	gchar *cloneof;
-	gchar *driver, *category, *version;
-
-	g_object_get (tmprom,
-		      "romname", &romname,
-		      "times-played", &timesplayed,
-		      "manufacturer", &manu,
-		      "year", &year,
-		      "cloneof", &cloneof,
-		      "driver", &driver,
-		      "category", &category,
-		      "version-added", &version,
-		      NULL);
-	
 	/* Set the pixbuf for the status icon */
 	pixbuf = get_icon_for_rom (tmprom, ROM_ICON_SIZE, icondir, iconzipfile, prefercustomicons);
-	
-	iter = mame_rom_entry_get_position (tmprom);
-
-	gtk_list_store_set (GTK_LIST_STORE (gamelist_view->priv->curr_model), &iter,
-			    GAMENAME,     name_in_list,
-			    HAS_SAMPLES,  my_hassamples,
-			    ROMNAME,      romname,
-			    TIMESPLAYED,  timesplayed,
-			    MANU,         manu,
-			    YEAR,         year,
-			    CLONE,        cloneof,
-			    DRIVER,       driver,
-			    MAMEVER,      version,
-			    CATEGORY,     category,
-			    TEXTSTYLE,    pangostyle,
-			    FILTERED,     game_filtered (tmprom, rom_filter_opt),
-			    PIXBUF,       pixbuf,
-			    -1);
-
-	g_free (romname);
-	g_free (manu);
-	g_free (year);
-	g_free (cloneof);
-	g_free (driver);
-	g_free (category);
-	g_free (version);
+	mame_rom_entry_set_icon (tmprom, pixbuf);
+
+	mame_gamelist_model_update_romset (gamelist_view->priv->model, tmprom);
 	
 	g_free (iconzipfile);
 	g_free (icondir);
@@ -798,7 +545,7 @@ set_status_bar_game_count (MameGamelistView *gamelist_view)
 	   displayed after filtering is applied, not the total).
 	   FIXME TODO Note we use visible_games here since it is used in so many
 	   other places to determine whether to perform specific actions. */
-	visible_games = gtk_tree_model_iter_n_children (GTK_TREE_MODEL (gamelist_view->priv->filter_model), NULL);
+	visible_games = mame_gamelist_model_get_num_visible (gamelist_view->priv->model);
 
 	message = g_strdup_printf ("%d %s", visible_games, visible_games == 1 ? _("game") : _("games"));
 
@@ -821,39 +568,19 @@ g_timer_start (timer);
 	g_object_get (main_gui.gui_prefs, "current-mode", &current_mode, NULL);
 	GMAMEUI_DEBUG ("  Creating the MameGameListView Model in mode %d", current_mode);
 	
-	/* Unset the tree model until it has been filled */
-	if ((gamelist_view) && (gamelist_view->priv->curr_model)) {
-		gtk_tree_view_set_model (GTK_TREE_VIEW (gamelist_view), NULL);
-	}
-
-	gamelist_view->priv->curr_model = gamelist_view->priv->liststore;
-	
 	/* Get the status icon */
 	get_status_icons ();
 	
-	/* Add a filter, and link the model to a filter function so that
-	   calls to gtk_tree_model_filter_refilter cause the model to be
-	   filtered from the MameSearchEntry field
-	 
-	   In order to perform both filtering and sorting, the model structure is set as:
-	      Sortable
-	      +- Filter
-	         +- Store
-	   where Store is the structure of the Gamelist
-	 */
-	gamelist_view->priv->filter_model = gtk_tree_model_filter_new (gamelist_view->priv->curr_model, NULL);
-	gtk_tree_model_filter_set_visible_func (GTK_TREE_MODEL_FILTER (gamelist_view->priv->filter_model),
-						(GtkTreeModelFilterVisibleFunc) filter_func,
-						main_gui.search_entry,
-						NULL);
-	gamelist_view->priv->sort_model = gtk_tree_model_sort_new_with_model (GTK_TREE_MODEL (gamelist_view->priv->filter_model));
-	gtk_tree_view_set_model (GTK_TREE_VIEW (gamelist_view), GTK_TREE_MODEL (gamelist_view->priv->sort_model));
+	/* The MameGamelistModel reads the romsets from the gamelist, and
+	   does its own filtering (from the filter list and the
+	   MameSearchEntry field) and sorting */
+	gtk_tree_view_set_model (GTK_TREE_VIEW (gamelist_view), GTK_TREE_MODEL (gamelist_view->priv->model));
  
 	/* Sort the list */
 	set_list_sortable_column (gamelist_view);
 
 	/* Callback when the sort column/order changes */
-	g_signal_connect (G_OBJECT (gamelist_view->priv->sort_model), "sort-column-changed",
+	g_signal_connect (G_OBJECT (gamelist_view->priv->model), "sort-column-changed",
 			  G_CALLBACK (on_displayed_list_sort_column_changed), NULL);
 
 	/* The column headers are clickable in Details view only */
@@ -942,59 +669,42 @@ foreach_find_random_rom_in_store (GtkTreeModel *model,
 	return return_val;   
 }
 
-/* This function walks the tree store containing the ROM data until
-   it finds the row that has the ROM from the preferences. It then
-   scrolls to that row */
-static gboolean
-foreach_find_rom_in_store (GtkTreeModel *model,
-			   GtkTreePath  *path,
-			   GtkTreeIter  *iter,
-			   gpointer      user_data)
-{
+/* Scroll to, and highlight, the current-rom in the preferences */
+void
+mame_gamelist_view_scroll_to_selected_game (MameGamelistView *gamelist_view)
+{	
+	gchar *current_rom_name;
 	MameRomEntry *rom;
+	GtkTreeIter iter;
+
+	g_object_get (main_gui.gui_prefs, "current-rom", &current_rom_name, NULL);
+
+	/* Don't even bother looking if the current game is not set */
+	if (current_rom_name == NULL)
+		return;
 	
-	gchar *current_rom_name = (gchar *) user_data;
-	
-	/* Don't even bother trying to walk the store if the current game
-	   is not set. We are just wasting our time */
-	g_return_val_if_fail ((current_rom_name != NULL), TRUE);
-	
-	gtk_tree_model_get (model, iter, ROMENTRY, &rom, -1);
-/*	
-	tree_path_str = gtk_tree_path_to_string (path);
-	GMAMEUI_DEBUG ("Row %s: name is %s", tree_path_str, rom->romname);
-	g_free (tree_path_str);
-*/	
-	if (g_ascii_strcasecmp (mame_rom_entry_get_romname (rom), current_rom_name) == 0) {
-		GMAMEUI_DEBUG ("Found row in tree view - %s", mame_rom_entry_get_romname (rom));
+	/* Find the selected game in the gamelist, and scroll to it */
+	rom = get_rom_from_gamelist_by_name (gui_prefs.gl, current_rom_name);
+	if (rom && mame_gamelist_model_get_iter_for_romset (gamelist_view->priv->model, rom, &iter)) {
+		GtkTreePath *path;
+
+		GMAMEUI_DEBUG ("Found row in tree view - %s", current_rom_name);
+
+		path = gtk_tree_model_get_path (GTK_TREE_MODEL (gamelist_view->priv->model), &iter);
+
+		/* A clone is under its parent in the tree */
+		if (gtk_tree_path_get_depth (path) > 1)
+			gtk_tree_view_expand_to_path (GTK_TREE_VIEW (gamelist_view), path);
 
 		/* Scroll to selection */
-		gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (main_gui.displayed_list),
+		gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (gamelist_view),
 					      path, NULL, TRUE, 0.5, 0);
 
 		/* And highlight the row */
-		gtk_tree_view_set_cursor (GTK_TREE_VIEW (main_gui.displayed_list),
+		gtk_tree_view_set_cursor (GTK_TREE_VIEW (gamelist_view),
 					  path, NULL, FALSE);
-		
-		return TRUE;    /* Found the row we are after, no need to keep walking */
-	}
-	
-	return FALSE;   /* Do not stop walking the store, call us with next row */
-}
 
-/* Scroll to, and highlight, the current-rom in the preferences */
-void
-mame_gamelist_view_scroll_to_selected_game (MameGamelistView *gamelist_view)
-{	
-	gchar *current_rom_name;
-	g_object_get (main_gui.gui_prefs, "current-rom", &current_rom_name, NULL);
-	
-	/* Find the selected game in the gamelist, and scroll to it */
-	if (visible_games > 0) {
-		/* Scroll to the game specified from the preferences */
-		gtk_tree_model_foreach (GTK_TREE_MODEL (gamelist_view->priv->sort_model),
-					foreach_find_rom_in_store,
-					current_rom_name);
+		gtk_tree_path_free (path);
 	}
 	
 	g_free (current_rom_name);
@@ -1047,6 +757,29 @@ on_row_selected (GtkTreeSelection *selection,
 				   selection);
 }
 
+/* The model only makes the rows of the clones while they are shown */
+static void
+on_row_expanded (GtkTreeView *treeview,
+		 GtkTreeIter *iter,
+		 GtkTreePath *path,
+		 gpointer     user_data)
+{
+	MameGamelistView *gamelist_view = MAME_GAMELIST_VIEW (treeview);
+
+	mame_gamelist_model_row_expanded (gamelist_view->priv->model, iter);
+}
+
+static void
+on_row_collapsed (GtkTreeView *treeview,
+		  GtkTreeIter *iter,
+		  GtkTreePath *path,
+		  gpointer     user_data)
+{
+	MameGamelistView *gamelist_view = MAME_GAMELIST_VIEW (treeview);
+
+	mame_gamelist_model_row_collapsed (gamelist_view->priv->model, iter);
+}
+
 static gboolean
 on_list_keypress (GtkWidget   *widget,
 		  GdkEventKey *event,
@@ -1151,28 +884,6 @@ on_column_click (GtkWidget         *button,
 	return FALSE;
 }
 
-/* Go through the model and update the display name of the ROM to reflect
-   the current value of theprefix */
-static gboolean
-foreach_update_prefix_in_store (GtkTreeModel *model,
-				GtkTreePath  *path,
-				GtkTreeIter  *iter,
-				gpointer      user_data)
-{
-	MameRomEntry *rom;
-	
-	gtk_tree_model_get (model, iter, ROMENTRY, &rom, -1);
-
-	g_return_val_if_fail (rom != NULL, FALSE);
-
-
-	gtk_list_store_set (GTK_LIST_STORE (model), iter,
-			    GAMENAME, mame_rom_entry_get_list_name (rom),
-			    -1);
-
-	return FALSE;   /* Do not stop walking the store, call us with next row */
-}
-
 /* Handler for when the columns in the GuiPrefs object are changed (usually via
    the GUI Preferences dialog */
 static void
@@ -1239,9 +950,9 @@ on_prefs_theprefix_toggled (MameGuiPrefs *prefs, gboolean theprefix, gpointer us
 	
 	gamelist_view = (gpointer) user_data;
 
-	gtk_tree_model_foreach (GTK_TREE_MODEL (gamelist_view->priv->curr_model),
-				foreach_update_prefix_in_store,
-				(gpointer) theprefix);
+	/* The model reads the names from the romsets, so they only need
+	   to be redrawn */
+	gtk_widget_queue_draw (GTK_WIDGET (gamelist_view));
 }
 
 /* Hide a column from the popup menu; changing the main_gui.gui_prefs setting
@@ -1355,188 +1066,69 @@ gamelist_get_selected_game (void)
 	return game_data;
 }
 
-/* Filters the GtkTreeModel by seeing if the text in the MameSearchEntry
-   is a case insensitive match for text in the first column */
-static gboolean
-filter_func (GtkTreeModel *model,
-             GtkTreeIter  *iter,
-             GtkEntry     *entry)
-{
-
-	const gchar *needle;
-	const gchar *haystack;
-	gint filtered;
-
-	/* Get the gamename, and whether it is filtered by ROM, from the iter */
-	gtk_tree_model_get (model, iter,
-			    GAMENAME, &haystack,
-			    FILTERED, &filtered,
-			    -1);
-	needle = gtk_entry_get_text (entry);
-
-	/*GMAMEUI_DEBUG ("Checking for filter on %s: %d", haystack, filtered);*/
-	
-	/* If no text has been entered in the MameSearchEntry, don't do a string
-	   comparison (which will segfault), but instead just check whether the
-	   ROM has been filtered */
-	if (haystack == NULL)
-		return filtered;
-	
-	/*GMAMEUI_DEBUG ("Comparing search criteria %s against %s", needle, haystack);*/
-	if ((strcasestr (haystack, needle) != NULL) && filtered) {
-		visible_games++;
-		return TRUE;
-	} else
-		return FALSE;
-
-
-} 
-
 /* Callback handler for when data is entered in the search criteria field.
-   It asks the GtkTreeView to refilter itself, invoking the callback registered
-   in the call to gtk_tree_model_filter_set_visible_func () */
+   The model shows only the romsets matching the query parsed from it */
 static void
 on_search_changed (GtkEntry *entry, gchar *criteria, gpointer user_data)
 {
-	GtkTreeModelSort *sort;
-	
-	/*
-	   The model structure is set as:
-	      Sortable
-	      +- Filter
-	         +- Store
-	   So, we need to first get the model from the main_gui.displayed_list, which
-	   returns the Sortable, then get the model from the Sortable, which yields the
-	   Filter. We can then perform the refilter on this.
-	 */
-	
-	sort = GTK_TREE_MODEL_SORT (gtk_tree_view_get_model (GTK_TREE_VIEW (main_gui.displayed_list)));
+	MameGamelistView *gamelist_view = main_gui.displayed_list;
 
-	gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (gtk_tree_model_sort_get_model (sort)));
+	mame_gamelist_model_set_search_query (gamelist_view->priv->model,
+					      mame_search_entry_get_query (MAME_SEARCH_ENTRY (entry)));
 
 	/* Update number of visible games */
-	set_status_bar_game_count (main_gui.displayed_list);
+	set_status_bar_game_count (gamelist_view);
 }
 
+/* Gives the model the compound filter, or else the filter selected in the
+   filter list, with the ROM filter setting */
 static void
-populate_model_from_gamelist (MameGamelistView *gamelist_view, MameGamelist *gl)
+apply_filter (MameGamelistView *gamelist_view)
 {
-	GList *listpointer;
-	MameRomEntry *tmprom;
-	gchar *my_hassamples;
-	GtkTreeIter iter;
 	gint rom_filter_opt;
-	const gchar *name_in_list;
-
-	g_return_if_fail (gamelist_view->priv->curr_model != NULL);
 
 	/* Get the current ROM filter setting */
 	g_object_get (main_gui.gui_prefs, "current-rom-filter", &rom_filter_opt, NULL);
-	
-	/* Always clear and repopulate, since we call from numerous instances */
-	gtk_list_store_clear (GTK_LIST_STORE (gamelist_view->priv->curr_model));
 
-	/* Fill the model with data */
-	for (listpointer = g_list_first (mame_gamelist_get_roms_glist (gl));
-	     (listpointer);
-	     listpointer = g_list_next (listpointer)) {
+	if (gamelist_view->priv->filter_expr)
+		mame_gamelist_model_set_filter_expr (gamelist_view->priv->model,
+						     gamelist_view->priv->filter_expr,
+						     rom_filter_opt);
+	else
+		mame_gamelist_model_set_filter (gamelist_view->priv->model,
+						selected_filter, rom_filter_opt);
+}
 
-		tmprom = (MameRomEntry *) listpointer->data;
+/* Points the model at the romsets in the gamelist. No strings are copied;
+   the model reads the columns from the romsets as they are drawn. The view
+   is detached while the rows are added, so it is only laid out once. The
+   model is emptied before the tree mode, search and filter are set, so
+   the rows are only worked out once, for the new gamelist */
+static void
+populate_model_from_gamelist (MameGamelistView *gamelist_view, MameGamelist *gl)
+{
+	gboolean clones_tree;
 
-		PangoStyle pangostyle;
-		GdkPixbuf *pixbuf = NULL;
+	g_object_get (main_gui.gui_prefs, "clones-tree", &clones_tree, NULL);
 
-		name_in_list = mame_rom_entry_get_list_name (tmprom);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (gamelist_view), NULL);
 
-		/* Has Samples */
-		if (!mame_rom_entry_has_samples (tmprom))
-			my_hassamples = NULL;
-		else
-			my_hassamples = (mame_rom_entry_get_sample_status (tmprom) == CORRECT) ? _("Yes") : _("No");
-		
-		if (mame_rom_entry_is_clone (tmprom)) {
-			pangostyle = PANGO_STYLE_ITALIC;	/* Clone */
-		} else {
-			pangostyle = PANGO_STYLE_NORMAL;	/* Original */
-		}
+	mame_gamelist_model_set_gamelist (gamelist_view->priv->model, NULL);
 
-		/* Set the pixbuf for the status icon - start as being the status icon,
-		   then look for the custom icon in the adjustment_scrolled_delayed
-		   callback since we don't want to load icons from zips for EVERY ROM */
-		pixbuf = gmameui_icon_mgr_get_pixbuf_for_status (mame_rom_entry_get_rom_status (tmprom));
-
-		gchar *romname, *manu, *year, *cloneof, *driver, *category, *version;
-		gint timesplayed;
-
-		g_object_get (tmprom,
-			      "romname", &romname,
-			      "times-played", &timesplayed,
-			      "manufacturer", &manu,
-			      "year", &year,
-			      "cloneof", &cloneof,
-			      "driver", &driver,
-			      "category", &category,
-			      "version-added", &version,
-			      NULL);
-	      
-
-		gtk_list_store_append (GTK_LIST_STORE (gamelist_view->priv->curr_model), &iter);  /* Acquire an iterator */
-
-		gtk_list_store_set (GTK_LIST_STORE (gamelist_view->priv->curr_model), &iter,
-				    GAMENAME,     name_in_list,
-				    HAS_SAMPLES,  my_hassamples,
-				    ROMNAME,      romname,
-				    TIMESPLAYED,  timesplayed,
-				    MANU,         manu,
-				    YEAR,         year,
-				    CLONE,        cloneof,
-				    DRIVER,       driver,
-				    MAMEVER,      version,
-				    CATEGORY,     category,
-				    ROMENTRY,     tmprom,
-				    TEXTSTYLE,    pangostyle,
-				    FILTERED,     game_filtered (tmprom, rom_filter_opt),
-				    PIXBUF,       pixbuf,
-				    -1);
-
-		mame_rom_entry_set_position (tmprom, iter);
-			
-		g_free (romname);
-		g_free (manu);
-		g_free (year);
-		g_free (cloneof);
-		g_free (driver);
-		g_free (category);
-		g_free (version);
+	mame_gamelist_model_set_tree_mode (gamelist_view->priv->model, clones_tree);
 
-	}
+	/* Always repopulate, since we call from numerous instances */
+	mame_gamelist_model_set_search_query (gamelist_view->priv->model,
+					      mame_search_entry_get_query (MAME_SEARCH_ENTRY (main_gui.search_entry)));
+	apply_filter (gamelist_view);
+	mame_gamelist_model_set_gamelist (gamelist_view->priv->model, gl);
+
+	gtk_tree_view_set_model (GTK_TREE_VIEW (gamelist_view), GTK_TREE_MODEL (gamelist_view->priv->model));
 	
 	set_status_bar_game_count (gamelist_view);
 
 }
 
-static gboolean
-foreach_update_filter (GtkTreeModel *model,
-		       GtkTreePath  *path,
-		       GtkTreeIter  *iter,
-		       gpointer      user_data)
-{
-	MameRomEntry *tmprom;
-	gint rom_filter_opt;
-
-	rom_filter_opt = (gint) user_data;
-
-	gtk_tree_model_get (model, iter,
-			    ROMENTRY, &tmprom,
-			    -1);
-
-	gtk_list_store_set (GTK_LIST_STORE (model), iter,
-			    FILTERED, game_filtered (tmprom, rom_filter_opt),
-			    -1);
-
-	return FALSE;
-}
-
 /* Completely clear the existing gamelist and repopulate it - usually after
    starting GMAMEUI, or when rebuilding the contents */
 void
@@ -1547,27 +1139,36 @@ mame_gamelist_view_repopulate_contents (MameGamelistView *gamelist_view)
 	populate_model_from_gamelist (gamelist_view, gui_prefs.gl);
 }
 
-/* For each ROM in the model, recalculate whether it should be shown, based on the
-   selected filter. Invoked whenever the LHS filter selection is changed, or the
-   top filter buttons are changed */
+/* Shows the ROMs passing the selected filter. Invoked whenever the LHS filter
+   selection is changed, or the top filter buttons are changed */
 void
 mame_gamelist_view_update_filter (MameGamelistView *gamelist_view)
 {
-	gint rom_filter_opt;
-	
 	g_return_if_fail (gamelist_view != NULL);	
 	
-	/* Get the current ROM filter setting */
-	g_object_get (main_gui.gui_prefs, "current-rom-filter", &rom_filter_opt, NULL);
-
-	gtk_tree_model_foreach (GTK_TREE_MODEL (gamelist_view->priv->curr_model),
-				foreach_update_filter,
-				(gpointer) rom_filter_opt);
+	apply_filter (gamelist_view);
 
 	set_status_bar_game_count (gamelist_view);
 
 }
 
+/* Shows the ROMs passing a compound filter built from the filters in the
+   filter list, or with NULL goes back to the filter selected in the list */
+void
+mame_gamelist_view_set_filter_expr (MameGamelistView *gamelist_view,
+				    GmameuiFilterExpr *expr)
+{
+	g_return_if_fail (gamelist_view != NULL);
+
+	if (expr)
+		gmameui_filter_expr_ref (expr);
+	if (gamelist_view->priv->filter_expr)
+		gmameui_filter_expr_unref (gamelist_view->priv->filter_expr);
+	gamelist_view->priv->filter_expr = expr;
+
+	mame_gamelist_view_update_filter (gamelist_view);
+}
+
 /**
  * on_romset_audited:
  * @audit: the currently selected #MameExec
@@ -1592,7 +1193,6 @@ on_romset_audited (GmameuiAudit *audit,
 	MameRomEntry *rom;
 	const gchar *romname;
 	gchar *icondir, *iconzipfile;
-	gint rom_filter_opt;
 	gboolean prefercustomicons;
 
 	gamelist_view = (gpointer) user_data;
@@ -1600,7 +1200,6 @@ on_romset_audited (GmameuiAudit *audit,
 	g_return_if_fail (gamelist_view != NULL);
 
 	g_object_get (main_gui.gui_prefs,
-		      "current-rom-filter", &rom_filter_opt,
 		      "dir-icons", &icondir,
 		      "prefercustomicons", &prefercustomicons,
 		      NULL);
@@ -1620,20 +1219,14 @@ on_romset_audited (GmameuiAudit *audit,
 
 		/* Update the status icon for the ROM */
 		pixbuf = get_icon_for_rom (rom, ROM_ICON_SIZE, icondir, iconzipfile, prefercustomicons);
+		mame_rom_entry_set_icon (rom, pixbuf);
 
-		/* Update the liststore with the icon and whether the ROM is
+		/* Update the row with the icon and whether the ROM is
 		   displayed based on the filter setting and the audit value */
-		GtkTreeIter iter = mame_rom_entry_get_position (rom);
-		gtk_list_store_set (GTK_LIST_STORE (gamelist_view->priv->curr_model), &iter,
-				    FILTERED, game_filtered (rom, rom_filter_opt),
-		                    PIXBUF,   pixbuf,
-				    -1);
+		mame_gamelist_model_update_romset (gamelist_view->priv->model, rom);
 
 		/* Increment the status bar as appropriate */
 		set_status_bar_game_count (gamelist_view);
-		
-		if (pixbuf)
-			g_object_unref (pixbuf);
 	}
 	
 	g_free (icondir);
@@ -1699,7 +1292,7 @@ gmameui_gamelist_rebuild (MameGamelistView *gamelist_view)
 
 	/* Set the GtkTreeView's model to the newly-populated model */
 	gtk_tree_view_set_model (GTK_TREE_VIEW (gamelist_view),
-	                         GTK_TREE_MODEL (gamelist_view->priv->sort_model));
+	                         GTK_TREE_MODEL (gamelist_view->priv->model));
 		
 	gtk_widget_set_sensitive (main_gui.scrolled_window_games, TRUE);
 	
@@ -1726,6 +1319,11 @@ gmameui_gamelist_rebuild (MameGamelistView *gamelist_view)
 	   them until they are audited as meeting the current filter settings */
 	mame_gamelist_view_update_filter (main_gui.displayed_list);
 
+	/* Once the rows are laid out, pass the visible romsets to the audit
+	   so they are audited ahead of the rest */
+	g_timeout_add (ICON_TIMEOUT,
+		       (GSourceFunc) adjustment_scrolled_delayed, gamelist_view);
+
 }
 
 /* This function is to set the game icon from the zip file for each visible game;
@@ -1733,15 +1331,14 @@ gmameui_gamelist_rebuild (MameGamelistView *gamelist_view)
 gboolean
 adjustment_scrolled_delayed (MameGamelistView *gamelist_view)
 {
-	GtkTreeIter iter;
-
-	GtkTreePath *tree_path;
-	guint i;
-	gboolean valid;
+	GtkTreeModel *model;
+	GtkTreePath *start_path, *end_path;
 	GtkAdjustment *vadj;
 	gchar *icondir;
 	gchar *iconzipfile;
 	gboolean prefercustomicons;
+	GList *visible_roms = NULL;	/* Romset names in the viewable area */
+	MameRomEntry *tmprom;
 	
 	g_return_val_if_fail (main_gui.gui_prefs != NULL, FALSE);
 	
@@ -1755,6 +1352,8 @@ GMAMEUI_DEBUG ("Entering adjustment_scrolled_delayed");
 	
 	iconzipfile = g_build_filename (icondir, "icons.zip", NULL);
 
+	model = GTK_TREE_MODEL (gamelist_view->priv->model);
+
 	/* Getting the vertical window area */
 	vadj = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (main_gui.scrolled_window_games));
 	
@@ -1763,76 +1362,37 @@ GMAMEUI_DEBUG ("Entering adjustment_scrolled_delayed");
 					 adjustment_scrolled,
 					 gamelist_view);
 
-	/* Get the first iter from the model */
-	valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (gamelist_view->priv->sort_model), &iter);
+	/* Only the rows in the viewable area are updated */
+	if (gtk_tree_view_get_visible_range (GTK_TREE_VIEW (gamelist_view), &start_path, &end_path)) {
+		gint row, last_row;
 
-	i = 0;
-
-	MameRomEntry *tmprom;
+		last_row = gtk_tree_path_get_indices (end_path)[0];
 
-	while ((i < visible_games) && valid) {
-		GtkTreeIter filter_iter;
-		GtkTreeIter model_iter;
-
-		gtk_tree_model_get (GTK_TREE_MODEL (gamelist_view->priv->sort_model),
-				    &iter,
-				    ROMENTRY, &tmprom,
-				    -1);
-		/*GMAMEUI_DEBUG ("Updating icon for %s - the value of icon_pixbuf is %d",
-				 tmprom->romname,
-				 !tmprom->icon_pixbuf);*/
-		
-		/* Get the path so we can get the new iter after the store is updated */
-		tree_path = gtk_tree_model_get_path (GTK_TREE_MODEL (gamelist_view->priv->sort_model), &iter);
-
-		/* Get the position of the current iter's path so we can see
-		   whether it falls within the visible area */
-		GdkRectangle rect;
-		gtk_tree_view_get_cell_area (GTK_TREE_VIEW (main_gui.displayed_list),
-					     tree_path,
-					     NULL, &rect);
-
-		/* Only update the pixbuf if it is in the viewable area (defined by the rect) */
-		if ((rect.y + rect.height) > 0 && (rect.y < vadj->page_size)) {
+		for (row = gtk_tree_path_get_indices (start_path)[0]; row <= last_row; row++) {
+			GtkTreePath *tree_path;
+			GtkTreeIter iter;
 			GdkPixbuf *icon;
 
-			icon = get_icon_for_rom (tmprom, ROM_ICON_SIZE, icondir, iconzipfile, prefercustomicons);
+			tree_path = gtk_tree_path_new_from_indices (row, -1);
 
-			mame_rom_entry_set_icon (tmprom, icon);
-			
-			/* Sort +- Filter +- Model, so need to convert the iter
-			   on the sort to get to the base before we can update the base model */
-
-			/* Get the filter model and iter */
-			gtk_tree_model_sort_convert_iter_to_child_iter (GTK_TREE_MODEL_SORT (gamelist_view->priv->sort_model),
-						&filter_iter,
-						&iter);
-
-			/* Get the base model and iter from the filter */
-			gtk_tree_model_filter_convert_iter_to_child_iter (GTK_TREE_MODEL_FILTER (gamelist_view->priv->filter_model),
-						  &model_iter,
-						  &filter_iter);
-
-			/* Update the ROM in the list store with the icon from the zip file */
-			if (icon) {
-				gtk_list_store_set (GTK_LIST_STORE (gamelist_view->priv->curr_model),
-						    &model_iter,
-						    PIXBUF, icon,
-						    -1);
-				/* After the list store has been updated, the iterator
-				   is lost, so we need to get it from the updated model */
-				gtk_tree_model_get_iter (GTK_TREE_MODEL (gamelist_view->priv->sort_model),
-							 &iter, tree_path);
-				
-			}
-		}
+			if (gtk_tree_model_get_iter (model, &iter, tree_path)) {
+				gtk_tree_model_get (model, &iter, ROMENTRY, &tmprom, -1);
 
-		/* Move to the next item in the list */
-		valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (gamelist_view->priv->sort_model), &iter);
+				visible_roms = g_list_prepend (visible_roms,
+							       (gpointer) mame_rom_entry_get_romname (tmprom));
 
-		gtk_tree_path_free (tree_path);
+				/* Update the ROM with the icon from the zip file */
+				icon = get_icon_for_rom (tmprom, ROM_ICON_SIZE, icondir, iconzipfile, prefercustomicons);
+				mame_rom_entry_set_icon (tmprom, icon);
 
-		i++;
+				gtk_tree_model_row_changed (model, tree_path, &iter);
+			}
+
+			gtk_tree_path_free (tree_path);
+		}
+
+		gtk_tree_path_free (start_path);
+		gtk_tree_path_free (end_path);
 	}
 
 	/* Re-Enable the callback */
@@ -1840,6 +1400,16 @@ GMAMEUI_DEBUG ("Entering adjustment_scrolled_delayed");
 					   adjustment_scrolled,
 					   gamelist_view);
 
+	/* Have any running audit check the selected and visible romsets
+	   first, so the status icons on screen are correct quickly */
+	tmprom = gamelist_get_selected_game ();
+	visible_roms = g_list_reverse (visible_roms);
+	if (tmprom)
+		visible_roms = g_list_prepend (visible_roms,
+					       (gpointer) mame_rom_entry_get_romname (tmprom));
+	mame_audit_set_priority_romsets (gui_prefs.audit, visible_roms);
+	g_list_free (visible_roms);
+
 	g_free (iconzipfile);
 	g_free (icondir);
 GMAMEUI_DEBUG ("Leaving adjustment_scrolled_delayed");
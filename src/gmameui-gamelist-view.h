@@ -28,6 +28,7 @@
 
 #include "rom_entry.h"  /* For MameRomEntry */
 #include "gmameui.h"	/* For ListMode */
+#include "gmameui-filter-expr.h"
 
 G_BEGIN_DECLS
 
@@ -79,6 +80,8 @@ void mame_gamelist_view_scroll_to_selected_game (MameGamelistView *gamelist_view
 
 void mame_gamelist_view_repopulate_contents (MameGamelistView *gamelist_view);
 void mame_gamelist_view_update_filter (MameGamelistView *gamelist_view);
+void mame_gamelist_view_set_filter_expr (MameGamelistView *gamelist_view,
+                                         GmameuiFilterExpr *expr);
 
 G_END_DECLS
 
@@ -210,7 +210,11 @@ XMLStartRomHandler2 (void *user_data, const XML_Char *name, const XML_Char **att
 		parser->priv->current_rom = get_rom_from_gamelist_by_name (gui_prefs.gl, romname);
 		g_free (romname);
 		
-		parser->priv->processing_romset = TRUE;
+		/* Romsets whose ROM information was read by an earlier run are
+		   kept as they are, rather than having it appended again */
+		parser->priv->processing_romset = (parser->priv->current_rom != NULL) &&
+			(mame_rom_entry_get_roms (parser->priv->current_rom) == NULL) &&
+			(mame_rom_entry_get_disks (parser->priv->current_rom) == NULL);
 	}
 	else if (g_ascii_strcasecmp (name, "rom") == 0)
 	{
@@ -222,6 +226,7 @@ XMLStartRomHandler2 (void *user_data, const XML_Char *name, const XML_Char **att
 			rom_value->sha1 = g_strdup (read_string_attribute (atts, "sha1"));
 			rom_value->crc = /*read_int_attribute (atts, "crc", 0);*/
 				g_strdup (read_string_attribute (atts, "crc"));
+			rom_value->uncomp_size = read_int_attribute (atts, "size", 0);
 			rom_value->merge = g_strdup (read_string_attribute (atts, "merge"));
 			rom_value->status = g_strdup (read_string_attribute (atts, "status"));
 			rom_value->region = g_strdup (read_string_attribute (atts, "region"));
@@ -235,6 +240,21 @@ XMLStartRomHandler2 (void *user_data, const XML_Char *name, const XML_Char **att
 		}
 
 	}
+	else if (g_ascii_strcasecmp (name, "disk") == 0)
+	{
+		/* Disks (CHDs) have a SHA1 but no CRC */
+		if (parser->priv->processing_romset == TRUE) {
+			individual_rom *disk_value = (individual_rom *) g_malloc0 (sizeof (individual_rom));
+
+			disk_value->name = g_strdup (read_string_attribute (atts, "name"));
+			disk_value->sha1 = g_strdup (read_string_attribute (atts, "sha1"));
+			disk_value->merge = g_strdup (read_string_attribute (atts, "merge"));
+			disk_value->status = g_strdup (read_string_attribute (atts, "status"));
+			disk_value->region = g_strdup (read_string_attribute (atts, "region"));
+
+			mame_rom_entry_add_disk_ref (parser->priv->current_rom, disk_value);
+		}
+	}
 }
 
 static void
@@ -269,6 +289,7 @@ XMLStartRomHandler (void *user_data, const XML_Char *name, const XML_Char **atts
 		rom_value->name = g_strdup (read_string_attribute (atts, "name"));
 		rom_value->sha1 = g_strdup (read_string_attribute (atts, "sha1"));
 		rom_value->crc = g_strdup (read_string_attribute (atts, "crc"));
+		rom_value->uncomp_size = read_int_attribute (atts, "size", 0);
 		rom_value->merge = g_strdup (read_string_attribute (atts, "merge"));
 		rom_value->status = g_strdup (read_string_attribute (atts, "status"));
 
@@ -357,44 +378,6 @@ XMLStartRomHandler (void *user_data, const XML_Char *name, const XML_Char **atts
 
 }
 
-// AAA FIXME TODO Not required
-static void
-XMLStartIndivRomHandler (void *user_data, const XML_Char *name, const XML_Char **atts)
-{
-	/* i.e. we are now processing the ROM data */
-
-	GMAMEUIListOutput *parser = (GMAMEUIListOutput *) user_data;
-	
-	if (g_ascii_strcasecmp (name, "game") == 0) {
-		parser->priv->current_romset_name = g_strdup (read_string_attribute (atts, "name"));
-		/*GMAMEUI_DEBUG ("  Processing romset %s", parser->priv->current_romset_name);*/
-	} else if (g_ascii_strcasecmp (name, "rom") == 0) {
-		gchar *sha1;
-		sha1 = g_strdup (read_string_attribute (atts, "sha1"));
-		if (sha1) {
-			/*GMAMEUI_DEBUG ("    Adding reference to %s from romset %s to hash table",
-				       read_string_attribute (atts, "sha1"),
-				       parser->priv->current_romset_name);*/
-/*AAA FIXME TODO - only insert if it doesn't exist; if it does, then existing entry will be leaked
-AAA FIXME TODO - only insert if ROM is available*/
-			g_hash_table_insert (gui_prefs.rom_hashtable,
-				             g_strdup (sha1),
-				             g_strdup (parser->priv->current_romset_name));
-			g_free (sha1);
-		} /*else {
-			GMAMEUI_DEBUG ("    Skipping %s from fromset %s - bad or no dump",
-			               read_string_attribute (atts, "name"),
-				       parser->priv->current_romset_name);
-		}*/
-	}
-}
-
-static void
-XMLEndIndivRomHandler (MameRomEntry *rom, const XML_Char *name)
-{
-	/* No need to do anything here */
-}
-
 static void
 XMLStartHandler (GMAMEUIListOutput *parser, const XML_Char *name, const XML_Char **atts)
 {
@@ -798,7 +781,6 @@ gmameui_listoutput_generate_rom_hash (GMAMEUIListOutput *parser, MameExec *exec)
 
 	g_return_val_if_fail (parser != NULL, FALSE);
 	g_return_val_if_fail (exec != NULL, FALSE);
-//DELETE	g_return_val_if_fail (gui_prefs.rom_hashtable != NULL, FALSE);
 
 	timer = g_timer_new ();
 	
@@ -32,6 +32,7 @@
 /* Other dialogs */
 #include "gui_prefs_dialog.h"
 #include "gmameui-audit-dlg.h"
+#include "gmameui-filter-builder-dlg.h"
 #include "gmameui-rominfo-dlg.h"
 #include "directories.h"
 #include "mame_options_dialog.h"
@@ -64,6 +65,8 @@ on_hpaned_position_notify        (GObject *object, GParamSpec *pspec, gpointer d
 static void
 on_view_type_changed             (GtkToggleAction *action, gpointer user_data);
 static void
+on_clones_tree_toggled           (GtkToggleAction *action, gpointer user_data);
+static void
 on_filter_btn_toggled            (GtkWidget *widget, gpointer user_data);
 static GtkWidget *
 get_filter_btn_by_id             (GtkBuilder *builder, gint i);
@@ -114,6 +117,8 @@ on_refresh_activate              (GtkAction *action, gpointer user_data);
 static void
 on_filter_list_activate          (GtkAction *action, gpointer user_data);
 static void
+on_compound_filter_activate      (GtkAction *action, gpointer user_data);
+static void
 on_toolbar_view_menu_activate    (GtkAction *action, gpointer user_data);
 static void
 on_status_bar_view_menu_activate (GtkAction *action, gpointer user_data);
@@ -155,7 +160,8 @@ static const GtkActionEntry gmameui_always_sensitive_menu_entries[] =
 	  N_("Quit GMAMEUI"), G_CALLBACK (on_exit_activate) },
 
 	/* View menu */
-
+	{ "ViewCompoundFilter", GTK_STOCK_FIND, N_("_Compound Filter..."), NULL,
+	  N_("Combine filters with AND, OR and NOT"), G_CALLBACK (on_compound_filter_activate) },
 
 	/* Option menu */
 	{ "OptionDirs", GTK_STOCK_DIRECTORY, N_("_Directories..."), NULL,
@@ -236,6 +242,9 @@ static const GtkToggleActionEntry gmameui_view_toggle_menu_entries[] =
 	{ "ViewDetailsListView", NULL, N_("_Details"), NULL,
 	  N_("Displays detailed information about each item"),
 	  G_CALLBACK (on_view_type_changed), TRUE },
+	{ "ViewClonesTree", NULL, N_("_Group Clones"), NULL,
+	  N_("Show clones under their parent game"),
+	  G_CALLBACK (on_clones_tree_toggled), FALSE },
 };
 
 static const GtkActionEntry gmameui_column_entries[] =
@@ -340,6 +349,7 @@ gmameui_main_win_init (GMAMEUIMainWin *main_window)
 	gint show_filters, show_screenshot;
 	gint show_statusbar, show_toolbar;
 	gint current_mode;
+	gboolean clones_tree;
 
 	GError *error = NULL;
 
@@ -356,6 +366,7 @@ GMAMEUI_DEBUG ("Setting up main window...");
 		      "show-statusbar", &show_statusbar,
 		      "show-toolbar", &show_toolbar,
 		      "current-mode", &current_mode,    /* FIXME TODO Rename to show-details */
+		      "clones-tree", &clones_tree,
 		      "xpos-filters", &xpos_filters,
 		      "xpos-gamelist", &xpos_gamelist,
 		      NULL);
@@ -514,6 +525,9 @@ GMAMEUI_DEBUG ("Setting up main window...");
 	gtk_toggle_action_set_active (GTK_TOGGLE_ACTION (gtk_ui_manager_get_action (main_gui.manager,
 				      "/MenuBar/ViewMenu/ViewDetailsListViewMenu")),
 	                              current_mode);
+	gtk_toggle_action_set_active (GTK_TOGGLE_ACTION (gtk_ui_manager_get_action (main_gui.manager,
+				      "/MenuBar/ViewMenu/ViewClonesTreeMenu")),
+	                              clones_tree);
 	
 	main_gui.hpanedLeft = gtk_hpaned_new ();
 	main_gui.hpanedRight = gtk_hpaned_new ();
@@ -759,6 +773,15 @@ on_filter_list_activate (GtkAction *action, gpointer user_data)
 
 }
 
+static void
+on_compound_filter_activate (GtkAction *action, gpointer user_data)
+{
+	GtkWidget *filter_dlg;
+
+	filter_dlg = gmameui_filter_builder_dialog_new (GTK_WINDOW (MainWindow));
+	gtk_widget_show (filter_dlg);
+}
+
 static void
 on_screen_shot_activate (GtkAction *action, gpointer user_data)
 {
@@ -859,6 +882,24 @@ on_view_type_changed (GtkToggleAction *action, gpointer user_data)
 	}	 
 }
 
+/* This function is called when the toggle action grouping clones under
+   their parent is changed */
+static void
+on_clones_tree_toggled (GtkToggleAction *action, gpointer user_data)
+{
+	gboolean clones_tree;
+
+	g_object_get (main_gui.gui_prefs, "clones-tree", &clones_tree, NULL);
+
+	if (clones_tree != gtk_toggle_action_get_active (action)) {
+		g_object_set (main_gui.gui_prefs,
+			      "clones-tree", gtk_toggle_action_get_active (action),
+			      NULL);
+
+		mame_gamelist_view_change_views (main_gui.displayed_list);
+	}
+}
+
 static void
 on_filter_btn_toggled (GtkWidget *widget, gpointer user_data)
 {
@@ -0,0 +1,180 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include <stdlib.h>
+
+#include "gmameui-rom-index.h"
+
+/* The entries are held in a single array, sorted by CRC then size, so a
+   lookup is a binary search followed by a scan over the matching run. All
+   the strings live in one string chunk, with romset names and SHA1s shared
+   between entries */
+struct _GmameuiRomIndex {
+	GArray *entries;	/* Array of RomIndexEntry */
+	GStringChunk *strings;
+	gboolean sorted;
+};
+
+GmameuiRomIndex *
+gmameui_rom_index_new (void)
+{
+	GmameuiRomIndex *index;
+
+	index = g_new0 (GmameuiRomIndex, 1);
+	index->entries = g_array_sized_new (FALSE, FALSE, sizeof (RomIndexEntry), 4096);
+	index->strings = g_string_chunk_new (65536);
+	index->sorted = TRUE;
+
+	return index;
+}
+
+void
+gmameui_rom_index_free (GmameuiRomIndex *index)
+{
+	g_return_if_fail (index != NULL);
+
+	g_array_free (index->entries, TRUE);
+	g_string_chunk_free (index->strings);
+	g_free (index);
+}
+
+void
+gmameui_rom_index_add (GmameuiRomIndex *index,
+		       guint32 crc,
+		       guint32 size,
+		       const gchar *romset,
+		       const gchar *name,
+		       const gchar *sha1)
+{
+	RomIndexEntry entry;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (romset != NULL);
+	g_return_if_fail (name != NULL);
+
+	entry.crc = crc;
+	entry.size = size;
+	entry.romset = g_string_chunk_insert_const (index->strings, romset);
+	entry.name = g_string_chunk_insert (index->strings, name);
+	entry.sha1 = sha1 ? g_string_chunk_insert_const (index->strings, sha1) : NULL;
+
+	g_array_append_val (index->entries, entry);
+	index->sorted = FALSE;
+}
+
+static gint
+compare_entries (gconstpointer a, gconstpointer b)
+{
+	const RomIndexEntry *ea = (const RomIndexEntry *) a;
+	const RomIndexEntry *eb = (const RomIndexEntry *) b;
+
+	if (ea->crc != eb->crc)
+		return (ea->crc < eb->crc) ? -1 : 1;
+	if (ea->size != eb->size)
+		return (ea->size < eb->size) ? -1 : 1;
+
+	return 0;
+}
+
+/* Must be called after the last entry is added, and before the index is
+   used from more than one thread */
+void
+gmameui_rom_index_sort (GmameuiRomIndex *index)
+{
+	GTimer *timer;
+
+	g_return_if_fail (index != NULL);
+
+	if (index->sorted)
+		return;
+
+	timer = g_timer_new ();
+
+	g_array_sort (index->entries, compare_entries);
+	index->sorted = TRUE;
+
+	GMAMEUI_DEBUG ("Sorted %d entries in ROM index in %0.3f seconds",
+		       index->entries->len, g_timer_elapsed (timer, NULL));
+	g_timer_destroy (timer);
+}
+
+guint
+gmameui_rom_index_get_num_entries (GmameuiRomIndex *index)
+{
+	g_return_val_if_fail (index != NULL, 0);
+
+	return index->entries->len;
+}
+
+/* Returns a GList of the RomIndexEntry items matching the CRC and size. A
+   size of 0 matches any size. If sha1 is given, entries whose SHA1 is known
+   and differs are skipped. The list must be freed with g_list_free, but the
+   entries belong to the index */
+GList *
+gmameui_rom_index_lookup (GmameuiRomIndex *index,
+			  guint32 crc,
+			  guint32 size,
+			  const gchar *sha1)
+{
+	RomIndexEntry *entries;
+	GList *matches = NULL;
+	guint lo, hi;
+
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (index->sorted, NULL);
+
+	entries = (RomIndexEntry *) index->entries->data;
+
+	/* Find the first entry with the CRC */
+	lo = 0;
+	hi = index->entries->len;
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (entries[mid].crc < crc)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < index->entries->len && entries[lo].crc == crc; lo++) {
+		if (size && entries[lo].size != size)
+			continue;
+
+		if (sha1 && entries[lo].sha1 &&
+		    g_ascii_strcasecmp (sha1, entries[lo].sha1) != 0)
+			continue;
+
+		matches = g_list_prepend (matches, &entries[lo]);
+	}
+
+	return g_list_reverse (matches);
+}
+
+/* The -listxml output and the zip contents give the CRC as a hex string */
+guint32
+gmameui_rom_index_parse_crc (const gchar *crc)
+{
+	g_return_val_if_fail (crc != NULL, 0);
+
+	return (guint32) strtoul (crc, NULL, 16);
+}
@@ -0,0 +1,74 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_ROM_INDEX_H__
+#define __GMAMEUI_ROM_INDEX_H__
+
+#include "common.h"
+
+G_BEGIN_DECLS
+
+/* A ROM available in a romset, keyed by its CRC and size. Strings are owned
+   by the index */
+typedef struct {
+	guint32 crc;
+	guint32 size;
+	const gchar *romset;	/* Romset (zipfile) containing the ROM */
+	const gchar *name;	/* Name of the ROM within the romset */
+	const gchar *sha1;	/* NULL if not known */
+} RomIndexEntry;
+
+/* Multimap of (CRC, size) to every romset containing a ROM with those
+   values. Entries are added, then the index is sorted once before
+   looking up. Once sorted, lookups can be made from several threads */
+typedef struct _GmameuiRomIndex GmameuiRomIndex;
+
+GmameuiRomIndex *
+gmameui_rom_index_new (void);
+
+void
+gmameui_rom_index_free (GmameuiRomIndex *index);
+
+void
+gmameui_rom_index_add (GmameuiRomIndex *index,
+		       guint32 crc,
+		       guint32 size,
+		       const gchar *romset,
+		       const gchar *name,
+		       const gchar *sha1);
+
+void
+gmameui_rom_index_sort (GmameuiRomIndex *index);
+
+guint
+gmameui_rom_index_get_num_entries (GmameuiRomIndex *index);
+
+GList *
+gmameui_rom_index_lookup (GmameuiRomIndex *index,
+			  guint32 crc,
+			  guint32 size,
+			  const gchar *sha1);
+
+guint32
+gmameui_rom_index_parse_crc (const gchar *crc);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_ROM_INDEX_H__ */
@@ -0,0 +1,352 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+
+#include "gmameui-rom-verify.h"
+#include "gmameui-rom-index.h"
+#include "gmameui-archive.h"
+
+struct _GmameuiRomVerifier {
+	gchar *statefile;	/* Romsets verified by the current run */
+	GHashTable *done;	/* Romset name -> "mtime size" from the state file */
+
+	guint max_kb_per_sec;	/* 0 means unlimited */
+	GMutex *throttle_mutex;	/* Protects the timer and byte count */
+	GTimer *timer;
+	guint64 bytes_read;
+
+	volatile gint cancelled;
+};
+
+static gchar *
+get_state_key (gint64 mtime, gint64 size)
+{
+	return g_strdup_printf ("%" G_GINT64_FORMAT " %" G_GINT64_FORMAT, mtime, size);
+}
+
+/* Reads the romsets recorded by an earlier run that didn't finish */
+static void
+read_state_file (GmameuiRomVerifier *verifier)
+{
+	gchar *contents;
+	gchar **lines;
+	guint i;
+
+	if (!g_file_get_contents (verifier->statefile, &contents, NULL, NULL))
+		return;
+
+	lines = g_strsplit (contents, "\n", 0);
+	for (i = 0; lines[i] != NULL; i++) {
+		gchar **fields;
+
+		fields = g_strsplit (lines[i], " ", 3);
+		if (g_strv_length (fields) == 3)
+			g_hash_table_insert (verifier->done,
+					     g_strdup (fields[0]),
+					     g_strdup_printf ("%s %s", fields[1], fields[2]));
+		g_strfreev (fields);
+	}
+	g_strfreev (lines);
+	g_free (contents);
+
+	GMAMEUI_DEBUG ("Resuming deep verify - %d romsets already verified",
+		       g_hash_table_size (verifier->done));
+}
+
+GmameuiRomVerifier *
+gmameui_rom_verifier_new (guint max_kb_per_sec)
+{
+	GmameuiRomVerifier *verifier;
+
+	verifier = g_new0 (GmameuiRomVerifier, 1);
+	verifier->statefile = g_build_filename (g_get_user_config_dir (), "gmameui",
+						"deepverify.state", NULL);
+	verifier->done = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	verifier->max_kb_per_sec = max_kb_per_sec;
+	verifier->throttle_mutex = g_mutex_new ();
+	verifier->timer = g_timer_new ();
+
+	read_state_file (verifier);
+
+	return verifier;
+}
+
+/* The workers must have stopped before the verifier is freed */
+void
+gmameui_rom_verifier_free (GmameuiRomVerifier *verifier)
+{
+	g_return_if_fail (verifier != NULL);
+
+	g_hash_table_destroy (verifier->done);
+	g_mutex_free (verifier->throttle_mutex);
+	g_timer_destroy (verifier->timer);
+	g_free (verifier->statefile);
+	g_free (verifier);
+}
+
+/* Sleeps until the bytes read by all the workers are within the limit */
+static void
+rom_verifier_throttle (GmameuiRomVerifier *verifier, guint64 len)
+{
+	gdouble expected, elapsed;
+
+	if (verifier->max_kb_per_sec == 0)
+		return;
+
+	g_mutex_lock (verifier->throttle_mutex);
+	verifier->bytes_read += len;
+	expected = (gdouble) verifier->bytes_read / ((gdouble) verifier->max_kb_per_sec * 1024.0);
+	elapsed = g_timer_elapsed (verifier->timer, NULL);
+	g_mutex_unlock (verifier->throttle_mutex);
+
+	if (expected > elapsed)
+		g_usleep ((gulong) ((expected - elapsed) * G_USEC_PER_SEC));
+}
+
+/* Returns the entry in the archive matching the ROM's CRC and size */
+static const ArchiveEntry *
+find_rom_entry (GmameuiArchive *archive, individual_rom *rom)
+{
+	guint32 crc;
+	guint i;
+
+	crc = gmameui_rom_index_parse_crc (rom->crc);
+
+	for (i = 0; i < gmameui_archive_get_num_entries (archive); i++) {
+		const ArchiveEntry *entry = gmameui_archive_get_nth_entry (archive, i);
+		guint32 entry_crc;
+
+		if ((rom->uncomp_size != 0) && (entry->size != (guint64) rom->uncomp_size))
+			continue;
+
+		if (gmameui_archive_get_crc (archive, entry, &entry_crc) && (entry_crc == crc))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Decompresses the entry and returns its SHA1, or NULL if it couldn't be
+   read or doesn't match the CRC in the archive */
+static gchar *
+hash_entry (GmameuiRomVerifier *verifier, GmameuiArchive *archive, const ArchiveEntry *entry)
+{
+	guchar *data;
+	gchar *sha1 = NULL;
+
+	data = gmameui_archive_extract (archive, entry);
+	if (data == NULL)
+		return NULL;
+
+	/* The entry was found by its CRC, so the CRC has been read */
+	if (crc32 (crc32 (0L, Z_NULL, 0), data, (uInt) entry->size) == entry->crc)
+		sha1 = g_compute_checksum_for_data (G_CHECKSUM_SHA1, data, (gsize) entry->size);
+	else
+		GMAMEUI_DEBUG ("%s in %s does not match its CRC", entry->name,
+			       gmameui_archive_get_path (archive));
+
+	g_free (data);
+
+	rom_verifier_throttle (verifier, entry->size);
+
+	return sha1;
+}
+
+/* Runs on a worker thread. Hashes each ROM in the romset that -listxml
+   gives a SHA1 for. ROMs a clone doesn't have are looked for in its parent's
+   romset; ROMs missing from both are left to the fix scan. Returns FALSE if
+   the romset couldn't be opened */
+gboolean
+gmameui_rom_verifier_verify_romset (GmameuiRomVerifier *verifier,
+				    MameRomEntry *romset,
+				    const gchar *path,
+				    RomVerifyResult *result)
+{
+	GmameuiArchive *archive;
+	GmameuiArchive *parent = NULL;
+	gboolean parent_opened = FALSE;
+	GHashTable *hashed;	/* ArchiveEntry -> SHA1, for ROMs sharing data */
+	const gchar *romname;
+	const gchar *done;
+	struct stat st;
+	GList *roms;
+
+	g_return_val_if_fail (verifier != NULL, FALSE);
+	g_return_val_if_fail (romset != NULL, FALSE);
+	g_return_val_if_fail (path != NULL, FALSE);
+	g_return_val_if_fail (result != NULL, FALSE);
+
+	memset (result, 0, sizeof (RomVerifyResult));
+
+	if (g_stat (path, &st) != 0)
+		return FALSE;
+
+	result->mtime = (gint64) st.st_mtime;
+	result->size = (gint64) st.st_size;
+
+	/* Skip romsets verified before a restart, unless they have changed */
+	romname = mame_rom_entry_get_romname (romset);
+	done = g_hash_table_lookup (verifier->done, romname);
+	if (done) {
+		gchar *key;
+
+		key = get_state_key (result->mtime, result->size);
+		result->resumed = (g_ascii_strcasecmp (key, done) == 0);
+		g_free (key);
+
+		if (result->resumed) {
+			result->complete = TRUE;
+			return TRUE;
+		}
+	}
+
+	archive = gmameui_archive_open (path);
+	if (archive == NULL)
+		return FALSE;
+
+	hashed = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+	for (roms = mame_rom_entry_get_roms (romset); roms; roms = g_list_next (roms)) {
+		individual_rom *rom = (individual_rom *) roms->data;
+		GmameuiArchive *container = archive;
+		const ArchiveEntry *entry;
+		gchar *sha1;
+
+		if (g_atomic_int_get (&verifier->cancelled))
+			break;
+
+		if ((rom->crc == NULL) || (rom->sha1 == NULL))
+			continue;
+
+		entry = find_rom_entry (archive, rom);
+		if ((entry == NULL) && mame_rom_entry_is_clone (romset)) {
+			if (!parent_opened) {
+				parent = gmameui_archive_open_romset (mame_rom_entry_get_parent_romname (romset));
+				parent_opened = TRUE;
+			}
+
+			if (parent) {
+				container = parent;
+				entry = find_rom_entry (parent, rom);
+			}
+		}
+
+		if (entry == NULL)
+			continue;
+
+		sha1 = g_hash_table_lookup (hashed, entry);
+		if (sha1 == NULL) {
+			sha1 = hash_entry (verifier, container, entry);
+			result->bytes += entry->size;
+
+			/* Unreadable data is recorded as an empty SHA1 so it is
+			   only read once */
+			g_hash_table_insert (hashed, (gpointer) entry, sha1 ? sha1 : g_strdup (""));
+			if (sha1 == NULL)
+				sha1 = g_hash_table_lookup (hashed, entry);
+		}
+
+		if (g_ascii_strcasecmp (sha1, rom->sha1) != 0) {
+			GMAMEUI_DEBUG ("Deep verify of %s - %s has SHA1 %s, expected %s",
+				       romname, rom->name, sha1, rom->sha1);
+			result->bad_roms = g_list_append (result->bad_roms, g_strdup (rom->name));
+		} else if (container == parent) {
+			result->parent_roms = g_list_append (result->parent_roms, g_strdup (rom->name));
+		}
+	}
+
+	result->complete = (roms == NULL);
+
+	g_hash_table_destroy (hashed);
+	if (parent)
+		gmameui_archive_unref (parent);
+	gmameui_archive_unref (archive);
+
+	return TRUE;
+}
+
+/* Records a romset as verified, so it isn't read again if the run is
+   interrupted. Only called from the main thread */
+void
+gmameui_rom_verifier_mark_done (GmameuiRomVerifier *verifier,
+				const gchar *romname,
+				RomVerifyResult *result)
+{
+	gchar *key;
+	FILE *f;
+
+	g_return_if_fail (verifier != NULL);
+	g_return_if_fail (romname != NULL);
+	g_return_if_fail (result != NULL);
+
+	if (result->resumed)
+		return;
+
+	key = get_state_key (result->mtime, result->size);
+
+	f = g_fopen (verifier->statefile, "a");
+	if (f) {
+		fprintf (f, "%s %s\n", romname, key);
+		fclose (f);
+	} else {
+		GMAMEUI_DEBUG ("Could not write to deep verify state %s", verifier->statefile);
+	}
+
+	g_free (key);
+}
+
+/* Every romset has been verified - the next run starts from the beginning */
+void
+gmameui_rom_verifier_finish (GmameuiRomVerifier *verifier)
+{
+	g_return_if_fail (verifier != NULL);
+
+	g_unlink (verifier->statefile);
+	g_hash_table_remove_all (verifier->done);
+}
+
+void
+gmameui_rom_verifier_cancel (GmameuiRomVerifier *verifier)
+{
+	g_return_if_fail (verifier != NULL);
+
+	g_atomic_int_set (&verifier->cancelled, TRUE);
+}
+
+void
+gmameui_rom_verify_result_clear (RomVerifyResult *result)
+{
+	g_return_if_fail (result != NULL);
+
+	g_list_foreach (result->bad_roms, (GFunc) g_free, NULL);
+	g_list_free (result->bad_roms);
+	result->bad_roms = NULL;
+
+	g_list_foreach (result->parent_roms, (GFunc) g_free, NULL);
+	g_list_free (result->parent_roms);
+	result->parent_roms = NULL;
+}
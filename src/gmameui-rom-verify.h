@@ -0,0 +1,75 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_ROM_VERIFY_H__
+#define __GMAMEUI_ROM_VERIFY_H__
+
+#include "common.h"
+#include "rom_entry.h"
+
+G_BEGIN_DECLS
+
+/* Result of deep verifying a single romset */
+typedef struct {
+	gint64 mtime;		/* Of the romset when it was verified */
+	gint64 size;
+	guint64 bytes;		/* Uncompressed bytes hashed */
+	GList *bad_roms;	/* Names of the ROMs whose data doesn't match -listxml */
+	GList *parent_roms;	/* Names of the ROMs only in the parent's romset,
+				   which were verified there */
+	gboolean resumed;	/* Already verified by an earlier, interrupted run */
+	gboolean complete;	/* Every ROM was read - FALSE if cancelled or unreadable */
+} RomVerifyResult;
+
+/* Decompresses every ROM in a romset and compares its SHA1 against the
+   -listxml SHA1. Romsets can be verified from several threads at once; the
+   romsets verified are recorded so that an interrupted run can carry on
+   where it stopped */
+typedef struct _GmameuiRomVerifier GmameuiRomVerifier;
+
+GmameuiRomVerifier *
+gmameui_rom_verifier_new (guint max_kb_per_sec);
+
+void
+gmameui_rom_verifier_free (GmameuiRomVerifier *verifier);
+
+gboolean
+gmameui_rom_verifier_verify_romset (GmameuiRomVerifier *verifier,
+				    MameRomEntry *romset,
+				    const gchar *path,
+				    RomVerifyResult *result);
+
+void
+gmameui_rom_verifier_mark_done (GmameuiRomVerifier *verifier,
+				const gchar *romname,
+				RomVerifyResult *result);
+
+void
+gmameui_rom_verifier_finish (GmameuiRomVerifier *verifier);
+
+void
+gmameui_rom_verifier_cancel (GmameuiRomVerifier *verifier);
+
+void
+gmameui_rom_verify_result_clear (RomVerifyResult *result);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_ROM_VERIFY_H__ */
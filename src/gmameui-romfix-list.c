@@ -19,20 +19,36 @@
  */
 
 #include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
 #include "gmameui-romfix-list.h"
+#include "gmameui-romfix-model.h"	/* For the ROMFIX_STATUS values */
 #include "gmameui-marshaller.h"
+#include "gmameui-zip-cache.h"
+#include "gmameui-zip-writer.h"
+#include "rom_entry.h"
+#include "game_list.h"
+#include "gmameui.h"	/* For gui_prefs */
 
 G_DEFINE_TYPE (GMAMEUIRomfixList, gmameui_romfix_list, G_TYPE_OBJECT)
 
 struct _GMAMEUIRomfixListPrivate
 {
 	GList *fixes;
+	gchar *journal;		/* Records the zips being rewritten by a run of fixes */
 };
 
 /* Signals enumeration */
 enum
 {
         ROMFIX_LIST_ADDED,               /* Item added to the list of romset fixes */
+        ROMFIX_LIST_CHANGED,             /* Item merged with more fixes for the romset */
+        ROMFIX_LIST_ZIP_FIXED,           /* Zip rewritten with its fixes */
         LAST_ROMFIX_LIST_SIGNAL
 };
 
@@ -40,78 +56,592 @@ enum
 static guint signals[LAST_ROMFIX_LIST_SIGNAL] = { 0 };
 
 
-void gmameui_romfix_list_add (GMAMEUIRomfixList *fixeslist, romset_fixes *romset_fixes)
+void
+gmameui_romfix_free (romfix *fix)
+{
+	GList *ptr;
+
+	g_return_if_fail (fix != NULL);
+
+	for (ptr = fix->sources; ptr; ptr = g_list_next (ptr)) {
+		romfix_source *source = (romfix_source *) ptr->data;
+
+		g_free (source->romset);
+		g_free (source->romname);
+		g_free (source);
+	}
+	g_list_free (fix->sources);
+
+	g_free (fix->romname);
+	g_free (fix->romset);
+	g_free (fix->container);
+	g_free (fix->region);
+	g_free (fix);
+}
+
+void
+gmameui_romset_fixes_free (romset_fixes *fixes)
+{
+	g_return_if_fail (fixes != NULL);
+
+	g_list_foreach (fixes->romfixes, (GFunc) gmameui_romfix_free, NULL);
+	g_list_free (fixes->romfixes);
+	g_free (fixes->romset_name);
+	g_free (fixes->romset_fullname);
+	g_free (fixes);
+}
+
+/* Removes every romset from the list, before a new scan */
+void
+gmameui_romfix_list_clear (GMAMEUIRomfixList *fixeslist)
+{
+	g_return_if_fail (fixeslist != NULL);
+
+	g_list_foreach (fixeslist->priv->fixes, (GFunc) gmameui_romset_fixes_free, NULL);
+	g_list_free (fixeslist->priv->fixes);
+	fixeslist->priv->fixes = NULL;
+}
+
+static romset_fixes *
+find_romset_fixes (GMAMEUIRomfixList *fixeslist, const gchar *romset_name)
+{
+	GList *ptr;
+
+	for (ptr = fixeslist->priv->fixes; ptr; ptr = g_list_next (ptr)) {
+		romset_fixes *fixes = (romset_fixes *) ptr->data;
+
+		if (g_ascii_strcasecmp (fixes->romset_name, romset_name) == 0)
+			return fixes;
+	}
+
+	return NULL;
+}
+
+/* Merges the later fixes into those already listed for the romset. The
+   later status of a ROM replaces the earlier one, e.g. a ROM found by the
+   scan that then fails a deep verify */
+static void
+merge_romset_fixes (romset_fixes *fixes, romset_fixes *later)
+{
+	GList *ptr, *old;
+
+	for (ptr = later->romfixes; ptr; ptr = g_list_next (ptr)) {
+		romfix *fix = (romfix *) ptr->data;
+
+		for (old = fixes->romfixes; old; old = g_list_next (old)) {
+			if (g_ascii_strcasecmp (((romfix *) old->data)->romname, fix->romname) == 0)
+				break;
+		}
+
+		if (old == NULL) {
+			fixes->romfixes = g_list_append (fixes->romfixes, fix);
+			continue;
+		}
+
+		/* Details the later fix doesn't have are kept */
+		if (fix->region == NULL)
+			fix->region = g_strdup (((romfix *) old->data)->region);
+		gmameui_romfix_free ((romfix *) old->data);
+		old->data = fix;
+	}
+
+	if (later->status == ROMFIX_STATUS_NOK)
+		fixes->status = ROMFIX_STATUS_NOK;
+
+	g_list_free (later->romfixes);
+	later->romfixes = NULL;
+	gmameui_romset_fixes_free (later);
+}
+
+/* Adds the fixes for a romset, which the list takes. If the romset already
+   has fixes listed they are merged, and romfix-list-changed is emitted
+   instead of romfix-list-added */
+void gmameui_romfix_list_add (GMAMEUIRomfixList *fixeslist, romset_fixes *fixes)
 {
-	g_return_if_fail (romset_fixes != NULL);
+	romset_fixes *existing;
+
+	g_return_if_fail (fixes != NULL);
 	
-	//GMAMEUI_DEBUG ("Added item %s to list", romset_fixes->romset_name);
+	existing = find_romset_fixes (fixeslist, fixes->romset_name);
+	if (existing) {
+		merge_romset_fixes (existing, fixes);
+		g_signal_emit (fixeslist, signals[ROMFIX_LIST_CHANGED],
+			       0, existing->romset_name, existing);
+		return;
+	}
+
+	//GMAMEUI_DEBUG ("Added item %s to list", fixes->romset_name);
 
-	fixeslist->priv->fixes = g_list_append (fixeslist->priv->fixes, romset_fixes);
+	fixeslist->priv->fixes = g_list_append (fixeslist->priv->fixes, fixes);
 
 	//GMAMEUI_DEBUG ("Emitting signal!");
 	g_signal_emit (fixeslist, signals[ROMFIX_LIST_ADDED],
-	               0, romset_fixes->romset_name, romset_fixes);
+	               0, fixes->romset_name, fixes);
 	//GMAMEUI_DEBUG ("Emitting signal done!");
 }
 
-static void
-process_romset_fixes (gpointer data, gpointer user_data)
+/* Returns the directory of the romset's zip, or NULL if the zip isn't in
+   the ROM paths */
+static ZipDirectory *
+get_romset_directory (gchar *romset_name)
 {
-	GList *list;
-	
-	romset_fixes *set_fixes = (romset_fixes *) data;
+	GFile *file;
+	gchar *filepath;
+	ZipDirectory *dir;
+
+	file = mame_rom_entry_get_disk_location (romset_name);
+	if (file == NULL)
+		return NULL;
+
+	filepath = g_file_get_parse_name (file);
+	dir = gmameui_zip_cache_lookup (filepath);
+
+	g_free (filepath);
+	g_object_unref (file);
+
+	return dir;
+}
+
+static const ZipCacheEntry *
+find_entry_by_crc (ZipDirectory *dir, guint32 crc, guint32 size)
+{
+	guint i;
+
+	for (i = 0; i < gmameui_zip_directory_get_num_entries (dir); i++) {
+		const ZipCacheEntry *entry = gmameui_zip_directory_get_nth_entry (dir, i);
+
+		if ((entry->crc == crc) && ((size == 0) || (entry->size == size)))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* Whether the romset expects a ROM with the name, either among its fixes
+   or in its ROMs from -listxml */
+static gboolean
+is_expected_rom_name (const gchar *romset_name, GList *romfixes, const gchar *name)
+{
+	MameRomEntry *romset;
+	GList *ptr;
+
+	for (ptr = romfixes; ptr; ptr = g_list_next (ptr)) {
+		romfix *aromfix = (romfix *) ptr->data;
+
+		if (g_ascii_strcasecmp (aromfix->romname, name) == 0)
+			return TRUE;
+	}
 
-	GMAMEUI_DEBUG ("  Processing fixes for %s", set_fixes->romset_name);
+	romset = gui_prefs.gl ? get_rom_from_gamelist_by_name (gui_prefs.gl, (gchar *) romset_name) : NULL;
+	for (ptr = romset ? mame_rom_entry_get_roms (romset) : NULL; ptr; ptr = g_list_next (ptr)) {
+		individual_rom *romref = (individual_rom *) ptr->data;
+
+		if (g_ascii_strcasecmp (romref->name, name) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Finds the file to rename to the ROM. Several files in the zip can share
+   a CRC, so one already under the ROM's name means nothing needs doing,
+   and otherwise a file that isn't expected under its own name is
+   preferred */
+static const ZipCacheEntry *
+find_rename_source (ZipDirectory *dir, const gchar *romset_name, GList *romfixes,
+		    romfix *aromfix)
+{
+	const ZipCacheEntry *found = NULL;
+	guint i;
+
+	for (i = 0; i < gmameui_zip_directory_get_num_entries (dir); i++) {
+		const ZipCacheEntry *entry = gmameui_zip_directory_get_nth_entry (dir, i);
+
+		if ((entry->crc != aromfix->crc) ||
+		    ((aromfix->size != 0) && (entry->size != aromfix->size)))
+			continue;
+
+		if (g_ascii_strcasecmp (entry->name, aromfix->romname) == 0)
+			return NULL;
+
+		if ((found == NULL) || !is_expected_rom_name (romset_name, romfixes, entry->name))
+			found = entry;
+	}
+
+	return found;
+}
 
-	list = g_list_first (set_fixes->romfixes);
+/* Adds the renamed and copied ROMs to the writer, which already holds
+   the romset's zip. Returns the number of ROMs fixed */
+static guint
+add_zip_fixes (ZipWriter *zw, ZipDirectory *dir, const gchar *romset_name, GList *romfixes)
+{
+	GList *list;
+	guint changes = 0;
 
-	while (list != NULL) {
+	for (list = romfixes; list != NULL; list = g_list_next (list)) {
 		romfix *aromfix = (romfix *) list->data;
+		ZipDirectory *src = NULL;
+		const ZipCacheEntry *entry = NULL;
 		
-		if (aromfix->status != 1) {
-			GMAMEUI_DEBUG ("    Fixing %s", aromfix->romname);
-
-			/* Fix any renaming */
-			if (aromfix->status == 2) {
-				GFile *file;
-				gchar *filepath;
-
-				/* FIXME TODO The following info should be held in the romset info GObject */
-				file = mame_rom_entry_get_disk_location (set_fixes->romset_name);
-				filepath = g_file_get_parse_name (file);
-
-#ifdef MAKE_FIXES			
-				rename_rom_in_zip_file (filepath, aromfix->romname, aromfix->container);
-#else
-				GMAMEUI_DEBUG ("      Renaming rom from %s to %s", aromfix->romname, aromfix->container);
-#endif
+		if (aromfix->status == ROMFIX_STATUS_RENAME) {
+			/* Rename - the ROM is in the zip under another name. The
+			   file is copied, and only removed if no other ROM in the
+			   romset is expected under its name */
+			entry = find_rename_source (dir, romset_name, romfixes, aromfix);
+			if (entry == NULL)
+				continue;
+
+			src = gmameui_zip_directory_ref (dir);
+			if (!is_expected_rom_name (romset_name, romfixes, entry->name))
+				gmameui_zip_writer_remove (zw, entry->name);
+		} else if ((aromfix->status == ROMFIX_STATUS_COPY) ||
+			   ((aromfix->status == ROMFIX_STATUS_INPARENT) && (aromfix->container != NULL))) {
+			/* Copy - from another romset, or from the parent if the ROM
+			   isn't shared with it */
+			const gchar *name = aromfix->romname;
+
+			if ((aromfix->status == ROMFIX_STATUS_COPY) && (aromfix->sources != NULL))
+				name = ((romfix_source *) aromfix->sources->data)->romname;
+
+			src = get_romset_directory (aromfix->container);
+			if (src) {
+				entry = gmameui_zip_directory_find (src, name);
+				if ((entry == NULL) || (entry->crc != aromfix->crc))
+					entry = find_entry_by_crc (src, aromfix->crc, aromfix->size);
 			}
+		}
 
-			if (aromfix->status == 5) {
-#ifdef MAKE_FIXES
-#else
-				GMAMEUI_DEBUG ("      Copying rom %s from romset %s", aromfix->romname, aromfix->container);
-#endif
+		if (src) {
+			if (entry && (entry->crc == aromfix->crc) &&
+			    gmameui_zip_writer_add (zw, src, entry, aromfix->romname)) {
+				GMAMEUI_DEBUG ("    Fixing %s from %s", aromfix->romname,
+					       gmameui_zip_directory_get_filename (src));
+				changes++;
+			} else {
+				GMAMEUI_DEBUG ("    Could not fix %s", aromfix->romname);
 			}
-			
+
+			gmameui_zip_directory_unref (src);
 		}
+	}
+
+	return changes;
+}
+
+/* The journal records each zip as it is rewritten, so that a run which is
+   interrupted can be rolled back or kept the next time the ROM manager is
+   opened. Each line is "zip <path>" before the zip is rewritten, with the
+   original kept as <path>.bak until the whole run has finished. Zips that
+   are created or removed are recorded as "new <path>" and "del <path>" */
+static const gchar *journal_prefixes[] = { "zip ", "new ", "del " };
+
+static GStaticMutex journal_mutex = G_STATIC_MUTEX_INIT;
+
+static void
+journal_append (GMAMEUIRomfixList *fixeslist, const gchar *line)
+{
+	FILE *f;
 
-		/* Get the next rom fix in the romset */
-		list = g_list_next (list);
+	g_static_mutex_lock (&journal_mutex);
+
+	f = g_fopen (fixeslist->priv->journal, "a");
+	if (f == NULL) {
+		GMAMEUI_DEBUG ("Could not write to ROM manager journal %s", fixeslist->priv->journal);
+		g_static_mutex_unlock (&journal_mutex);
+		return;
 	}
+
+	fprintf (f, "%s\n", line);
+	fflush (f);
+	fsync (fileno (f));
+	fclose (f);
+
+	g_static_mutex_unlock (&journal_mutex);
+}
+
+/* Returns the zips recorded in the journal with the action, or NULL if
+   there isn't a journal */
+static gchar **
+journal_read_zips (GMAMEUIRomfixList *fixeslist, RomfixJournalAction action)
+{
+	gchar *contents;
+	gchar **lines;
+	GPtrArray *zips;
+	guint i;
+
+	if (!g_file_get_contents (fixeslist->priv->journal, &contents, NULL, NULL))
+		return NULL;
+
+	zips = g_ptr_array_new ();
+	lines = g_strsplit (contents, "\n", -1);
+	for (i = 0; lines[i] != NULL; i++) {
+		if (g_str_has_prefix (lines[i], journal_prefixes[action]))
+			g_ptr_array_add (zips, g_strdup (lines[i] + strlen (journal_prefixes[action])));
+	}
+	g_ptr_array_add (zips, NULL);
+
+	g_strfreev (lines);
+	g_free (contents);
+
+	return (gchar **) g_ptr_array_free (zips, FALSE);
 }
 
+/* Records a change to a zip before it is made. May be called from any
+   thread */
+void
+gmameui_romfix_list_journal_zip (GMAMEUIRomfixList *fixeslist,
+				 RomfixJournalAction action,
+				 const gchar *zipfile)
+{
+	gchar *line;
+
+	g_return_if_fail (fixeslist != NULL);
+	g_return_if_fail (zipfile != NULL);
+
+	line = g_strconcat (journal_prefixes[action], zipfile, NULL);
+	journal_append (fixeslist, line);
+	g_free (line);
+}
+
+/* Removes the backups and the journal once every zip has been rewritten */
+void
+gmameui_romfix_list_journal_finish (GMAMEUIRomfixList *fixeslist)
+{
+	gchar **zips;
+	guint i;
+
+	g_return_if_fail (fixeslist != NULL);
+
+	zips = journal_read_zips (fixeslist, ROMFIX_JOURNAL_REWRITE);
+	for (i = 0; zips && zips[i]; i++) {
+		gchar *backup = g_strdup_printf ("%s.bak", zips[i]);
+
+		g_unlink (backup);
+		g_free (backup);
+	}
+	g_strfreev (zips);
+
+	zips = journal_read_zips (fixeslist, ROMFIX_JOURNAL_REMOVE);
+	for (i = 0; zips && zips[i]; i++) {
+		gchar *backup = g_strdup_printf ("%s.bak", zips[i]);
+
+		g_unlink (backup);
+		g_free (backup);
+	}
+	g_strfreev (zips);
+
+	g_unlink (fixeslist->priv->journal);
+}
+
+gboolean
+gmameui_romfix_list_is_interrupted (GMAMEUIRomfixList *fixeslist)
+{
+	g_return_val_if_fail (fixeslist != NULL, FALSE);
+
+	return g_file_test (fixeslist->priv->journal, G_FILE_TEST_EXISTS);
+}
+
+/**
+ * gmameui_romfix_list_recover:
+ * @fixeslist: the fix list
+ * @rollback: TRUE to restore the zips rewritten by the interrupted run,
+ * FALSE to keep them
+ *
+ * Cleans up after a run of fixes that was interrupted. Zips that weren't
+ * reached are untouched either way, and will be listed again by the next
+ * scan.
+ */
+void
+gmameui_romfix_list_recover (GMAMEUIRomfixList *fixeslist, gboolean rollback)
+{
+	gchar **zips;
+	guint i;
+
+	g_return_if_fail (fixeslist != NULL);
+
+	zips = journal_read_zips (fixeslist, ROMFIX_JOURNAL_REWRITE);
+	for (i = 0; zips && zips[i]; i++) {
+		gchar *backup, *tmpname;
+
+		backup = g_strdup_printf ("%s.bak", zips[i]);
+		tmpname = g_strdup_printf ("%s.tmp", zips[i]);
+
+		g_unlink (tmpname);
+
+		/* The original is also restored if the run stopped between
+		   moving it to the backup and renaming the new zip */
+		if (g_file_test (backup, G_FILE_TEST_EXISTS)) {
+			if (rollback || !g_file_test (zips[i], G_FILE_TEST_EXISTS)) {
+				GMAMEUI_DEBUG ("Restoring %s from %s", zips[i], backup);
+				g_rename (backup, zips[i]);
+			} else {
+				g_unlink (backup);
+			}
+		}
+		gmameui_zip_cache_invalidate (zips[i]);
+
+		g_free (backup);
+		g_free (tmpname);
+	}
+	g_strfreev (zips);
+
+	/* Created zips are only removed when rolling back */
+	zips = journal_read_zips (fixeslist, ROMFIX_JOURNAL_CREATE);
+	for (i = 0; zips && zips[i]; i++) {
+		gchar *tmpname;
+
+		tmpname = g_strdup_printf ("%s.tmp", zips[i]);
+		g_unlink (tmpname);
+		if (rollback)
+			g_unlink (zips[i]);
+		gmameui_zip_cache_invalidate (zips[i]);
+
+		g_free (tmpname);
+	}
+	g_strfreev (zips);
+
+	zips = journal_read_zips (fixeslist, ROMFIX_JOURNAL_REMOVE);
+	for (i = 0; zips && zips[i]; i++) {
+		gchar *backup;
+
+		backup = g_strdup_printf ("%s.bak", zips[i]);
+		if (rollback && !g_file_test (zips[i], G_FILE_TEST_EXISTS)) {
+			GMAMEUI_DEBUG ("Restoring %s from %s", zips[i], backup);
+			g_rename (backup, zips[i]);
+		} else {
+			g_unlink (backup);
+		}
+		gmameui_zip_cache_invalidate (zips[i]);
+
+		g_free (backup);
+	}
+	g_strfreev (zips);
+
+	g_unlink (fixeslist->priv->journal);
+}
+
+/* Rebuilds the romset's zip with all its renamed and copied ROMs in a single
+   rewrite. The ROMs are copied still compressed from the source zips, and
+   the zip is only replaced once the new one has been written and checked */
+static gboolean
+process_zip_fixes (GMAMEUIRomfixList *fixeslist, gchar *romset_name, GList *romfixes,
+		   romfix_zip_result *result)
+{
+	ZipDirectory *dir;
+	ZipWriter *zw;
+	GTimer *timer;
+	guint i, changes;
+
+	GMAMEUI_DEBUG ("  Processing fixes for %s", romset_name);
+
+	dir = get_romset_directory (romset_name);
+	if (dir == NULL) {
+		GMAMEUI_DEBUG ("    Zip for %s could not be read", romset_name);
+		return FALSE;
+	}
+
+	timer = g_timer_new ();
+
+	/* Start with the current contents of the zip */
+	zw = gmameui_zip_writer_new (gmameui_zip_directory_get_filename (dir));
+	for (i = 0; i < gmameui_zip_directory_get_num_entries (dir); i++)
+		gmameui_zip_writer_add (zw, dir, gmameui_zip_directory_get_nth_entry (dir, i), NULL);
+
+	changes = add_zip_fixes (zw, dir, romset_name, romfixes);
+
+	result->ok = TRUE;
+	if (changes > 0) {
+		gchar *backup;
+
+		gmameui_romfix_list_journal_zip (fixeslist, ROMFIX_JOURNAL_REWRITE,
+						 gmameui_zip_directory_get_filename (dir));
+
+		backup = g_strdup_printf ("%s.bak", gmameui_zip_directory_get_filename (dir));
+		result->ok = gmameui_zip_writer_commit (zw, backup);
+		result->bytes = gmameui_zip_writer_get_bytes_written (zw);
+		g_free (backup);
+	}
+	result->seconds = g_timer_elapsed (timer, NULL);
+
+	g_timer_destroy (timer);
+	gmameui_zip_writer_free (zw);
+	gmameui_zip_directory_unref (dir);
+
+	return (changes > 0);
+}
+
+/**
+ * gmameui_romfix_list_process_fixes:
+ * @fixeslist: the fix list
+ *
+ * Applies the fixes. Fixes for the same romset are grouped, so that each
+ * zip is rewritten once however many of its ROMs need fixing. The
+ * "romfix-zip-fixed" signal is emitted as each zip is written.
+ */
 void
 gmameui_romfix_list_process_fixes (GMAMEUIRomfixList *fixeslist)
 {
+	GHashTable *groups;	/* Romset name -> GList of romfix */
+	GList *order = NULL;	/* Romset names in the order first listed */
+	GList *ptr;
+	guint index, total;
+
 	g_return_if_fail (fixeslist != NULL);
 
-	g_list_foreach (fixeslist->priv->fixes, (GFunc) process_romset_fixes, NULL);
+	/* Don't start over the top of a run that hasn't been recovered */
+	g_return_if_fail (!gmameui_romfix_list_is_interrupted (fixeslist));
+
+	groups = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (ptr = fixeslist->priv->fixes; ptr; ptr = g_list_next (ptr)) {
+		romset_fixes *set_fixes = (romset_fixes *) ptr->data;
+		GList *romfixes;
+
+		if (!g_hash_table_lookup_extended (groups, set_fixes->romset_name, NULL, (gpointer *) &romfixes)) {
+			romfixes = NULL;
+			order = g_list_prepend (order, set_fixes->romset_name);
+		}
+
+		romfixes = g_list_concat (romfixes, g_list_copy (set_fixes->romfixes));
+		g_hash_table_insert (groups, set_fixes->romset_name, romfixes);
+	}
+	order = g_list_reverse (order);
+
+	index = 0;
+	total = g_list_length (order);
+
+	for (ptr = order; ptr; ptr = g_list_next (ptr)) {
+		romfix_zip_result result;
+		GList *romfixes;
+
+		romfixes = g_hash_table_lookup (groups, ptr->data);
+
+		memset (&result, 0, sizeof (result));
+		result.romset_name = (gchar *) ptr->data;
+		result.index = ++index;
+		result.total = total;
+
+		if (process_zip_fixes (fixeslist, (gchar *) ptr->data, romfixes, &result))
+			g_signal_emit (fixeslist, signals[ROMFIX_LIST_ZIP_FIXED],
+				       0, result.romset_name, &result);
+
+		g_list_free (romfixes);
+	}
+
+	gmameui_romfix_list_journal_finish (fixeslist);
+
+	g_list_free (order);
+	g_hash_table_destroy (groups);
 }
 
 static void
 gmameui_romfix_list_finalize (GObject *object)
 {
+  GMAMEUIRomfixList *self = GMAMEUI_ROMFIX_LIST (object);
+
+  g_free (self->priv->journal);
+
   G_OBJECT_CLASS (gmameui_romfix_list_parent_class)->finalize (object);
 }
 
@@ -134,6 +664,26 @@ gmameui_romfix_list_class_init (GMAMEUIRomfixListClass *klass)
                                                 2, G_TYPE_STRING, G_TYPE_POINTER        /* Two parameters */
                                                 );
 
+	signals[ROMFIX_LIST_CHANGED] = g_signal_new ("romfix-list-changed",
+                                                G_TYPE_FROM_CLASS(klass),
+                                                G_SIGNAL_RUN_FIRST,
+                                                0,              /* This signal is not handled by the class */
+                                                NULL, NULL,     /* Accumulator and accumulator data */
+                                                gmameui_marshaller_VOID__STRING_POINTER,
+                                                G_TYPE_NONE,    /* Return type */
+                                                2, G_TYPE_STRING, G_TYPE_POINTER        /* Two parameters */
+                                                );
+
+	signals[ROMFIX_LIST_ZIP_FIXED] = g_signal_new ("romfix-zip-fixed",
+                                                G_TYPE_FROM_CLASS(klass),
+                                                G_SIGNAL_RUN_FIRST,
+                                                0,              /* This signal is not handled by the class */
+                                                NULL, NULL,     /* Accumulator and accumulator data */
+                                                gmameui_marshaller_VOID__STRING_POINTER,
+                                                G_TYPE_NONE,    /* Return type */
+                                                2, G_TYPE_STRING, G_TYPE_POINTER        /* Two parameters */
+                                                );
+
 }
 
 static void
@@ -142,6 +692,8 @@ gmameui_romfix_list_init (GMAMEUIRomfixList *self)
 	self->priv = g_new0 (GMAMEUIRomfixListPrivate, 1);
 	
 	self->priv->fixes = NULL;
+	self->priv->journal = g_build_filename (g_get_user_config_dir (), "gmameui",
+						"rommgr.journal", NULL);
 }
 
 GMAMEUIRomfixList*
@@ -63,6 +63,12 @@ typedef struct {
   GObjectClass parent_class;
 } GMAMEUIRomfixListClass;
 
+/* A romset containing a copy of a missing ROM */
+typedef struct {
+	gchar *romset;
+	gchar *romname;		/* Name of the ROM within that romset */
+} romfix_source;
+
 typedef struct {
 	gchar *romname;
 	gchar *romset;		/* Name of the romset that this relates to */
@@ -70,6 +76,9 @@ typedef struct {
 						/* AAA FIXME TODO Also need to use this (or another variable) as the target romname for renaming */
 	gchar *region;
 	gint status;
+	guint32 crc;		/* Expected CRC and size of the ROM */
+	guint32 size;
+	GList *sources;		/* romfix_source structs for every romset containing a missing ROM */
 } romfix;
 
 /* Struct representing the possible fixes for a romset */
@@ -80,12 +89,37 @@ typedef struct {
 	GList *romfixes;        /* GList of romfix structs */
 } romset_fixes;
 
+/* Emitted with the romfix-zip-fixed signal once a zip has been rewritten */
+typedef struct {
+	gchar *romset_name;
+	guint index;		/* Position of the zip in the run, from 1 */
+	guint total;		/* Number of zips in the run */
+	guint64 bytes;		/* Size of the rewritten zip */
+	gdouble seconds;
+	gboolean ok;
+} romfix_zip_result;
+
+/* How a zip is changed by a run of fixes, as recorded in the journal */
+typedef enum {
+	ROMFIX_JOURNAL_REWRITE,		/* Replaced, with the original kept as <zip>.bak */
+	ROMFIX_JOURNAL_CREATE,		/* Written where there was no zip */
+	ROMFIX_JOURNAL_REMOVE		/* Moved to <zip>.bak */
+} RomfixJournalAction;
+
 GType gmameui_romfix_list_get_type (void);
 
 GMAMEUIRomfixList* gmameui_romfix_list_new (void);
 
+void gmameui_romfix_free (romfix *fix);
+void gmameui_romset_fixes_free (romset_fixes *fixes);
+
 void gmameui_romfix_list_add (GMAMEUIRomfixList *, romset_fixes *);
+void gmameui_romfix_list_clear (GMAMEUIRomfixList *fixeslist);
 void gmameui_romfix_list_process_fixes (GMAMEUIRomfixList *fixeslist);
+gboolean gmameui_romfix_list_is_interrupted (GMAMEUIRomfixList *fixeslist);
+void gmameui_romfix_list_recover (GMAMEUIRomfixList *fixeslist, gboolean rollback);
+void gmameui_romfix_list_journal_zip (GMAMEUIRomfixList *fixeslist, RomfixJournalAction action, const gchar *zipfile);
+void gmameui_romfix_list_journal_finish (GMAMEUIRomfixList *fixeslist);
 
 G_END_DECLS
 
@@ -0,0 +1,672 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include "gmameui-romfix-model.h"
+
+/* A romset in the model. Iters for a romset point to the row with
+   user_data2 set to 0; iters for a ROM point to its romset's row with
+   user_data2 set to the position of the ROM in children, plus one */
+typedef struct {
+	romset_fixes *fixes;
+	guint child_mask;	/* Statuses of all the ROMs in the romset */
+	gint pos;		/* Position among the visible romsets, or -1 if hidden */
+	GPtrArray *children;	/* romfix structs shown by the filter, or NULL
+				   until the romset is expanded */
+	gint status;		/* Romset status and ROM statuses in the counts, */
+	guint rom_counts[NUM_ROMFIX_STATUSES];	/* so they can be taken out again */
+} romfix_row;
+
+struct _GMAMEUIRomfixModelPrivate {
+	GPtrArray *rows;	/* Every romset, in the order they were added */
+	GPtrArray *visible;	/* Romsets shown by the filter */
+	GHashTable *row_of_fixes;	/* romset_fixes -> romfix_row */
+	guint mask;		/* ROMFIX_STATUS_MASK of the statuses shown */
+	gint stamp;
+
+	guint romset_counts[NUM_ROMFIX_STATUSES];
+	guint rom_counts[NUM_ROMFIX_STATUSES];
+};
+
+static void gmameui_romfix_model_tree_model_init (GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (GMAMEUIRomfixModel, gmameui_romfix_model, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+						gmameui_romfix_model_tree_model_init))
+
+static guint
+status_mask (gint status)
+{
+	if ((status < 0) || (status >= NUM_ROMFIX_STATUSES))
+		return 0;
+
+	return ROMFIX_STATUS_MASK (status);
+}
+
+/* A romset is shown if its own status or that of any of its ROMs is */
+static gboolean
+row_is_visible (GMAMEUIRomfixModel *model, romfix_row *row)
+{
+	return ((status_mask (row->fixes->status) | row->child_mask) & model->priv->mask) != 0;
+}
+
+static GPtrArray *
+row_get_children (GMAMEUIRomfixModel *model, romfix_row *row)
+{
+	GList *ptr;
+
+	if (row->children)
+		return row->children;
+
+	row->children = g_ptr_array_new ();
+	for (ptr = row->fixes->romfixes; ptr; ptr = g_list_next (ptr)) {
+		romfix *fix = (romfix *) ptr->data;
+
+		if (status_mask (fix->status) & model->priv->mask)
+			g_ptr_array_add (row->children, fix);
+	}
+
+	return row->children;
+}
+
+static void
+row_clear_children (romfix_row *row)
+{
+	if (row->children) {
+		g_ptr_array_free (row->children, TRUE);
+		row->children = NULL;
+	}
+}
+
+/* Updates the counts and child mask from the romset's fixes, replacing what
+   was counted for the row before */
+static void
+row_count (GMAMEUIRomfixModel *model, romfix_row *row)
+{
+	GMAMEUIRomfixModelPrivate *priv = model->priv;
+	GList *ptr;
+	guint i;
+
+	if (status_mask (row->status))
+		priv->romset_counts[row->status]--;
+	for (i = 0; i < NUM_ROMFIX_STATUSES; i++) {
+		priv->rom_counts[i] -= row->rom_counts[i];
+		row->rom_counts[i] = 0;
+	}
+
+	row->child_mask = 0;
+	for (ptr = row->fixes->romfixes; ptr; ptr = g_list_next (ptr)) {
+		romfix *fix = (romfix *) ptr->data;
+
+		row->child_mask |= status_mask (fix->status);
+		if (status_mask (fix->status))
+			row->rom_counts[fix->status]++;
+	}
+
+	row->status = row->fixes->status;
+	if (status_mask (row->status))
+		priv->romset_counts[row->status]++;
+	for (i = 0; i < NUM_ROMFIX_STATUSES; i++)
+		priv->rom_counts[i] += row->rom_counts[i];
+}
+
+static gboolean
+set_iter (GMAMEUIRomfixModel *model, GtkTreeIter *iter, romfix_row *row, guint child)
+{
+	iter->stamp = model->priv->stamp;
+	iter->user_data = row;
+	iter->user_data2 = GUINT_TO_POINTER (child);
+	iter->user_data3 = NULL;
+
+	return TRUE;
+}
+
+static gchar *
+get_romfix_status (romfix *fix)
+{
+	switch (fix->status) {
+		case ROMFIX_STATUS_NOK:
+			return g_strdup (_("Incorrect"));
+		case ROMFIX_STATUS_OK:
+			return g_strdup (_("OK"));
+		case ROMFIX_STATUS_RENAME:
+			return g_strdup (_("should be renamed to"));
+		case ROMFIX_STATUS_INPARENT:
+			return g_strdup_printf (_("available in parent %s"), fix->container);
+		case ROMFIX_STATUS_DUPEPARENT:
+			return g_strdup_printf (_("duplicated in parent %s"), fix->container);
+		case ROMFIX_STATUS_COPY:
+			return g_strdup_printf (_("available in romset %s"), fix->container);
+		case ROMFIX_STATUS_BIOS:
+			return g_strdup (_("contained in a BIOS"));
+		default:
+			return g_strdup ("");
+	}
+}
+
+/* GtkTreeModel implementation */
+static GtkTreeModelFlags
+romfix_model_get_flags (GtkTreeModel *tree_model)
+{
+	return 0;
+}
+
+static gint
+romfix_model_get_n_columns (GtkTreeModel *tree_model)
+{
+	return NUM_ROMFIX_MODEL_COLUMNS;
+}
+
+static GType
+romfix_model_get_column_type (GtkTreeModel *tree_model, gint index)
+{
+	g_return_val_if_fail ((index >= 0) && (index < NUM_ROMFIX_MODEL_COLUMNS), G_TYPE_INVALID);
+
+	return (index == ROMFIX_MODEL_COL_STATUS) ? G_TYPE_INT : G_TYPE_STRING;
+}
+
+static gboolean
+romfix_model_get_iter (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path)
+{
+	GMAMEUIRomfixModel *model = GMAMEUI_ROMFIX_MODEL (tree_model);
+	romfix_row *row;
+	GPtrArray *children;
+	gint *indices;
+	gint depth;
+
+	depth = gtk_tree_path_get_depth (path);
+	indices = gtk_tree_path_get_indices (path);
+
+	if ((depth < 1) || (depth > 2))
+		return FALSE;
+
+	if ((indices[0] < 0) || (indices[0] >= (gint) model->priv->visible->len))
+		return FALSE;
+
+	row = g_ptr_array_index (model->priv->visible, indices[0]);
+	if (depth == 1)
+		return set_iter (model, iter, row, 0);
+
+	children = row_get_children (model, row);
+	if ((indices[1] < 0) || (indices[1] >= (gint) children->len))
+		return FALSE;
+
+	return set_iter (model, iter, row, indices[1] + 1);
+}
+
+static GtkTreePath *
+romfix_model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	GMAMEUIRomfixModel *model = GMAMEUI_ROMFIX_MODEL (tree_model);
+	romfix_row *row;
+	GtkTreePath *path;
+	guint child;
+
+	g_return_val_if_fail (iter->stamp == model->priv->stamp, NULL);
+
+	row = (romfix_row *) iter->user_data;
+	child = GPOINTER_TO_UINT (iter->user_data2);
+
+	path = gtk_tree_path_new ();
+	gtk_tree_path_append_index (path, row->pos);
+	if (child > 0)
+		gtk_tree_path_append_index (path, child - 1);
+
+	return path;
+}
+
+static void
+romfix_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value)
+{
+	GMAMEUIRomfixModel *model = GMAMEUI_ROMFIX_MODEL (tree_model);
+	romfix_row *row;
+	romfix *fix;
+	guint child;
+
+	g_return_if_fail (iter->stamp == model->priv->stamp);
+	g_return_if_fail ((column >= 0) && (column < NUM_ROMFIX_MODEL_COLUMNS));
+
+	g_value_init (value, romfix_model_get_column_type (tree_model, column));
+
+	row = (romfix_row *) iter->user_data;
+	child = GPOINTER_TO_UINT (iter->user_data2);
+
+	/* Romset row */
+	if (child == 0) {
+		switch (column) {
+			case ROMFIX_MODEL_COL_NAME:
+				g_value_take_string (value, g_strdup_printf ("%s (%s)",
+									     row->fixes->romset_fullname,
+									     row->fixes->romset_name));
+				break;
+			case ROMFIX_MODEL_COL_REGION:
+			case ROMFIX_MODEL_COL_STATUSTXT:
+				g_value_set_static_string (value, "");
+				break;
+			case ROMFIX_MODEL_COL_STATUS:
+				g_value_set_int (value, row->fixes->status);
+				break;
+		}
+		return;
+	}
+
+	/* ROM row */
+	fix = g_ptr_array_index (row->children, child - 1);
+	switch (column) {
+		case ROMFIX_MODEL_COL_NAME:
+			g_value_set_string (value, fix->romname);
+			break;
+		case ROMFIX_MODEL_COL_REGION:
+			g_value_set_string (value, fix->region);
+			break;
+		case ROMFIX_MODEL_COL_STATUSTXT:
+			g_value_take_string (value, get_romfix_status (fix));
+			break;
+		case ROMFIX_MODEL_COL_STATUS:
+			g_value_set_int (value, fix->status);
+			break;
+	}
+}
+
+static gboolean
+romfix_model_iter_next (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	GMAMEUIRomfixModel *model = GMAMEUI_ROMFIX_MODEL (tree_model);
+	romfix_row *row;
+	guint child;
+
+	g_return_val_if_fail (iter->stamp == model->priv->stamp, FALSE);
+
+	row = (romfix_row *) iter->user_data;
+	child = GPOINTER_TO_UINT (iter->user_data2);
+
+	if (child == 0) {
+		if (row->pos + 1 >= (gint) model->priv->visible->len)
+			return FALSE;
+
+		return set_iter (model, iter, g_ptr_array_index (model->priv->visible, row->pos + 1), 0);
+	}
+
+	if (child >= row->children->len)
+		return FALSE;
+
+	return set_iter (model, iter, row, child + 1);
+}
+
+static gboolean
+romfix_model_iter_nth_child (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+	GMAMEUIRomfixModel *model = GMAMEUI_ROMFIX_MODEL (tree_model);
+	romfix_row *row;
+	GPtrArray *children;
+
+	if (n < 0)
+		return FALSE;
+
+	if (parent == NULL) {
+		if (n >= (gint) model->priv->visible->len)
+			return FALSE;
+
+		return set_iter (model, iter, g_ptr_array_index (model->priv->visible, n), 0);
+	}
+
+	g_return_val_if_fail (parent->stamp == model->priv->stamp, FALSE);
+
+	/* ROMs have no children */
+	if (GPOINTER_TO_UINT (parent->user_data2) > 0)
+		return FALSE;
+
+	row = (romfix_row *) parent->user_data;
+	children = row_get_children (model, row);
+	if (n >= (gint) children->len)
+		return FALSE;
+
+	return set_iter (model, iter, row, n + 1);
+}
+
+static gboolean
+romfix_model_iter_children (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+	return romfix_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+/* Answered from the statuses of the ROMs, so collapsed romsets never
+   need their children built */
+static gboolean
+romfix_model_iter_has_child (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	GMAMEUIRomfixModel *model = GMAMEUI_ROMFIX_MODEL (tree_model);
+	romfix_row *row;
+
+	g_return_val_if_fail (iter->stamp == model->priv->stamp, FALSE);
+
+	if (GPOINTER_TO_UINT (iter->user_data2) > 0)
+		return FALSE;
+
+	row = (romfix_row *) iter->user_data;
+
+	return (row->child_mask & model->priv->mask) != 0;
+}
+
+static gint
+romfix_model_iter_n_children (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	GMAMEUIRomfixModel *model = GMAMEUI_ROMFIX_MODEL (tree_model);
+
+	if (iter == NULL)
+		return model->priv->visible->len;
+
+	g_return_val_if_fail (iter->stamp == model->priv->stamp, 0);
+
+	if (GPOINTER_TO_UINT (iter->user_data2) > 0)
+		return 0;
+
+	return row_get_children (model, (romfix_row *) iter->user_data)->len;
+}
+
+static gboolean
+romfix_model_iter_parent (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+	GMAMEUIRomfixModel *model = GMAMEUI_ROMFIX_MODEL (tree_model);
+
+	g_return_val_if_fail (child->stamp == model->priv->stamp, FALSE);
+
+	if (GPOINTER_TO_UINT (child->user_data2) == 0)
+		return FALSE;
+
+	return set_iter (model, iter, (romfix_row *) child->user_data, 0);
+}
+
+static void
+gmameui_romfix_model_tree_model_init (GtkTreeModelIface *iface)
+{
+	iface->get_flags = romfix_model_get_flags;
+	iface->get_n_columns = romfix_model_get_n_columns;
+	iface->get_column_type = romfix_model_get_column_type;
+	iface->get_iter = romfix_model_get_iter;
+	iface->get_path = romfix_model_get_path;
+	iface->get_value = romfix_model_get_value;
+	iface->iter_next = romfix_model_iter_next;
+	iface->iter_children = romfix_model_iter_children;
+	iface->iter_has_child = romfix_model_iter_has_child;
+	iface->iter_n_children = romfix_model_iter_n_children;
+	iface->iter_nth_child = romfix_model_iter_nth_child;
+	iface->iter_parent = romfix_model_iter_parent;
+}
+
+/* Appends the romset to the visible rows and tells the view about it */
+static void
+show_row (GMAMEUIRomfixModel *model, romfix_row *row)
+{
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	row->pos = model->priv->visible->len;
+	g_ptr_array_add (model->priv->visible, row);
+
+	set_iter (model, &iter, row, 0);
+	path = gtk_tree_path_new_from_indices (row->pos, -1);
+	gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+	if (romfix_model_iter_has_child (GTK_TREE_MODEL (model), &iter))
+		gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model), path, &iter);
+	gtk_tree_path_free (path);
+}
+
+/* Removes the romset from the visible rows and tells the view about it */
+static void
+hide_row (GMAMEUIRomfixModel *model, romfix_row *row)
+{
+	GtkTreePath *path;
+	guint i;
+
+	path = gtk_tree_path_new_from_indices (row->pos, -1);
+
+	g_ptr_array_remove_index (model->priv->visible, row->pos);
+	for (i = row->pos; i < model->priv->visible->len; i++)
+		((romfix_row *) g_ptr_array_index (model->priv->visible, i))->pos = i;
+	row->pos = -1;
+	row_clear_children (row);
+
+	gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+	gtk_tree_path_free (path);
+}
+
+/* Removes the ROM rows of an expanded romset, from the end so the paths
+   of the other ROMs don't change */
+static void
+remove_children (GMAMEUIRomfixModel *model, romfix_row *row)
+{
+	if (row->children == NULL)
+		return;
+
+	while (row->children->len > 0) {
+		GtkTreePath *path;
+
+		g_ptr_array_remove_index (row->children, row->children->len - 1);
+
+		path = gtk_tree_path_new_from_indices (row->pos, row->children->len, -1);
+		gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+		gtk_tree_path_free (path);
+	}
+
+	row_clear_children (row);
+}
+
+void
+gmameui_romfix_model_add (GMAMEUIRomfixModel *model, romset_fixes *fixes)
+{
+	romfix_row *row;
+
+	g_return_if_fail (GMAMEUI_IS_ROMFIX_MODEL (model));
+	g_return_if_fail (fixes != NULL);
+
+	row = g_new0 (romfix_row, 1);
+	row->fixes = fixes;
+	row->pos = -1;
+	row->status = -1;
+
+	row_count (model, row);
+
+	g_ptr_array_add (model->priv->rows, row);
+	g_hash_table_insert (model->priv->row_of_fixes, fixes, row);
+
+	if (row_is_visible (model, row))
+		show_row (model, row);
+}
+
+/* Frees the ROM rows of a romset once the view has collapsed it, so only
+   the expanded romsets hold rows for their ROMs. They are built again if
+   the romset is expanded */
+void
+gmameui_romfix_model_collapse (GMAMEUIRomfixModel *model, GtkTreeIter *iter)
+{
+	g_return_if_fail (GMAMEUI_IS_ROMFIX_MODEL (model));
+	g_return_if_fail (iter != NULL);
+	g_return_if_fail (iter->stamp == model->priv->stamp);
+
+	if (GPOINTER_TO_UINT (iter->user_data2) > 0)
+		return;
+
+	row_clear_children ((romfix_row *) iter->user_data);
+}
+
+/* Called once more fixes have been merged into a romset already in the
+   model. Its ROM rows are rebuilt when the romset is next expanded */
+void
+gmameui_romfix_model_update (GMAMEUIRomfixModel *model, romset_fixes *fixes)
+{
+	romfix_row *row;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	gboolean was_visible;
+
+	g_return_if_fail (GMAMEUI_IS_ROMFIX_MODEL (model));
+	g_return_if_fail (fixes != NULL);
+
+	row = g_hash_table_lookup (model->priv->row_of_fixes, fixes);
+	if (row == NULL) {
+		gmameui_romfix_model_add (model, fixes);
+		return;
+	}
+
+	was_visible = (row->pos >= 0);
+	if (was_visible)
+		remove_children (model, row);
+
+	row_count (model, row);
+
+	if (!row_is_visible (model, row)) {
+		if (was_visible)
+			hide_row (model, row);
+		return;
+	}
+
+	if (!was_visible) {
+		show_row (model, row);
+		return;
+	}
+
+	set_iter (model, &iter, row, 0);
+	path = gtk_tree_path_new_from_indices (row->pos, -1);
+	gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+	if (romfix_model_iter_has_child (GTK_TREE_MODEL (model), &iter))
+		gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model), path, &iter);
+	gtk_tree_path_free (path);
+}
+
+/* Changes the statuses shown. The view is told the visible romsets were
+   removed and the new ones added, rather than the whole model being
+   rebuilt. Views should be detached first when there are many romsets */
+void
+gmameui_romfix_model_set_status_filter (GMAMEUIRomfixModel *model, guint mask)
+{
+	GMAMEUIRomfixModelPrivate *priv;
+	guint i;
+
+	g_return_if_fail (GMAMEUI_IS_ROMFIX_MODEL (model));
+
+	priv = model->priv;
+
+	if (mask == priv->mask)
+		return;
+
+	/* Removed from the end, so the paths of the other rows don't change */
+	while (priv->visible->len > 0) {
+		GtkTreePath *path;
+		romfix_row *row;
+
+		row = g_ptr_array_index (priv->visible, priv->visible->len - 1);
+		row->pos = -1;
+		row_clear_children (row);
+		g_ptr_array_remove_index (priv->visible, priv->visible->len - 1);
+
+		path = gtk_tree_path_new_from_indices (priv->visible->len, -1);
+		gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+		gtk_tree_path_free (path);
+	}
+
+	priv->mask = mask;
+	priv->stamp++;
+
+	for (i = 0; i < priv->rows->len; i++) {
+		romfix_row *row = g_ptr_array_index (priv->rows, i);
+
+		if (row_is_visible (model, row))
+			show_row (model, row);
+	}
+}
+
+guint
+gmameui_romfix_model_get_status_filter (GMAMEUIRomfixModel *model)
+{
+	g_return_val_if_fail (GMAMEUI_IS_ROMFIX_MODEL (model), 0);
+
+	return model->priv->mask;
+}
+
+/* Number of romsets found with the status, whether shown or not */
+guint
+gmameui_romfix_model_get_romset_count (GMAMEUIRomfixModel *model, gint status)
+{
+	g_return_val_if_fail (GMAMEUI_IS_ROMFIX_MODEL (model), 0);
+	g_return_val_if_fail (status_mask (status) != 0, 0);
+
+	return model->priv->romset_counts[status];
+}
+
+/* Number of ROMs found with the status, whether shown or not */
+guint
+gmameui_romfix_model_get_rom_count (GMAMEUIRomfixModel *model, gint status)
+{
+	g_return_val_if_fail (GMAMEUI_IS_ROMFIX_MODEL (model), 0);
+	g_return_val_if_fail (status_mask (status) != 0, 0);
+
+	return model->priv->rom_counts[status];
+}
+
+static void
+gmameui_romfix_model_finalize (GObject *object)
+{
+	GMAMEUIRomfixModel *model = GMAMEUI_ROMFIX_MODEL (object);
+	guint i;
+
+	for (i = 0; i < model->priv->rows->len; i++) {
+		romfix_row *row = g_ptr_array_index (model->priv->rows, i);
+
+		row_clear_children (row);
+		g_free (row);
+	}
+	g_ptr_array_free (model->priv->rows, TRUE);
+	g_ptr_array_free (model->priv->visible, TRUE);
+	g_hash_table_destroy (model->priv->row_of_fixes);
+
+	G_OBJECT_CLASS (gmameui_romfix_model_parent_class)->finalize (object);
+}
+
+static void
+gmameui_romfix_model_class_init (GMAMEUIRomfixModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (GMAMEUIRomfixModelPrivate));
+
+	object_class->finalize = gmameui_romfix_model_finalize;
+}
+
+static void
+gmameui_romfix_model_init (GMAMEUIRomfixModel *model)
+{
+	model->priv = G_TYPE_INSTANCE_GET_PRIVATE (model,
+						   GMAMEUI_TYPE_ROMFIX_MODEL,
+						   GMAMEUIRomfixModelPrivate);
+
+	model->priv->rows = g_ptr_array_new ();
+	model->priv->visible = g_ptr_array_new ();
+	model->priv->row_of_fixes = g_hash_table_new (g_direct_hash, g_direct_equal);
+	model->priv->mask = ROMFIX_STATUS_MASK_ALL;
+	model->priv->stamp = g_random_int ();
+}
+
+GMAMEUIRomfixModel *
+gmameui_romfix_model_new (void)
+{
+	return g_object_new (GMAMEUI_TYPE_ROMFIX_MODEL, NULL);
+}
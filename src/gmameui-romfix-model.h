@@ -0,0 +1,105 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_ROMFIX_MODEL_H__
+#define __GMAMEUI_ROMFIX_MODEL_H__
+
+#include "common.h"
+#include "gmameui-romfix-list.h"
+
+G_BEGIN_DECLS
+
+#define GMAMEUI_TYPE_ROMFIX_MODEL gmameui_romfix_model_get_type()
+
+#define GMAMEUI_ROMFIX_MODEL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+  GMAMEUI_TYPE_ROMFIX_MODEL, GMAMEUIRomfixModel))
+
+#define GMAMEUI_ROMFIX_MODEL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), \
+  GMAMEUI_TYPE_ROMFIX_MODEL, GMAMEUIRomfixModelClass))
+
+#define GMAMEUI_IS_ROMFIX_MODEL(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), \
+  GMAMEUI_TYPE_ROMFIX_MODEL))
+
+#define GMAMEUI_IS_ROMFIX_MODEL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), \
+  GMAMEUI_TYPE_ROMFIX_MODEL))
+
+#define GMAMEUI_ROMFIX_MODEL_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), \
+  GMAMEUI_TYPE_ROMFIX_MODEL, GMAMEUIRomfixModelClass))
+
+typedef struct _GMAMEUIRomfixModelPrivate GMAMEUIRomfixModelPrivate;
+
+/* Tree model over the romset_fixes found by a scan. The romsets are the
+   top level rows and their ROMs the children; the rows for the ROMs of a
+   romset are only built once the romset is expanded, and are freed again
+   by gmameui_romfix_model_collapse. The romset_fixes
+   are owned by the GMAMEUIRomfixList */
+typedef struct {
+	GObject parent;
+
+	GMAMEUIRomfixModelPrivate *priv;
+} GMAMEUIRomfixModel;
+
+typedef struct {
+	GObjectClass parent_class;
+} GMAMEUIRomfixModelClass;
+
+enum {
+	ROMFIX_MODEL_COL_NAME,
+	ROMFIX_MODEL_COL_REGION,
+	ROMFIX_MODEL_COL_STATUSTXT,
+	ROMFIX_MODEL_COL_STATUS,
+	NUM_ROMFIX_MODEL_COLUMNS
+};
+
+/* Matches the status of a romfix and a romset_fixes */
+enum {
+	ROMFIX_STATUS_NOK,
+	ROMFIX_STATUS_OK,
+	ROMFIX_STATUS_RENAME,
+	ROMFIX_STATUS_INPARENT,
+	ROMFIX_STATUS_DUPEPARENT,
+	ROMFIX_STATUS_COPY,
+	ROMFIX_STATUS_BIOS,
+	NUM_ROMFIX_STATUSES
+};
+
+#define ROMFIX_STATUS_MASK(status) (1 << (status))
+#define ROMFIX_STATUS_MASK_ALL ((1 << NUM_ROMFIX_STATUSES) - 1)
+
+GType gmameui_romfix_model_get_type (void);
+
+GMAMEUIRomfixModel *gmameui_romfix_model_new (void);
+
+void gmameui_romfix_model_add (GMAMEUIRomfixModel *model, romset_fixes *fixes);
+void gmameui_romfix_model_update (GMAMEUIRomfixModel *model, romset_fixes *fixes);
+void gmameui_romfix_model_collapse (GMAMEUIRomfixModel *model, GtkTreeIter *iter);
+void gmameui_romfix_model_set_status_filter (GMAMEUIRomfixModel *model, guint mask);
+guint gmameui_romfix_model_get_status_filter (GMAMEUIRomfixModel *model);
+guint gmameui_romfix_model_get_romset_count (GMAMEUIRomfixModel *model, gint status);
+guint gmameui_romfix_model_get_rom_count (GMAMEUIRomfixModel *model, gint status);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_ROMFIX_MODEL_H__ */
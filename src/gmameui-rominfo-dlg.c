@@ -123,6 +123,19 @@ audit_idle (gpointer data)
 	return FALSE;
 }
 
+/* Show the stored detail of the last audit, e.g. which ROMs are bad, as the
+   tooltip of the ROM check result */
+static void
+set_audit_detail_tooltip (MameRomInfoDialog *dialog)
+{
+	gchar *detail;
+
+	detail = gmameui_audit_store_describe (gui_prefs.audit_store,
+					       mame_rom_entry_get_romname (dialog->priv->rom));
+	gtk_widget_set_tooltip_text (dialog->priv->rom_check_result, detail);
+	g_free (detail);
+}
+
 static void
 on_romset_audited (GmameuiAudit *audit, gchar *audit_line, gint type, gint auditresult, gpointer user_data)
 {
@@ -137,6 +150,7 @@ on_romset_audited (GmameuiAudit *audit, gchar *audit_line, gint type, gint audit
 		title = rom_status_string_value [auditresult];
 		if (type == AUDIT_TYPE_ROM) {
 			g_object_set (dialog->priv->rom, "has-roms", auditresult, NULL);
+			set_audit_detail_tooltip (dialog);
 
 			gtk_label_set_text (GTK_LABEL (dialog->priv->rom_check_result), title);
 		} else {
@@ -470,6 +484,15 @@ g_object_unref (parser);
 	/* Get the ROM audit result labels so that they can be set later */
 	priv->rom_check_result = GTK_WIDGET (gtk_builder_get_object (priv->builder, "rom_check_result"));
 	priv->sample_check_result = GTK_WIDGET (gtk_builder_get_object (priv->builder, "sample_check_result"));
+
+	/* Show the result of the last audit until the new audit completes */
+	const AuditRecord *record;
+	record = gmameui_audit_store_lookup (gui_prefs.audit_store, mame_rom_entry_get_romname (priv->rom));
+	if (record && record->rom_status != UNKNOWN) {
+		gtk_label_set_text (GTK_LABEL (priv->rom_check_result),
+				    rom_status_string_value[record->rom_status]);
+		set_audit_detail_tooltip (dialog);
+	}
 	
 
 	priv->romset_sigid = g_signal_connect (gui_prefs.audit, "romset-audited",
@@ -27,6 +27,13 @@
 #include "gmameui-rommgr-dlg.h"
 #include "rom_entry.h"
 #include "game_list.h"
+#include "gmameui-chd.h"
+#include "gmameui-zip-cache.h"
+#include "gmameui-archive.h"
+#include "gmameui-rom-verify.h"
+#include "gmameui-romset-convert.h"
+#include "gmameui-romfix-model.h"
+#include "gmameui-space-report.h"
 
 /* Improvements:
 	- button to fix ROM where available
@@ -41,30 +48,67 @@
 
 */
 
-enum {
-	COL_NAME,
-	COL_REGION,
-	COL_STATUSTXT,
-	COL_STATUS,
-};
-
 struct _GMAMEUIRomMgrDialogPrivate {
 	GtkBuilder *builder;
 
-	GtkTreeStore *treestore;
+	GMAMEUIRomfixModel *model;	/* Romsets found by the scan, filtered by status */
 	GtkListStore *liststore;
 
-	GtkTreeModel *filter_model;	/* Wraps the treestore and allows filtering of
-	                               Correct romsets */
-
 	GtkTreeView *tv;
 	GtkTreeView *lv;
 
 	GList *avail_romsets;	/* GList of gchar* items representing romset names */
+	GHashTable *avail_paths;	/* Romset name to zipfile path for avail_romsets */
+	GList *disk_verifies;	/* GList of disk_verify structs for running CHD deep verifies */
+
+	/* Romsets are read by a pool of worker threads; the results are
+	   passed back to the main thread through the queue */
+	GThreadPool *pool;
+	GAsyncQueue *results;
+	guint results_sourceid;
+	gint pending;		/* Jobs pushed to the pool but not yet collected */
+	gint phase;
+	gint cancelled;		/* Set (atomically) when the dialog is destroyed */
+	GTimer *timer;
 
 	gint total_romsets, total_ok;
+
+	/* Deep verify of the ROM data, run after the fixes have been found */
+	GmameuiRomVerifier *verifier;
+	gint verify_total, verify_done, verify_resumed;
+	guint64 verify_bytes;
+
+	/* Disk space used by the romsets, built while they are listed */
+	GmameuiSpaceReport *report;
+
+	/* Throughput of the current run of fixes */
+	guint64 fix_bytes;
+	gdouble fix_seconds;
+};
+
+/* The scan runs in two phases - the contents of every zipfile are first
+   added to the ROM index, then each parent and its clones are checked for
+   fixes. The index is only read while looking for fixes. If enabled, a
+   third phase then decompresses every ROM to check its SHA1 */
+enum {
+	SCAN_PHASE_LIST,
+	SCAN_PHASE_FIX,
+	SCAN_PHASE_VERIFY,
 };
 
+typedef struct {
+	gchar *romname;		/* In SCAN_PHASE_FIX, the parent of the family */
+	GList *family;		/* SCAN_PHASE_FIX only - scan_jobs for the available
+				   romsets in the family, parent first */
+	GmameuiArchive *archive;	/* Set by the worker in SCAN_PHASE_LIST, with
+					   the CRCs of its files read */
+	romset_fixes *fixes;	/* Set by the worker in SCAN_PHASE_FIX */
+	RomVerifyResult verify;	/* Set by the worker in SCAN_PHASE_VERIFY */
+	gboolean verified;
+} scan_job;
+
+#define SCAN_RESULTS_INTERVAL 100	/* Time in ms between collecting results */
+
 #define GMAMEUI_ROMMGR_DIALOG_GET_PRIVATE(o)  (GMAMEUI_ROMMGR_DIALOG (o)->priv)
 
 G_DEFINE_TYPE (GMAMEUIRomMgrDialog, gmameui_rommgr_dialog, GTK_TYPE_DIALOG)
@@ -74,198 +118,622 @@ static void
 gmameui_rommgr_dialog_response             (GtkDialog *dialog, gint response);
 static void
 gmameui_rommgr_dialog_destroy              (GtkObject *object);
+static void
+recover_interrupted_fixes                  (GMAMEUIRomMgrDialog *dialog);
+
+static void
+add_avail_romset (gpointer key, gpointer value, gpointer user_data)
+{
+	GMAMEUIRomMgrDialog *dialog;
+	const gchar *romname;
+
+	dialog = (GMAMEUIRomMgrDialog *) user_data;
+	romname = (const gchar *) key;
+
+	if (get_rom_from_gamelist_by_name (gui_prefs.gl, (gchar *) romname)) {
+		dialog->priv->avail_romsets = g_list_prepend (dialog->priv->avail_romsets, g_strdup (romname));
+		g_hash_table_insert (dialog->priv->avail_paths,
+				     g_strdup (romname),
+				     g_strdup ((const gchar *) value));
+	}
+}
 
-/* This function generates a GList of all the romsets that exist in the rom paths */
+/* This function generates a GList of all the romsets that exist in the rom
+   paths, whether as a zip, a 7z or a directory */
 static void
 get_avail_romsets (GMAMEUIRomMgrDialog *dialog)
 {
-	GValueArray *va_rom_paths;
-	GDir *romdir;
-	const gchar *rompath;
-	
-	g_object_get (main_gui.gui_prefs, "rom-paths", &va_rom_paths, NULL);
-	if (va_rom_paths) {
-		guint i;
-		for (i = 0; i < va_rom_paths->n_values; i++) {
-			const gchar *romset_path;
-			
-			rompath = g_value_get_string (g_value_array_get_nth (va_rom_paths, i));
+	gmameui_archive_index_rom_paths ();
+	gmameui_archive_foreach_romset (add_avail_romset, dialog);
 
-			romdir = g_dir_open (rompath, 0, NULL);	/* AAA FIXME TODO Handle error */
+	dialog->priv->avail_romsets = g_list_reverse (dialog->priv->avail_romsets);
+}
 
-			while (romset_path = g_dir_read_name (romdir)) {
-				gchar *romset_path_full;
+/* Shows the number of romsets and ROMs found with each status */
+static void
+update_summary (GMAMEUIRomMgrDialog *dialog)
+{
+	GMAMEUIRomfixModel *model = dialog->priv->model;
+	GtkWidget *label;
+	gchar *msg;
 
-				romset_path_full = g_build_filename (rompath, romset_path, NULL);
-				
+	msg = g_strdup_printf (_("%d romsets correct, %d incorrect. ROMs: %d incorrect, %d to rename, %d in parent, %d duplicated in parent, %d in another romset, %d in a BIOS"),
+			       gmameui_romfix_model_get_romset_count (model, ROMFIX_STATUS_OK),
+			       gmameui_romfix_model_get_romset_count (model, ROMFIX_STATUS_NOK),
+			       gmameui_romfix_model_get_rom_count (model, ROMFIX_STATUS_NOK),
+			       gmameui_romfix_model_get_rom_count (model, ROMFIX_STATUS_RENAME),
+			       gmameui_romfix_model_get_rom_count (model, ROMFIX_STATUS_INPARENT),
+			       gmameui_romfix_model_get_rom_count (model, ROMFIX_STATUS_DUPEPARENT),
+			       gmameui_romfix_model_get_rom_count (model, ROMFIX_STATUS_COPY),
+			       gmameui_romfix_model_get_rom_count (model, ROMFIX_STATUS_BIOS));
+
+	label = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "lbl_summary"));
+	gtk_label_set_text (GTK_LABEL (label), msg);
+	g_free (msg);
+}
 
-				/* If it's a zip file... FIXME TODO Doesn't discriminate on zip files */
-				if (g_file_test (romset_path_full, G_FILE_TEST_IS_REGULAR)) {
-					MameRomEntry *romset;
-					gchar *romname;
+/* This callback handles when the GMAMEUIRomfixList emits that a romset fixlist
+   has been generated, and adds the romset to the model. The rows for its
+   ROMs aren't built until the romset is expanded */
+static void
+on_romset_fix_found (GMAMEUIRomfixList *fixlist,
+				   gchar *romset_name,
+				   gpointer *data,
+				   gpointer user_data)
+{
+	romset_fixes *fixes = (romset_fixes *) data;
+	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) user_data;
+
+	gmameui_romfix_model_add (dialog->priv->model, fixes);
+}
+
+/* More fixes have been merged into a romset already in the list, e.g. by
+   a deep verify */
+static void
+on_romset_fix_changed (GMAMEUIRomfixList *fixlist,
+		       gchar *romset_name,
+		       gpointer *data,
+		       gpointer user_data)
+{
+	romset_fixes *fixes = (romset_fixes *) data;
+	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) user_data;
 
-					romname = get_romname_from_zipfile (romset_path);
-					
-					romset = get_rom_from_gamelist_by_name (gui_prefs.gl, romname);
-					if (romset)
-						dialog->priv->avail_romsets = g_list_append (dialog->priv->avail_romsets, g_strdup (romname));
-					/*else
-						GMAMEUI_DEBUG ("  Error - Couldn't find romset %s in gamelist", romset_path);*/
+	gmameui_romfix_model_update (dialog->priv->model, fixes);
+}
 
-					g_free (romname);
-				} /*else
-					GMAMEUI_DEBUG ("IGNORING FILE %s", romset_path);*/
+/* A CHD being deep verified in the background */
+typedef struct {
+	GMAMEUIRomMgrDialog *dialog;	/* NULL once the dialog has been destroyed */
+	ChdDeepVerify *verify;
+	gchar *romset_name;
+	gchar *romset_fullname;
+	gchar *disk_name;
+} disk_verify;
+
+/* Called once the whole CHD has been read. Only disks that fail are added;
+   the list merges them into the fixes listed when the header was checked */
+static void
+on_chd_deep_verified (const gchar *filename, ChdResult result, gpointer user_data)
+{
+	disk_verify *dv = (disk_verify *) user_data;
 
-				g_free (romset_path_full);
-			}
+	if (dv->dialog) {
+		dv->dialog->priv->disk_verifies = g_list_remove (dv->dialog->priv->disk_verifies, dv);
 
-			g_dir_close (romdir);
+		if ((result != CHD_RESULT_OK) &&
+		    (result != CHD_RESULT_NODUMP) &&
+		    (result != CHD_RESULT_CANCELLED)) {
+			romset_fixes *fixes;
+			romfix *fix;
+
+			GMAMEUI_DEBUG ("Deep verify of %s failed - %s", filename, gmameui_chd_result_to_string (result));
+
+			fix = (romfix *) g_malloc0 (sizeof (romfix));
+			fix->romname = g_strdup (dv->disk_name);
+			fix->region = g_strdup ("disk");
+			fix->status = ROMFIX_STATUS_NOK;
+
+			fixes = (romset_fixes *) g_malloc0 (sizeof (romset_fixes));
+			fixes->romset_name = g_strdup (dv->romset_name);
+			fixes->romset_fullname = g_strdup (dv->romset_fullname);
+			fixes->status = ROMFIX_STATUS_NOK;
+			fixes->romfixes = g_list_append (NULL, fix);
+
+			gmameui_romfix_list_add (gui_prefs.fixes, fixes);
+			update_summary (dv->dialog);
 		}
 	}
+
+	g_free (dv->romset_name);
+	g_free (dv->romset_fullname);
+	g_free (dv->disk_name);
+	g_free (dv);
 }
 
+/* Queue a deep verify for each CHD in the romset whose header matched */
 static void
-add_romset_contents_to_hashtable (gpointer data, gpointer user_data)
+romset_deep_verify_disks (GMAMEUIRomMgrDialog *dialog, MameRomEntry *romset, romset_fixes *fixes)
 {
-	MameRomEntry *romset = NULL;
-	gchar *romname = NULL;
-	
-	romname = (gchar *) data;
+	GList *disks;
+	gint rate;
+
+	g_object_get (main_gui.gui_prefs, "chd-verify-rate", &rate, NULL);
+
+	for (disks = mame_rom_entry_get_disks (romset); disks; disks = g_list_next (disks)) {
+		individual_rom *disk = (individual_rom *) disks->data;
+		disk_verify *dv;
+		gchar *filename;
+
+		filename = gmameui_chd_get_disk_filename (romset, disk);
+		if (filename == NULL)
+			continue;
+
+		if (gmameui_chd_verify_disk (filename, disk->sha1) == CHD_RESULT_OK) {
+			dv = g_new0 (disk_verify, 1);
+			dv->dialog = dialog;
+			dv->romset_name = g_strdup (fixes->romset_name);
+			dv->romset_fullname = g_strdup (fixes->romset_fullname);
+			dv->disk_name = g_strdup (disk->name);
+			dv->verify = gmameui_chd_deep_verify (filename, disk->sha1, rate,
+							      on_chd_deep_verified, dv);
+
+			dialog->priv->disk_verifies = g_list_append (dialog->priv->disk_verifies, dv);
+		}
 
-	g_return_if_fail (romname != NULL);
-	
-//GMAMEUI_DEBUG ("In add_romset_contents_to_hashtable processing rom %s", romname);
-	romset = get_rom_from_gamelist_by_name (gui_prefs.gl, romname);
+		g_free (filename);
+	}
+}
+
+/* Runs on the main thread once a romset has been checked by a worker */
+static void
+romset_find_fixes (GMAMEUIRomMgrDialog *dialog, scan_job *job)
+{
+	MameRomEntry *romset;
+	romset_fixes *fixes;
+
+	fixes = job->fixes;
+	job->fixes = NULL;
+
+	romset = get_rom_from_gamelist_by_name (gui_prefs.gl, job->romname);
 
-//GMAMEUI_DEBUG ("  Found romset %s", mame_rom_entry_get_romname (romset));
 	g_return_if_fail (romset != NULL);
-	
-	mame_rom_entry_add_roms_to_hashtable (romset);
-//GMAMEUI_DEBUG ("Finished add_romset_contents_to_hashtable");
+	g_return_if_fail (fixes != NULL);
+
+	/* Add to our collected list, which updates the dialog with the ROMs
+	   and their statuses */
+	gmameui_romfix_list_add (gui_prefs.fixes, fixes);
+
+	/* Update the counts */
+	dialog->priv->total_romsets++;
+	if (fixes->status == ROMFIX_STATUS_OK) dialog->priv->total_ok++;
+
+	/* Checking the CHD headers is quick, but reading the whole image
+	   isn't, so this is done in the background only if requested */
+	if (mame_rom_entry_get_disks (romset) != NULL) {
+		gboolean deep_verify;
+
+		g_object_get (main_gui.gui_prefs, "chd-deep-verify", &deep_verify, NULL);
+		if (deep_verify)
+			romset_deep_verify_disks (dialog, romset, fixes);
+	}
 }
 
-static gchar *
-get_romfix_status (romfix *fix)
+/* Checks a parent and its clones in turn. The parent's archive is listed
+   once for the whole family, and the family's listings are dropped from
+   the caches afterwards since the scan doesn't need them again */
+static void
+scan_family (GMAMEUIRomMgrDialog *dialog, scan_job *job)
 {
-	int i;
-	gchar *msg;
+	RomsetFamilyListing *listing;
+	GList *ptr;
 
-	i = fix->status;
-	
-	/* AAA FIXME TODO matches enum in rom_entry.c */
-	if (i == 0)
-		msg = g_strdup (_("Incorrect"));
-	else if (i == 1)
-		msg = g_strdup (_("OK"));
-	else if (i == 2)
-		msg = g_strdup (_("should be renamed to"));
-	else if (i == 3)
-		msg = g_strdup_printf (_("available in parent %s"), fix->container);
-	else if (i == 4)
-		msg = g_strdup_printf (_("duplicated in parent %s"), fix->container);
-	else if (i == 5)
-		msg = g_strdup_printf (_("available in romset %s"), fix->container);
-	else if (i == 6)
-		msg = g_strdup (_("contained in a BIOS"));
-	else
-		g_assert_not_reached ();
-
-	return msg;
+	listing = mame_rom_entry_family_listing_new (job->romname);
+
+	for (ptr = job->family; ptr; ptr = g_list_next (ptr)) {
+		scan_job *member = (scan_job *) ptr->data;
+		MameRomEntry *romset;
+
+		if (g_atomic_int_get (&dialog->priv->cancelled))
+			break;
+
+		romset = get_rom_from_gamelist_by_name (gui_prefs.gl, member->romname);
+		if (romset)
+			member->fixes = mame_rom_entry_find_family_fixes (romset, listing);
+	}
+
+	mame_rom_entry_family_listing_free (listing);
+
+	for (ptr = job->family; ptr; ptr = g_list_next (ptr)) {
+		const gchar *path;
+
+		path = g_hash_table_lookup (dialog->priv->avail_paths, ((scan_job *) ptr->data)->romname);
+		if (path)
+			gmameui_archive_invalidate (path);
+	}
 }
 
-/* This callback handles when the GMAMEUIRomfixList emits that a romset fixlist
-   has been generated, and updates the treeview with the details */
+/* Worker thread function. In the first phase this reads the central
+   directory of the zipfile into the zip cache, so that adding the contents
+   to the ROM index on the main thread doesn't touch the disk. In the second
+   phase it looks for the fixes for a parent and its clones, which only
+   reads the zip cache and the ROM index. The deep verify phase decompresses
+   and hashes every ROM */
 static void
-on_romset_fix_found (GMAMEUIRomfixList *fixlist,
-				   gchar *romset_name,
-				   gpointer *data,
-				   gpointer user_data)
+scan_romset_worker (gpointer data, gpointer user_data)
 {
-	GtkTreeIter iter, child_iter;
-	gchar *rom_fullname;
-	GList *roms;
+	GMAMEUIRomMgrDialog *dialog;
+	scan_job *job;
 
-	romset_fixes *fixes = (romset_fixes *) data;
-	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) user_data;
+	job = (scan_job *) data;
+	dialog = (GMAMEUIRomMgrDialog *) user_data;
 
-		/* Add the romset to the tree */
-	rom_fullname = g_strdup_printf ("%s (%s)",
-	                                fixes->romset_fullname, fixes->romset_name);
-	gtk_tree_store_append (dialog->priv->treestore, &iter, NULL);
-	gtk_tree_store_set (dialog->priv->treestore, &iter,
-	                    COL_NAME, rom_fullname,
-	                    COL_REGION, "",
-	                    COL_STATUSTXT, /*get_romfix_status (fixes->status)*/"",
-	                    COL_STATUS, fixes->status,	/* If status is OK, set to 1, for filtering */
-	                    -1);
-	g_free (rom_fullname);
-
-	/* Now add the roms to the tree as nested elements underneath the romset */
-	roms = g_list_first (fixes->romfixes);
-	while (roms) {
-		romfix *fix = roms->data;
-
-		gtk_tree_store_append (dialog->priv->treestore, &child_iter, &iter);
-		gtk_tree_store_set (dialog->priv->treestore, &child_iter,
-		                    COL_NAME, fix->romname,
-		                    COL_REGION, fix->region,
-		                    COL_STATUSTXT, get_romfix_status (fix),
-		                    COL_STATUS, fix->status,	/* If status is OK, set to 1, for filtering */
-		                    -1);
-		
-		roms = g_list_next (roms);
+	if (!g_atomic_int_get (&dialog->priv->cancelled)) {
+		if (dialog->priv->phase == SCAN_PHASE_LIST) {
+			const gchar *path;
+
+			path = g_hash_table_lookup (dialog->priv->avail_paths, job->romname);
+			job->archive = path ? gmameui_archive_open (path) : NULL;
+			if (job->archive) {
+				guint32 crc;
+				guint i;
+
+				/* 7z archives and directories aren't listed with
+				   their CRCs, so they are read here rather than in
+				   the main thread. The archive is kept on the job so
+				   the space report sees them, even if it has since
+				   left the archive cache */
+				for (i = 0; i < gmameui_archive_get_num_entries (job->archive); i++)
+					gmameui_archive_get_crc (job->archive,
+								 gmameui_archive_get_nth_entry (job->archive, i),
+								 &crc);
+			}
+		} else if (dialog->priv->phase == SCAN_PHASE_FIX) {
+			scan_family (dialog, job);
+		} else {
+			MameRomEntry *romset;
+			const gchar *path;
+
+			romset = get_rom_from_gamelist_by_name (gui_prefs.gl, job->romname);
+			path = g_hash_table_lookup (dialog->priv->avail_paths, job->romname);
+			if (romset && path)
+				job->verified = gmameui_rom_verifier_verify_romset (dialog->priv->verifier,
+										    romset, path,
+										    &job->verify);
+		}
 	}
 
-	UPDATE_GUI;
-	
+	g_async_queue_push (dialog->priv->results, job);
+}
+
+static void
+scan_job_free (scan_job *job)
+{
+	/* Fixes are only left on the job if the dialog was destroyed before
+	   they were collected */
+	if (job->archive)
+		gmameui_archive_unref (job->archive);
+	if (job->fixes)
+		gmameui_romset_fixes_free (job->fixes);
+	g_list_foreach (job->family, (GFunc) scan_job_free, NULL);
+	g_list_free (job->family);
+	gmameui_rom_verify_result_clear (&job->verify);
+	g_free (job->romname);
+	g_free (job);
+}
+
+/* Groups the available romsets by parent, with the parent ahead of its
+   clones. Returns a GList of scan_jobs, one per family */
+static GList *
+get_scan_families (GMAMEUIRomMgrDialog *dialog)
+{
+	GHashTable *families;	/* Parent name -> scan_job */
+	GList *jobs = NULL;
+	GList *ptr;
+
+	families = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (ptr = dialog->priv->avail_romsets; ptr; ptr = g_list_next (ptr)) {
+		MameRomEntry *romset;
+		scan_job *job, *member;
+		const gchar *parent;
+
+		romset = get_rom_from_gamelist_by_name (gui_prefs.gl, (gchar *) ptr->data);
+		if (romset == NULL)
+			continue;
+
+		if (mame_rom_entry_is_clone (romset))
+			parent = mame_rom_entry_get_parent_romname (romset);
+		else
+			parent = mame_rom_entry_get_romname (romset);
+
+		job = g_hash_table_lookup (families, parent);
+		if (job == NULL) {
+			job = g_new0 (scan_job, 1);
+			job->romname = g_strdup (parent);
+			g_hash_table_insert (families, job->romname, job);
+			jobs = g_list_prepend (jobs, job);
+		}
+
+		member = g_new0 (scan_job, 1);
+		member->romname = g_strdup ((gchar *) ptr->data);
+
+		if (g_ascii_strcasecmp (member->romname, job->romname) == 0)
+			job->family = g_list_prepend (job->family, member);
+		else
+			job->family = g_list_append (job->family, member);
+	}
+
+	g_hash_table_destroy (families);
+
+	return g_list_reverse (jobs);
+}
+
+/* Pushes a job for each available romset to the worker pool. Fixes are
+   found a family at a time */
+static void
+queue_scan_phase (GMAMEUIRomMgrDialog *dialog, gint phase)
+{
+	GList *jobs, *ptr;
+
+	dialog->priv->phase = phase;
+
+	if (phase == SCAN_PHASE_FIX) {
+		jobs = get_scan_families (dialog);
+	} else {
+		jobs = NULL;
+		for (ptr = dialog->priv->avail_romsets; ptr; ptr = g_list_next (ptr)) {
+			scan_job *job;
+
+			job = g_new0 (scan_job, 1);
+			job->romname = g_strdup ((gchar *) ptr->data);
+			jobs = g_list_prepend (jobs, job);
+		}
+		jobs = g_list_reverse (jobs);
+	}
+
+	for (ptr = jobs; ptr; ptr = g_list_next (ptr)) {
+		dialog->priv->pending++;
+		g_thread_pool_push (dialog->priv->pool, ptr->data, NULL);
+	}
+	g_list_free (jobs);
 }
 
 static void
-romset_find_fixes (gpointer data, gpointer user_data)
+scan_finished (GMAMEUIRomMgrDialog *dialog)
+{
+	GtkWidget *widget;
+
+	GMAMEUI_DEBUG ("  Romset rebuild - finished in %0.2f seconds", g_timer_elapsed (dialog->priv->timer, NULL));
+
+	/* Ask user whether they want to have more detailed look for missing ROMs */
+
+	/* Enable fix button */
+	widget = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "btn_fix"));
+	gtk_widget_set_sensitive (widget, TRUE);
+
+	/* Converting needs the ROMs of each romset from -listxml */
+	widget = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "btn_convert"));
+	gtk_widget_set_sensitive (widget, TRUE);
+
+	widget = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "btn_report"));
+	gtk_widget_set_sensitive (widget, TRUE);
+
+	/* Destroy hash table */
+	/* Destroy ROM index */
+	gmameui_rom_index_free (gui_prefs.rom_index);
+	gui_prefs.rom_index = NULL;
+
+	g_timer_destroy (dialog->priv->timer);
+	dialog->priv->timer = NULL;
+}
+
+static void
+add_verified_roms (romset_fixes *fixes, MameRomEntry *romset, GList *romnames, gint status)
+{
+	GList *ptr;
+
+	for (ptr = romnames; ptr; ptr = g_list_next (ptr)) {
+		romfix *fix;
+		GList *roms;
+
+		fix = (romfix *) g_malloc0 (sizeof (romfix));
+		fix->romname = g_strdup ((gchar *) ptr->data);
+		fix->status = status;
+		if (status == ROMFIX_STATUS_INPARENT)
+			fix->container = g_strdup (mame_rom_entry_get_parent_romname (romset));
+
+		for (roms = mame_rom_entry_get_roms (romset); roms; roms = g_list_next (roms)) {
+			individual_rom *rom = (individual_rom *) roms->data;
+
+			if (g_ascii_strcasecmp (rom->name, fix->romname) == 0) {
+				fix->region = g_strdup (rom->region);
+				break;
+			}
+		}
+
+		fixes->romfixes = g_list_append (fixes->romfixes, fix);
+	}
+}
+
+/* Adds the ROMs whose data doesn't match their SHA1, and those verified in
+   the parent's romset, to the fixes already listed for the romset. Romsets
+   that were read completely are recorded, so they are skipped if the verify
+   is interrupted and restarted */
+static void
+romset_deep_verified (GMAMEUIRomMgrDialog *dialog, scan_job *job)
 {
 	MameRomEntry *romset;
 	romset_fixes *fixes;
-	gchar *romname;
 
-	romname = (gchar *) data;
+	dialog->priv->verify_done++;
 
-	g_return_if_fail (romname != NULL);
+	if (!job->verified)
+		return;
 
-	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) user_data;
-	
-	fixes = NULL;
-	
-	romset = get_rom_from_gamelist_by_name (gui_prefs.gl, romname);
+	dialog->priv->verify_bytes += job->verify.bytes;
+	if (job->verify.resumed)
+		dialog->priv->verify_resumed++;
 
-	//GMAMEUI_DEBUG ("  Looking for fixes for %s", romname);
-	
-	g_return_val_if_fail (romset != NULL, TRUE);
+	if ((job->verify.bad_roms == NULL) && job->verify.complete)
+		gmameui_rom_verifier_mark_done (dialog->priv->verifier, job->romname, &job->verify);
 
-	/* Check the status for each rom in the romset */
-	fixes = mame_rom_entry_find_fixes (romset);
+	if ((job->verify.bad_roms == NULL) && (job->verify.parent_roms == NULL))
+		return;
+
+	romset = get_rom_from_gamelist_by_name (gui_prefs.gl, job->romname);
+	g_return_if_fail (romset != NULL);
+
+	/* Merged into the romset's fixes by the list */
+	fixes = (romset_fixes *) g_malloc0 (sizeof (romset_fixes));
+	fixes->romset_name = g_strdup (job->romname);
+	fixes->romset_fullname = g_strdup (mame_rom_entry_get_list_name (romset));
+	fixes->status = job->verify.bad_roms ? ROMFIX_STATUS_NOK : ROMFIX_STATUS_OK;
+
+	add_verified_roms (fixes, romset, job->verify.parent_roms, ROMFIX_STATUS_INPARENT);
+	add_verified_roms (fixes, romset, job->verify.bad_roms, ROMFIX_STATUS_NOK);
 
-	/* Add to our collected list */
 	gmameui_romfix_list_add (gui_prefs.fixes, fixes);
+}
 
-	/* Once romset is returned, update the dialog with the ROMs and their statuses */
-	g_return_val_if_fail (fixes != NULL, TRUE);
-	
-	/* Update the counts */
-	dialog->priv->total_romsets++;
-	if (fixes->status == 1) dialog->priv->total_ok++;
-
-	/* Update labels *
-	gchar *count;
-	count = g_strdup_printf ("%s", dialog->priv->total_romsets);
-	//gtk_label_set_text (dialog->priv->total_lbl);
-	g_free (count);
-
-	gchar *count;
-	count = g_strdup_printf ("%s", dialog->priv->total_ok);
-	//gtk_label_set_text (dialog->priv->ok_lbl);
-	g_free (count);*/
-	
-	return TRUE;
+/* Shows how far the deep verify has got, and an estimate of the time left
+   based on the romsets read so far in this run */
+static void
+update_verify_progress (GMAMEUIRomMgrDialog *dialog)
+{
+	GtkWidget *label;
+	gchar *msg;
+	gdouble elapsed, rate;
+	gint read, remaining;
+
+	elapsed = g_timer_elapsed (dialog->priv->timer, NULL);
+	rate = (elapsed > 0) ? dialog->priv->verify_bytes / elapsed : 0;
+	read = dialog->priv->verify_done - dialog->priv->verify_resumed;
+	remaining = dialog->priv->verify_total - dialog->priv->verify_done;
+
+	if ((read > 0) && (remaining > 0)) {
+		gint eta;
+
+		eta = (gint) (elapsed / read * remaining);
+		msg = g_strdup_printf (_("Verifying ROM data - %d of %d romsets, %.1f MB/s, about %d:%02d remaining"),
+				       dialog->priv->verify_done, dialog->priv->verify_total,
+				       rate / (1024 * 1024), eta / 60, eta % 60);
+	} else {
+		msg = g_strdup_printf (_("Verifying ROM data - %d of %d romsets"),
+				       dialog->priv->verify_done, dialog->priv->verify_total);
+	}
+
+	label = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "lbl_fix_status"));
+	gtk_label_set_text (GTK_LABEL (label), msg);
+	g_free (msg);
+}
+
+/* Starts the deep verify phase if it is enabled. Returns FALSE if there
+   is nothing to verify */
+static gboolean
+start_deep_verify (GMAMEUIRomMgrDialog *dialog)
+{
+	gboolean deep_verify;
+	gint rate;
+
+	g_object_get (main_gui.gui_prefs,
+		      "rom-deep-verify", &deep_verify,
+		      "rom-verify-rate", &rate,
+		      NULL);
+	if (!deep_verify)
+		return FALSE;
+
+	GMAMEUI_DEBUG ("  Romset rebuild - found fixes in %0.2f seconds",
+		       g_timer_elapsed (dialog->priv->timer, NULL));
+	g_timer_start (dialog->priv->timer);
+
+	dialog->priv->verifier = gmameui_rom_verifier_new (MAX (rate, 0));
+	dialog->priv->verify_total = g_list_length (dialog->priv->avail_romsets);
+	dialog->priv->verify_done = 0;
+	dialog->priv->verify_resumed = 0;
+	dialog->priv->verify_bytes = 0;
+
+	queue_scan_phase (dialog, SCAN_PHASE_VERIFY);
+	update_verify_progress (dialog);
+
+	return (dialog->priv->pending > 0);
+}
+
+/* Collects the results from the worker threads. Results are added to the
+   ROM index or the fix list as they arrive, so the tree fills in while the
+   remaining zipfiles are still being read */
+static gboolean
+collect_scan_results (gpointer data)
+{
+	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) data;
+	scan_job *job;
+
+	while ((job = g_async_queue_try_pop (dialog->priv->results)) != NULL) {
+		dialog->priv->pending--;
+
+		if (dialog->priv->phase == SCAN_PHASE_LIST) {
+			MameRomEntry *romset;
+
+			romset = get_rom_from_gamelist_by_name (gui_prefs.gl, job->romname);
+			if (romset) {
+				mame_rom_entry_add_roms_to_index (romset);
+
+				if (job->archive)
+					gmameui_space_report_add_romset (dialog->priv->report, romset, job->archive);
+			}
+		} else if (dialog->priv->phase == SCAN_PHASE_FIX) {
+			GList *ptr;
+
+			for (ptr = job->family; ptr; ptr = g_list_next (ptr))
+				romset_find_fixes (dialog, (scan_job *) ptr->data);
+		} else {
+			romset_deep_verified (dialog, job);
+		}
+
+		scan_job_free (job);
+	}
+
+	if (dialog->priv->phase == SCAN_PHASE_VERIFY)
+		update_verify_progress (dialog);
+
+	update_summary (dialog);
+
+	if (dialog->priv->pending > 0)
+		return TRUE;
+
+	if (dialog->priv->phase == SCAN_PHASE_LIST) {
+		GMAMEUI_DEBUG ("  Romset rebuild - added %d ROMs from available romsets to index in %0.2f seconds",
+			       gmameui_rom_index_get_num_entries (gui_prefs.rom_index),
+			       g_timer_elapsed (dialog->priv->timer, NULL));
+		g_timer_start (dialog->priv->timer);
+
+		/* Workers look up the index concurrently, so it must be sorted first */
+		gmameui_rom_index_sort (gui_prefs.rom_index);
+
+		/* Find fix for each romset */
+		queue_scan_phase (dialog, SCAN_PHASE_FIX);
+
+		/* No romsets available */
+		if (dialog->priv->pending > 0)
+			return TRUE;
+	}
+
+	if ((dialog->priv->phase == SCAN_PHASE_FIX) && start_deep_verify (dialog))
+		return TRUE;
+
+	if (dialog->priv->phase == SCAN_PHASE_VERIFY) {
+		GMAMEUI_DEBUG ("  Romset rebuild - deep verified %" G_GUINT64_FORMAT " bytes in %0.2f seconds",
+			       dialog->priv->verify_bytes, g_timer_elapsed (dialog->priv->timer, NULL));
+
+		/* The next deep verify starts again from the first romset */
+		gmameui_rom_verifier_finish (dialog->priv->verifier);
+		gmameui_rom_verifier_free (dialog->priv->verifier);
+		dialog->priv->verifier = NULL;
+	}
+
+	scan_finished (dialog);
+	dialog->priv->results_sourceid = 0;
+
+	return FALSE;
 }
 
 /* Starts the scan of all the ROMs. Should be called in a g_idle_add
@@ -276,61 +744,64 @@ start_scan_process (gpointer *data)
 {
 	GMAMEUIListOutput *parser;
 	MameExec *exec;
-	GtkWidget *widget;
-
-	GTimer *timer;
+	GError *error = NULL;
+	gint io_depth;
 
 	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) data;
 
-	timer = g_timer_new ();
-	
+	/* Put any interrupted fixes right before the zips are read */
+	recover_interrupted_fixes (dialog);
+
+	dialog->priv->timer = g_timer_new ();
+
 	/* Read ROM information for each romset using -listxml */
 	parser = gmameui_listoutput_new ();
 	exec = mame_exec_list_get_current_executable (main_gui.exec_list);
 	gmameui_listoutput_generate_rom_hash (parser, exec);	// Rename this file?
 	g_object_unref (parser);
 
-	GMAMEUI_DEBUG ("  Romset rebuild - processed -listxml data in %0.2f seconds", g_timer_elapsed (timer, NULL));
+	GMAMEUI_DEBUG ("  Romset rebuild - processed -listxml data in %0.2f seconds", g_timer_elapsed (dialog->priv->timer, NULL));
 
-	/* Create hash table for available ROMs in romsets */
-	gui_prefs.rom_hashtable = g_hash_table_new (g_str_hash, g_str_equal);
+	/* Create index of available ROMs in romsets */
+	gui_prefs.rom_index = gmameui_rom_index_new ();
+	dialog->priv->report = gmameui_space_report_new ();
+
+	g_timer_start (dialog->priv->timer);
 
-	g_timer_start (timer);
-	
 	/* Get list of available romset zipfiles */
 	get_avail_romsets (dialog);
-	GMAMEUI_DEBUG ("  Romset rebuild - got list of all available romsets in %0.2f seconds", g_timer_elapsed (timer, NULL));
+	GMAMEUI_DEBUG ("  Romset rebuild - got list of all available romsets in %0.2f seconds", g_timer_elapsed (dialog->priv->timer, NULL));
 
-	/* Add the contents of all the available romsets to a hash table */
-	g_list_foreach (dialog->priv->avail_romsets, (GFunc) add_romset_contents_to_hashtable, NULL);
-	GMAMEUI_DEBUG ("  Romset rebuild - added contents of available romsets to hashtable in %0.2f seconds", g_timer_elapsed (timer, NULL));
-
-	g_timer_start (timer);
+	/* Fixes found by an earlier scan are out of date */
+	gmameui_romfix_list_clear (gui_prefs.fixes);
 
 	g_signal_connect (G_OBJECT (gui_prefs.fixes), "romfix-list-added",
 	                  G_CALLBACK (on_romset_fix_found), dialog);
-	
-	/* Find fix for each romset */
-	g_list_foreach (dialog->priv->avail_romsets, (GFunc) romset_find_fixes, dialog);
-
-	GMAMEUI_DEBUG ("  Romset rebuild - finished in %0.2f seconds", g_timer_elapsed (timer, NULL));
-
-	/* Ask user whether they want to have more detailed look for missing ROMs */
+	g_signal_connect (G_OBJECT (gui_prefs.fixes), "romfix-list-changed",
+	                  G_CALLBACK (on_romset_fix_changed), dialog);
+
+	/* The number of zipfiles being read at the same time */
+	g_object_get (main_gui.gui_prefs, "rommgr-io-depth", &io_depth, NULL);
+	io_depth = CLAMP (io_depth, 1, 64);
+
+	dialog->priv->results = g_async_queue_new ();
+	dialog->priv->pool = g_thread_pool_new (scan_romset_worker, dialog,
+						io_depth, FALSE, &error);
+	if (error) {
+		GMAMEUI_DEBUG ("Error creating romset scan thread pool - %s", error->message);
+		g_error_free (error);
+		scan_finished (dialog);
+		return FALSE;
+	}
 
-	/* Enable fix button */
-	widget = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "btn_fix"));
-	gtk_widget_set_sensitive (widget, TRUE);
-	
-	/* Destroy hash table */
-	GMAMEUI_DEBUG ("Destroying rom hashtable...");
-	g_hash_table_destroy (gui_prefs.rom_hashtable);
-	g_hash_table_unref (gui_prefs.rom_hashtable);	/* FIXME TODO Is this needed after destroy? */
-	GMAMEUI_DEBUG ("Destroying rom hashtable... done");
+	/* Add the contents of all the available romsets to the ROM index */
+	queue_scan_phase (dialog, SCAN_PHASE_LIST);
+	dialog->priv->results_sourceid = g_timeout_add (SCAN_RESULTS_INTERVAL,
+							collect_scan_results,
+							dialog);
 
-	g_timer_destroy (timer);
-	
 /*
-For each zip file in romdir 
+For each zip file in romdir
 	Open zip file
 	For each file in romset
 		Add available files to hash table
@@ -352,7 +823,7 @@ For each zip file in romdir
 				Copy zip file to backup dir
 				backedup = true
 			Else
-				Add to notify queue	
+				Add to notify queue
 		If not found and not merged rom (i.e. should exist in parent)
 			Add romset to 'fixable' GList - GList of items to review from the hash table
 		End if
@@ -382,33 +853,40 @@ samsho2 uses neogeo bios, so reports roms as missing
 	return FALSE;
 }
 
-/* Triggered whenever the model is told to refilter */
-static gboolean
-filter_func (GtkTreeModel *model,
-             GtkTreeIter  *iter,
-             GtkCheckButton *chk)
+/* Updates the status label as each zip is rewritten */
+static void
+on_romfix_zip_fixed (GMAMEUIRomfixList *fixeslist,
+		     gchar *romset_name,
+		     gpointer *data,
+		     gpointer user_data)
 {
-	gint toggled;
-	gint romset_status;
+	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) user_data;
+	romfix_zip_result *result = (romfix_zip_result *) data;
+	GtkWidget *label;
+	gchar *msg;
+	gdouble zip_rate, total_rate;
 
-	/* Get the gamename, and whether it is filtered by ROM, from the iter */
-	gtk_tree_model_get (model, iter, COL_STATUS, &romset_status, -1);
+	dialog->priv->fix_bytes += result->bytes;
+	dialog->priv->fix_seconds += result->seconds;
 
-	toggled = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (chk));
+	zip_rate = (result->seconds > 0) ? result->bytes / result->seconds : 0;
+	total_rate = (dialog->priv->fix_seconds > 0) ?
+		     dialog->priv->fix_bytes / dialog->priv->fix_seconds : 0;
 
-	/* Automatically hide romsets that are in the parent */
-	if (romset_status == 3)
-		return FALSE;
-	
-	if (toggled) {
-		/* If toggled, hide romsets and ROMs that are marked as "OK" */
-		return (romset_status != 1);
-	} else {
-		/* Show all the rows */
-		return TRUE;
-	}
+	GMAMEUI_DEBUG ("  Fixed %s - %" G_GUINT64_FORMAT " bytes in %0.2f seconds",
+		       romset_name, result->bytes, result->seconds);
+
+	msg = g_strdup_printf (_("%s %s (%d of %d) - %.1f MB/s, overall %.1f MB/s"),
+			       result->ok ? _("Fixed") : _("Failed to fix"),
+			       romset_name, result->index, result->total,
+			       zip_rate / (1024 * 1024), total_rate / (1024 * 1024));
 
-} 
+	label = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "lbl_fix_status"));
+	gtk_label_set_text (GTK_LABEL (label), msg);
+	g_free (msg);
+
+	UPDATE_GUI;
+}
 
 static void
 on_btn_fixes_clicked (GtkWidget *widget, gpointer user_data)
@@ -417,22 +895,219 @@ on_btn_fixes_clicked (GtkWidget *widget, gpointer user_data)
 
 	dialog = (GMAMEUIRomMgrDialog *) user_data;
 
-	GMAMEUI_DEBUG ("Clicked!");
-gmameui_romfix_list_process_fixes (gui_prefs.fixes);
-	GMAMEUI_DEBUG ("Done!");
+	gtk_widget_set_sensitive (widget, FALSE);
+
+	dialog->priv->fix_bytes = 0;
+	dialog->priv->fix_seconds = 0;
+
+	g_signal_connect (G_OBJECT (gui_prefs.fixes), "romfix-zip-fixed",
+	                  G_CALLBACK (on_romfix_zip_fixed), dialog);
+	gmameui_romfix_list_process_fixes (gui_prefs.fixes);
+	g_signal_handlers_disconnect_by_func (G_OBJECT (gui_prefs.fixes),
+					      G_CALLBACK (on_romfix_zip_fixed), dialog);
+
+	GMAMEUI_DEBUG ("Fixes applied - %" G_GUINT64_FORMAT " bytes written in %0.2f seconds",
+		       dialog->priv->fix_bytes, dialog->priv->fix_seconds);
+}
+
+static void
+set_fix_status (GMAMEUIRomMgrDialog *dialog, const gchar *msg)
+{
+	GtkWidget *label;
+
+	label = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "lbl_fix_status"));
+	gtk_label_set_text (GTK_LABEL (label), msg);
+}
+
+static void
+on_romset_family_converted (const gchar *parent, guint index, guint total, gpointer user_data)
+{
+	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) user_data;
+	gchar *msg;
+
+	msg = g_strdup_printf (_("Converted %s (%d of %d)"), parent, index, total);
+	set_fix_status (dialog, msg);
+	g_free (msg);
+}
+
+/* Asks the user to confirm the conversion, showing the space it is
+   expected to save */
+static gboolean
+confirm_romset_conversion (GMAMEUIRomMgrDialog *dialog, RomsetConvertPlan *plan)
+{
+	GtkWidget *msgdlg;
+	gdouble current, predicted;
+	gint response;
+
+	current = (gdouble) gmameui_romset_convert_plan_get_current_bytes (plan) / (1024 * 1024);
+	predicted = (gdouble) gmameui_romset_convert_plan_get_predicted_bytes (plan) / (1024 * 1024);
+
+	msgdlg = gtk_message_dialog_new (GTK_WINDOW (dialog),
+					 GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+					 GTK_MESSAGE_QUESTION,
+					 GTK_BUTTONS_OK_CANCEL,
+					 _("Convert the romsets?"));
+	gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdlg),
+						  _("%d zips will be written and %d removed. "
+						    "They take %.1f MB now, and will take about %.1f MB (%+.1f MB)."),
+						  gmameui_romset_convert_plan_get_num_zips (plan),
+						  gmameui_romset_convert_plan_get_num_removed (plan),
+						  current, predicted, predicted - current);
+
+	response = gtk_dialog_run (GTK_DIALOG (msgdlg));
+	gtk_widget_destroy (msgdlg);
+
+	return (response == GTK_RESPONSE_OK);
+}
+
+/* Rewrites the whole collection in the layout chosen in the combo box */
+static void
+on_btn_convert_clicked (GtkWidget *widget, gpointer user_data)
+{
+	GMAMEUIRomMgrDialog *dialog;
+	RomsetConvertPlan *plan;
+	RomsetConvertResult result;
+	GtkWidget *combo, *btn_fix;
+	gint layout, io_depth;
+	gchar *msg;
+
+	dialog = (GMAMEUIRomMgrDialog *) user_data;
+
+	combo = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "cmb_layout"));
+	layout = gtk_combo_box_get_active (GTK_COMBO_BOX (combo));
+	g_return_if_fail ((layout >= 0) && (layout < NUM_ROMSET_LAYOUTS));
+
+	set_fix_status (dialog, _("Working out the changes to the romsets..."));
+	UPDATE_GUI;
+
+	plan = gmameui_romset_convert_plan_new (layout);
+
+	if ((gmameui_romset_convert_plan_get_num_zips (plan) == 0) &&
+	    (gmameui_romset_convert_plan_get_num_removed (plan) == 0)) {
+		set_fix_status (dialog, _("The romsets already have this layout"));
+		gmameui_romset_convert_plan_free (plan);
+		return;
+	}
+
+	if (!confirm_romset_conversion (dialog, plan)) {
+		set_fix_status (dialog, "");
+		gmameui_romset_convert_plan_free (plan);
+		return;
+	}
+
+	/* The fixes found by the scan no longer apply once the zips change */
+	btn_fix = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "btn_fix"));
+	gtk_widget_set_sensitive (btn_fix, FALSE);
+	gtk_widget_set_sensitive (widget, FALSE);
+
+	g_object_get (main_gui.gui_prefs, "rommgr-io-depth", &io_depth, NULL);
+
+	gmameui_romset_convert_run (plan, gui_prefs.fixes, io_depth,
+				    on_romset_family_converted, dialog, &result);
+
+	msg = g_strdup_printf (_("Converted %d romsets in %.0f seconds - %.1f MB before, %.1f MB after "
+				 "(predicted %.1f MB), %d could not be converted"),
+			       result.families, result.seconds,
+			       (gdouble) result.bytes_before / (1024 * 1024),
+			       (gdouble) result.bytes_after / (1024 * 1024),
+			       (gdouble) gmameui_romset_convert_plan_get_predicted_bytes (plan) / (1024 * 1024),
+			       result.failed);
+	set_fix_status (dialog, msg);
+	g_free (msg);
+
+	/* A family that failed part way and couldn't be put back is left in
+	   the journal, to be restored or kept */
+	recover_interrupted_fixes (dialog);
+
+	gmameui_romset_convert_plan_free (plan);
+
+	gtk_widget_set_sensitive (widget, TRUE);
 }
 
+/* If a previous run of fixes was interrupted, asks whether to restore the
+   zips it rewrote or keep them */
 static void
-on_hidecorrectromsets_toggled (GtkWidget *widget, gpointer user_data)
+recover_interrupted_fixes (GMAMEUIRomMgrDialog *dialog)
+{
+	GtkWidget *msgdlg;
+	gint response;
+
+	if (!gmameui_romfix_list_is_interrupted (gui_prefs.fixes))
+		return;
+
+	msgdlg = gtk_message_dialog_new (GTK_WINDOW (dialog),
+					 GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+					 GTK_MESSAGE_QUESTION,
+					 GTK_BUTTONS_NONE,
+					 _("The last romset fix was interrupted"));
+	gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdlg),
+						  _("The romsets fixed before it stopped can be restored to how they were, or kept. Romsets that weren't reached are unchanged."));
+	gtk_dialog_add_buttons (GTK_DIALOG (msgdlg),
+				_("_Restore"), GTK_RESPONSE_REJECT,
+				_("_Keep"), GTK_RESPONSE_ACCEPT,
+				NULL);
+	gtk_dialog_set_default_response (GTK_DIALOG (msgdlg), GTK_RESPONSE_ACCEPT);
+
+	response = gtk_dialog_run (GTK_DIALOG (msgdlg));
+	gtk_widget_destroy (msgdlg);
+
+	gmameui_romfix_list_recover (gui_prefs.fixes, response == GTK_RESPONSE_REJECT);
+}
+
+/* Statuses in the order they are listed in cmb_status_filter, after
+   the first entry showing every status */
+static const gint status_filter_statuses[] = {
+	ROMFIX_STATUS_NOK,
+	ROMFIX_STATUS_RENAME,
+	ROMFIX_STATUS_INPARENT,
+	ROMFIX_STATUS_DUPEPARENT,
+	ROMFIX_STATUS_COPY,
+	ROMFIX_STATUS_BIOS,
+};
+
+/* Works out the statuses to show from the filter widgets, and tells the
+   model to show them. The view is detached while the rows are replaced */
+static void
+on_status_filter_changed (GtkWidget *widget, gpointer user_data)
 {
 	GMAMEUIRomMgrDialog *dialog;
+	GtkWidget *chk, *cmb;
+	guint mask;
+	gint active;
 
 	dialog = (GMAMEUIRomMgrDialog *) user_data;
 
-	/* Good reference for filtering:
-	   http://tadeboro.blogspot.com/2009/05/gtktreemodel-and-filtering-4.html */
+	chk = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "chk_hideok"));
+	cmb = GTK_WIDGET (gtk_builder_get_object (dialog->priv->builder, "cmb_status_filter"));
+
+	active = gtk_combo_box_get_active (GTK_COMBO_BOX (cmb));
+	if ((active > 0) && (active <= (gint) G_N_ELEMENTS (status_filter_statuses))) {
+		mask = ROMFIX_STATUS_MASK (status_filter_statuses[active - 1]);
+	} else {
+		/* Automatically hide ROMs that are in the parent */
+		mask = ROMFIX_STATUS_MASK_ALL & ~ROMFIX_STATUS_MASK (ROMFIX_STATUS_INPARENT);
+	}
+
+	/* Hide romsets and ROMs that are marked as "OK" */
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (chk)))
+		mask &= ~ROMFIX_STATUS_MASK (ROMFIX_STATUS_OK);
+
+	if (mask == gmameui_romfix_model_get_status_filter (dialog->priv->model))
+		return;
+
+	g_object_ref (dialog->priv->model);
+	gtk_tree_view_set_model (dialog->priv->tv, NULL);
+	gmameui_romfix_model_set_status_filter (dialog->priv->model, mask);
+	gtk_tree_view_set_model (dialog->priv->tv, GTK_TREE_MODEL (dialog->priv->model));
+	g_object_unref (dialog->priv->model);
+}
+
+static void
+on_row_collapsed (GtkTreeView *treeview, GtkTreeIter *iter, GtkTreePath *path, gpointer user_data)
+{
+	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) user_data;
 
-	gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (dialog->priv->filter_model));
+	gmameui_romfix_model_collapse (dialog->priv->model, iter);
 }
 
 static void
@@ -456,6 +1131,201 @@ on_row_selected (GtkTreeSelection *selection, gpointer data)
 }
 
 
+enum {
+	REPORT_COL_NAME,
+	REPORT_COL_ROMSETS,
+	REPORT_COL_COMPRESSED,
+	REPORT_COL_UNCOMPRESSED,
+	REPORT_COL_DUPLICATED,
+	NUM_REPORT_COLUMNS
+};
+
+#define RESPONSE_EXPORT 1
+
+/* Shows a size column in MB */
+static void
+report_size_data_func (GtkTreeViewColumn *column, GtkCellRenderer *renderer,
+		       GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data)
+{
+	guint64 size;
+	gchar *text;
+
+	gtk_tree_model_get (model, iter, GPOINTER_TO_INT (user_data), &size, -1);
+
+	text = g_strdup_printf ("%.1f MB", (gdouble) size / (1024 * 1024));
+	g_object_set (renderer, "text", text, NULL);
+	g_free (text);
+}
+
+static void
+fill_report_store (GtkListStore *store, GmameuiSpaceReport *report, SpaceReportGrouping grouping)
+{
+	GList *groups, *ptr;
+
+	gtk_list_store_clear (store);
+
+	groups = gmameui_space_report_get_groups (report, grouping);
+	for (ptr = groups; ptr; ptr = g_list_next (ptr)) {
+		SpaceReportGroup *group = (SpaceReportGroup *) ptr->data;
+		GtkTreeIter iter;
+
+		gtk_list_store_append (store, &iter);
+		gtk_list_store_set (store, &iter,
+				    REPORT_COL_NAME, group->name,
+				    REPORT_COL_ROMSETS, group->romsets,
+				    REPORT_COL_COMPRESSED, group->compressed,
+				    REPORT_COL_UNCOMPRESSED, group->uncompressed,
+				    REPORT_COL_DUPLICATED, group->duplicated,
+				    -1);
+	}
+	g_list_free (groups);
+}
+
+static void
+on_report_grouping_changed (GtkComboBox *combo, gpointer user_data)
+{
+	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) user_data;
+	GtkListStore *store;
+
+	store = g_object_get_data (G_OBJECT (combo), "store");
+	fill_report_store (store, dialog->priv->report, gtk_combo_box_get_active (combo));
+}
+
+/* Saves the report for the current grouping as CSV */
+static void
+export_space_report (GMAMEUIRomMgrDialog *dialog, GtkWidget *parent, SpaceReportGrouping grouping)
+{
+	GtkWidget *chooser;
+	GError *error = NULL;
+
+	chooser = gtk_file_chooser_dialog_new (_("Export Space Report"),
+					       GTK_WINDOW (parent),
+					       GTK_FILE_CHOOSER_ACTION_SAVE,
+					       GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+					       GTK_STOCK_SAVE, GTK_RESPONSE_ACCEPT,
+					       NULL);
+	gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (chooser), TRUE);
+	gtk_file_chooser_set_current_name (GTK_FILE_CHOOSER (chooser), "romsets.csv");
+
+	if (gtk_dialog_run (GTK_DIALOG (chooser)) == GTK_RESPONSE_ACCEPT) {
+		gchar *filename;
+
+		filename = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (chooser));
+		if (!gmameui_space_report_write_csv (dialog->priv->report, grouping, filename, &error)) {
+			gmameui_message (ERROR, GTK_WINDOW (parent), "%s", error->message);
+			g_error_free (error);
+		}
+		g_free (filename);
+	}
+
+	gtk_widget_destroy (chooser);
+}
+
+/* Shows the disk space taken by the romsets, grouped by driver,
+   manufacturer, year or category. Every column can be sorted */
+static void
+on_btn_report_clicked (GtkWidget *widget, gpointer user_data)
+{
+	GMAMEUIRomMgrDialog *dialog = (GMAMEUIRomMgrDialog *) user_data;
+	const SpaceReportGroup *total;
+	GtkWidget *reportdlg, *vbox, *combo, *scrolled, *tv, *label;
+	GtkListStore *store;
+	gchar *msg;
+	gint i;
+
+	static const gchar *column_titles[NUM_REPORT_COLUMNS] = {
+		NULL, N_("Romsets"), N_("Size on disk"), N_("Uncompressed"), N_("Duplicated")
+	};
+
+	g_return_if_fail (dialog->priv->report != NULL);
+
+	reportdlg = gtk_dialog_new_with_buttons (_("Romset Space Report"),
+						 GTK_WINDOW (dialog),
+						 GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+						 _("_Export..."), RESPONSE_EXPORT,
+						 GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE,
+						 NULL);
+	gtk_window_set_default_size (GTK_WINDOW (reportdlg), 600, 450);
+	gtk_dialog_set_has_separator (GTK_DIALOG (reportdlg), FALSE);
+
+	vbox = gtk_vbox_new (FALSE, 6);
+	gtk_container_set_border_width (GTK_CONTAINER (vbox), 6);
+	gtk_box_pack_start (GTK_BOX (GTK_DIALOG (reportdlg)->vbox), vbox, TRUE, TRUE, 0);
+
+	/* Totals for the whole collection */
+	total = gmameui_space_report_get_total (dialog->priv->report);
+	msg = g_strdup_printf (_("%d romsets take %.1f MB on disk (%.1f MB uncompressed). "
+				 "%.1f MB is duplicated, of which %.1f MB is shared by parents and clones."),
+			       total->romsets,
+			       (gdouble) total->compressed / (1024 * 1024),
+			       (gdouble) total->uncompressed / (1024 * 1024),
+			       (gdouble) total->duplicated / (1024 * 1024),
+			       (gdouble) gmameui_space_report_get_family_duplicated (dialog->priv->report) / (1024 * 1024));
+	label = gtk_label_new (msg);
+	gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+	gtk_misc_set_alignment (GTK_MISC (label), 0, 0.5);
+	gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 0);
+	g_free (msg);
+
+	store = gtk_list_store_new (NUM_REPORT_COLUMNS,
+				    G_TYPE_STRING, G_TYPE_UINT,
+				    G_TYPE_UINT64, G_TYPE_UINT64, G_TYPE_UINT64);
+
+	combo = gtk_combo_box_new_text ();
+	gtk_combo_box_append_text (GTK_COMBO_BOX (combo), _("By driver"));
+	gtk_combo_box_append_text (GTK_COMBO_BOX (combo), _("By manufacturer"));
+	gtk_combo_box_append_text (GTK_COMBO_BOX (combo), _("By year"));
+	gtk_combo_box_append_text (GTK_COMBO_BOX (combo), _("By category"));
+	g_object_set_data (G_OBJECT (combo), "store", store);
+	g_signal_connect (G_OBJECT (combo), "changed",
+			  G_CALLBACK (on_report_grouping_changed), dialog);
+	gtk_box_pack_start (GTK_BOX (vbox), combo, FALSE, FALSE, 0);
+
+	scrolled = gtk_scrolled_window_new (NULL, NULL);
+	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled),
+					GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scrolled), GTK_SHADOW_IN);
+	gtk_box_pack_start (GTK_BOX (vbox), scrolled, TRUE, TRUE, 0);
+
+	tv = gtk_tree_view_new_with_model (GTK_TREE_MODEL (store));
+	g_object_unref (store);
+	gtk_container_add (GTK_CONTAINER (scrolled), tv);
+
+	for (i = 0; i < NUM_REPORT_COLUMNS; i++) {
+		GtkTreeViewColumn *column;
+		GtkCellRenderer *renderer;
+
+		renderer = gtk_cell_renderer_text_new ();
+		column = gtk_tree_view_column_new ();
+		gtk_tree_view_column_set_title (column, column_titles[i] ? _(column_titles[i]) : _("Name"));
+		gtk_tree_view_column_pack_start (column, renderer, TRUE);
+		gtk_tree_view_column_set_sort_column_id (column, i);
+		gtk_tree_view_column_set_resizable (column, TRUE);
+
+		if (i == REPORT_COL_NAME) {
+			gtk_tree_view_column_add_attribute (column, renderer, "text", i);
+			gtk_tree_view_column_set_expand (column, TRUE);
+		} else if (i == REPORT_COL_ROMSETS) {
+			gtk_tree_view_column_add_attribute (column, renderer, "text", i);
+		} else {
+			gtk_tree_view_column_set_cell_data_func (column, renderer,
+								 report_size_data_func,
+								 GINT_TO_POINTER (i), NULL);
+		}
+
+		gtk_tree_view_append_column (GTK_TREE_VIEW (tv), column);
+	}
+
+	gtk_combo_box_set_active (GTK_COMBO_BOX (combo), SPACE_REPORT_BY_DRIVER);
+
+	gtk_widget_show_all (vbox);
+
+	while (gtk_dialog_run (GTK_DIALOG (reportdlg)) == RESPONSE_EXPORT)
+		export_space_report (dialog, reportdlg, gtk_combo_box_get_active (GTK_COMBO_BOX (combo)));
+
+	gtk_widget_destroy (reportdlg);
+}
+
 /* Boilerplate functions */
 static GObject *
 gmameui_rommgr_dialog_constructor (GType                  type,
@@ -503,7 +1373,6 @@ gmameui_rommgr_dialog_init (GMAMEUIRomMgrDialog *dialog)
 
 	GtkTreeSelection *select;	/* Handle rows in the treeview being selected */
 	GtkWidget *rommgr_vbox;
-	GtkWidget *chk_hidecorrectromsets;
 	GtkWidget *widget;
 
 	GError *error = NULL;
@@ -512,8 +1381,9 @@ gmameui_rommgr_dialog_init (GMAMEUIRomMgrDialog *dialog)
 		"vbox1",
 		"romset_treeview",
 		"roms_listview",
-		"treestore1",
 		"liststore1",
+		"model_layout",
+		"model_status_filter",
 		"chk_hideok",
 		NULL
 	};
@@ -554,28 +1424,27 @@ gmameui_rommgr_dialog_init (GMAMEUIRomMgrDialog *dialog)
 	gtk_dialog_add_button (GTK_DIALOG (dialog), GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE);
 
 	/* Set up the stores */
-	priv->treestore = gtk_builder_get_object (priv->builder, "treestore1");
 	priv->liststore = gtk_builder_get_object (priv->builder, "liststore1");
 	priv->tv = gtk_builder_get_object (priv->builder, "romset_treeview");
 	/*priv->lv = gtk_builder_get_object (priv->builder, "roms_listview");
 	gtk_tree_view_set_model (priv->tv, priv->treestore);
 	gtk_tree_view_set_model (priv->lv, priv->liststore);*/
 
-	/* Checkbox hiding rows that are correct */
-	chk_hidecorrectromsets = GTK_WIDGET (gtk_builder_get_object (priv->builder, "chk_hideok"));
-	g_signal_connect (G_OBJECT (chk_hidecorrectromsets), "toggled",
-	                  G_CALLBACK (on_hidecorrectromsets_toggled), dialog);
-	
-	/* Wrap the model up in a filter model to allow the checkbox to filter rows */ 
-	priv->filter_model = gtk_tree_model_filter_new (GTK_TREE_MODEL (priv->treestore), NULL);
-	gtk_tree_model_filter_set_visible_func (GTK_TREE_MODEL_FILTER (priv->filter_model),
-						(GtkTreeModelFilterVisibleFunc) filter_func,
-						chk_hidecorrectromsets,
-						NULL);
-
-	/* Replace the current model (set in the GtkBuilder .ui file) with the
-	   filter model (containing the base model) */ 
-	gtk_tree_view_set_model (priv->tv, priv->filter_model);
+	/* The romsets found are listed by a model that filters them itself */
+	priv->model = gmameui_romfix_model_new ();
+	gtk_tree_view_set_model (priv->tv, GTK_TREE_MODEL (priv->model));
+	g_signal_connect (G_OBJECT (priv->tv), "row-collapsed",
+	                  G_CALLBACK (on_row_collapsed), dialog);
+
+	/* Checkbox hiding rows that are correct, and combo box showing a
+	   single status */
+	widget = GTK_WIDGET (gtk_builder_get_object (priv->builder, "chk_hideok"));
+	g_signal_connect (G_OBJECT (widget), "toggled",
+	                  G_CALLBACK (on_status_filter_changed), dialog);
+	widget = GTK_WIDGET (gtk_builder_get_object (priv->builder, "cmb_status_filter"));
+	g_signal_connect (G_OBJECT (widget), "changed",
+	                  G_CALLBACK (on_status_filter_changed), dialog);
+	on_status_filter_changed (widget, dialog);
 
 	/* Add a selection handler for when an item in the tree is clicked */
 	select = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tv));
@@ -584,11 +1453,24 @@ gmameui_rommgr_dialog_init (GMAMEUIRomMgrDialog *dialog)
 	                  G_CALLBACK (on_row_selected), NULL);
 	
 	dialog->priv->avail_romsets = NULL;
+	dialog->priv->avail_paths = g_hash_table_new_full (g_str_hash, g_str_equal,
+							   g_free, g_free);
+	dialog->priv->disk_verifies = NULL;
 
 	widget = GTK_WIDGET (gtk_builder_get_object (priv->builder, "btn_fix"));
 	g_signal_connect (G_OBJECT (widget), "clicked",
 	                  G_CALLBACK (on_btn_fixes_clicked), dialog);
 	gtk_widget_set_sensitive (widget, FALSE);
+
+	widget = GTK_WIDGET (gtk_builder_get_object (priv->builder, "btn_convert"));
+	g_signal_connect (G_OBJECT (widget), "clicked",
+	                  G_CALLBACK (on_btn_convert_clicked), dialog);
+	gtk_widget_set_sensitive (widget, FALSE);
+
+	widget = GTK_WIDGET (gtk_builder_get_object (priv->builder, "btn_report"));
+	g_signal_connect (G_OBJECT (widget), "clicked",
+	                  G_CALLBACK (on_btn_report_clicked), dialog);
+	gtk_widget_set_sensitive (widget, FALSE);
 	
 	/* Initialise the counts */
 	dialog->priv->total_romsets = 0;
@@ -645,17 +1527,84 @@ static void
 gmameui_rommgr_dialog_destroy (GtkObject *object)
 {
 	GMAMEUIRomMgrDialog *dlg;
+	GList *ptr;
 	
 GMAMEUI_DEBUG ("Destroying gmameui romset mgr dialog...");	
 	dlg = GMAMEUI_ROMMGR_DIALOG (object);
 	
+	/* Stop the romset scan. Jobs still queued in the pool are skipped, and
+	   any results not yet collected are discarded */
+	if (dlg->priv->results_sourceid) {
+		g_source_remove (dlg->priv->results_sourceid);
+		dlg->priv->results_sourceid = 0;
+	}
+	g_atomic_int_set (&dlg->priv->cancelled, TRUE);
+	if (dlg->priv->verifier)
+		gmameui_rom_verifier_cancel (dlg->priv->verifier);
+	if (dlg->priv->pool) {
+		g_thread_pool_free (dlg->priv->pool, FALSE, TRUE);
+		dlg->priv->pool = NULL;
+	}
+	if (dlg->priv->verifier) {
+		/* Romsets verified so far stay recorded for the next run */
+		gmameui_rom_verifier_free (dlg->priv->verifier);
+		dlg->priv->verifier = NULL;
+	}
+	if (dlg->priv->results) {
+		scan_job *job;
+
+		while ((job = g_async_queue_try_pop (dlg->priv->results)) != NULL)
+			scan_job_free (job);
+		g_async_queue_unref (dlg->priv->results);
+		dlg->priv->results = NULL;
+	}
+	g_signal_handlers_disconnect_by_func (G_OBJECT (gui_prefs.fixes),
+					      G_CALLBACK (on_romset_fix_found), dlg);
+	g_signal_handlers_disconnect_by_func (G_OBJECT (gui_prefs.fixes),
+					      G_CALLBACK (on_romset_fix_changed), dlg);
+	if (dlg->priv->timer) {
+		/* Scan didn't complete */
+		if (gui_prefs.rom_index) {
+			gmameui_rom_index_free (gui_prefs.rom_index);
+			gui_prefs.rom_index = NULL;
+		}
+		g_timer_destroy (dlg->priv->timer);
+		dlg->priv->timer = NULL;
+	}
+
 	if (dlg->priv->builder)
 		g_object_unref (dlg->priv->builder);
 
+	if (dlg->priv->report) {
+		gmameui_space_report_free (dlg->priv->report);
+		dlg->priv->report = NULL;
+	}
+
+	/* The tree view holds its own reference until it is destroyed */
+	if (dlg->priv->model) {
+		g_object_unref (dlg->priv->model);
+		dlg->priv->model = NULL;
+	}
+
 	/* Unref the list of avail roms */
 	g_list_foreach (dlg->priv->avail_romsets, (GFunc) g_free, NULL);
 	g_list_free (dlg->priv->avail_romsets);
 	dlg->priv->avail_romsets = NULL;
+	if (dlg->priv->avail_paths) {
+		g_hash_table_destroy (dlg->priv->avail_paths);
+		dlg->priv->avail_paths = NULL;
+	}
+
+	/* Stop any CHD deep verifies - the callback still runs, but no longer
+	   references the dialog */
+	for (ptr = dlg->priv->disk_verifies; ptr; ptr = g_list_next (ptr)) {
+		disk_verify *dv = (disk_verify *) ptr->data;
+
+		dv->dialog = NULL;
+		gmameui_chd_deep_verify_cancel (dv->verify);
+	}
+	g_list_free (dlg->priv->disk_verifies);
+	dlg->priv->disk_verifies = NULL;
 	
 	g_object_unref (dlg->priv);
 	
@@ -0,0 +1,916 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#include "gmameui-romset-convert.h"
+#include "gmameui-zip-cache.h"
+#include "gmameui-zip-writer.h"
+#include "gmameui-archive.h"
+#include "gmameui-rom-index.h"
+#include "gmameui.h"
+#include "game_list.h"
+#include "rom_entry.h"
+
+/* Sizes of the fixed parts of the zip records, used to predict the size
+   of the new zips */
+#define ZIP_LOCAL_SIZE		30
+#define ZIP_CENTRAL_SIZE	46
+#define ZIP_EOCD_SIZE		22
+
+#define ZIP_FLAG_ENCRYPTED	0x0001
+
+/* A file in a new zip, and where its compressed data is copied from */
+typedef struct {
+	gchar *name;
+	ZipDirectory *src;
+	const ZipCacheEntry *entry;	/* Belongs to src */
+} ConvertMember;
+
+/* A zip to be written or removed */
+typedef struct {
+	gchar *path;
+	ZipDirectory *dir;		/* Current contents, or NULL if the zip is new */
+	GList *members;			/* ConvertMember, in the order to write them */
+	gboolean remove;
+	guint64 current_size;
+	guint64 predicted_size;
+	ZipWriter *writer;		/* Used while converting */
+	gboolean committed;		/* Put in place, or removed */
+} ConvertZip;
+
+/* A parent and its clones. Their zips copy ROMs from each other, so they
+   are converted together */
+typedef struct {
+	gchar *parent;
+	GList *zips;			/* ConvertZip */
+
+	gboolean ok;
+	guint zips_written;
+	guint zips_removed;
+	guint64 bytes_before;
+	guint64 bytes_after;
+} ConvertFamily;
+
+/* A romset of a family, while the family is planned */
+typedef struct {
+	MameRomEntry *romset;
+	gchar *path;
+	ZipDirectory *dir;
+} FamilyMember;
+
+struct _RomsetConvertPlan {
+	RomsetLayout layout;
+	GList *families;		/* ConvertFamily */
+
+	guint num_zips;
+	guint num_removed;
+	guint64 current_bytes;
+	guint64 predicted_bytes;
+};
+
+typedef struct {
+	GMAMEUIRomfixList *fixeslist;
+	GAsyncQueue *results;
+	volatile gint incomplete;	/* A family couldn't be put back after failing */
+} ConvertRun;
+
+static gchar *
+get_rom_key (guint32 crc, guint64 size)
+{
+	return g_strdup_printf ("%08x:%" G_GUINT64_FORMAT, crc, size);
+}
+
+/* Identifies a file of a new zip. Romsets can have several ROMs with the
+   same data under different names, each of which MAME looks for */
+static gchar *
+get_member_key (const gchar *name, guint32 crc)
+{
+	gchar *folded, *key;
+
+	folded = g_ascii_strdown (name, -1);
+	key = g_strdup_printf ("%s:%08x", folded, crc);
+	g_free (folded);
+
+	return key;
+}
+
+/* Whether the ROM has data that can be looked for */
+static gboolean
+rom_is_dumped (individual_rom *rom)
+{
+	return (rom->crc != NULL) &&
+	       ((rom->status == NULL) || (g_ascii_strcasecmp (rom->status, "nodump") != 0));
+}
+
+/* Returns the set of ROMs in the parent's BIOS, if it has one. BIOS ROMs
+   stay in the BIOS zip whatever the layout */
+static GHashTable *
+get_bios_keys (MameRomEntry *parent)
+{
+	GHashTable *keys;
+	MameRomEntry *bios;
+	gchar *romof;
+	GList *roms;
+
+	keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	g_object_get (parent, "romof", &romof, NULL);
+	if ((romof == NULL) || (g_ascii_strcasecmp (romof, "-") == 0) ||
+	    (g_ascii_strcasecmp (romof, mame_rom_entry_get_romname (parent)) == 0)) {
+		g_free (romof);
+		return keys;
+	}
+
+	bios = get_rom_from_gamelist_by_name (gui_prefs.gl, romof);
+	g_free (romof);
+
+	for (roms = bios ? mame_rom_entry_get_roms (bios) : NULL; roms; roms = g_list_next (roms)) {
+		individual_rom *rom = (individual_rom *) roms->data;
+
+		if (rom_is_dumped (rom))
+			g_hash_table_insert (keys,
+					     get_rom_key (gmameui_rom_index_parse_crc (rom->crc), rom->uncomp_size),
+					     GINT_TO_POINTER (TRUE));
+	}
+
+	return keys;
+}
+
+static gboolean
+rom_is_in_bios (individual_rom *rom, GHashTable *bios_keys)
+{
+	gchar *key;
+	gboolean found;
+
+	if (rom->merge == NULL)
+		return FALSE;
+
+	key = get_rom_key (gmameui_rom_index_parse_crc (rom->crc), rom->uncomp_size);
+	found = (g_hash_table_lookup (bios_keys, key) != NULL);
+	g_free (key);
+
+	return found;
+}
+
+/* Whether the ROM belongs in the romset's own zip in a split set */
+static gboolean
+rom_is_own (individual_rom *rom, gboolean is_clone, GHashTable *bios_keys)
+{
+	if (!rom_is_dumped (rom) || rom_is_in_bios (rom, bios_keys))
+		return FALSE;
+
+	return !is_clone || (rom->merge == NULL);
+}
+
+static gboolean
+entry_can_be_copied (const ZipCacheEntry *entry)
+{
+	return !(entry->flags & ZIP_FLAG_ENCRYPTED) &&
+	       ((entry->method == 0) || (entry->method == 8));
+}
+
+static const ZipCacheEntry *
+find_entry (ZipDirectory *dir, const gchar *name, guint32 crc, guint64 size)
+{
+	const ZipCacheEntry *entry;
+	guint i;
+
+	/* Prefer the entry with the same name, so nothing needs renaming */
+	entry = name ? gmameui_zip_directory_find (dir, name) : NULL;
+	if (entry && (entry->crc == crc) && (entry->size == size) && entry_can_be_copied (entry))
+		return entry;
+
+	for (i = 0; i < gmameui_zip_directory_get_num_entries (dir); i++) {
+		entry = gmameui_zip_directory_get_nth_entry (dir, i);
+
+		if ((entry->crc == crc) && (entry->size == size) && entry_can_be_copied (entry))
+			return entry;
+	}
+
+	return NULL;
+}
+
+static ConvertMember *
+find_member (ConvertZip *zip, const gchar *name)
+{
+	GList *ptr;
+
+	for (ptr = zip->members; ptr; ptr = g_list_next (ptr)) {
+		ConvertMember *member = (ConvertMember *) ptr->data;
+
+		if (g_ascii_strcasecmp (member->name, name) == 0)
+			return member;
+	}
+
+	return NULL;
+}
+
+static void
+add_member (ConvertZip *zip, const gchar *name, ZipDirectory *src, const ZipCacheEntry *entry)
+{
+	ConvertMember *member;
+
+	member = g_new0 (ConvertMember, 1);
+	member->name = g_strdup (name);
+	member->src = gmameui_zip_directory_ref (src);
+	member->entry = entry;
+
+	zip->members = g_list_append (zip->members, member);
+}
+
+/* Adds the ROM to the new zip, copied from whichever zip of the family has
+   it - the zip itself first. ROMs that can't be found are left missing.
+   A ROM with the same name and CRC is only added once however many
+   romsets of the family need it, so merged sets hold a single copy of ROMs
+   shared with clones */
+static void
+add_rom (ConvertZip *zip, GList *members, GHashTable *added,
+	 individual_rom *rom, const gchar *prefix)
+{
+	const ZipCacheEntry *entry = NULL;
+	ZipDirectory *src = NULL;
+	guint32 crc;
+	gchar *key, *name;
+	GList *ptr;
+
+	crc = gmameui_rom_index_parse_crc (rom->crc);
+	key = get_member_key (rom->name, crc);
+
+	if (g_hash_table_lookup (added, key)) {
+		g_free (key);
+		return;
+	}
+
+	if (zip->dir) {
+		src = zip->dir;
+		entry = find_entry (src, rom->name, crc, rom->uncomp_size);
+	}
+
+	for (ptr = members; (entry == NULL) && ptr; ptr = g_list_next (ptr)) {
+		FamilyMember *fm = (FamilyMember *) ptr->data;
+
+		if ((fm->dir == NULL) || (fm->dir == zip->dir))
+			continue;
+
+		src = fm->dir;
+		entry = find_entry (src, rom->name, crc, rom->uncomp_size);
+	}
+
+	if (entry == NULL) {
+		g_free (key);
+		return;
+	}
+
+	/* A clone ROM in a merged set which has the name of a different
+	   parent ROM goes in a directory named after the clone */
+	name = g_strdup (rom->name);
+	if (find_member (zip, name) && prefix) {
+		g_free (name);
+		name = g_strdup_printf ("%s/%s", prefix, rom->name);
+	}
+
+	if (find_member (zip, name) == NULL) {
+		add_member (zip, name, src, entry);
+		g_hash_table_insert (added, key, GINT_TO_POINTER (TRUE));
+		key = NULL;
+	}
+
+	g_free (name);
+	g_free (key);
+}
+
+/* Whether the new zip would have the same files as the current one */
+static gboolean
+zip_is_unchanged (ConvertZip *zip)
+{
+	GList *ptr;
+
+	if ((zip->dir == NULL) ||
+	    (g_list_length (zip->members) != gmameui_zip_directory_get_num_entries (zip->dir)))
+		return FALSE;
+
+	for (ptr = zip->members; ptr; ptr = g_list_next (ptr)) {
+		ConvertMember *member = (ConvertMember *) ptr->data;
+
+		if ((member->src != zip->dir) || (strcmp (member->name, member->entry->name) != 0))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+convert_zip_free (ConvertZip *zip)
+{
+	GList *ptr;
+
+	for (ptr = zip->members; ptr; ptr = g_list_next (ptr)) {
+		ConvertMember *member = (ConvertMember *) ptr->data;
+
+		gmameui_zip_directory_unref (member->src);
+		g_free (member->name);
+		g_free (member);
+	}
+	g_list_free (zip->members);
+
+	if (zip->dir)
+		gmameui_zip_directory_unref (zip->dir);
+	if (zip->writer)
+		gmameui_zip_writer_free (zip->writer);
+	g_free (zip->path);
+	g_free (zip);
+}
+
+static void
+convert_family_free (ConvertFamily *family)
+{
+	g_list_foreach (family->zips, (GFunc) convert_zip_free, NULL);
+	g_list_free (family->zips);
+	g_free (family->parent);
+	g_free (family);
+}
+
+static void
+family_member_free (FamilyMember *fm)
+{
+	if (fm->dir)
+		gmameui_zip_directory_unref (fm->dir);
+	g_free (fm->path);
+	g_free (fm);
+}
+
+/* Reads the zips of the parent and its clones. Returns FALSE if any of
+   them is held in a 7z or a directory, or can't be read */
+static gboolean
+read_family_members (GList *members)
+{
+	GList *ptr;
+
+	for (ptr = members; ptr; ptr = g_list_next (ptr)) {
+		FamilyMember *fm = (FamilyMember *) ptr->data;
+		const gchar *romname;
+
+		romname = mame_rom_entry_get_romname (fm->romset);
+		fm->path = gmameui_archive_find_romset (romname);
+		if (fm->path == NULL)
+			continue;
+
+		if (!g_str_has_suffix (fm->path, ".zip")) {
+			GMAMEUI_DEBUG ("Can't convert %s - only zips can be rewritten", fm->path);
+			return FALSE;
+		}
+
+		fm->dir = gmameui_zip_cache_lookup (fm->path);
+		if (fm->dir == NULL) {
+			GMAMEUI_DEBUG ("Can't convert %s - the zip could not be read", fm->path);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Works out the contents of every zip of the family in the new layout.
+   Files in the zips that aren't ROMs of the family - including BIOS ROMs -
+   are kept where they are */
+static ConvertFamily *
+plan_family (RomsetLayout layout, MameRomEntry *parent, GList *clones)
+{
+	ConvertFamily *family;
+	GHashTable *bios_keys;
+	GHashTable *family_keys;	/* Every ROM of the family outside the BIOS */
+	GList *members = NULL;
+	GList *ptr, *roms;
+	gchar *basedir = NULL;
+	FamilyMember *fm;
+
+	fm = g_new0 (FamilyMember, 1);
+	fm->romset = parent;
+	members = g_list_append (members, fm);
+	for (ptr = clones; ptr; ptr = g_list_next (ptr)) {
+		fm = g_new0 (FamilyMember, 1);
+		fm->romset = (MameRomEntry *) ptr->data;
+		members = g_list_append (members, fm);
+	}
+
+	if (!read_family_members (members)) {
+		g_list_foreach (members, (GFunc) family_member_free, NULL);
+		g_list_free (members);
+		return NULL;
+	}
+
+	/* New zips go alongside the existing ones */
+	for (ptr = members; (basedir == NULL) && ptr; ptr = g_list_next (ptr)) {
+		fm = (FamilyMember *) ptr->data;
+		if (fm->path)
+			basedir = g_path_get_dirname (fm->path);
+	}
+
+	if (basedir == NULL) {
+		g_list_foreach (members, (GFunc) family_member_free, NULL);
+		g_list_free (members);
+		return NULL;
+	}
+
+	bios_keys = get_bios_keys (parent);
+	family_keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (ptr = members; ptr; ptr = g_list_next (ptr)) {
+		fm = (FamilyMember *) ptr->data;
+
+		for (roms = mame_rom_entry_get_roms (fm->romset); roms; roms = g_list_next (roms)) {
+			individual_rom *rom = (individual_rom *) roms->data;
+
+			if (rom_is_dumped (rom) && !rom_is_in_bios (rom, bios_keys))
+				g_hash_table_insert (family_keys,
+						     get_rom_key (gmameui_rom_index_parse_crc (rom->crc), rom->uncomp_size),
+						     GINT_TO_POINTER (TRUE));
+		}
+	}
+
+	family = g_new0 (ConvertFamily, 1);
+	family->parent = g_strdup (mame_rom_entry_get_romname (parent));
+
+	for (ptr = members; ptr; ptr = g_list_next (ptr)) {
+		ConvertZip *zip;
+		GHashTable *added;	/* ROMs already in the new zip */
+		gboolean is_clone;
+		GList *cptr;
+		guint i;
+
+		fm = (FamilyMember *) ptr->data;
+		is_clone = (ptr != members);
+
+		zip = g_new0 (ConvertZip, 1);
+		if (fm->path) {
+			struct stat st;
+
+			zip->path = g_strdup (fm->path);
+			zip->dir = gmameui_zip_directory_ref (fm->dir);
+			if (g_stat (zip->path, &st) == 0)
+				zip->current_size = (guint64) st.st_size;
+		} else {
+			gchar *filename;
+
+			filename = g_strdup_printf ("%s.zip", mame_rom_entry_get_romname (fm->romset));
+			zip->path = g_build_filename (basedir, filename, NULL);
+			g_free (filename);
+		}
+
+		added = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+		if (!is_clone || (layout != ROMSET_LAYOUT_MERGED)) {
+			for (roms = mame_rom_entry_get_roms (fm->romset); roms; roms = g_list_next (roms)) {
+				individual_rom *rom = (individual_rom *) roms->data;
+
+				if ((layout == ROMSET_LAYOUT_NON_MERGED) ?
+				    (rom_is_dumped (rom) && !rom_is_in_bios (rom, bios_keys)) :
+				    rom_is_own (rom, is_clone, bios_keys))
+					add_rom (zip, members, added, rom, NULL);
+			}
+		}
+
+		/* The parent of a merged set also holds what differs in each clone */
+		if (!is_clone && (layout == ROMSET_LAYOUT_MERGED)) {
+			for (cptr = g_list_next (members); cptr; cptr = g_list_next (cptr)) {
+				FamilyMember *clone = (FamilyMember *) cptr->data;
+
+				for (roms = mame_rom_entry_get_roms (clone->romset); roms; roms = g_list_next (roms)) {
+					individual_rom *rom = (individual_rom *) roms->data;
+
+					if (rom_is_own (rom, TRUE, bios_keys))
+						add_rom (zip, members, added, rom,
+							 mame_rom_entry_get_romname (clone->romset));
+				}
+			}
+		}
+
+		g_hash_table_destroy (added);
+
+		/* Keep anything that isn't a ROM of the family */
+		for (i = 0; zip->dir && (i < gmameui_zip_directory_get_num_entries (zip->dir)); i++) {
+			const ZipCacheEntry *entry;
+			gchar *key;
+
+			entry = gmameui_zip_directory_get_nth_entry (zip->dir, i);
+			key = get_rom_key (entry->crc, entry->size);
+			if (!g_hash_table_lookup (family_keys, key) && !find_member (zip, entry->name))
+				add_member (zip, entry->name, zip->dir, entry);
+			g_free (key);
+		}
+
+		if (zip->members == NULL)
+			zip->remove = (zip->dir != NULL);
+
+		if ((zip->members == NULL && !zip->remove) || zip_is_unchanged (zip)) {
+			convert_zip_free (zip);
+			continue;
+		}
+
+		if (!zip->remove) {
+			zip->predicted_size = ZIP_EOCD_SIZE;
+			for (cptr = zip->members; cptr; cptr = g_list_next (cptr)) {
+				ConvertMember *member = (ConvertMember *) cptr->data;
+
+				zip->predicted_size += ZIP_LOCAL_SIZE + ZIP_CENTRAL_SIZE +
+						       (2 * strlen (member->name)) +
+						       member->entry->compressed_size;
+			}
+		}
+
+		family->zips = g_list_append (family->zips, zip);
+	}
+
+	g_hash_table_destroy (family_keys);
+	g_hash_table_destroy (bios_keys);
+	g_free (basedir);
+	g_list_foreach (members, (GFunc) family_member_free, NULL);
+	g_list_free (members);
+
+	if (family->zips == NULL) {
+		convert_family_free (family);
+		return NULL;
+	}
+
+	return family;
+}
+
+/**
+ * gmameui_romset_convert_plan_new:
+ * @layout: the layout to convert the collection to
+ *
+ * Works out every zip that has to be written or removed to change the
+ * romsets in the ROM paths to the layout, and how much space it would
+ * save. Nothing is changed until the plan is run.
+ */
+RomsetConvertPlan *
+gmameui_romset_convert_plan_new (RomsetLayout layout)
+{
+	RomsetConvertPlan *plan;
+	GHashTable *clones;	/* Parent name -> GList of clone MameRomEntry */
+	GList *ptr;
+	GTimer *timer;
+
+	g_return_val_if_fail (layout < NUM_ROMSET_LAYOUTS, NULL);
+	g_return_val_if_fail (gui_prefs.gl != NULL, NULL);
+
+	timer = g_timer_new ();
+
+	plan = g_new0 (RomsetConvertPlan, 1);
+	plan->layout = layout;
+
+	gmameui_archive_index_rom_paths ();
+
+	clones = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (ptr = mame_gamelist_get_roms_glist (gui_prefs.gl); ptr; ptr = g_list_next (ptr)) {
+		MameRomEntry *rom = (MameRomEntry *) ptr->data;
+		const gchar *parent;
+		GList *list;
+
+		if (!mame_rom_entry_is_clone (rom))
+			continue;
+
+		parent = mame_rom_entry_get_parent_romname (rom);
+		list = g_hash_table_lookup (clones, parent);
+		g_hash_table_insert (clones, g_strdup (parent), g_list_append (list, rom));
+	}
+
+	for (ptr = mame_gamelist_get_roms_glist (gui_prefs.gl); ptr; ptr = g_list_next (ptr)) {
+		MameRomEntry *rom = (MameRomEntry *) ptr->data;
+		ConvertFamily *family;
+		GList *zips;
+
+		if (mame_rom_entry_is_clone (rom))
+			continue;
+
+		family = plan_family (layout, rom,
+				     g_hash_table_lookup (clones, mame_rom_entry_get_romname (rom)));
+		if (family == NULL)
+			continue;
+
+		for (zips = family->zips; zips; zips = g_list_next (zips)) {
+			ConvertZip *zip = (ConvertZip *) zips->data;
+
+			if (zip->remove)
+				plan->num_removed++;
+			else
+				plan->num_zips++;
+			plan->current_bytes += zip->current_size;
+			plan->predicted_bytes += zip->predicted_size;
+		}
+
+		plan->families = g_list_prepend (plan->families, family);
+	}
+	plan->families = g_list_reverse (plan->families);
+
+	for (ptr = g_hash_table_get_values (clones); ptr; ptr = g_list_delete_link (ptr, ptr))
+		g_list_free ((GList *) ptr->data);
+	g_hash_table_destroy (clones);
+
+	GMAMEUI_DEBUG ("Planned conversion of %d romset families in %0.2f seconds - %d zips to write, "
+		       "%d to remove, %" G_GUINT64_FORMAT " bytes now, %" G_GUINT64_FORMAT " predicted",
+		       g_list_length (plan->families), g_timer_elapsed (timer, NULL),
+		       plan->num_zips, plan->num_removed, plan->current_bytes, plan->predicted_bytes);
+	g_timer_destroy (timer);
+
+	return plan;
+}
+
+void
+gmameui_romset_convert_plan_free (RomsetConvertPlan *plan)
+{
+	g_return_if_fail (plan != NULL);
+
+	g_list_foreach (plan->families, (GFunc) convert_family_free, NULL);
+	g_list_free (plan->families);
+	g_free (plan);
+}
+
+guint
+gmameui_romset_convert_plan_get_num_zips (RomsetConvertPlan *plan)
+{
+	g_return_val_if_fail (plan != NULL, 0);
+
+	return plan->num_zips;
+}
+
+guint
+gmameui_romset_convert_plan_get_num_removed (RomsetConvertPlan *plan)
+{
+	g_return_val_if_fail (plan != NULL, 0);
+
+	return plan->num_removed;
+}
+
+guint64
+gmameui_romset_convert_plan_get_current_bytes (RomsetConvertPlan *plan)
+{
+	g_return_val_if_fail (plan != NULL, 0);
+
+	return plan->current_bytes;
+}
+
+guint64
+gmameui_romset_convert_plan_get_predicted_bytes (RomsetConvertPlan *plan)
+{
+	g_return_val_if_fail (plan != NULL, 0);
+
+	return plan->predicted_bytes;
+}
+
+/* Puts back the zips of the family that were already changed when a later
+   one failed, so the family is left as it was. Returns FALSE if any of
+   them couldn't be */
+static gboolean
+rollback_family (ConvertFamily *family)
+{
+	GList *ptr;
+	gboolean ok = TRUE;
+
+	for (ptr = family->zips; ptr; ptr = g_list_next (ptr)) {
+		ConvertZip *zip = (ConvertZip *) ptr->data;
+		gchar *backup;
+
+		if (!zip->committed)
+			continue;
+
+		/* Rewritten and removed zips were moved to the backup; new
+		   zips didn't exist */
+		backup = g_strdup_printf ("%s.bak", zip->path);
+		if (zip->dir) {
+			if (g_rename (backup, zip->path) != 0)
+				ok = FALSE;
+		} else if (g_unlink (zip->path) != 0) {
+			ok = FALSE;
+		}
+		gmameui_zip_cache_invalidate (zip->path);
+		g_free (backup);
+
+		zip->committed = FALSE;
+	}
+
+	family->zips_written = family->zips_removed = 0;
+	family->bytes_before = family->bytes_after = 0;
+
+	return ok;
+}
+
+/* Worker thread function. All the new zips of the family are written
+   before any is put in place, since they copy ROMs from each other's
+   current zips */
+static void
+convert_family_worker (gpointer data, gpointer user_data)
+{
+	ConvertFamily *family = (ConvertFamily *) data;
+	ConvertRun *run = (ConvertRun *) user_data;
+	GList *ptr, *mptr;
+
+	family->ok = TRUE;
+
+	for (ptr = family->zips; family->ok && ptr; ptr = g_list_next (ptr)) {
+		ConvertZip *zip = (ConvertZip *) ptr->data;
+
+		if (zip->remove)
+			continue;
+
+		zip->writer = gmameui_zip_writer_new (zip->path);
+		for (mptr = zip->members; family->ok && mptr; mptr = g_list_next (mptr)) {
+			ConvertMember *member = (ConvertMember *) mptr->data;
+
+			family->ok = gmameui_zip_writer_add (zip->writer, member->src,
+							     member->entry, member->name);
+		}
+
+		if (family->ok)
+			family->ok = gmameui_zip_writer_write (zip->writer);
+	}
+
+	if (!family->ok) {
+		GMAMEUI_DEBUG ("Could not convert %s - its zips are unchanged", family->parent);
+
+		for (ptr = family->zips; ptr; ptr = g_list_next (ptr)) {
+			ConvertZip *zip = (ConvertZip *) ptr->data;
+			gchar *tmpname;
+
+			tmpname = g_strdup_printf ("%s.tmp", zip->path);
+			g_unlink (tmpname);
+			g_free (tmpname);
+		}
+
+		g_async_queue_push (run->results, family);
+		return;
+	}
+
+	for (ptr = family->zips; family->ok && ptr; ptr = g_list_next (ptr)) {
+		ConvertZip *zip = (ConvertZip *) ptr->data;
+		gchar *backup;
+
+		backup = g_strdup_printf ("%s.bak", zip->path);
+
+		if (zip->remove) {
+			gmameui_romfix_list_journal_zip (run->fixeslist, ROMFIX_JOURNAL_REMOVE, zip->path);
+			if (g_rename (zip->path, backup) == 0) {
+				zip->committed = TRUE;
+				family->zips_removed++;
+				family->bytes_before += zip->current_size;
+			} else {
+				family->ok = FALSE;
+			}
+			gmameui_zip_cache_invalidate (zip->path);
+		} else {
+			gmameui_romfix_list_journal_zip (run->fixeslist,
+							 zip->dir ? ROMFIX_JOURNAL_REWRITE : ROMFIX_JOURNAL_CREATE,
+							 zip->path);
+			if (gmameui_zip_writer_commit (zip->writer, zip->dir ? backup : NULL)) {
+				zip->committed = TRUE;
+				family->zips_written++;
+				family->bytes_before += zip->current_size;
+				family->bytes_after += gmameui_zip_writer_get_bytes_written (zip->writer);
+			} else {
+				family->ok = FALSE;
+			}
+		}
+
+		g_free (backup);
+	}
+
+	/* The journal is kept if the family can't be put back, so the user
+	   is asked to recover it when the ROM manager is next opened */
+	if (!family->ok) {
+		if (rollback_family (family)) {
+			GMAMEUI_DEBUG ("Could not convert %s - its zips have been put back", family->parent);
+		} else {
+			GMAMEUI_DEBUG ("Could not convert %s, nor put its zips back - "
+				       "it can be recovered from the journal", family->parent);
+			g_atomic_int_set (&run->incomplete, TRUE);
+		}
+	}
+
+	g_async_queue_push (run->results, family);
+}
+
+/**
+ * gmameui_romset_convert_run:
+ * @plan: the plan
+ * @fixeslist: the fix list, whose journal records each zip as it changes
+ * @threads: the number of families to convert at the same time
+ * @func: called as each family is converted
+ * @user_data: data for @func
+ * @result: filled in with the zips changed and the space saved
+ *
+ * Converts the zips in the plan, keeping the GUI responsive. The zips are
+ * recorded in the ROM manager journal, so an interrupted conversion is
+ * offered for recovery the same as an interrupted run of fixes. Returns
+ * FALSE if any family could not be converted.
+ */
+gboolean
+gmameui_romset_convert_run (RomsetConvertPlan *plan,
+			    GMAMEUIRomfixList *fixeslist,
+			    gint threads,
+			    RomsetConvertProgressFunc func,
+			    gpointer user_data,
+			    RomsetConvertResult *result)
+{
+	ConvertRun run;
+	GThreadPool *pool;
+	GTimer *timer;
+	GError *error = NULL;
+	GList *ptr;
+	guint index, total, pending;
+
+	g_return_val_if_fail (plan != NULL, FALSE);
+	g_return_val_if_fail (fixeslist != NULL, FALSE);
+	g_return_val_if_fail (result != NULL, FALSE);
+
+	/* Don't start over the top of a run that hasn't been recovered */
+	g_return_val_if_fail (!gmameui_romfix_list_is_interrupted (fixeslist), FALSE);
+
+	memset (result, 0, sizeof (RomsetConvertResult));
+
+	run.fixeslist = fixeslist;
+	run.results = g_async_queue_new ();
+	run.incomplete = FALSE;
+
+	pool = g_thread_pool_new (convert_family_worker, &run, CLAMP (threads, 1, 64), FALSE, &error);
+	if (error) {
+		GMAMEUI_DEBUG ("Error creating romset conversion thread pool - %s", error->message);
+		g_error_free (error);
+		g_async_queue_unref (run.results);
+		return FALSE;
+	}
+
+	timer = g_timer_new ();
+
+	total = g_list_length (plan->families);
+	for (ptr = plan->families; ptr; ptr = g_list_next (ptr))
+		g_thread_pool_push (pool, ptr->data, NULL);
+
+	index = 0;
+	pending = total;
+	while (pending > 0) {
+		ConvertFamily *family;
+		GTimeVal timeout;
+
+		g_get_current_time (&timeout);
+		g_time_val_add (&timeout, 100000);
+
+		family = (ConvertFamily *) g_async_queue_timed_pop (run.results, &timeout);
+		if (family) {
+			pending--;
+
+			if (family->ok)
+				result->families++;
+			else
+				result->failed++;
+			result->zips_written += family->zips_written;
+			result->zips_removed += family->zips_removed;
+			result->bytes_before += family->bytes_before;
+			result->bytes_after += family->bytes_after;
+
+			if (func)
+				func (family->parent, ++index, total, user_data);
+		}
+
+		UPDATE_GUI;
+	}
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_async_queue_unref (run.results);
+
+	if (!g_atomic_int_get (&run.incomplete))
+		gmameui_romfix_list_journal_finish (fixeslist);
+
+	/* Zips have been created and removed */
+	gmameui_archive_index_rom_paths ();
+
+	result->seconds = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	GMAMEUI_DEBUG ("Converted %d romset families in %0.2f seconds - %" G_GUINT64_FORMAT
+		       " bytes before, %" G_GUINT64_FORMAT " after, %d failed",
+		       result->families, result->seconds, result->bytes_before,
+		       result->bytes_after, result->failed);
+
+	return (result->failed == 0);
+}
@@ -0,0 +1,85 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_ROMSET_CONVERT_H__
+#define __GMAMEUI_ROMSET_CONVERT_H__
+
+#include "common.h"
+#include "gmameui-romfix-list.h"
+
+G_BEGIN_DECLS
+
+/* How the ROMs of a parent and its clones are spread over their zips */
+typedef enum {
+	ROMSET_LAYOUT_SPLIT,		/* Clones only hold the ROMs that differ from the parent */
+	ROMSET_LAYOUT_MERGED,		/* Parent holds the ROMs of all its clones */
+	ROMSET_LAYOUT_NON_MERGED,	/* Every romset holds all its ROMs */
+	NUM_ROMSET_LAYOUTS
+} RomsetLayout;
+
+/* Every zip to be written or removed to change the layout of the
+   collection, worked out before anything is changed */
+typedef struct _RomsetConvertPlan RomsetConvertPlan;
+
+typedef struct {
+	guint families;		/* Parents whose zips were converted */
+	guint failed;		/* Parents whose zips were left unchanged after an error */
+	guint zips_written;
+	guint zips_removed;
+	guint64 bytes_before;	/* Size of the zips converted, before and after */
+	guint64 bytes_after;
+	gdouble seconds;
+} RomsetConvertResult;
+
+/* Called in the main loop as each parent and its clones are converted */
+typedef void (*RomsetConvertProgressFunc) (const gchar *parent,
+					   guint index,
+					   guint total,
+					   gpointer user_data);
+
+RomsetConvertPlan *
+gmameui_romset_convert_plan_new (RomsetLayout layout);
+
+void
+gmameui_romset_convert_plan_free (RomsetConvertPlan *plan);
+
+guint
+gmameui_romset_convert_plan_get_num_zips (RomsetConvertPlan *plan);
+
+guint
+gmameui_romset_convert_plan_get_num_removed (RomsetConvertPlan *plan);
+
+guint64
+gmameui_romset_convert_plan_get_current_bytes (RomsetConvertPlan *plan);
+
+guint64
+gmameui_romset_convert_plan_get_predicted_bytes (RomsetConvertPlan *plan);
+
+gboolean
+gmameui_romset_convert_run (RomsetConvertPlan *plan,
+			    GMAMEUIRomfixList *fixeslist,
+			    gint threads,
+			    RomsetConvertProgressFunc func,
+			    gpointer user_data,
+			    RomsetConvertResult *result);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_ROMSET_CONVERT_H__ */
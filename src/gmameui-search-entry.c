@@ -20,11 +20,70 @@
  */
 
 #include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
 #include "gmameui-search-entry.h"
 #include "gmameui-marshaller.h"
+#include "gmameui.h"	/* For the column ids */
+#include "rom_entry.h"	/* For the driver status and ROM status values */
 
 struct _MameSearchEntryPrivate {
-	gint search_timeout;
+	gchar *search_text;	/* Text last searched for */
+	MameSearchQuery *query;	/* Parsed from the search text */
+};
+
+/* How the value of a field is read */
+typedef enum {
+	FIELD_NAME,		/* Text matched exactly */
+	FIELD_NUMBER,		/* A number, or a range such as 1990..1995 */
+	FIELD_STATUS		/* A driver status */
+} SearchFieldType;
+
+static const struct {
+	const gchar *name;
+	gint column;
+	SearchFieldType type;
+} search_fields[] = {
+	{ "manufacturer", MANU, FIELD_NAME },
+	{ "manu", MANU, FIELD_NAME },
+	{ "name", ROMNAME, FIELD_NAME },
+	{ "driver", DRIVER, FIELD_NAME },
+	{ "category", CATEGORY, FIELD_NAME },
+	{ "version", MAMEVER, FIELD_NAME },
+	{ "year", YEAR, FIELD_NUMBER },
+	{ "players", NUMPLAYERS, FIELD_NUMBER },
+	{ "buttons", NUMBUTTONS, FIELD_NUMBER },
+	{ "played", TIMESPLAYED, FIELD_NUMBER },
+	{ "status", DRIVER_STATUS, FIELD_STATUS },
+};
+
+static const struct {
+	const gchar *name;
+	DriverStatus status;
+} search_statuses[] = {
+	{ "working", DRIVER_STATUS_GOOD },
+	{ "good", DRIVER_STATUS_GOOD },
+	{ "imperfect", DRIVER_STATUS_IMPERFECT },
+	{ "preliminary", DRIVER_STATUS_PRELIMINARY },
+	{ "notworking", DRIVER_STATUS_PRELIMINARY },
+};
+
+/* Words that match a property of the romset rather than its text. Quote
+   them to search for the text instead, e.g. "vector" */
+static const struct {
+	const gchar *name;
+	gint column;
+	gint value;
+	gboolean negate;
+} search_flags[] = {
+	{ "clone", CLONE, TRUE, FALSE },
+	{ "bios", IS_BIOS, TRUE, FALSE },
+	{ "vector", VECTOR, TRUE, FALSE },
+	{ "favorite", FAVORITE, TRUE, FALSE },
+	{ "favourite", FAVORITE, TRUE, FALSE },
+	{ "available", HAS_ROMS, NOT_AVAIL, TRUE },
 };
 
 G_DEFINE_TYPE (MameSearchEntry, mame_search_entry, GTK_TYPE_ENTRY)
@@ -45,8 +104,6 @@ mame_search_entry_finalize              (GObject *object);
 
 static void
 search_entry_changed (MameSearchEntry *entry, gpointer user_data);
-static gboolean
-search_entry_changed_timeout (GtkWidget *widget);
 
 #if GTK_CHECK_VERSION(2,16,0)
 static void
@@ -116,6 +173,10 @@ mame_search_entry_init (MameSearchEntry *entry)
 	
 	/* Initialise private variables */
 
+	gtk_widget_set_tooltip_text (GTK_WIDGET (entry),
+				     _("Search the name, romname, manufacturer and driver, or fields such as\n"
+				       "manufacturer:capcom year:1990..1995 players:2 status:working -clone"));
+
 	/* Add a 'clear' icon if GTK supports it; Rhythmbox uses libsexy if the
 	   version is less than 2.16 */
 	#if GTK_CHECK_VERSION(2,16,0) 
@@ -152,6 +213,9 @@ mame_search_entry_finalize (GObject *object)
 GMAMEUI_DEBUG ("Destroying mame search entry...");	
 	entry = MAME_SEARCH_ENTRY (object);
 	
+	g_free (entry->priv->search_text);
+	if (entry->priv->query)
+		mame_search_query_unref (entry->priv->query);
 	
 	g_object_unref (entry->priv);
 	
@@ -162,42 +226,29 @@ GMAMEUI_DEBUG ("Destroying mame search entry...");
 GMAMEUI_DEBUG ("Destroying mame search entry... done");
 }
 
-static gboolean
-search_entry_changed_timeout (GtkWidget *widget)
+/* Callback for when the MameSearchEntry field is changed. The text is
+   parsed into a query here; the gamelist evaluates it against its indexes
+   rather than every romset, so the search is run on each keystroke rather
+   than waiting for typing to pause */
+static void
+search_entry_changed (MameSearchEntry *entry, gpointer user_data)
 {
-	MameSearchEntry *entry;
+	const gchar *text;
 
-	entry = (MameSearchEntry *) widget;
-	/* Emit the signal so that the gmameui-gamelist-view can handle it. */
-	gdk_threads_enter ();
+	text = gtk_entry_get_text (GTK_ENTRY (entry));
 
-	g_signal_emit (G_OBJECT (widget), signals[SEARCH_TEXT_CHANGED], 0,
-				   gtk_entry_get_text (GTK_EDITABLE (widget)));
-	entry->priv->search_timeout = 0;
-	
-	gdk_threads_leave ();
-	
-	return FALSE;
-}
+	if (g_strcmp0 (text, entry->priv->search_text) == 0)
+		return;
 
-/* Callback for when the MameSearchEntry field is changed; this adds a
-   timeout to fire every 300ms to reduce the frequency of the refresh */
-static void
-search_entry_changed (MameSearchEntry *entry, gpointer user_data)
-{
-	GtkTreeModelFilter *filter;
-	
-	if (entry->priv->search_timeout != 0) {
-		g_source_remove (entry->priv->search_timeout);
-		entry->priv->search_timeout = 0;
-	}
-	
-	/* emit it now if we're clearing the entry */
-	if (gtk_entry_get_text (GTK_ENTRY (entry)))
-		entry->priv->search_timeout = g_timeout_add (300, (GSourceFunc) search_entry_changed_timeout, entry);
-	else
-		search_entry_changed_timeout (entry);
- 
+	g_free (entry->priv->search_text);
+	entry->priv->search_text = g_strdup (text);
+
+	if (entry->priv->query)
+		mame_search_query_unref (entry->priv->query);
+	entry->priv->query = mame_search_query_parse (text);
+
+	/* Emit the signal so that the gmameui-gamelist-view can handle it. */
+	g_signal_emit (G_OBJECT (entry), signals[SEARCH_TEXT_CHANGED], 0, text);
 }
 
 #if GTK_CHECK_VERSION(2,16,0)
@@ -207,4 +258,228 @@ search_entry_clear (GtkEntry *entry, GtkEntryIconPosition icon_pos,
 {
 	gtk_entry_set_text (GTK_ENTRY (search_entry), "");
 }
-#endif
\ No newline at end of file
+#endif
+
+/* The query for the text in the entry, or NULL if nothing has been
+   searched for. The query belongs to the entry */
+MameSearchQuery *
+mame_search_entry_get_query (MameSearchEntry *entry)
+{
+	g_return_val_if_fail (MAME_IS_SEARCH_ENTRY (entry), NULL);
+
+	return entry->priv->query;
+}
+
+/* Reads a word up to the next space, or a quoted phrase up to the closing
+   quote, moving p past it */
+static gchar *
+search_query_read_word (const gchar **p)
+{
+	const gchar *start;
+	gchar *word;
+
+	if (**p == '"') {
+		start = ++(*p);
+		while (**p && (**p != '"'))
+			(*p)++;
+		word = g_strndup (start, *p - start);
+		if (**p == '"')
+			(*p)++;
+	} else {
+		start = *p;
+		while (**p && !g_ascii_isspace (**p))
+			(*p)++;
+		word = g_strndup (start, *p - start);
+	}
+
+	return word;
+}
+
+/* Reads a number of at most 9 digits. Returns FALSE if the text isn't one */
+static gboolean
+search_query_parse_number (const gchar *text, gsize len, gint *value)
+{
+	gsize i;
+
+	if ((len == 0) || (len > 9))
+		return FALSE;
+
+	for (i = 0; i < len; i++) {
+		if (!g_ascii_isdigit (text[i]))
+			return FALSE;
+	}
+
+	*value = atoi (text);
+
+	return TRUE;
+}
+
+/* Reads a number, or a range written min..max where either end may be
+   left open */
+static gboolean
+search_query_parse_range (const gchar *text, gint *min, gint *max)
+{
+	const gchar *dots;
+
+	dots = strstr (text, "..");
+	if (dots == NULL) {
+		if (!search_query_parse_number (text, strlen (text), min))
+			return FALSE;
+		*max = *min;
+		return TRUE;
+	}
+
+	*min = 0;
+	*max = G_MAXINT;
+
+	if ((dots > text) &&
+	    !search_query_parse_number (text, dots - text, min))
+		return FALSE;
+
+	if ((dots[2] != '\0') &&
+	    !search_query_parse_number (dots + 2, strlen (dots + 2), max))
+		return FALSE;
+
+	return (*min <= *max);
+}
+
+static void
+search_query_parse_field (MameSearchTerm *term, guint field, gchar *value)
+{
+	guint i;
+
+	term->column = search_fields[field].column;
+
+	switch (search_fields[field].type) {
+		case FIELD_NAME:
+			term->type = SEARCH_TERM_NAME;
+			term->text = value;
+			return;
+		case FIELD_NUMBER:
+			if (search_query_parse_range (value, &term->min, &term->max))
+				term->type = SEARCH_TERM_RANGE;
+			break;
+		case FIELD_STATUS:
+			for (i = 0; i < G_N_ELEMENTS (search_statuses); i++) {
+				if (g_ascii_strcasecmp (value, search_statuses[i].name) == 0) {
+					term->type = SEARCH_TERM_RANGE;
+					term->min = term->max = search_statuses[i].status;
+				}
+			}
+			break;
+	}
+
+	g_free (value);
+}
+
+/* Parses search text into the terms a romset must match. Anything that
+   isn't a known field or flag is searched for as text, so plain text
+   searches as it always has */
+MameSearchQuery *
+mame_search_query_parse (const gchar *text)
+{
+	MameSearchQuery *query;
+	const gchar *p;
+
+	query = g_new0 (MameSearchQuery, 1);
+	query->terms = g_array_new (FALSE, TRUE, sizeof (MameSearchTerm));
+	query->ref_count = 1;
+
+	p = text ? text : "";
+	while (*p) {
+		MameSearchTerm term = { SEARCH_TERM_NONE, 0, NULL, 0, 0, FALSE };
+		const gchar *start;
+		guint i;
+
+		if (g_ascii_isspace (*p)) {
+			p++;
+			continue;
+		}
+
+		if ((*p == '-') && (p[1] != '\0') && !g_ascii_isspace (p[1])) {
+			term.negate = TRUE;
+			p++;
+		}
+
+		start = p;
+		while (*p && !g_ascii_isspace (*p) && (*p != ':') && (*p != '"'))
+			p++;
+
+		if ((*p == ':') && (p > start)) {
+			for (i = 0; i < G_N_ELEMENTS (search_fields); i++) {
+				if ((strlen (search_fields[i].name) == (gsize) (p - start)) &&
+				    (g_ascii_strncasecmp (start, search_fields[i].name, p - start) == 0))
+					break;
+			}
+
+			if (i < G_N_ELEMENTS (search_fields)) {
+				gchar *value;
+
+				p++;
+				value = search_query_read_word (&p);
+
+				/* Skip a field whose value hasn't been typed yet */
+				if (*value == '\0') {
+					g_free (value);
+					continue;
+				}
+
+				search_query_parse_field (&term, i, value);
+				g_array_append_val (query->terms, term);
+				continue;
+			}
+		}
+
+		/* Not a field, so the word is read again as text */
+		p = start;
+		term.type = SEARCH_TERM_TEXT;
+		term.text = search_query_read_word (&p);
+
+		for (i = 0; (*start != '"') && (i < G_N_ELEMENTS (search_flags)); i++) {
+			if (g_ascii_strcasecmp (term.text, search_flags[i].name) == 0) {
+				g_free (term.text);
+				term.text = NULL;
+				term.type = SEARCH_TERM_RANGE;
+				term.column = search_flags[i].column;
+				term.min = term.max = search_flags[i].value;
+				term.negate = (term.negate != search_flags[i].negate);
+				break;
+			}
+		}
+
+		if ((term.type == SEARCH_TERM_TEXT) && (*term.text == '\0')) {
+			g_free (term.text);
+			continue;
+		}
+
+		g_array_append_val (query->terms, term);
+	}
+
+	return query;
+}
+
+MameSearchQuery *
+mame_search_query_ref (MameSearchQuery *query)
+{
+	g_return_val_if_fail (query != NULL, NULL);
+
+	query->ref_count++;
+
+	return query;
+}
+
+void
+mame_search_query_unref (MameSearchQuery *query)
+{
+	guint i;
+
+	g_return_if_fail (query != NULL);
+
+	if (--query->ref_count > 0)
+		return;
+
+	for (i = 0; i < query->terms->len; i++)
+		g_free (g_array_index (query->terms, MameSearchTerm, i).text);
+	g_array_free (query->terms, TRUE);
+	g_free (query);
+}
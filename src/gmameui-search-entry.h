@@ -33,6 +33,31 @@ G_BEGIN_DECLS
 #define MAME_IS_SEARCH_ENTRY_CLASS(k) (G_TYPE_CHECK_CLASS_TYPE ((k), MAME_TYPE_SEARCH_ENTRY))
 #define MAME_SEARCH_ENTRY_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), MAME_TYPE_SEARCH_ENTRY, MameSearchEntryClass))
 
+/* A search is a list of terms, all of which a romset must match, e.g.
+   manufacturer:capcom year:1990..1995 players:2 status:working -clone
+   Words without a field match part of the description, romname,
+   manufacturer or driver */
+typedef enum {
+	SEARCH_TERM_TEXT,	/* Text is part of the romset's details */
+	SEARCH_TERM_NAME,	/* Column is the text, ignoring case */
+	SEARCH_TERM_RANGE,	/* Column is between min and max */
+	SEARCH_TERM_NONE	/* Matches no romset, e.g. year:abc */
+} MameSearchTermType;
+
+typedef struct {
+	MameSearchTermType type;
+	gint column;		/* Column id from gmameui.h */
+	gchar *text;
+	gint min;
+	gint max;
+	gboolean negate;	/* Written with a leading - */
+} MameSearchTerm;
+
+typedef struct {
+	GArray *terms;		/* MameSearchTerm */
+	gint ref_count;
+} MameSearchQuery;
+
 typedef struct _MameSearchEntry        MameSearchEntry;
 typedef struct _MameSearchEntryClass   MameSearchEntryClass;
 typedef struct _MameSearchEntryPrivate MameSearchEntryPrivate;
@@ -52,6 +77,12 @@ struct _MameSearchEntryClass {
 GType mame_search_entry_get_type (void);
 MameSearchEntry *mame_search_entry_new (void);
 
+MameSearchQuery *mame_search_entry_get_query (MameSearchEntry *entry);
+
+MameSearchQuery *mame_search_query_parse (const gchar *text);
+MameSearchQuery *mame_search_query_ref (MameSearchQuery *query);
+void mame_search_query_unref (MameSearchQuery *query);
+
 G_END_DECLS
 
 #endif /* __GMAMEUI_SEARCH_ENTRY_H__ */
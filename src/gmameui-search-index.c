@@ -0,0 +1,438 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gmameui-search-index.h"
+#include "rom_entry.h"
+
+/* Key of the three characters starting at p */
+#define TRIGRAM(p) ((((guint32) (guchar) (p)[0]) << 16) | \
+		    (((guint32) (guchar) (p)[1]) << 8) | \
+		    ((guint32) (guchar) (p)[2]))
+
+/* Separates the fields of a romset's text. Search text can't contain it,
+   so sequences across two fields are not indexed */
+#define FIELD_SEPARATOR '\n'
+
+#define NUM_FIELDS 4
+
+struct _GmameuiSearchIndex {
+	guint num_romsets;
+	GStringChunk *chunk;	/* Holds the text of the romsets */
+	gchar **texts;		/* Per romset, its lower case fields */
+	GHashTable *postings;	/* Trigram -> GArray of the romsets containing
+				   it, in ascending order */
+};
+
+static void
+free_posting_list (GArray *romsets)
+{
+	g_array_free (romsets, TRUE);
+}
+
+GmameuiSearchIndex *
+gmameui_search_index_new (void)
+{
+	GmameuiSearchIndex *index;
+
+	index = g_new0 (GmameuiSearchIndex, 1);
+	index->postings = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+						 (GDestroyNotify) free_posting_list);
+
+	return index;
+}
+
+static void
+search_index_clear (GmameuiSearchIndex *index)
+{
+	g_hash_table_remove_all (index->postings);
+	if (index->chunk)
+		g_string_chunk_free (index->chunk);
+	index->chunk = NULL;
+	g_free (index->texts);
+	index->texts = NULL;
+	index->num_romsets = 0;
+}
+
+void
+gmameui_search_index_free (GmameuiSearchIndex *index)
+{
+	g_return_if_fail (index != NULL);
+
+	search_index_clear (index);
+	g_hash_table_destroy (index->postings);
+	g_free (index);
+}
+
+static void
+search_index_init (GmameuiSearchIndex *index, guint num_romsets)
+{
+	search_index_clear (index);
+
+	index->num_romsets = num_romsets;
+	index->texts = g_new0 (gchar *, num_romsets);
+	index->chunk = g_string_chunk_new (64 * 1024);
+}
+
+/* Romsets must be added in ascending order, so that each list of romsets
+   stays sorted without duplicates */
+static void
+search_index_add_romset (GmameuiSearchIndex *index,
+			 guint romset,
+			 const gchar **fields)
+{
+	GString *text;
+	const gchar *p;
+	guint i;
+
+	text = g_string_sized_new (128);
+	for (i = 0; i < NUM_FIELDS; i++) {
+		if ((fields[i] == NULL) || (*fields[i] == '\0'))
+			continue;
+
+		if (text->len > 0)
+			g_string_append_c (text, FIELD_SEPARATOR);
+		g_string_append (text, fields[i]);
+	}
+
+	for (i = 0; i < text->len; i++)
+		text->str[i] = g_ascii_tolower (text->str[i]);
+
+	index->texts[romset] = g_string_chunk_insert (index->chunk, text->str);
+	g_string_free (text, TRUE);
+
+	for (p = index->texts[romset]; p[0] && p[1] && p[2]; p++) {
+		GArray *romsets;
+		gpointer key;
+
+		if ((p[0] == FIELD_SEPARATOR) || (p[1] == FIELD_SEPARATOR) ||
+		    (p[2] == FIELD_SEPARATOR))
+			continue;
+
+		key = GUINT_TO_POINTER (TRIGRAM (p));
+		romsets = g_hash_table_lookup (index->postings, key);
+		if (romsets == NULL) {
+			romsets = g_array_new (FALSE, FALSE, sizeof (guint));
+			g_hash_table_insert (index->postings, key, romsets);
+		}
+
+		if ((romsets->len == 0) ||
+		    (g_array_index (romsets, guint, romsets->len - 1) != romset))
+			g_array_append_val (romsets, romset);
+	}
+}
+
+void
+gmameui_search_index_build (GmameuiSearchIndex *index, GPtrArray *romsets)
+{
+	guint i;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (romsets != NULL);
+
+	search_index_init (index, romsets->len);
+
+	for (i = 0; i < romsets->len; i++) {
+		MameRomEntry *rom = g_ptr_array_index (romsets, i);
+		const gchar *fields[NUM_FIELDS];
+
+		fields[0] = mame_rom_entry_get_list_name (rom);
+		fields[1] = mame_rom_entry_get_romname (rom);
+		fields[2] = mame_rom_entry_get_manufacturer (rom);
+		fields[3] = mame_rom_entry_get_driver (rom);
+
+		search_index_add_romset (index, i, fields);
+	}
+
+	GMAMEUI_DEBUG ("Search index of %d romsets has %d trigrams",
+		       index->num_romsets, g_hash_table_size (index->postings));
+}
+
+static gint
+compare_posting_lengths (const void *a, const void *b)
+{
+	const GArray *list_a = *(GArray * const *) a;
+	const GArray *list_b = *(GArray * const *) b;
+
+	return (list_a->len > list_b->len) - (list_a->len < list_b->len);
+}
+
+/* Keeps the candidates that are in the list. Both are in ascending order,
+   and the list is usually much longer, so it is searched by galloping
+   forward from the last match rather than stepped through */
+static guint
+intersect_candidates (guint *candidates, guint num_candidates, GArray *list)
+{
+	const guint *items = (const guint *) list->data;
+	guint pos = 0, num_kept = 0;
+	guint i;
+
+	for (i = 0; i < num_candidates; i++) {
+		guint low = pos, high = pos, step = 1;
+
+		while ((high < list->len) && (items[high] < candidates[i])) {
+			low = high + 1;
+			high += step;
+			step *= 2;
+		}
+		if (high > list->len)
+			high = list->len;
+
+		while (low < high) {
+			guint mid = (low + high) / 2;
+
+			if (items[mid] < candidates[i])
+				low = mid + 1;
+			else
+				high = mid;
+		}
+
+		pos = low;
+		if (pos == list->len)
+			break;
+
+		if (items[pos] == candidates[i])
+			candidates[num_kept++] = candidates[i];
+	}
+
+	return num_kept;
+}
+
+/* Sets the bits of the romsets matching the text. Text shorter than three
+   characters is compared against every romset */
+void
+gmameui_search_index_search (GmameuiSearchIndex *index,
+			     const gchar *text,
+			     GmameuiBitset *matches)
+{
+	GArray **lists;
+	guint *candidates;
+	guint num_candidates, num_lists;
+	gchar *folded;
+	gsize len;
+	guint i;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (matches != NULL);
+	g_return_if_fail (matches->size == index->num_romsets);
+
+	if ((text == NULL) || (*text == '\0')) {
+		gmameui_bitset_fill (matches, TRUE);
+		return;
+	}
+
+	gmameui_bitset_fill (matches, FALSE);
+
+	folded = g_ascii_strdown (text, -1);
+	len = strlen (folded);
+
+	if (len < 3) {
+		for (i = 0; i < index->num_romsets; i++) {
+			if (strstr (index->texts[i], folded))
+				gmameui_bitset_set (matches, i, TRUE);
+		}
+		g_free (folded);
+		return;
+	}
+
+	num_lists = len - 2;
+	lists = g_new (GArray *, num_lists);
+	for (i = 0; i < num_lists; i++) {
+		lists[i] = g_hash_table_lookup (index->postings,
+						GUINT_TO_POINTER (TRIGRAM (folded + i)));
+
+		/* No romset has this part of the text */
+		if (lists[i] == NULL) {
+			g_free (lists);
+			g_free (folded);
+			return;
+		}
+	}
+
+	/* Start from the rarest trigram, so there are fewest candidates */
+	qsort (lists, num_lists, sizeof (GArray *), compare_posting_lengths);
+
+	num_candidates = lists[0]->len;
+	candidates = g_memdup (lists[0]->data, num_candidates * sizeof (guint));
+	for (i = 1; (i < num_lists) && (num_candidates > 0); i++) {
+		if (lists[i] != lists[i - 1])
+			num_candidates = intersect_candidates (candidates, num_candidates, lists[i]);
+	}
+
+	/* Having every trigram doesn't mean they are in order */
+	for (i = 0; i < num_candidates; i++) {
+		if (strstr (index->texts[candidates[i]], folded))
+			gmameui_bitset_set (matches, candidates[i], TRUE);
+	}
+
+	g_free (candidates);
+	g_free (lists);
+	g_free (folded);
+}
+
+/* Whether a single romset matches the text, as for
+   gmameui_search_index_search () */
+gboolean
+gmameui_search_index_matches (GmameuiSearchIndex *index,
+			      const gchar *text,
+			      guint romset)
+{
+	gchar *folded;
+	gboolean matches;
+
+	g_return_val_if_fail (index != NULL, FALSE);
+	g_return_val_if_fail (romset < index->num_romsets, FALSE);
+
+	if ((text == NULL) || (*text == '\0'))
+		return TRUE;
+
+	folded = g_ascii_strdown (text, -1);
+	matches = (strstr (index->texts[romset], folded) != NULL);
+	g_free (folded);
+
+	return matches;
+}
+
+#ifdef GMAMEUI_BENCHMARK
+static const gchar *benchmark_words[] = {
+	"street", "fighter", "super", "dragon", "ninja", "turtles", "space", "invaders",
+	"galaga", "pac", "man", "world", "champion", "soccer", "racing", "rally",
+	"battle", "zone", "star", "wars", "knights", "round", "metal", "slug",
+	"puzzle", "bobble", "golden", "axe", "final", "fight", "double", "trouble",
+	"mahjong", "quiz", "baseball", "stars", "tetris", "bomberman", "rampage", "tempest",
+};
+
+static const gchar *benchmark_manufacturers[] = {
+	"Capcom", "Konami", "Namco", "Sega", "SNK", "Taito", "Irem", "Data East",
+	"Atari", "Williams", "Midway", "Nintendo", "Jaleco", "Toaplan", "Cave", "Psikyo",
+};
+
+static const gchar *benchmark_drivers[] = {
+	"cps1.c", "cps2.c", "neodrvr.c", "segas16b.c", "model2.c", "namcos22.c",
+	"galaxian.c", "pacman.c", "taito_f3.c", "konamigx.c", "m72.c", "dec0.c",
+};
+
+static const gchar *benchmark_queries[] = {
+	"street fighter", "capcom", "neodrvr", "xyzzy", "man", "double trouble ii",
+};
+
+/* Fills an index with a synthetic gamelist and times typing each query a
+   character at a time, against comparing the text of every romset as the
+   search used to */
+void
+gmameui_search_index_benchmark (guint num_romsets)
+{
+	GmameuiSearchIndex *index;
+	GmameuiBitset *matches;
+	GPtrArray *descriptions;
+	GTimer *timer;
+	GRand *rand;
+	gdouble build_time, index_time, scan_time, index_max, scan_max;
+	guint keystrokes = 0;
+	guint i, q;
+
+	rand = g_rand_new_with_seed (42);
+	timer = g_timer_new ();
+	index = gmameui_search_index_new ();
+	descriptions = g_ptr_array_new ();
+
+	search_index_init (index, num_romsets);
+	for (i = 0; i < num_romsets; i++) {
+		const gchar *fields[NUM_FIELDS];
+		gchar *description, *romname;
+		guint num_words, w;
+		GString *words;
+
+		words = g_string_new (NULL);
+		num_words = g_rand_int_range (rand, 2, 5);
+		for (w = 0; w < num_words; w++) {
+			if (w > 0)
+				g_string_append_c (words, ' ');
+			g_string_append (words, benchmark_words[g_rand_int_range (rand, 0, G_N_ELEMENTS (benchmark_words))]);
+		}
+		g_string_append_printf (words, " %s", (i % 7 == 0) ? "II" : "(World)");
+		description = g_string_free (words, FALSE);
+		romname = g_strdup_printf ("g%06x", g_rand_int (rand) & 0xffffff);
+
+		fields[0] = description;
+		fields[1] = romname;
+		fields[2] = benchmark_manufacturers[g_rand_int_range (rand, 0, G_N_ELEMENTS (benchmark_manufacturers))];
+		fields[3] = benchmark_drivers[g_rand_int_range (rand, 0, G_N_ELEMENTS (benchmark_drivers))];
+
+		g_timer_continue (timer);
+		search_index_add_romset (index, i, fields);
+		g_timer_stop (timer);
+
+		g_ptr_array_add (descriptions, description);
+		g_free (romname);
+	}
+	build_time = g_timer_elapsed (timer, NULL);
+
+	matches = gmameui_bitset_new (num_romsets);
+	index_time = scan_time = index_max = scan_max = 0;
+
+	for (q = 0; q < G_N_ELEMENTS (benchmark_queries); q++) {
+		guint len;
+
+		for (len = 1; len <= strlen (benchmark_queries[q]); len++) {
+			gchar *text = g_strndup (benchmark_queries[q], len);
+			gdouble elapsed;
+			guint found = 0;
+
+			g_timer_start (timer);
+			gmameui_search_index_search (index, text, matches);
+			elapsed = g_timer_elapsed (timer, NULL);
+			index_time += elapsed;
+			index_max = MAX (index_max, elapsed);
+
+			g_timer_start (timer);
+			for (i = 0; i < num_romsets; i++) {
+				if (strcasestr (g_ptr_array_index (descriptions, i), text))
+					found++;
+			}
+			elapsed = g_timer_elapsed (timer, NULL);
+			scan_time += elapsed;
+			scan_max = MAX (scan_max, elapsed);
+
+			keystrokes++;
+			g_free (text);
+		}
+	}
+
+	g_print ("Search benchmark for %d romsets - index built in %.3f seconds with %d trigrams; "
+		 "%d keystrokes: index %.3f ms average, %.3f ms worst; "
+		 "description scan %.3f ms average, %.3f ms worst\n",
+		 num_romsets, build_time, g_hash_table_size (index->postings),
+		 keystrokes,
+		 index_time * 1000 / keystrokes, index_max * 1000,
+		 scan_time * 1000 / keystrokes, scan_max * 1000);
+
+	g_ptr_array_foreach (descriptions, (GFunc) g_free, NULL);
+	g_ptr_array_free (descriptions, TRUE);
+	gmameui_bitset_free (matches);
+	gmameui_search_index_free (index);
+	g_timer_destroy (timer);
+	g_rand_free (rand);
+}
+#endif
@@ -0,0 +1,64 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_SEARCH_INDEX_H__
+#define __GMAMEUI_SEARCH_INDEX_H__
+
+#include "common.h"
+#include "gmameui-bitset.h"
+
+G_BEGIN_DECLS
+
+/* Finds the romsets whose description, romname, manufacturer or driver
+   contains the search text, ignoring case. Every three character sequence
+   of the lower case text is indexed when the gamelist is loaded; a search
+   intersects the lists of romsets containing each sequence of the search
+   text, and only compares the text of the romsets left. Romsets are
+   numbered by their position in the array given to
+   gmameui_search_index_build () */
+typedef struct _GmameuiSearchIndex GmameuiSearchIndex;
+
+GmameuiSearchIndex *
+gmameui_search_index_new (void);
+
+void
+gmameui_search_index_free (GmameuiSearchIndex *index);
+
+void
+gmameui_search_index_build (GmameuiSearchIndex *index, GPtrArray *romsets);
+
+void
+gmameui_search_index_search (GmameuiSearchIndex *index,
+			     const gchar *text,
+			     GmameuiBitset *matches);
+
+gboolean
+gmameui_search_index_matches (GmameuiSearchIndex *index,
+			      const gchar *text,
+			      guint romset);
+
+#ifdef GMAMEUI_BENCHMARK
+void
+gmameui_search_index_benchmark (guint num_romsets);
+#endif
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_SEARCH_INDEX_H__ */
@@ -0,0 +1,331 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+
+#include "gmameui-space-report.h"
+
+/* A ROM's content, for finding duplicates */
+typedef struct {
+	guint32 crc;
+	guint64 size;
+} RomContent;
+
+struct _GmameuiSpaceReport {
+	GHashTable *groups[NUM_SPACE_REPORT_GROUPINGS];	/* Name -> SpaceReportGroup */
+	SpaceReportGroup total;
+
+	GHashTable *contents;		/* RomContent -> parent of the first romset holding it */
+	guint64 family_duplicated;	/* Duplicated bytes first held by the same parent or clone */
+};
+
+static const gchar *grouping_names[NUM_SPACE_REPORT_GROUPINGS] = {
+	N_("Driver"),
+	N_("Manufacturer"),
+	N_("Year"),
+	N_("Category"),
+};
+
+static guint
+rom_content_hash (gconstpointer key)
+{
+	const RomContent *content = (const RomContent *) key;
+
+	return content->crc ^ (guint) content->size;
+}
+
+static gboolean
+rom_content_equal (gconstpointer a, gconstpointer b)
+{
+	const RomContent *ca = (const RomContent *) a;
+	const RomContent *cb = (const RomContent *) b;
+
+	return (ca->crc == cb->crc) && (ca->size == cb->size);
+}
+
+static void
+space_report_group_free (SpaceReportGroup *group)
+{
+	g_free (group->name);
+	g_free (group);
+}
+
+GmameuiSpaceReport *
+gmameui_space_report_new (void)
+{
+	GmameuiSpaceReport *report;
+	gint i;
+
+	report = g_new0 (GmameuiSpaceReport, 1);
+
+	for (i = 0; i < NUM_SPACE_REPORT_GROUPINGS; i++)
+		report->groups[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
+							   NULL, (GDestroyNotify) space_report_group_free);
+
+	report->contents = g_hash_table_new_full (rom_content_hash, rom_content_equal,
+						  g_free, g_free);
+
+	return report;
+}
+
+void
+gmameui_space_report_free (GmameuiSpaceReport *report)
+{
+	gint i;
+
+	g_return_if_fail (report != NULL);
+
+	for (i = 0; i < NUM_SPACE_REPORT_GROUPINGS; i++)
+		g_hash_table_destroy (report->groups[i]);
+	g_hash_table_destroy (report->contents);
+	g_free (report);
+}
+
+/* Returns the name of the romset's group, which must be freed */
+static gchar *
+get_group_name (MameRomEntry *romset, SpaceReportGrouping grouping)
+{
+	gchar *name = NULL;
+
+	switch (grouping) {
+		case SPACE_REPORT_BY_DRIVER:
+			name = g_strdup (mame_rom_entry_get_driver (romset));
+			break;
+		case SPACE_REPORT_BY_MANUFACTURER:
+			name = g_strdup (mame_rom_entry_get_manufacturer (romset));
+			break;
+		case SPACE_REPORT_BY_YEAR:
+			name = g_strdup (mame_rom_entry_get_year (romset));
+			break;
+		case SPACE_REPORT_BY_CATEGORY:
+			g_object_get (romset, "category", &name, NULL);
+			break;
+		default:
+			break;
+	}
+
+	if ((name == NULL) || (*name == '\0')) {
+		g_free (name);
+		name = g_strdup (_("Unknown"));
+	}
+
+	return name;
+}
+
+static SpaceReportGroup *
+get_group (GmameuiSpaceReport *report, MameRomEntry *romset, SpaceReportGrouping grouping)
+{
+	SpaceReportGroup *group;
+	gchar *name;
+
+	name = get_group_name (romset, grouping);
+
+	group = g_hash_table_lookup (report->groups[grouping], name);
+	if (group == NULL) {
+		group = g_new0 (SpaceReportGroup, 1);
+		group->name = name;
+		g_hash_table_insert (report->groups[grouping], group->name, group);
+	} else {
+		g_free (name);
+	}
+
+	return group;
+}
+
+/* Adds the romset's sizes to the total and to its group in each grouping.
+   The archive isn't read, so the CRCs of its files must already have been
+   read with gmameui_archive_get_crc - 7z archives and directories are
+   listed without them */
+void
+gmameui_space_report_add_romset (GmameuiSpaceReport *report,
+				 MameRomEntry *romset,
+				 GmameuiArchive *archive)
+{
+	SpaceReportGroup sizes;
+	const gchar *family;
+	gint i;
+	guint n;
+
+	g_return_if_fail (report != NULL);
+	g_return_if_fail (romset != NULL);
+	g_return_if_fail (archive != NULL);
+
+	memset (&sizes, 0, sizeof (SpaceReportGroup));
+	sizes.compressed = gmameui_archive_get_size (archive);
+
+	family = mame_rom_entry_is_clone (romset) ?
+		 mame_rom_entry_get_parent_romname (romset) :
+		 mame_rom_entry_get_romname (romset);
+
+	for (n = 0; n < gmameui_archive_get_num_entries (archive); n++) {
+		const ArchiveEntry *entry = gmameui_archive_get_nth_entry (archive, n);
+		RomContent content;
+		const gchar *holder;
+
+		sizes.uncompressed += entry->size;
+
+		/* A file whose CRC couldn't be read isn't counted as a
+		   duplicate */
+		if (!entry->has_crc)
+			continue;
+
+		content.crc = entry->crc;
+		content.size = entry->size;
+
+		holder = g_hash_table_lookup (report->contents, &content);
+		if (holder) {
+			sizes.duplicated += entry->size;
+			if (g_ascii_strcasecmp (holder, family) == 0)
+				report->family_duplicated += entry->size;
+		} else {
+			g_hash_table_insert (report->contents,
+					     g_memdup (&content, sizeof (RomContent)),
+					     g_strdup (family));
+		}
+	}
+
+	report->total.romsets++;
+	report->total.compressed += sizes.compressed;
+	report->total.uncompressed += sizes.uncompressed;
+	report->total.duplicated += sizes.duplicated;
+
+	for (i = 0; i < NUM_SPACE_REPORT_GROUPINGS; i++) {
+		SpaceReportGroup *group = get_group (report, romset, i);
+
+		group->romsets++;
+		group->compressed += sizes.compressed;
+		group->uncompressed += sizes.uncompressed;
+		group->duplicated += sizes.duplicated;
+	}
+}
+
+static gint
+compare_groups_by_size (gconstpointer a, gconstpointer b)
+{
+	const SpaceReportGroup *ga = (const SpaceReportGroup *) a;
+	const SpaceReportGroup *gb = (const SpaceReportGroup *) b;
+
+	if (ga->compressed != gb->compressed)
+		return (ga->compressed < gb->compressed) ? 1 : -1;
+
+	return g_utf8_collate (ga->name, gb->name);
+}
+
+/* Returns the groups, largest on disk first. The list must be freed with
+   g_list_free; the groups belong to the report */
+GList *
+gmameui_space_report_get_groups (GmameuiSpaceReport *report,
+				 SpaceReportGrouping grouping)
+{
+	g_return_val_if_fail (report != NULL, NULL);
+	g_return_val_if_fail (grouping < NUM_SPACE_REPORT_GROUPINGS, NULL);
+
+	return g_list_sort (g_hash_table_get_values (report->groups[grouping]),
+			    compare_groups_by_size);
+}
+
+const SpaceReportGroup *
+gmameui_space_report_get_total (GmameuiSpaceReport *report)
+{
+	g_return_val_if_fail (report != NULL, NULL);
+
+	return &report->total;
+}
+
+/* Duplicated bytes whose first copy is held by the same parent or one of
+   its clones */
+guint64
+gmameui_space_report_get_family_duplicated (GmameuiSpaceReport *report)
+{
+	g_return_val_if_fail (report != NULL, 0);
+
+	return report->family_duplicated;
+}
+
+/* Quotes a field for CSV if it contains a separator, quote or newline */
+static void
+write_csv_field (FILE *f, const gchar *field)
+{
+	const gchar *p;
+
+	if (strpbrk (field, ",\"\r\n") == NULL) {
+		fputs (field, f);
+		return;
+	}
+
+	fputc ('"', f);
+	for (p = field; *p; p++) {
+		if (*p == '"')
+			fputc ('"', f);
+		fputc (*p, f);
+	}
+	fputc ('"', f);
+}
+
+gboolean
+gmameui_space_report_write_csv (GmameuiSpaceReport *report,
+				SpaceReportGrouping grouping,
+				const gchar *filename,
+				GError **error)
+{
+	GList *groups, *ptr;
+	FILE *f;
+	gboolean ok;
+
+	g_return_val_if_fail (report != NULL, FALSE);
+	g_return_val_if_fail (grouping < NUM_SPACE_REPORT_GROUPINGS, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	f = g_fopen (filename, "w");
+	if (f == NULL) {
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+			     _("Could not write to %s: %s"), filename, g_strerror (errno));
+		return FALSE;
+	}
+
+	write_csv_field (f, _(grouping_names[grouping]));
+	fprintf (f, ",%s,%s,%s,%s\n", _("Romsets"), _("Size on disk"),
+		 _("Uncompressed size"), _("Duplicated size"));
+
+	groups = gmameui_space_report_get_groups (report, grouping);
+	for (ptr = groups; ptr; ptr = g_list_next (ptr)) {
+		SpaceReportGroup *group = (SpaceReportGroup *) ptr->data;
+
+		write_csv_field (f, group->name);
+		fprintf (f, ",%u,%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT "\n",
+			 group->romsets, group->compressed, group->uncompressed, group->duplicated);
+	}
+	g_list_free (groups);
+
+	ok = (ferror (f) == 0);
+	if (fclose (f) != 0)
+		ok = FALSE;
+
+	if (!ok)
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_IO,
+			     _("Could not write to %s"), filename);
+
+	return ok;
+}
@@ -0,0 +1,81 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_SPACE_REPORT_H__
+#define __GMAMEUI_SPACE_REPORT_H__
+
+#include "common.h"
+#include "rom_entry.h"
+#include "gmameui-archive.h"
+
+G_BEGIN_DECLS
+
+/* How the romsets are grouped in a space report */
+typedef enum {
+	SPACE_REPORT_BY_DRIVER,
+	SPACE_REPORT_BY_MANUFACTURER,
+	SPACE_REPORT_BY_YEAR,
+	SPACE_REPORT_BY_CATEGORY,
+	NUM_SPACE_REPORT_GROUPINGS
+} SpaceReportGrouping;
+
+typedef struct {
+	gchar *name;
+	guint romsets;
+	guint64 compressed;	/* Bytes on disk */
+	guint64 uncompressed;
+	guint64 duplicated;	/* Uncompressed bytes of ROMs already held by another romset */
+} SpaceReportGroup;
+
+/* Disk space taken by the romsets in the ROM paths, built up one romset
+   at a time from the archive listings. A ROM is duplicated if a romset
+   added earlier holds a ROM with the same CRC and size */
+typedef struct _GmameuiSpaceReport GmameuiSpaceReport;
+
+GmameuiSpaceReport *
+gmameui_space_report_new (void);
+
+void
+gmameui_space_report_free (GmameuiSpaceReport *report);
+
+void
+gmameui_space_report_add_romset (GmameuiSpaceReport *report,
+				 MameRomEntry *romset,
+				 GmameuiArchive *archive);
+
+GList *
+gmameui_space_report_get_groups (GmameuiSpaceReport *report,
+				 SpaceReportGrouping grouping);
+
+const SpaceReportGroup *
+gmameui_space_report_get_total (GmameuiSpaceReport *report);
+
+guint64
+gmameui_space_report_get_family_duplicated (GmameuiSpaceReport *report);
+
+gboolean
+gmameui_space_report_write_csv (GmameuiSpaceReport *report,
+				SpaceReportGrouping grouping,
+				const gchar *filename,
+				GError **error);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_SPACE_REPORT_H__ */
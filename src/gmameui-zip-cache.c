@@ -0,0 +1,590 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/* Process-wide cache of zip central directories. The names, sizes, CRCs and
+   local header offsets of every file in a zip are all held in the central
+   directory at the end of the zip, so listing a zip only needs two reads
+   rather than opening each entry. Directories are keyed by path and
+   revalidated against the file's mtime and size, so each zip is only read
+   again after it has changed. The cache is shared by the ROM manager, the
+   icon and snapshot loaders, and may be used from worker threads. */
+
+#define _LARGEFILE_SOURCE
+#define _FILE_OFFSET_BITS 64	/* ROM zips for some systems are larger than 2GB */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+
+#include "gmameui-zip-cache.h"
+
+#define ZIP_EOCD_SIG		0x06054b50
+#define ZIP_EOCD_SIZE		22
+#define ZIP_MAX_COMMENT		0xffff
+#define ZIP64_LOCATOR_SIG	0x07064b50
+#define ZIP64_LOCATOR_SIZE	20
+#define ZIP64_EOCD_SIG		0x06064b50
+#define ZIP64_EOCD_SIZE		56
+#define ZIP_CENTRAL_SIG		0x02014b50
+#define ZIP_CENTRAL_SIZE	46
+#define ZIP64_EXTRA_ID		0x0001
+#define ZIP_LOCAL_SIG		0x04034b50
+#define ZIP_LOCAL_SIZE		30
+
+#define ZIP_METHOD_STORED	0
+#define ZIP_METHOD_DEFLATED	8
+
+/* Largest file that will be extracted into memory */
+#define ZIP_MAX_EXTRACT_SIZE	(256 * 1024 * 1024)
+
+struct _ZipDirectory {
+	gint ref_count;
+	gchar *filename;
+	time_t mtime;
+	goffset size;
+	ZipCacheEntry *entries;
+	guint num_entries;
+	GHashTable *by_name;	/* Lowercase name -> ZipCacheEntry */
+};
+
+static GStaticMutex zip_cache_mutex = G_STATIC_MUTEX_INIT;
+static GHashTable *zip_cache = NULL;	/* Filename -> ZipDirectory */
+
+static guint16
+get_le16 (const guchar *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static guint32
+get_le32 (const guchar *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((guint32) p[3] << 24);
+}
+
+static guint64
+get_le64 (const guchar *p)
+{
+	return get_le32 (p) | ((guint64) get_le32 (p + 4) << 32);
+}
+
+static gboolean
+read_at (FILE *f, guint64 offset, guchar *buf, gsize len)
+{
+	if (fseeko (f, (off_t) offset, SEEK_SET) != 0)
+		return FALSE;
+
+	return (fread (buf, 1, len, f) == len);
+}
+
+static void
+zip_directory_free (ZipDirectory *dir)
+{
+	guint i;
+
+	for (i = 0; i < dir->num_entries; i++)
+		g_free (dir->entries[i].name);
+	g_free (dir->entries);
+	if (dir->by_name)
+		g_hash_table_destroy (dir->by_name);
+	g_free (dir->filename);
+	g_free (dir);
+}
+
+/* Find the end of central directory record, and from it (or the zip64
+   record) the location and number of the central directory entries */
+static gboolean
+zip_find_central_directory (FILE *f, goffset size,
+			    guint64 *cd_offset, guint64 *cd_size, guint64 *num_entries)
+{
+	guchar *tail;
+	gsize tail_len;
+	guchar *eocd = NULL;
+	guint64 eocd_offset;
+	gboolean ok = FALSE;
+
+	if (size < ZIP_EOCD_SIZE)
+		return FALSE;
+
+	/* The record is at the end of the file, followed by an optional comment */
+	tail_len = MIN ((guint64) size, ZIP_EOCD_SIZE + ZIP_MAX_COMMENT);
+	tail = g_malloc (tail_len);
+
+	if (read_at (f, size - tail_len, tail, tail_len)) {
+		gsize i;
+
+		for (i = tail_len - ZIP_EOCD_SIZE + 1; i-- > 0; ) {
+			if (get_le32 (tail + i) == ZIP_EOCD_SIG) {
+				eocd = tail + i;
+				break;
+			}
+		}
+	}
+
+	if (eocd) {
+		eocd_offset = size - tail_len + (eocd - tail);
+
+		*num_entries = get_le16 (eocd + 10);
+		*cd_size = get_le32 (eocd + 12);
+		*cd_offset = get_le32 (eocd + 16);
+		ok = TRUE;
+
+		/* Zip64 - the real values are in the zip64 end of central
+		   directory record, found via the locator preceding the EOCD */
+		if ((*num_entries == 0xffff) || (*cd_size == 0xffffffff) || (*cd_offset == 0xffffffff)) {
+			guchar locator[ZIP64_LOCATOR_SIZE];
+			guchar eocd64[ZIP64_EOCD_SIZE];
+
+			ok = (eocd_offset >= ZIP64_LOCATOR_SIZE) &&
+			     read_at (f, eocd_offset - ZIP64_LOCATOR_SIZE, locator, ZIP64_LOCATOR_SIZE) &&
+			     (get_le32 (locator) == ZIP64_LOCATOR_SIG) &&
+			     read_at (f, get_le64 (locator + 8), eocd64, ZIP64_EOCD_SIZE) &&
+			     (get_le32 (eocd64) == ZIP64_EOCD_SIG);
+
+			if (ok) {
+				*num_entries = get_le64 (eocd64 + 32);
+				*cd_size = get_le64 (eocd64 + 40);
+				*cd_offset = get_le64 (eocd64 + 48);
+			}
+		}
+	}
+
+	g_free (tail);
+
+	return ok && (*cd_offset + *cd_size <= (guint64) size);
+}
+
+/* Values that do not fit in 32 bits are held in the zip64 extra field, in
+   the order uncompressed size, compressed size, local header offset, each
+   only present if the main field is 0xffffffff */
+static void
+zip_parse_zip64_extra (ZipCacheEntry *entry, const guchar *extra, guint16 extra_len)
+{
+	const guchar *end = extra + extra_len;
+
+	while (extra + 4 <= end) {
+		guint16 id = get_le16 (extra);
+		guint16 len = get_le16 (extra + 2);
+		const guchar *p = extra + 4;
+		const guchar *field_end = p + len;
+
+		if (field_end > end)
+			return;
+
+		if (id == ZIP64_EXTRA_ID) {
+			if ((entry->size == 0xffffffff) && (p + 8 <= field_end)) {
+				entry->size = get_le64 (p);
+				p += 8;
+			}
+			if ((entry->compressed_size == 0xffffffff) && (p + 8 <= field_end)) {
+				entry->compressed_size = get_le64 (p);
+				p += 8;
+			}
+			if ((entry->local_header_offset == 0xffffffff) && (p + 8 <= field_end))
+				entry->local_header_offset = get_le64 (p);
+			return;
+		}
+
+		extra = field_end;
+	}
+}
+
+static ZipDirectory *
+zip_directory_read (const gchar *zipfilename, struct stat *st)
+{
+	ZipDirectory *dir;
+	FILE *f;
+	guchar *cd, *p, *end;
+	guint64 cd_offset, cd_size, num_entries;
+	guint i;
+
+	f = g_fopen (zipfilename, "rb");
+	if (!f) {
+		GMAMEUI_DEBUG ("Could not open zip file %s", zipfilename);
+		return NULL;
+	}
+
+	if (!zip_find_central_directory (f, st->st_size, &cd_offset, &cd_size, &num_entries)) {
+		GMAMEUI_DEBUG ("%s is not a valid zip file", zipfilename);
+		fclose (f);
+		return NULL;
+	}
+
+	/* Each entry takes at least ZIP_CENTRAL_SIZE bytes, which stops a
+	   corrupt count allocating a huge array */
+	num_entries = MIN (num_entries, cd_size / ZIP_CENTRAL_SIZE);
+
+	cd = g_malloc (cd_size ? cd_size : 1);
+	if (!read_at (f, cd_offset, cd, cd_size)) {
+		GMAMEUI_DEBUG ("Could not read the central directory of %s", zipfilename);
+		g_free (cd);
+		fclose (f);
+		return NULL;
+	}
+	fclose (f);
+
+	dir = g_new0 (ZipDirectory, 1);
+	dir->ref_count = 1;
+	dir->filename = g_strdup (zipfilename);
+	dir->mtime = st->st_mtime;
+	dir->size = st->st_size;
+	dir->entries = g_new0 (ZipCacheEntry, num_entries);
+	dir->by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	p = cd;
+	end = cd + cd_size;
+	for (i = 0; i < num_entries; i++) {
+		ZipCacheEntry *entry;
+		guint16 name_len, extra_len, comment_len;
+
+		if ((p + ZIP_CENTRAL_SIZE > end) || (get_le32 (p) != ZIP_CENTRAL_SIG))
+			break;
+
+		name_len = get_le16 (p + 28);
+		extra_len = get_le16 (p + 30);
+		comment_len = get_le16 (p + 32);
+		if (p + ZIP_CENTRAL_SIZE + name_len + extra_len + comment_len > end)
+			break;
+
+		entry = &dir->entries[dir->num_entries++];
+		entry->flags = get_le16 (p + 8);
+		entry->method = get_le16 (p + 10);
+		entry->dos_datetime = get_le32 (p + 12);
+		entry->crc = get_le32 (p + 16);
+		entry->compressed_size = get_le32 (p + 20);
+		entry->size = get_le32 (p + 24);
+		entry->local_header_offset = get_le32 (p + 42);
+		entry->name = g_strndup ((const gchar *) p + ZIP_CENTRAL_SIZE, name_len);
+		zip_parse_zip64_extra (entry, p + ZIP_CENTRAL_SIZE + name_len, extra_len);
+
+		g_hash_table_insert (dir->by_name, g_ascii_strdown (entry->name, -1), entry);
+
+		p += ZIP_CENTRAL_SIZE + name_len + extra_len + comment_len;
+	}
+
+	if (dir->num_entries < num_entries)
+		GMAMEUI_DEBUG ("Central directory of %s is truncated, read %d of %d entries",
+			       zipfilename, dir->num_entries, (gint) num_entries);
+
+	g_free (cd);
+
+	return dir;
+}
+
+/**
+ * gmameui_zip_cache_lookup:
+ * @zipfilename: full path to the zip file
+ *
+ * Returns the central directory of the zip, reading it only if it is not
+ * already cached or the file has changed since it was read. Returns NULL if
+ * the file does not exist or is not a zip. The result must be released with
+ * gmameui_zip_directory_unref.
+ */
+ZipDirectory *
+gmameui_zip_cache_lookup (const gchar *zipfilename)
+{
+	ZipDirectory *dir;
+	struct stat st;
+
+	g_return_val_if_fail (zipfilename != NULL, NULL);
+
+	if (g_stat (zipfilename, &st) != 0) {
+		gmameui_zip_cache_invalidate (zipfilename);
+		return NULL;
+	}
+
+	g_static_mutex_lock (&zip_cache_mutex);
+
+	if (!zip_cache)
+		zip_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+						   NULL, (GDestroyNotify) gmameui_zip_directory_unref);
+
+	dir = g_hash_table_lookup (zip_cache, zipfilename);
+	if (dir && ((dir->mtime != st.st_mtime) || (dir->size != st.st_size))) {
+		g_hash_table_remove (zip_cache, zipfilename);
+		dir = NULL;
+	}
+
+	if (dir)
+		g_atomic_int_inc (&dir->ref_count);
+
+	g_static_mutex_unlock (&zip_cache_mutex);
+
+	if (dir)
+		return dir;
+
+	/* Read outside the lock so other threads are not held up by I/O. If
+	   two threads read the same zip, the later one replaces the first */
+	dir = zip_directory_read (zipfilename, &st);
+	if (!dir)
+		return NULL;
+
+	g_static_mutex_lock (&zip_cache_mutex);
+	g_atomic_int_inc (&dir->ref_count);
+	g_hash_table_replace (zip_cache, dir->filename, dir);
+	g_static_mutex_unlock (&zip_cache_mutex);
+
+	return dir;
+}
+
+/* Drop a zip from the cache, e.g. after it has been rewritten */
+void
+gmameui_zip_cache_invalidate (const gchar *zipfilename)
+{
+	g_return_if_fail (zipfilename != NULL);
+
+	g_static_mutex_lock (&zip_cache_mutex);
+	if (zip_cache)
+		g_hash_table_remove (zip_cache, zipfilename);
+	g_static_mutex_unlock (&zip_cache_mutex);
+}
+
+void
+gmameui_zip_cache_clear (void)
+{
+	g_static_mutex_lock (&zip_cache_mutex);
+	if (zip_cache) {
+		g_hash_table_destroy (zip_cache);
+		zip_cache = NULL;
+	}
+	g_static_mutex_unlock (&zip_cache_mutex);
+}
+
+ZipDirectory *
+gmameui_zip_directory_ref (ZipDirectory *dir)
+{
+	g_return_val_if_fail (dir != NULL, NULL);
+
+	g_atomic_int_inc (&dir->ref_count);
+
+	return dir;
+}
+
+void
+gmameui_zip_directory_unref (ZipDirectory *dir)
+{
+	if (!dir)
+		return;
+
+	if (g_atomic_int_dec_and_test (&dir->ref_count))
+		zip_directory_free (dir);
+}
+
+const gchar *
+gmameui_zip_directory_get_filename (ZipDirectory *dir)
+{
+	g_return_val_if_fail (dir != NULL, NULL);
+
+	return dir->filename;
+}
+
+guint
+gmameui_zip_directory_get_num_entries (ZipDirectory *dir)
+{
+	g_return_val_if_fail (dir != NULL, 0);
+
+	return dir->num_entries;
+}
+
+const ZipCacheEntry *
+gmameui_zip_directory_get_nth_entry (ZipDirectory *dir, guint n)
+{
+	g_return_val_if_fail (dir != NULL, NULL);
+	g_return_val_if_fail (n < dir->num_entries, NULL);
+
+	return &dir->entries[n];
+}
+
+/* Find a file in the zip by name, ignoring case as MAME does */
+const ZipCacheEntry *
+gmameui_zip_directory_find (ZipDirectory *dir, const gchar *name)
+{
+	ZipCacheEntry *entry;
+	gchar *key;
+
+	g_return_val_if_fail (dir != NULL, NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	key = g_ascii_strdown (name, -1);
+	entry = g_hash_table_lookup (dir->by_name, key);
+	g_free (key);
+
+	return entry;
+}
+
+/**
+ * gmameui_zip_directory_extract:
+ * @dir: the zip's directory
+ * @entry: the file to extract, from gmameui_zip_directory_find
+ *
+ * Reads a single file from the zip by seeking straight to its local header,
+ * rather than reading through the zip for it. Only stored and deflated
+ * files are supported. Returns a newly allocated buffer of entry->size
+ * bytes, or NULL if the file could not be read or its CRC is wrong.
+ */
+guchar *
+gmameui_zip_directory_extract (ZipDirectory *dir, const ZipCacheEntry *entry)
+{
+	FILE *f;
+	guchar local[ZIP_LOCAL_SIZE];
+	guchar *compressed = NULL;
+	guchar *data = NULL;
+	guint64 data_offset;
+	gboolean ok = FALSE;
+
+	g_return_val_if_fail (dir != NULL, NULL);
+	g_return_val_if_fail (entry != NULL, NULL);
+
+	if ((entry->size > ZIP_MAX_EXTRACT_SIZE) || (entry->compressed_size > ZIP_MAX_EXTRACT_SIZE)) {
+		GMAMEUI_DEBUG ("%s in %s is too large to extract", entry->name, dir->filename);
+		return NULL;
+	}
+
+	if ((entry->method != ZIP_METHOD_STORED) && (entry->method != ZIP_METHOD_DEFLATED)) {
+		GMAMEUI_DEBUG ("%s in %s uses unsupported compression method %d",
+			       entry->name, dir->filename, entry->method);
+		return NULL;
+	}
+
+	f = g_fopen (dir->filename, "rb");
+	if (!f)
+		return NULL;
+
+	/* The local header's name and extra field lengths can differ from the
+	   central directory's, so the data offset must be taken from it */
+	if (!read_at (f, entry->local_header_offset, local, ZIP_LOCAL_SIZE) ||
+	    (get_le32 (local) != ZIP_LOCAL_SIG))
+		goto out;
+
+	data_offset = entry->local_header_offset + ZIP_LOCAL_SIZE +
+		      get_le16 (local + 26) + get_le16 (local + 28);
+
+	data = g_malloc (entry->size ? entry->size : 1);
+
+	if (entry->method == ZIP_METHOD_STORED) {
+		ok = (entry->compressed_size == entry->size) &&
+		     read_at (f, data_offset, data, entry->size);
+	} else {
+		z_stream zs;
+
+		compressed = g_malloc (entry->compressed_size ? entry->compressed_size : 1);
+		if (!read_at (f, data_offset, compressed, entry->compressed_size))
+			goto out;
+
+		memset (&zs, 0, sizeof (zs));
+		if (inflateInit2 (&zs, -MAX_WBITS) != Z_OK)
+			goto out;
+
+		zs.next_in = compressed;
+		zs.avail_in = entry->compressed_size;
+		zs.next_out = data;
+		zs.avail_out = entry->size;
+
+		ok = (inflate (&zs, Z_FINISH) == Z_STREAM_END) && (zs.total_out == entry->size);
+		inflateEnd (&zs);
+	}
+
+	if (ok && (crc32 (crc32 (0L, Z_NULL, 0), data, entry->size) != entry->crc)) {
+		GMAMEUI_DEBUG ("CRC of %s in %s is incorrect", entry->name, dir->filename);
+		ok = FALSE;
+	}
+
+out:
+	fclose (f);
+	g_free (compressed);
+
+	if (!ok) {
+		GMAMEUI_DEBUG ("Could not extract %s from %s", entry->name, dir->filename);
+		g_free (data);
+		data = NULL;
+	}
+
+	return data;
+}
+
+/**
+ * gmameui_zip_directory_copy_raw:
+ * @dir: the zip's directory
+ * @entry: the file to copy, from gmameui_zip_directory_find
+ * @out: stream positioned where the data should be written
+ *
+ * Copies the file's data to @out exactly as it is stored in the zip, without
+ * decompressing it, so that it can be added to another zip with the same
+ * CRC, sizes and method. Returns FALSE if the local header doesn't agree
+ * with the central directory or the data could not be copied.
+ */
+gboolean
+gmameui_zip_directory_copy_raw (ZipDirectory *dir, const ZipCacheEntry *entry, FILE *out)
+{
+	FILE *f;
+	guchar local[ZIP_LOCAL_SIZE];
+	guchar buf[65536];
+	guint64 remaining;
+	gboolean ok = FALSE;
+
+	g_return_val_if_fail (dir != NULL, FALSE);
+	g_return_val_if_fail (entry != NULL, FALSE);
+	g_return_val_if_fail (out != NULL, FALSE);
+
+	f = g_fopen (dir->filename, "rb");
+	if (!f)
+		return FALSE;
+
+	if (!read_at (f, entry->local_header_offset, local, ZIP_LOCAL_SIZE) ||
+	    (get_le32 (local) != ZIP_LOCAL_SIG) ||
+	    (get_le16 (local + 8) != entry->method))
+		goto out;
+
+	/* Without a data descriptor, the local header has its own copy of the
+	   CRC, which must match the one being written to the new zip */
+	if (!(get_le16 (local + 6) & 0x0008) && (get_le32 (local + 14) != entry->crc)) {
+		GMAMEUI_DEBUG ("CRC of %s in the local header of %s is inconsistent",
+			       entry->name, dir->filename);
+		goto out;
+	}
+
+	if (fseeko (f, (off_t) (entry->local_header_offset + ZIP_LOCAL_SIZE +
+				get_le16 (local + 26) + get_le16 (local + 28)), SEEK_SET) != 0)
+		goto out;
+
+	remaining = entry->compressed_size;
+	while (remaining > 0) {
+		gsize len = MIN (remaining, sizeof (buf));
+
+		if ((fread (buf, 1, len, f) != len) || (fwrite (buf, 1, len, out) != len))
+			goto out;
+		remaining -= len;
+	}
+
+	ok = TRUE;
+
+out:
+	fclose (f);
+
+	if (!ok)
+		GMAMEUI_DEBUG ("Could not copy %s from %s", entry->name, dir->filename);
+
+	return ok;
+}
@@ -0,0 +1,81 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_ZIP_CACHE_H__
+#define __GMAMEUI_ZIP_CACHE_H__
+
+#include "common.h"
+
+#include <stdio.h>
+
+G_BEGIN_DECLS
+
+/* A file within a zip, as listed in the zip's central directory */
+typedef struct {
+	gchar *name;
+	guint32 crc;
+	guint16 flags;			/* General purpose bit flags */
+	guint16 method;			/* 0 = stored, 8 = deflated */
+	guint32 dos_datetime;		/* MS-DOS time in the low 16 bits, date in the high */
+	guint64 compressed_size;
+	guint64 size;
+	guint64 local_header_offset;
+} ZipCacheEntry;
+
+/* The central directory of a zip file. Directories are shared, so must be
+   released with gmameui_zip_directory_unref when no longer needed */
+typedef struct _ZipDirectory ZipDirectory;
+
+ZipDirectory *
+gmameui_zip_cache_lookup (const gchar *zipfilename);
+
+void
+gmameui_zip_cache_invalidate (const gchar *zipfilename);
+
+void
+gmameui_zip_cache_clear (void);
+
+ZipDirectory *
+gmameui_zip_directory_ref (ZipDirectory *dir);
+
+void
+gmameui_zip_directory_unref (ZipDirectory *dir);
+
+const gchar *
+gmameui_zip_directory_get_filename (ZipDirectory *dir);
+
+guint
+gmameui_zip_directory_get_num_entries (ZipDirectory *dir);
+
+const ZipCacheEntry *
+gmameui_zip_directory_get_nth_entry (ZipDirectory *dir, guint n);
+
+const ZipCacheEntry *
+gmameui_zip_directory_find (ZipDirectory *dir, const gchar *name);
+
+guchar *
+gmameui_zip_directory_extract (ZipDirectory *dir, const ZipCacheEntry *entry);
+
+gboolean
+gmameui_zip_directory_copy_raw (ZipDirectory *dir, const ZipCacheEntry *entry, FILE *out);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_ZIP_CACHE_H__ */
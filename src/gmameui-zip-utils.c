@@ -26,6 +26,8 @@
 #include <zip.h>	/* New - for zip_rename etc */
 
 #include "gmameui-zip-utils.h"
+#include "gmameui-zip-cache.h"
+#include "gmameui-archive.h"
 #include "rom_entry.h"	/* Needed for individual_rom struct */
 
 #define _FILE_OFFSET_BITS 64	/* Needed for compiling using libarchive on i386 */
@@ -57,61 +59,53 @@ load_pixbuf_data (gchar *data, gint size)
 	return pixbuf;
 }
 
-/* Given a specified zip file and target romname, return the relevant pixbuf */
+/* Image types that may be stored in icons.zip and snap.zip */
+static const gchar *zip_image_extensions[] = { "png", "ico", "jpg", "bmp", NULL };
+
+/* Given a specified zip file and target romname, return the relevant pixbuf.
+   The zip's cached directory is used to find <romname>.<extension> by exact
+   name, and only that file is read from the zip */
 GdkPixbuf *
 read_pixbuf_from_zip_file (gchar *zipfilename, gchar *romname)
 {
 	GdkPixbuf *pixbuf;
-	gchar *buffer_data; /* Space to read found pixbuf entry */
-	struct archive *zipfile;
-	struct archive_entry *zipentry;
+	GmameuiArchive *archive;
+	const ArchiveEntry *entry;
+	guchar *buffer_data; /* Space to read found pixbuf entry */
+	guint i;
 	
 	g_return_val_if_fail (zipfilename != NULL, NULL);
 	g_return_val_if_fail (romname != NULL, NULL);
-	
-	zipfile = archive_read_new ();
-	
-	g_return_val_if_fail (zipfile != NULL, NULL);
 
-	archive_read_support_compression_all (zipfile); /* Check that we can support all compression levels */
-	archive_read_support_format_zip (zipfile);  /* Check that we can support zipfiles */
-	
-	if (archive_read_open_file (zipfile, zipfilename, 10240) != ARCHIVE_OK) {
-		GMAMEUI_DEBUG ("Error opening the archive %s", zipfilename);
+	/* The images may also be in a .7z or a directory of the same name */
+	archive = gmameui_archive_open (zipfilename);
+	if (!archive)
 		return NULL;
+
+	entry = NULL;
+	for (i = 0; (entry == NULL) && (zip_image_extensions[i] != NULL); i++) {
+		gchar *entryname;
+
+		entryname = g_strdup_printf ("%s.%s", romname, zip_image_extensions[i]);
+		entry = gmameui_archive_find (archive, entryname);
+		g_free (entryname);
 	}
 
 	pixbuf = NULL;
-	
-	while (archive_read_next_header (zipfile, &zipentry) == ARCHIVE_OK) {
-		gint filesize;  /* Uncompressed size of the file */
 
-		filesize = archive_entry_size (zipentry);
+	if (entry) {
+		GMAMEUI_DEBUG ("Found entry %s in archive for ROM %s", entry->name, romname);
 
-		if (g_ascii_strncasecmp ((gchar *) archive_entry_pathname (zipentry),
-								 romname,
-								 strlen (romname)) == 0) {
-			GMAMEUI_DEBUG ("Found entry in zip file for ROM %s", romname);
-
-			buffer_data = (gchar *) g_malloc0 (filesize);
-			
-			/* Read the zipped pixbuf into memory */
-			archive_read_data_into_buffer (zipfile, buffer_data, filesize);
-			
-			pixbuf = load_pixbuf_data (buffer_data, filesize);
-									 
-			g_free (buffer_data);
-
-			break;  /* Found it - no need to continue processing */
-		}
+		buffer_data = gmameui_archive_extract (archive, entry);
+		if (buffer_data)
+			pixbuf = load_pixbuf_data ((gchar *) buffer_data, entry->size);
+
+		g_free (buffer_data);
 	}
-	
-	/* Close and clean up */
-	archive_read_close (zipfile);
-	archive_read_finish (zipfile);
+
+	gmameui_archive_unref (archive);
 	
 	return pixbuf;
-	
 }
 
 /* Takes either a full path or filename (including suffix) and strips
@@ -174,52 +168,48 @@ rename_rom_in_zip_file (gchar *zipfilename, gchar *oldname, gchar *newname)
 		GMAMEUI_DEBUG ("Zip closed successfully");
 	else
 		GMAMEUI_DEBUG ("Zip failed to update");
+
+	gmameui_zip_cache_invalidate (zipfilename);
 }
 
+/* Returns the files in the zip as a GList of individual_rom structs, from the
+   cached central directory */
 GList *get_zip_contents (gchar *zipfilename)
 {
-	struct zip *ziparchive;
-	struct zip_stat *zipcompressedfile;
-	gint num_files, i;
-	int *error;
+	ZipDirectory *dir;
+	guint num_files, i;
 	GList *contents = NULL;
 	
 	g_return_val_if_fail (zipfilename != NULL, NULL);
 	
-	ziparchive = zip_open (zipfilename, 0, error);
+	dir = gmameui_zip_cache_lookup (zipfilename);
+	if (!dir)
+		return NULL;
 
-	num_files = zip_get_num_files (ziparchive);
+	num_files = gmameui_zip_directory_get_num_entries (dir);
 
 	GMAMEUI_DEBUG ("  Opening zip file %s, there are %d files to process", zipfilename, num_files);
 	
 	for (i = 0; i < num_files; i++) {
-		int result;
-
-		zipcompressedfile = g_malloc0 (sizeof (struct zip_stat));
-		zip_stat_init (zipcompressedfile);
+		const ZipCacheEntry *entry;
 
-		result = zip_stat_index (ziparchive, i, 0, zipcompressedfile);
-
-		/*GMAMEUI_DEBUG ("   Found rom %s with CRC %x (result %d)", zipcompressedfile->name,
-		               zipcompressedfile->crc, result);*/
+		entry = gmameui_zip_directory_get_nth_entry (dir, i);
 
 		individual_rom *rom_value = (individual_rom *) g_malloc0 (sizeof (individual_rom));
 
-		rom_value->name = g_strdup (zipcompressedfile->name);
-		/*rom_value->sha1 = g_strdup (chksum_val);*/
+		rom_value->name = g_strdup (entry->name);
+		rom_value->uncomp_size = entry->size;
 
 		/* Note - we can't just store the int value of CRC, since the -listxml output
 		   provides the string (%x) version, not the integer */
-		rom_value->crc = g_strdup_printf ("%x", zipcompressedfile->crc);
-
-		contents = g_list_append (contents, rom_value);
+		rom_value->crc = g_strdup_printf ("%x", entry->crc);
 
-		/* FIXME TODO Free the zipcompressedfile stat */
+		contents = g_list_prepend (contents, rom_value);
 	}
 
-	zip_close (ziparchive);
+	gmameui_zip_directory_unref (dir);
 
-	return contents;
+	return g_list_reverse (contents);
 
 }
 
@@ -0,0 +1,497 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#define _LARGEFILE_SOURCE
+#define _FILE_OFFSET_BITS 64	/* ROM zips for some systems are larger than 2GB */
+
+#include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "gmameui-zip-writer.h"
+
+#define ZIP_LOCAL_SIG		0x04034b50
+#define ZIP_CENTRAL_SIG		0x02014b50
+#define ZIP_EOCD_SIG		0x06054b50
+#define ZIP64_EOCD_SIG		0x06064b50
+#define ZIP64_LOCATOR_SIG	0x07064b50
+#define ZIP64_EXTRA_ID		0x0001
+
+#define ZIP_VERSION		20
+#define ZIP64_VERSION		45
+
+#define ZIP_FLAG_ENCRYPTED	0x0001
+#define ZIP_FLAG_DESCRIPTOR	0x0008	/* Sizes and CRC follow the data */
+
+/* Fields of this size or larger are moved to the zip64 extra field */
+#define ZIP_MAX32		0xffffffffULL
+#define ZIP_MAX16		0xffff
+
+typedef struct {
+	ZipDirectory *src;
+	const ZipCacheEntry *entry;	/* Belongs to src */
+	gchar *name;			/* Name in the new zip */
+	guint64 offset;			/* Local header offset in the new zip */
+} ZipWriterMember;
+
+struct _ZipWriter {
+	gchar *filename;
+	GList *members;			/* ZipWriterMember, in the order to write them */
+	guint64 bytes_written;
+	gboolean written;		/* The temporary file is written and checked */
+};
+
+static void
+put_le16 (guchar *p, guint16 v)
+{
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+}
+
+static void
+put_le32 (guchar *p, guint32 v)
+{
+	put_le16 (p, v & 0xffff);
+	put_le16 (p + 2, (v >> 16) & 0xffff);
+}
+
+static void
+put_le64 (guchar *p, guint64 v)
+{
+	put_le32 (p, (guint32) (v & 0xffffffff));
+	put_le32 (p + 4, (guint32) (v >> 32));
+}
+
+static void
+zip_writer_member_free (ZipWriterMember *member)
+{
+	gmameui_zip_directory_unref (member->src);
+	g_free (member->name);
+	g_free (member);
+}
+
+ZipWriter *
+gmameui_zip_writer_new (const gchar *zipfilename)
+{
+	ZipWriter *zw;
+
+	g_return_val_if_fail (zipfilename != NULL, NULL);
+
+	zw = g_new0 (ZipWriter, 1);
+	zw->filename = g_strdup (zipfilename);
+
+	return zw;
+}
+
+void
+gmameui_zip_writer_free (ZipWriter *zw)
+{
+	g_return_if_fail (zw != NULL);
+
+	g_list_foreach (zw->members, (GFunc) zip_writer_member_free, NULL);
+	g_list_free (zw->members);
+	g_free (zw->filename);
+	g_free (zw);
+}
+
+/* Removes the file with the name from the new zip, if it has been added */
+void
+gmameui_zip_writer_remove (ZipWriter *zw, const gchar *name)
+{
+	GList *ptr;
+
+	g_return_if_fail (zw != NULL);
+	g_return_if_fail (name != NULL);
+
+	for (ptr = zw->members; ptr; ptr = g_list_next (ptr)) {
+		ZipWriterMember *member = (ZipWriterMember *) ptr->data;
+
+		if (g_ascii_strcasecmp (member->name, name) == 0) {
+			zw->members = g_list_delete_link (zw->members, ptr);
+			zip_writer_member_free (member);
+			return;
+		}
+	}
+}
+
+/**
+ * gmameui_zip_writer_add:
+ * @zw: the writer
+ * @src: directory of the zip containing the file
+ * @entry: the file, from gmameui_zip_directory_find
+ * @name: name for the file in the new zip, or NULL to keep its name
+ *
+ * Adds a file to the new zip, replacing any file already added with the
+ * same name. Encrypted files and files using a compression method other
+ * than store or deflate can't be copied.
+ */
+gboolean
+gmameui_zip_writer_add (ZipWriter *zw,
+			ZipDirectory *src,
+			const ZipCacheEntry *entry,
+			const gchar *name)
+{
+	ZipWriterMember *member;
+
+	g_return_val_if_fail (zw != NULL, FALSE);
+	g_return_val_if_fail (src != NULL, FALSE);
+	g_return_val_if_fail (entry != NULL, FALSE);
+
+	if ((entry->flags & ZIP_FLAG_ENCRYPTED) ||
+	    ((entry->method != 0) && (entry->method != 8))) {
+		GMAMEUI_DEBUG ("Can't copy %s from %s - encrypted or unsupported method",
+			       entry->name, gmameui_zip_directory_get_filename (src));
+		return FALSE;
+	}
+
+	if (name == NULL)
+		name = entry->name;
+
+	if (strlen (name) > ZIP_MAX16)
+		return FALSE;
+
+	gmameui_zip_writer_remove (zw, name);
+
+	member = g_new0 (ZipWriterMember, 1);
+	member->src = gmameui_zip_directory_ref (src);
+	member->entry = entry;
+	member->name = g_strdup (name);
+
+	zw->members = g_list_append (zw->members, member);
+
+	return TRUE;
+}
+
+guint
+gmameui_zip_writer_get_num_entries (ZipWriter *zw)
+{
+	g_return_val_if_fail (zw != NULL, 0);
+
+	return g_list_length (zw->members);
+}
+
+static gboolean
+write_local_header (FILE *out, ZipWriterMember *member)
+{
+	const ZipCacheEntry *entry = member->entry;
+	guchar header[30 + 20];
+	gboolean zip64;
+	guint16 name_len;
+	gsize len;
+
+	zip64 = (entry->size >= ZIP_MAX32) || (entry->compressed_size >= ZIP_MAX32);
+	name_len = strlen (member->name);
+
+	put_le32 (header, ZIP_LOCAL_SIG);
+	put_le16 (header + 4, zip64 ? ZIP64_VERSION : ZIP_VERSION);
+	put_le16 (header + 6, entry->flags & ~ZIP_FLAG_DESCRIPTOR);
+	put_le16 (header + 8, entry->method);
+	put_le32 (header + 10, entry->dos_datetime);
+	put_le32 (header + 14, entry->crc);
+	put_le32 (header + 18, zip64 ? ZIP_MAX32 : entry->compressed_size);
+	put_le32 (header + 22, zip64 ? ZIP_MAX32 : entry->size);
+	put_le16 (header + 26, name_len);
+	put_le16 (header + 28, zip64 ? 20 : 0);
+	len = 30;
+
+	if (fwrite (header, 1, len, out) != len)
+		return FALSE;
+	if (fwrite (member->name, 1, name_len, out) != name_len)
+		return FALSE;
+
+	if (zip64) {
+		/* The local zip64 field always holds both sizes */
+		put_le16 (header, ZIP64_EXTRA_ID);
+		put_le16 (header + 2, 16);
+		put_le64 (header + 4, entry->size);
+		put_le64 (header + 12, entry->compressed_size);
+
+		if (fwrite (header, 1, 20, out) != 20)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+write_central_header (FILE *out, ZipWriterMember *member)
+{
+	const ZipCacheEntry *entry = member->entry;
+	guchar header[46];
+	guchar extra[4 + 24];
+	guint16 extra_len, name_len;
+	gboolean big_size, big_csize, big_offset;
+
+	big_size = (entry->size >= ZIP_MAX32);
+	big_csize = (entry->compressed_size >= ZIP_MAX32);
+	big_offset = (member->offset >= ZIP_MAX32);
+	name_len = strlen (member->name);
+
+	/* Only the fields that don't fit are in the zip64 extra field, in
+	   this order */
+	extra_len = 4;
+	if (big_size) {
+		put_le64 (extra + extra_len, entry->size);
+		extra_len += 8;
+	}
+	if (big_csize) {
+		put_le64 (extra + extra_len, entry->compressed_size);
+		extra_len += 8;
+	}
+	if (big_offset) {
+		put_le64 (extra + extra_len, member->offset);
+		extra_len += 8;
+	}
+	put_le16 (extra, ZIP64_EXTRA_ID);
+	put_le16 (extra + 2, extra_len - 4);
+	if (extra_len == 4)
+		extra_len = 0;
+
+	put_le32 (header, ZIP_CENTRAL_SIG);
+	put_le16 (header + 4, extra_len ? ZIP64_VERSION : ZIP_VERSION);
+	put_le16 (header + 6, extra_len ? ZIP64_VERSION : ZIP_VERSION);
+	put_le16 (header + 8, entry->flags & ~ZIP_FLAG_DESCRIPTOR);
+	put_le16 (header + 10, entry->method);
+	put_le32 (header + 12, entry->dos_datetime);
+	put_le32 (header + 16, entry->crc);
+	put_le32 (header + 20, big_csize ? ZIP_MAX32 : entry->compressed_size);
+	put_le32 (header + 24, big_size ? ZIP_MAX32 : entry->size);
+	put_le16 (header + 28, name_len);
+	put_le16 (header + 30, extra_len);
+	put_le16 (header + 32, 0);	/* Comment */
+	put_le16 (header + 34, 0);	/* Disk number */
+	put_le16 (header + 36, 0);	/* Internal attributes */
+	put_le32 (header + 38, 0);	/* External attributes */
+	put_le32 (header + 42, big_offset ? ZIP_MAX32 : member->offset);
+
+	return (fwrite (header, 1, 46, out) == 46) &&
+	       (fwrite (member->name, 1, name_len, out) == name_len) &&
+	       (fwrite (extra, 1, extra_len, out) == extra_len);
+}
+
+static gboolean
+write_end_of_central_directory (FILE *out, guint64 num_entries,
+				guint64 cd_offset, guint64 cd_size)
+{
+	guchar record[56 + 20];
+	gboolean zip64;
+
+	zip64 = (num_entries >= ZIP_MAX16) ||
+		(cd_offset >= ZIP_MAX32) ||
+		(cd_size >= ZIP_MAX32);
+
+	if (zip64) {
+		guint64 eocd64_offset = cd_offset + cd_size;
+
+		put_le32 (record, ZIP64_EOCD_SIG);
+		put_le64 (record + 4, 56 - 12);
+		put_le16 (record + 12, ZIP64_VERSION);
+		put_le16 (record + 14, ZIP64_VERSION);
+		put_le32 (record + 16, 0);
+		put_le32 (record + 20, 0);
+		put_le64 (record + 24, num_entries);
+		put_le64 (record + 32, num_entries);
+		put_le64 (record + 40, cd_size);
+		put_le64 (record + 48, cd_offset);
+
+		put_le32 (record + 56, ZIP64_LOCATOR_SIG);
+		put_le32 (record + 60, 0);
+		put_le64 (record + 64, eocd64_offset);
+		put_le32 (record + 72, 1);
+
+		if (fwrite (record, 1, 76, out) != 76)
+			return FALSE;
+	}
+
+	put_le32 (record, ZIP_EOCD_SIG);
+	put_le16 (record + 4, 0);
+	put_le16 (record + 6, 0);
+	put_le16 (record + 8, zip64 ? ZIP_MAX16 : num_entries);
+	put_le16 (record + 10, zip64 ? ZIP_MAX16 : num_entries);
+	put_le32 (record + 12, zip64 ? ZIP_MAX32 : cd_size);
+	put_le32 (record + 16, zip64 ? ZIP_MAX32 : cd_offset);
+	put_le16 (record + 20, 0);	/* Comment */
+
+	return (fwrite (record, 1, 22, out) == 22);
+}
+
+/* Re-read the central directory of the new zip and check that every file
+   is present with the CRC and sizes it was copied with */
+static gboolean
+verify_written_zip (ZipWriter *zw, const gchar *filename)
+{
+	ZipDirectory *dir;
+	GList *ptr;
+	gboolean ok;
+
+	dir = gmameui_zip_cache_lookup (filename);
+	if (!dir)
+		return FALSE;
+
+	ok = (gmameui_zip_directory_get_num_entries (dir) == g_list_length (zw->members));
+
+	for (ptr = zw->members; ok && ptr; ptr = g_list_next (ptr)) {
+		ZipWriterMember *member = (ZipWriterMember *) ptr->data;
+		const ZipCacheEntry *entry;
+
+		entry = gmameui_zip_directory_find (dir, member->name);
+		ok = entry &&
+		     (entry->crc == member->entry->crc) &&
+		     (entry->size == member->entry->size) &&
+		     (entry->compressed_size == member->entry->compressed_size);
+
+		if (!ok)
+			GMAMEUI_DEBUG ("%s is missing or different in %s", member->name, filename);
+	}
+
+	gmameui_zip_directory_unref (dir);
+	gmameui_zip_cache_invalidate (filename);
+
+	return ok;
+}
+
+guint64
+gmameui_zip_writer_get_bytes_written (ZipWriter *zw)
+{
+	g_return_val_if_fail (zw != NULL, 0);
+
+	return zw->bytes_written;
+}
+
+/**
+ * gmameui_zip_writer_write:
+ * @zw: the writer
+ *
+ * Writes the new zip to a temporary file alongside the target and checks
+ * it, without touching the target. The source zips are only read here, so
+ * zips which copy from each other can all be written before any of them is
+ * committed. Returns TRUE if the temporary file was written.
+ */
+gboolean
+gmameui_zip_writer_write (ZipWriter *zw)
+{
+	FILE *out;
+	gchar *tmpname;
+	GList *ptr;
+	guint64 cd_offset, cd_size;
+	gboolean ok = TRUE;
+
+	g_return_val_if_fail (zw != NULL, FALSE);
+
+	tmpname = g_strdup_printf ("%s.tmp", zw->filename);
+
+	out = g_fopen (tmpname, "wb");
+	if (!out) {
+		GMAMEUI_DEBUG ("Could not create %s", tmpname);
+		g_free (tmpname);
+		return FALSE;
+	}
+
+	for (ptr = zw->members; ok && ptr; ptr = g_list_next (ptr)) {
+		ZipWriterMember *member = (ZipWriterMember *) ptr->data;
+
+		member->offset = (guint64) ftello (out);
+		ok = write_local_header (out, member) &&
+		     gmameui_zip_directory_copy_raw (member->src, member->entry, out);
+	}
+
+	cd_offset = (guint64) ftello (out);
+	for (ptr = zw->members; ok && ptr; ptr = g_list_next (ptr))
+		ok = write_central_header (out, (ZipWriterMember *) ptr->data);
+	cd_size = (guint64) ftello (out) - cd_offset;
+
+	if (ok)
+		ok = write_end_of_central_directory (out, g_list_length (zw->members),
+						     cd_offset, cd_size);
+	zw->bytes_written = (guint64) ftello (out);
+
+	/* Make sure the data is on disk before the rename replaces the
+	   original */
+	if (ok)
+		ok = (fflush (out) == 0) && (fsync (fileno (out)) == 0);
+
+	if (fclose (out) != 0)
+		ok = FALSE;
+
+	if (ok)
+		ok = verify_written_zip (zw, tmpname);
+
+	if (!ok) {
+		GMAMEUI_DEBUG ("Could not write %s", tmpname);
+		g_unlink (tmpname);
+	}
+
+	zw->written = ok;
+	g_free (tmpname);
+
+	return ok;
+}
+
+/**
+ * gmameui_zip_writer_commit:
+ * @zw: the writer
+ * @backupname: where to move the original zip, or NULL to replace it
+ *
+ * Writes the new zip to a temporary file if gmameui_zip_writer_write
+ * hasn't already, then renames it over the target. The target is left
+ * unchanged if anything fails. Returns TRUE if the target was replaced.
+ */
+gboolean
+gmameui_zip_writer_commit (ZipWriter *zw, const gchar *backupname)
+{
+	gchar *tmpname;
+	gboolean ok;
+
+	g_return_val_if_fail (zw != NULL, FALSE);
+
+	if (!zw->written && !gmameui_zip_writer_write (zw))
+		return FALSE;
+
+	tmpname = g_strdup_printf ("%s.tmp", zw->filename);
+
+	/* Keep the original until the new zip is in place, so it can be put
+	   back if the rename fails */
+	if (backupname) {
+		ok = (g_rename (zw->filename, backupname) == 0);
+		if (ok && (g_rename (tmpname, zw->filename) != 0)) {
+			g_rename (backupname, zw->filename);
+			ok = FALSE;
+		}
+	} else {
+		ok = (g_rename (tmpname, zw->filename) == 0);
+	}
+
+	zw->written = FALSE;
+
+	if (ok) {
+		gmameui_zip_cache_invalidate (zw->filename);
+		GMAMEUI_DEBUG ("Wrote %d files to %s", g_list_length (zw->members), zw->filename);
+	} else {
+		GMAMEUI_DEBUG ("Could not write %s", zw->filename);
+		g_unlink (tmpname);
+	}
+
+	g_free (tmpname);
+
+	return ok;
+}
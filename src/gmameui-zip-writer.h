@@ -0,0 +1,64 @@
+/*
+ * GMAMEUI
+ *
+ * Copyright 2010 Andrew Burton <adb@iinet.net.au>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+#ifndef __GMAMEUI_ZIP_WRITER_H__
+#define __GMAMEUI_ZIP_WRITER_H__
+
+#include "common.h"
+#include "gmameui-zip-cache.h"
+
+G_BEGIN_DECLS
+
+/* Builds a zip from files already stored in other zips. The compressed data
+   is copied as-is, so nothing is inflated or deflated. The zip is only
+   written when committed, to a temporary file which then replaces the
+   target */
+typedef struct _ZipWriter ZipWriter;
+
+ZipWriter *
+gmameui_zip_writer_new (const gchar *zipfilename);
+
+void
+gmameui_zip_writer_free (ZipWriter *zw);
+
+gboolean
+gmameui_zip_writer_add (ZipWriter *zw,
+			ZipDirectory *src,
+			const ZipCacheEntry *entry,
+			const gchar *name);
+
+void
+gmameui_zip_writer_remove (ZipWriter *zw, const gchar *name);
+
+guint
+gmameui_zip_writer_get_num_entries (ZipWriter *zw);
+
+guint64
+gmameui_zip_writer_get_bytes_written (ZipWriter *zw);
+
+gboolean
+gmameui_zip_writer_write (ZipWriter *zw);
+
+gboolean
+gmameui_zip_writer_commit (ZipWriter *zw, const gchar *backupname);
+
+G_END_DECLS
+
+#endif /* __GMAMEUI_ZIP_WRITER_H__ */
@@ -40,6 +40,8 @@
 #include "gmameui.h"
 #include "gui.h"
 #include "io.h"
+#include "gmameui-zip-cache.h"
+#include "gmameui-archive.h"
 #include "mame_options.h"
 #include "mame_options_legacy.h"
 #include "options_string.h"
@@ -51,6 +53,8 @@
 
 #define BUFFER_SIZE 1000
 
+/* The benchmark program has its own main, and sets up only what it uses */
+#ifndef GMAMEUI_BENCHMARK
 static void
 gmameui_init (void);
 
@@ -63,6 +67,10 @@ main (int argc, char *argv[])
 	bind_textdomain_codeset (PACKAGE, "UTF-8");
 #endif
 
+	/* Threads are used to verify CHDs in the background */
+	if (!g_thread_supported ())
+		g_thread_init (NULL);
+
 	gtk_init (&argc, &argv);
 
 	gmameui_init ();
@@ -70,6 +78,10 @@ main (int argc, char *argv[])
 	if (init_gui () == -1)
 		return -1;
 
+	/* Romsets are also found from worker threads, which can't read the
+	   ROM paths from the preferences themselves */
+	gmameui_archive_index_rom_paths ();
+
 	/* Show a progress bar while the gamelist is being loaded */
 	/* FIXME TODO These should be controlled via g_signal_emit
 	   calls for loading the gamelist etc */
@@ -95,6 +107,13 @@ main (int argc, char *argv[])
 		   filter list, so the catver filters are added after the default ones */
 		if (!load_catver_ini ())
 			g_message (_("catver not loaded, using default values"));
+
+		/* Restore the results of previous audits */
+		gmameui_audit_store_apply (gui_prefs.audit_store, gui_prefs.gl);
+
+		/* Mark which romsets are present in the ROM paths, so the
+		   availability filters are correct before an audit is run */
+		quick_check ();
 	}
 	
 	/* FIXME TODO These should be controlled via g_signal_emit
@@ -208,6 +227,12 @@ g_message (_("Time to initialise: %.02f seconds"), g_timer_elapsed (mytimer, NUL
 	/* Create a new audit object */
 	gui_prefs.audit = gmameui_audit_new ();
 
+	/* Load the results of previous audits */
+	filename = g_build_filename (g_get_user_config_dir (), "gmameui", "audit.dat", NULL);
+	gui_prefs.audit_store = gmameui_audit_store_new (filename);
+	gmameui_audit_store_load (gui_prefs.audit_store);
+	g_free (filename);
+
 	/* Create a new IO Handler object */
 	gui_prefs.io_handler = gmameui_io_handler_new ();
 
@@ -244,6 +269,7 @@ g_message (_("Time to initialise: %.02f seconds"), g_timer_elapsed (mytimer, NUL
 	joy_focus_on ();
 
 }
+#endif /* GMAMEUI_BENCHMARK */
 
 /* launch following the commandline prepared by play_game, playback_game and record_game 
    then test if the game is launched, detect error and update game status */
@@ -649,6 +675,13 @@ exit_gmameui (void)
 	g_object_unref (gui_prefs.audit);
 	gui_prefs.audit = NULL;
 
+	gmameui_audit_store_save (gui_prefs.audit_store);
+	gmameui_audit_store_free (gui_prefs.audit_store);
+	gui_prefs.audit_store = NULL;
+
+	gmameui_archive_cache_clear ();
+	gmameui_zip_cache_clear ();
+
 	g_object_unref (gui_prefs.io_handler);
 	gui_prefs.io_handler = NULL;
 
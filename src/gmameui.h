@@ -34,6 +34,8 @@
 #include "gmameui-romfix-list.h"
 #include "filter.h"
 #include "audit.h"
+#include "gmameui-audit-store.h"
+#include "gmameui-rom-index.h"
 #include "io.h"
 
 typedef enum {
@@ -136,8 +138,9 @@ struct gui_prefs_struct {
 	MameRomEntry *current_game;
 	MameGamelist *gl;
 	GmameuiAudit *audit;
+	GmameuiAuditStore *audit_store;
 	GMAMEUIIOHandler *io_handler;
-	GHashTable *rom_hashtable;
+	GmameuiRomIndex *rom_index;
 	GMAMEUIRomfixList *fixes;
 };
 
@@ -87,6 +87,7 @@ struct _MameGuiPrefsPrivate {
 	gint current_rom_filter;	/* Whether to show all, available or unavailable ROMs in selected filter */
 	ListMode current_mode;
 	ListMode previous_mode;
+	gboolean clones_tree;		/* Whether clones are shown under their parent */
 	
 	GValueArray *cols_shown;	/* Array of integer, 0 hidden, 1 shown */
 	GValueArray *cols_width;	/* Array of integer */
@@ -101,6 +102,13 @@ struct _MameGuiPrefsPrivate {
 	gboolean prefercustomicons;     /* Whether to use custom icons or status icons in gamelist */
 	gboolean gui_joy;
 	gchar *joystick_name;
+
+	/* ROM manager preferences */
+	gboolean chd_deep_verify;	/* Whether to read the whole CHD, as well as checking the header */
+	gint chd_verify_rate;		/* Maximum KB/s read when deep verifying a CHD */
+	gint rommgr_io_depth;		/* Number of zips the ROM manager reads at once */
+	gboolean rom_deep_verify;	/* Whether to inflate and SHA1 every ROM, as well as checking the CRCs */
+	gint rom_verify_rate;		/* Maximum KB/s read when deep verifying ROMs */
 	
 	/* Column layout preferences */
 	
@@ -186,6 +194,21 @@ mame_gui_prefs_set_property (GObject *object,
 		case PROP_JOYSTICKNAME:
 			prefs->priv->joystick_name = g_strdup (g_value_get_string (value));
 			break;
+		case PROP_CHD_DEEP_VERIFY:
+			prefs->priv->chd_deep_verify = g_value_get_boolean (value);
+			break;
+		case PROP_CHD_VERIFY_RATE:
+			prefs->priv->chd_verify_rate = g_value_get_int (value);
+			break;
+		case PROP_ROMMGR_IO_DEPTH:
+			prefs->priv->rommgr_io_depth = g_value_get_int (value);
+			break;
+		case PROP_ROM_DEEP_VERIFY:
+			prefs->priv->rom_deep_verify = g_value_get_boolean (value);
+			break;
+		case PROP_ROM_VERIFY_RATE:
+			prefs->priv->rom_verify_rate = g_value_get_int (value);
+			break;
 		case PROP_THEPREFIX:
 			prefs->priv->theprefix = g_value_get_boolean (value);
 
@@ -226,6 +249,9 @@ mame_gui_prefs_set_property (GObject *object,
 		case PROP_PREVIOUS_MODE:
 			prefs->priv->previous_mode = g_value_get_int (value);
 			break;
+		case PROP_CLONES_TREE:
+			prefs->priv->clones_tree = g_value_get_boolean (value);
+			break;
 		case PROP_COLS_SHOWN:
 			va = g_value_get_boxed (value);
 			if (prefs->priv->cols_shown)
@@ -335,6 +361,21 @@ mame_gui_prefs_get_property (GObject *object,
 		case PROP_JOYSTICKNAME:
 			g_value_set_string (value, prefs->priv->joystick_name);
 			break;
+		case PROP_CHD_DEEP_VERIFY:
+			g_value_set_boolean (value, prefs->priv->chd_deep_verify);
+			break;
+		case PROP_CHD_VERIFY_RATE:
+			g_value_set_int (value, prefs->priv->chd_verify_rate);
+			break;
+		case PROP_ROMMGR_IO_DEPTH:
+			g_value_set_int (value, prefs->priv->rommgr_io_depth);
+			break;
+		case PROP_ROM_DEEP_VERIFY:
+			g_value_set_boolean (value, prefs->priv->rom_deep_verify);
+			break;
+		case PROP_ROM_VERIFY_RATE:
+			g_value_set_int (value, prefs->priv->rom_verify_rate);
+			break;
 		case PROP_THEPREFIX:
 			g_value_set_boolean (value, prefs->priv->theprefix);
 			break;
@@ -363,6 +404,9 @@ mame_gui_prefs_get_property (GObject *object,
 		case PROP_PREVIOUS_MODE:
 			g_value_set_int (value, prefs->priv->previous_mode);
 			break;
+		case PROP_CLONES_TREE:
+			g_value_set_boolean (value, prefs->priv->clones_tree);
+			break;
 		case PROP_COLS_SHOWN:
 			g_value_set_boxed (value, prefs->priv->cols_shown);
 			break;
@@ -467,6 +511,9 @@ mame_gui_prefs_class_init (MameGuiPrefsClass *klass)
 	g_object_class_install_property (object_class,
 					 PROP_PREVIOUS_MODE,
 					 g_param_spec_int ("previous-mode", "Previous Mode", "Previous Mode", LIST, DETAILS, LIST, G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_CLONES_TREE,
+					 g_param_spec_boolean ("clones-tree", "Group Clones", "Show clones under their parent", FALSE, G_PARAM_READWRITE));
 	g_object_class_install_property (object_class,
 					 PROP_COLS_SHOWN,
 					 g_param_spec_value_array ("cols-shown", "Columns Shown", "Which Columns Are Shown or Hidden", NULL, G_PARAM_READWRITE));
@@ -505,6 +552,23 @@ mame_gui_prefs_class_init (MameGuiPrefsClass *klass)
 	g_object_class_install_property (object_class,
 					 PROP_JOYSTICKNAME,
 					 g_param_spec_string ("joystick-name", "Joystick Name", "Device name of the joystick", "/dev/js0", G_PARAM_READWRITE));
+
+	/* ROM manager preferences */
+	g_object_class_install_property (object_class,
+					 PROP_CHD_DEEP_VERIFY,
+					 g_param_spec_boolean ("chd-deep-verify", "Deep CHD verify", "Read the whole CHD image when verifying disks, not just the header", FALSE, G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_CHD_VERIFY_RATE,
+					 g_param_spec_int ("chd-verify-rate", "CHD verify rate", "Maximum rate in KB per second to read CHD images when deep verifying (0 is unlimited)", 0, G_MAXINT, 20480, G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_ROMMGR_IO_DEPTH,
+					 g_param_spec_int ("rommgr-io-depth", "ROM manager I/O depth", "Number of romsets the ROM manager scans at the same time", 1, 64, 4, G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_ROM_DEEP_VERIFY,
+					 g_param_spec_boolean ("rom-deep-verify", "Deep ROM verify", "Decompress every ROM and check its SHA1, not just the CRC in the zip header", FALSE, G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+					 PROP_ROM_VERIFY_RATE,
+					 g_param_spec_int ("rom-verify-rate", "ROM verify rate", "Maximum rate in KB per second to read romsets when deep verifying (0 is unlimited)", 0, G_MAXINT, 20480, G_PARAM_READWRITE));
 	
 	/* Miscellaneous preferences */
 	g_object_class_install_property (object_class,
@@ -614,6 +678,7 @@ mame_gui_prefs_init (MameGuiPrefs *pr)
 	pr->priv->current_rom_filter = mame_gui_prefs_get_int_property_from_key_file (pr, "current-rom-filter");
 	pr->priv->current_mode = mame_gui_prefs_get_int_property_from_key_file (pr, "current-mode");
 	pr->priv->previous_mode = mame_gui_prefs_get_int_property_from_key_file (pr, "previous-mode");
+	pr->priv->clones_tree = mame_gui_prefs_get_bool_property_from_key_file (pr, "clones-tree");
 	int_array = g_key_file_get_integer_list (pr->priv->prefs_ini_file, "Preferences", "cols-shown", &columnsize, &error);
 	for (i = 0; i < NUMBER_COLUMN; ++i) {
 		GValue val = { 0, };
@@ -659,6 +724,13 @@ mame_gui_prefs_init (MameGuiPrefs *pr)
 	pr->priv->joystick_name = mame_gui_prefs_get_string_property_from_key_file (pr, "joystick-name");
 	if (!pr->priv->joystick_name)
 		pr->priv->joystick_name = g_strdup (get_joy_dev ());
+
+	/* ROM manager preferences */
+	pr->priv->chd_deep_verify = mame_gui_prefs_get_bool_property_from_key_file (pr, "chd-deep-verify");
+	pr->priv->chd_verify_rate = mame_gui_prefs_get_int_property_from_key_file (pr, "chd-verify-rate");
+	pr->priv->rommgr_io_depth = mame_gui_prefs_get_int_property_from_key_file (pr, "rommgr-io-depth");
+	pr->priv->rom_deep_verify = mame_gui_prefs_get_bool_property_from_key_file (pr, "rom-deep-verify");
+	pr->priv->rom_verify_rate = mame_gui_prefs_get_int_property_from_key_file (pr, "rom-verify-rate");
 	
 	/* Miscellaneous preferences */
 	pr->priv->theprefix = mame_gui_prefs_get_bool_property_from_key_file (pr, "theprefix");
@@ -710,6 +782,7 @@ mame_gui_prefs_init (MameGuiPrefs *pr)
 	g_signal_connect (pr, "notify::current-rom-filter", (GCallback) mame_gui_prefs_save_int, NULL);
 	g_signal_connect (pr, "notify::current-mode", (GCallback) mame_gui_prefs_save_int, NULL);
 	g_signal_connect (pr, "notify::previous-mode", (GCallback) mame_gui_prefs_save_int, NULL);
+	g_signal_connect (pr, "notify::clones-tree", (GCallback) mame_gui_prefs_save_bool, NULL);
 	g_signal_connect (pr, "notify::cols-shown", (GCallback) mame_gui_prefs_save_int_arr, NULL);
 	g_signal_connect (pr, "notify::cols-width", (GCallback) mame_gui_prefs_save_int_arr, NULL);
 	g_signal_connect (pr, "notify::sort-col", (GCallback) mame_gui_prefs_save_int, NULL);
@@ -722,6 +795,11 @@ mame_gui_prefs_init (MameGuiPrefs *pr)
 	g_signal_connect (pr, "notify::prefercustomicons", (GCallback) mame_gui_prefs_save_bool, NULL);
 	g_signal_connect (pr, "notify::usejoyingui", (GCallback) mame_gui_prefs_save_bool, NULL);
 	g_signal_connect (pr, "notify::joystick-name", (GCallback) mame_gui_prefs_save_string, NULL);
+	g_signal_connect (pr, "notify::chd-deep-verify", (GCallback) mame_gui_prefs_save_bool, NULL);
+	g_signal_connect (pr, "notify::chd-verify-rate", (GCallback) mame_gui_prefs_save_int, NULL);
+	g_signal_connect (pr, "notify::rommgr-io-depth", (GCallback) mame_gui_prefs_save_int, NULL);
+	g_signal_connect (pr, "notify::rom-deep-verify", (GCallback) mame_gui_prefs_save_bool, NULL);
+	g_signal_connect (pr, "notify::rom-verify-rate", (GCallback) mame_gui_prefs_save_int, NULL);
 	g_signal_connect (pr, "notify::theprefix", (GCallback) mame_gui_prefs_save_bool, NULL);
 	g_signal_connect (pr, "notify::current-rom", (GCallback) mame_gui_prefs_save_string, NULL);
 	g_signal_connect (pr, "notify::current-executable", (GCallback) mame_gui_prefs_save_string, NULL);
@@ -73,6 +73,7 @@ enum
 	PROP_CURRENT_ROMFILTER,
 	PROP_CURRENT_MODE,
 	PROP_PREVIOUS_MODE,
+	PROP_CLONES_TREE,
 	PROP_COLS_SHOWN,
 	PROP_COLS_WIDTH,
 	PROP_SORT_COL,
@@ -86,6 +87,12 @@ enum
 	PROP_PREFERCUSTOMICONS,
 	PROP_USEJOYINGUI,
 	PROP_JOYSTICKNAME,
+	/* ROM manager preferences */
+	PROP_CHD_DEEP_VERIFY,
+	PROP_CHD_VERIFY_RATE,
+	PROP_ROMMGR_IO_DEPTH,
+	PROP_ROM_DEEP_VERIFY,
+	PROP_ROM_VERIFY_RATE,
 	/* Miscellaneous preferences */
 	PROP_THEPREFIX,
 	PROP_CURRENT_ROM,
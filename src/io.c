@@ -30,6 +30,7 @@
 #include "io.h"
 #include "gui.h"
 #include "gmameui-marshaller.h"
+#include "gmameui-archive.h"
 
 static void gmameui_io_handler_class_init (GMAMEUIIOHandlerClass *klass);
 static void gmameui_io_handler_init (GMAMEUIIOHandler *handler);
@@ -180,9 +181,6 @@ load_games_ini (void)
 		GMAMEUI_DEBUG ("Error loading games.ini file: %s", error->message);
 		g_error_free (error);
 		g_key_file_free (gameini_list);
-#ifdef QUICK_CHECK_ENABLED
-		mame_gamelist_set_not_checked_list (gui_prefs.gl, romlist);
-#endif
 		return FALSE;
 	}
 
@@ -211,14 +209,6 @@ load_games_ini (void)
 				      "has-samples", has_samples,
 				      "is-favourite", is_favourite,
 				      NULL);
-
-#ifdef QUICK_CHECK_ENABLED
-			if ((mame_rom_entry_get_rom_status (tmprom) == UNKNOWN || NOT_AVAIL || INCORRECT) &&
-			    (gui_prefs.GameCheck))
-			{
-				game_list.not_checked_list = g_list_append (game_list.not_checked_list, tmprom);
-			}
-#endif
 		} else {
 			GMAMEUI_DEBUG ("Could not find ROM in list for %s", gamelist[i]);
 		}
@@ -369,37 +359,14 @@ load_catver_ini (void)
 	return TRUE;
 }
 
-#ifdef QUICK_CHECK_ENABLED
 gboolean
 check_rom_exists_as_file (gchar *romname) {
-	gchar *filename, *dirname;
-	gchar *zipname;
-	gboolean retval;
-	int i;
-	
-	retval = FALSE;
-
-	zipname = g_strdup_printf("%s.zip", romname);
-	
-	for (i = 0; gui_prefs.RomPath[i] != NULL; i++) {
-		filename = g_build_filename (gui_prefs.RomPath[i], zipname, NULL);
-		dirname = g_build_filename (gui_prefs.RomPath[i], romname, NULL);
-		
-		if (g_file_test (filename, G_FILE_TEST_EXISTS) ||
-		    g_file_test (dirname, G_FILE_TEST_IS_DIR)) {
-			retval = TRUE;
-	    		break;
-		}
-	}
-	if (filename)
-		g_free (filename);
-	if (dirname)
-		g_free (dirname);
-	g_free (zipname);
+	g_return_val_if_fail (romname != NULL, FALSE);
 
-	return retval;
+	return gmameui_archive_romset_exists (romname);
 }
 
+#ifdef QUICK_CHECK_ENABLED
 /* TODO FIXME This function never gets called, but should use similar code
    to check_rom_exists_as_file; or combine the two */
 gboolean
@@ -423,97 +390,84 @@ check_samples_exists_as_file (gchar *samplename) {
 }
 #endif
 
-void
-quick_check (void)
+/* Whether the romsets in the ROM paths look to be merged, with each clone's
+   ROMs in its parent's file. Clones have no file of their own in a merged
+   collection, so a collection with any clone file is split or non-merged.
+   Only the romset index is used, so no file is opened */
+static gboolean
+romsets_are_merged (GList *romlist)
 {
-#ifdef QUICK_CHECK_ENABLED
-	static gboolean quick_check_running = FALSE;
-	GList *list_pointer;
-	gint nb_rom_not_checked;
-	gfloat done;
-	MameRomEntry *rom;
+	GList *ptr;
+	gboolean parent_found = FALSE;
 
-	GMAMEUI_DEBUG ("Running quick check.");
-	if (game_list.num_games == 0)
-		return;
+	for (ptr = romlist; ptr; ptr = g_list_next (ptr)) {
+		MameRomEntry *rom = (MameRomEntry *) ptr->data;
 
-	/*prevent user to launch several quick check at the same time */
-	if (quick_check_running)
-	{
-		GMAMEUI_DEBUG ("Quick check already running");
-		return;
-	}
-	quick_check_running = TRUE;
-		
-	show_progress_bar ();
-
-	nb_rom_not_checked = g_list_length (game_list.not_checked_list);
-	g_message (_("Performing quick check, please wait:"));
-	/* Disable the callback */
-	g_signal_handlers_block_by_func (G_OBJECT (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (main_gui.scrolled_window_games))),
-					 (gpointer)adjustment_scrolled, NULL);
-
-	/* need to use the last or I can find the list anymore*/
-	for (list_pointer = game_list.not_checked_list;
-	     list_pointer;
-	     list_pointer = g_list_next (list_pointer))
-	{
-		rom = (MameRomEntry *)list_pointer->data;
+		if (!check_rom_exists_as_file ((gchar *) mame_rom_entry_get_romname (rom)))
+			continue;
 
-		/* Check for the existence of the ROM; if the ROM is a clone, the
-		   parent set must exist as well */
 		if (mame_rom_entry_is_clone (rom))
-			if ((check_rom_exists_as_file (mame_rom_entry_get_romname (rom))) &&
-			    (check_rom_exists_as_file (mame_rom_entry_get_parent_romname (rom))))
-			    g_object_set (rom, "has-roms", UNKNOWN, NULL);
-			else
-			    g_object_set (rom, "has-roms", NOT_AVAIL, NULL);
-
-		else if (check_rom_exists_as_file (mame_rom_entry_get_romname (rom)))
-			g_object_set (rom, "has-roms", UNKNOWN, NULL);
-		else
-			g_object_set (rom, "has-roms", NOT_AVAIL, NULL);
+			return FALSE;
 
+		parent_found = TRUE;
+	}
 
-		/* Looking for samples */
-		rom->has_samples = 0;
+	return parent_found;
+}
 
-		if (mame_rom_entry_has_samples (rom))
-		{
-			/* Check for the existence of the samples; if the samples is a clone, the
-			   parent set must exist as well */
-			if (strcmp (rom->sampleof, "-")) {
-				if ((check_rom_exists_as_file (mame_rom_entry_get_romname (rom))) &&
-				    (check_rom_exists_as_file (rom->sampleof)))
-					g_object_set (rom, "has-samples", CORRECT, NULL);
-			} else if (check_rom_exists_as_file (mame_rom_entry_get_romname (rom)))
-				g_object_set (rom, "has-samples", CORRECT, NULL);
-		}
-		
-		list_pointer->data = NULL;
-		nb_rom_not_checked--;
+/* Quick check for the presence of each romset, without running a MAME audit.
+   Romsets with no file or directory in the ROM paths are marked as not
+   available; romsets that are present but were previously not available are
+   marked as unknown until they are audited. Romsets already audited keep
+   their status */
+void
+quick_check (void)
+{
+	GList *romlist;
+	GList *list_pointer;
+	gboolean gamecheck;
+	GTimer *timer;
+	gboolean merged;
+	guint num_avail = 0;
 
-		done = (gfloat) (game_list.num_games - nb_rom_not_checked) / (gfloat)game_list.num_games;
+	g_object_get (main_gui.gui_prefs, "gamecheck", &gamecheck, NULL);
+	if (!gamecheck)
+		return;
 
-#if 0
-		if (done >= 0.0 && done <= 1.0)
-			update_progress_bar (done);
-#endif
+	GMAMEUI_DEBUG ("Running quick check.");
+	timer = g_timer_new ();
+
+	gmameui_archive_index_rom_paths ();
+
+	romlist = mame_gamelist_get_roms_glist (gui_prefs.gl);
+	merged = romsets_are_merged (romlist);
+	GMAMEUI_DEBUG ("Quick check - romsets are %s", merged ? "merged" : "split or non-merged");
 
-		/* if the game is in the list, update it */
-		if (rom->is_in_list)
-			mame_gamelist_view_update_game_in_list (rom);
+	for (list_pointer = g_list_first (romlist);
+	     list_pointer != NULL;
+	     list_pointer = g_list_next (list_pointer)) {
+		MameRomEntry *rom = (MameRomEntry *) list_pointer->data;
+		gboolean present;
+
+		/* In a merged set the clone's ROMs are found in the parent's
+		   file, so a clone has no file of its own. Otherwise a clone
+		   without a file isn't available, whatever its parent */
+		present = check_rom_exists_as_file ((gchar *) mame_rom_entry_get_romname (rom));
+		if (!present && merged && mame_rom_entry_is_clone (rom))
+			present = check_rom_exists_as_file ((gchar *) mame_rom_entry_get_parent_romname (rom));
+
+		if (!present)
+			g_object_set (rom, "has-roms", NOT_AVAIL, NULL);
+		else {
+			if (mame_rom_entry_get_rom_status (rom) == NOT_AVAIL)
+				g_object_set (rom, "has-roms", UNKNOWN, NULL);
+			num_avail++;
+		}
 	}
-	g_list_free(game_list.not_checked_list);
-	game_list.not_checked_list = NULL;
 
-	hide_progress_bar ();
-	quick_check_running= FALSE;
-	
-	/* Re-Enable the callback */
-	g_signal_handlers_unblock_by_func (G_OBJECT (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (main_gui.scrolled_window_games))),
-					   (gpointer)adjustment_scrolled, NULL);
-#endif
+	GMAMEUI_DEBUG ("Quick check found %d romsets in %.3f seconds",
+		       num_avail, g_timer_elapsed (timer, NULL));
+	g_timer_destroy (timer);
 }
 
 GList *
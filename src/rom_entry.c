@@ -30,6 +30,9 @@
 #include "gui.h"	/* For main_gui.gui_prefs */
 #include "gmameui-zip-utils.h"
 #include "gmameui-listoutput.h" /* To create the ROM hash table */
+#include "gmameui-chd.h"
+#include "gmameui-rom-index.h"
+#include "gmameui-archive.h"
 #include "mame-exec-list.h"
 
 static void
@@ -148,6 +151,7 @@ struct _MameRomEntryPrivate {
 	DriverStatus driver_status_graphics;
 	
 	GList *roms;    /* GList of individual_rom structs, as expected and generated by -listxml */
+	GList *disks;   /* GList of individual_rom structs for the CHDs - crc is always NULL */
 	
 	/* String to sort the clones next to the original (will be original-clone) */
 	gchar *clonesort;
@@ -455,6 +459,9 @@ mame_rom_entry_finalize (GObject *obj)
 	g_list_foreach (rom->priv->roms,
 			(GFunc) destroy_rom,
 			NULL);
+	g_list_foreach (rom->priv->disks,
+			(GFunc) destroy_rom,
+			NULL);
 		
 // FIXME TODO	g_free (pr->priv);
 
@@ -608,6 +615,7 @@ mame_rom_entry_init (MameRomEntry *rom)
 	
 	/* Initialise the GList */
 	rom->priv->roms = NULL;
+	rom->priv->disks = NULL;
 	
 	/* Set handlers so that whenever the values are changed (from anywhere), the signal handler
 	   is invoked; the callback then saves to the g_key_file */
@@ -743,9 +751,16 @@ mame_rom_entry_set_position (MameRomEntry *rom, GtkTreeIter position)
 	rom->priv->position = position;
 }
 
+/* The romset takes over the reference to the icon */
 void
 mame_rom_entry_set_icon (MameRomEntry *rom, GdkPixbuf *icon_pixbuf)
 {
+	if (rom->priv->icon_pixbuf == icon_pixbuf)
+		return;
+
+	if (rom->priv->icon_pixbuf)
+		g_object_unref (rom->priv->icon_pixbuf);
+
 	rom->priv->icon_pixbuf = icon_pixbuf;
 }
 
@@ -886,6 +901,18 @@ mame_rom_entry_get_manufacturer (MameRomEntry *rom)
 	return rom->priv->manu;
 }
 
+const gchar *
+mame_rom_entry_get_category (MameRomEntry *rom)
+{
+	return rom->priv->category;
+}
+
+const gchar *
+mame_rom_entry_get_version_added (MameRomEntry *rom)
+{
+	return rom->priv->mame_ver_added;
+}
+
 gchar **
 mame_rom_entry_get_manufacturers (MameRomEntry *rom)
 {
@@ -1001,6 +1028,12 @@ mame_rom_entry_add_rom_ref (MameRomEntry *rom, individual_rom *rom_ref)
 	rom->priv->roms = g_list_append (rom->priv->roms, rom_ref);
 }
 
+void
+mame_rom_entry_add_disk_ref (MameRomEntry *rom, individual_rom *disk_ref)
+{
+	rom->priv->disks = g_list_append (rom->priv->disks, disk_ref);
+}
+
 void
 mame_rom_entry_rom_played (MameRomEntry *rom, gboolean warning, gboolean error)
 {
@@ -1182,90 +1215,88 @@ mame_rom_entry_get_brothers (MameRomEntry *rom)
 	return brothers;
 }
 
-/* Get a list of clones of this ROM using the -listclones option */
+/* Get the romnames of the clones of this ROM from the gamelist's clone
+   index, or NULL if it has none. Free with g_strfreev () */
 gchar **
 mame_rom_entry_get_clones (MameRomEntry *rom)
 {
+	GList *clones, *ptr;
+	gchar **romnames;
+	guint i;
+
 	g_return_val_if_fail (rom != NULL, NULL);
 	
 	if (mame_rom_entry_is_clone (rom))
 		return NULL;
 
-	/* AAA FIXME TODO */ return NULL;
+	clones = mame_gamelist_get_clones (gui_prefs.gl, rom->priv->romname);
+	if (clones == NULL)
+		return NULL;
+
+	romnames = g_new0 (gchar *, g_list_length (clones) + 1);
+	for (ptr = clones, i = 0; ptr; ptr = g_list_next (ptr), i++)
+		romnames[i] = g_strdup (mame_rom_entry_get_romname (ptr->data));
+
+	return romnames;
 }
 
+/* Returns the zip, 7z or directory holding the romset in the ROM paths, or
+   NULL if the romset isn't there */
 GFile *
 mame_rom_entry_get_disk_location (gchar *romname)
 {
-	GValueArray *va_rom_paths;
 	GFile *file;
-	gchar *romfilename;
-	gboolean found;
+	gchar *path;
 
 	g_return_val_if_fail (romname != NULL, NULL);
 
-	found = FALSE;
-	
-	romfilename = g_strdup_printf ("%s.zip", romname);
-
-	/* Get the ROM paths */
-	g_object_get (main_gui.gui_prefs, "rom-paths", &va_rom_paths, NULL);
-
-	guint i;
-	for (i = 0; i < va_rom_paths->n_values; i++) {
-		
-		gchar *path;
-
-		path = g_build_filename (g_value_get_string (g_value_array_get_nth (va_rom_paths, i)),
-		                         romfilename,
-		                         NULL);
-
-		if (g_file_test (path, G_FILE_TEST_EXISTS)) {
-			found = TRUE;
-			file = g_file_new_for_path (path);
-			g_free (path);
-			break;
-		}/* else {
-			GMAMEUI_DEBUG ("Could not open file %s - file does not exist", path);
-			g_free (path);
-		}*/
-	}
-
-	g_value_array_free (va_rom_paths);
-	va_rom_paths = NULL;
+	path = gmameui_archive_find_romset (romname);
+	if (path == NULL)
+		return NULL;
 
-	g_free (romfilename);
+	file = g_file_new_for_path (path);
+	g_free (path);
 
-	if (found)
-		return file;
-	else
-		return NULL;
+	return file;
 }
 
-/* Gets all the ROMs in the zipfile returned as a GList of
+/* Gets all the ROMs in the romset's archive returned as a GList of
    individual_rom structs */
 static GList *
-get_roms_in_zip_file (gchar *romname)
+get_roms_in_romset (gchar *romname)
 {
-	GFile *romfile; /* Zipped romset */
-	gchar *romfilename;
+	GmameuiArchive *archive;
 	GList *roms = NULL;
+	guint i;
 
-	romfile = mame_rom_entry_get_disk_location (romname);
+	archive = gmameui_archive_open_romset (romname);
 
-	/* If romfile is NULL, then it isn't available in the ROM paths */
-	g_return_val_if_fail (romfile != NULL, NULL);
-	//if (romfile == NULL) return NULL;
+	/* If archive is NULL, then it isn't available in the ROM paths */
+	g_return_val_if_fail (archive != NULL, NULL);
 
-	romfilename = g_file_get_parse_name (romfile);
+	for (i = 0; i < gmameui_archive_get_num_entries (archive); i++) {
+		const ArchiveEntry *entry = gmameui_archive_get_nth_entry (archive, i);
+		individual_rom *rom_value;
+		guint32 crc;
 
-	g_return_val_if_fail (romfilename != NULL, NULL);
-	
-	roms = get_zip_contents (romfilename);
-	
-	g_free (romfilename);
+		/* Files that can't be read can't match any ROM */
+		if (!gmameui_archive_get_crc (archive, entry, &crc))
+			continue;
+
+		rom_value = (individual_rom *) g_malloc0 (sizeof (individual_rom));
+		rom_value->name = g_strdup (entry->name);
+		rom_value->uncomp_size = entry->size;
+
+		/* The -listxml output provides the string (%x) version of the
+		   CRC, not the integer */
+		rom_value->crc = g_strdup_printf ("%x", crc);
 
-	return roms;
+		roms = g_list_prepend (roms, rom_value);
+	}
+
+	gmameui_archive_unref (archive);
+
+	return g_list_reverse (roms);
 }
 
 enum {
@@ -1309,44 +1340,124 @@ find_rom_in_zip_file (gchar *romname, individual_rom *romref, GList *zroms)
 	return result;
 }
 
+/* Returns the SHA1 of the expected ROM in the romset matching the CRC and
+   size, so that ROMs with colliding CRCs can be told apart */
+static const gchar *
+get_expected_rom_sha1 (MameRomEntry *romset, guint32 crc, guint32 size)
+{
+	GList *eromptr;
+
+	for (eromptr = romset->priv->roms; eromptr; eromptr = g_list_next (eromptr)) {
+		individual_rom *romref = (individual_rom *) eromptr->data;
+
+		if ((romref->crc == NULL) || (romref->sha1 == NULL))
+			continue;
+
+		if ((gmameui_rom_index_parse_crc (romref->crc) == crc) &&
+		    ((romref->uncomp_size == 0) || (romref->uncomp_size == size)))
+			return romref->sha1;
+	}
+
+	return NULL;
+}
+
 void
-mame_rom_entry_add_roms_to_hashtable (MameRomEntry *romset)
+mame_rom_entry_add_roms_to_index (MameRomEntry *romset)
 {
 	GList *zroms = NULL;   /* GList of ROMs in the zipped romset */
 	GList *zromptr;
 
 	g_return_if_fail (romset != NULL);
+	g_return_if_fail (gui_prefs.rom_index != NULL);
 	
-	//GMAMEUI_DEBUG ("  Getting list of all available ROMs in available romset %s", romset->priv->romname);
-	
-	zroms = get_roms_in_zip_file (romset->priv->romname);
+	zroms = get_roms_in_romset (romset->priv->romname);
 
 	g_return_if_fail (zroms != NULL);
 	
 	for (zromptr = g_list_first (zroms); zromptr; zromptr = g_list_next (zromptr)) {
 		individual_rom *zromref;
-		gchar *crc;
+		guint32 crc;
 
 		zromref = (individual_rom *) zromptr->data;
-		crc = g_strdup_printf ("%s", zromref->crc);
-		//GMAMEUI_DEBUG ("    Adding rom %s with crc %s, value %s to hashtable", zromref->name, crc, romset->priv->romname);
-
-		/* Add ROM info to the hash table *
-		* FIXME Don't add if it already exists - memory leak */
-		
-		g_hash_table_insert (gui_prefs.rom_hashtable,
-		                     /*g_strdup (zromref->sha1)*/
-		                     crc,
-		                     g_strdup (romset->priv->romname));
+		crc = gmameui_rom_index_parse_crc (zromref->crc);
+
+		gmameui_rom_index_add (gui_prefs.rom_index,
+				       crc,
+				       zromref->uncomp_size,
+				       romset->priv->romname,
+				       zromref->name,
+				       get_expected_rom_sha1 (romset, crc, zromref->uncomp_size));
 	}
 
-	//GMAMEUI_DEBUG ("  Getting list of all available ROMs in available romset %s... done", romset->priv->romname);
+	g_list_foreach (zroms, (GFunc) destroy_rom, NULL);
+	g_list_free (zroms);
+}
+
+/* The ROMs in the archive of a parent romset. Checking a clone needs the
+   parent's ROMs as well as its own, so the parent's archive is listed once
+   and kept while the parent and all its clones are checked */
+struct _RomsetFamilyListing {
+	gchar *parent;
+	GList *roms;		/* individual_rom structs, listed when first needed */
+	gboolean listed;
+};
+
+RomsetFamilyListing *
+mame_rom_entry_family_listing_new (const gchar *parent)
+{
+	RomsetFamilyListing *listing;
+
+	g_return_val_if_fail (parent != NULL, NULL);
 
-	/* Emit signal - romset ROMs added to hash table */
+	listing = g_new0 (RomsetFamilyListing, 1);
+	listing->parent = g_strdup (parent);
+
+	return listing;
+}
+
+void
+mame_rom_entry_family_listing_free (RomsetFamilyListing *listing)
+{
+	g_return_if_fail (listing != NULL);
+
+	g_list_foreach (listing->roms, (GFunc) destroy_rom, NULL);
+	g_list_free (listing->roms);
+	g_free (listing->parent);
+	g_free (listing);
+}
+
+static GList *
+family_listing_get_roms (RomsetFamilyListing *listing)
+{
+	if (!listing->listed) {
+		listing->roms = get_roms_in_romset (listing->parent);
+		listing->listed = TRUE;
+	}
+
+	return listing->roms;
 }
 
 romset_fixes *
 mame_rom_entry_find_fixes (MameRomEntry *romset)
+{
+	RomsetFamilyListing *listing;
+	romset_fixes *fixes;
+
+	g_return_val_if_fail (romset != NULL, NULL);
+
+	listing = mame_rom_entry_family_listing_new (mame_rom_entry_is_clone (romset) ?
+						     romset->priv->cloneof : romset->priv->romname);
+	fixes = mame_rom_entry_find_family_fixes (romset, listing);
+	mame_rom_entry_family_listing_free (listing);
+
+	return fixes;
+}
+
+/* Finds the fixes for a romset, reading the parent's ROMs from @listing.
+   @listing must be for the romset itself if it is a parent, or for its
+   parent if it is a clone */
+romset_fixes *
+mame_rom_entry_find_family_fixes (MameRomEntry *romset, RomsetFamilyListing *listing)
 {
 	GList *zroms;			/* GList of ROMs in the zipped romset */
 	GList *proms;			/* GList of ROMs in the zipped romset's parent */
@@ -1357,6 +1468,7 @@ mame_rom_entry_find_fixes (MameRomEntry *romset)
 	gboolean fixable;
 	
 	g_return_val_if_fail (romset != NULL, NULL);
+	g_return_val_if_fail (listing != NULL, NULL);
 	g_return_val_if_fail (g_list_length (romset->priv->roms) > 0, NULL);
 
 	//GMAMEUI_DEBUG ("    Processing romset %s", romset->priv->romname);
@@ -1385,14 +1497,18 @@ mame_rom_entry_find_fixes (MameRomEntry *romset)
 	zroms = NULL;
 	proms = NULL;
 
-	/* Get the list of ROMs in the romset that we actually have */
-	zroms = get_roms_in_zip_file (romset->priv->romname);
+	/* Get the list of ROMs in the romset that we actually have, and in
+	   the parent romset. The parent's are shared by the whole family */
+	if (mame_rom_entry_is_clone (romset)) {
+		g_return_val_if_fail (g_ascii_strcasecmp (listing->parent, romset->priv->cloneof) == 0, NULL);
 
-	/* Get the list of ROMs in the parent romset */
-	/* AAA FIXME TODO Go via parent romset first, then the clones. Fixing the
-	   parent will often fix the clones */
-	if (mame_rom_entry_is_clone (romset))
-		proms = get_roms_in_zip_file (romset->priv->cloneof);
+		zroms = get_roms_in_romset (romset->priv->romname);
+		proms = family_listing_get_roms (listing);
+	} else {
+		g_return_val_if_fail (g_ascii_strcasecmp (listing->parent, romset->priv->romname) == 0, NULL);
+
+		zroms = family_listing_get_roms (listing);
+	}
 
 	g_return_val_if_fail (g_list_length (zroms) > 0, NULL);
 
@@ -1410,6 +1526,8 @@ mame_rom_entry_find_fixes (MameRomEntry *romset)
 
 		aromfix->romname = g_strdup (romref->name);
 		aromfix->region = g_strdup (romref->region);
+		aromfix->crc = romref->crc ? gmameui_rom_index_parse_crc (romref->crc) : 0;
+		aromfix->size = romref->uncomp_size;
 
 		if (romref->sha1 == NULL) {
 			GMAMEUI_DEBUG ("      ROM %s DOES NOT HAVE SHA1 - NODUMP ASSUMED", romref->name);
@@ -1454,6 +1572,11 @@ mame_rom_entry_find_fixes (MameRomEntry *romset)
 			if (!found) {
 				GMAMEUI_DEBUG ("        OK - FOUND IN PARENT");
 				aromfix->status = INPARENT;
+
+				/* Unless shared with the parent, the ROM
+				   belongs in this romset and can be copied */
+				if (romref->merge == NULL)
+					aromfix->container = g_strdup (romset->priv->cloneof);
 			} else {
 				GMAMEUI_DEBUG ("        ROM CAN BE DELETED (ALSO AVAILABLE IN PARENT %s)", romset->priv->cloneof);
 				aromfix->status = DUPEPARENT;
@@ -1464,35 +1587,51 @@ mame_rom_entry_find_fixes (MameRomEntry *romset)
 			continue;       /* Move to next expected ROM */
 		}
 
-		/* Look in other available romsets (stored in the hashtable) to see
-		   whether the rom is available in other romset */
-		if ((!found) && (!foundpar)) {
-			gchar *container;       /* Romset that contains the missing rom */
-			gchar *crcval;
+		/* Look in other available romsets (stored in the ROM index) to see
+		   whether the rom is available in other romsets */
+		if ((!found) && (!foundpar) && (romref->crc != NULL)) {
+			GList *sources, *srcptr;
+
 			GMAMEUI_DEBUG ("        NOK - MISSING ROM %s", romref->name);
 			/* AAA FIXME TODO Only do this when the user selects they want
 			   the more detailed search */
 
-			/* Look in the hashtable */
-			crcval = g_strdup_printf ("%s", romref->crc);
-			GMAMEUI_DEBUG ("        LOOKING IN HASH TABLE FOR %s", romref->crc);
-			container = (gchar *) g_hash_table_lookup (gui_prefs.rom_hashtable,
-			                                           crcval);
+			sources = gmameui_rom_index_lookup (gui_prefs.rom_index,
+							    gmameui_rom_index_parse_crc (romref->crc),
+							    romref->uncomp_size,
+							    romref->sha1);
+
+			for (srcptr = sources; srcptr; srcptr = g_list_next (srcptr)) {
+				RomIndexEntry *entry = (RomIndexEntry *) srcptr->data;
+				romfix_source *source;
+
+				/* This romset and its parent have already been checked */
+				if ((g_ascii_strcasecmp (entry->romset, romset->priv->romname) == 0) ||
+				    (romset->priv->cloneof &&
+				     g_ascii_strcasecmp (entry->romset, romset->priv->cloneof) == 0))
+					continue;
+
+				source = g_new0 (romfix_source, 1);
+				source->romset = g_strdup (entry->romset);
+				source->romname = g_strdup (entry->name);
+				aromfix->sources = g_list_append (aromfix->sources, source);
+			}
+			g_list_free (sources);
+
+			if (aromfix->sources) {
+				romfix_source *source = (romfix_source *) aromfix->sources->data;
 
-			if (container) {
 				/* AAA FIXME TODO If the rom is merge, should be moved to parent */
-				GMAMEUI_DEBUG ("        ROM IS AVAILABLE IN ROMSET %s", container);
+				GMAMEUI_DEBUG ("        ROM IS AVAILABLE IN %d ROMSETS, INCLUDING %s",
+					       g_list_length (aromfix->sources), source->romset);
 				found = TRUE;
 
 				aromfix->status = COPY;
-				aromfix->container = g_strdup (container);
+				aromfix->container = g_strdup (source->romset);
 				fixes->romfixes = g_list_append (fixes->romfixes, aromfix);
 				
 				continue;       /* Move to next expected ROM */
 			}
-			g_free (container);
-			g_free (crcval);
-
 		}
 
 		/* If we still haven't found it, give up */
@@ -1507,15 +1646,38 @@ mame_rom_entry_find_fixes (MameRomEntry *romset)
 
 	}
 
-	/* Clean up */
-	g_list_foreach (zroms,
-			(GFunc) destroy_rom,
-			NULL);
-	g_list_free (zroms);
-	g_list_foreach (proms,
-			(GFunc) destroy_rom,
-			NULL);
-	g_list_free (proms);
+	/* Disks are checked using the SHA1 in the CHD header, rather than
+	   reading the whole image as -verifyroms does */
+	for (eromptr = g_list_first (romset->priv->disks); eromptr; eromptr = g_list_next (eromptr)) {
+		individual_rom *diskref;
+		romfix *aromfix;
+		ChdResult chd_result;
+
+		diskref = (individual_rom *) eromptr->data;
+		aromfix = (romfix *) g_malloc0 (sizeof (romfix));
+
+		aromfix->romname = g_strdup (diskref->name);
+		aromfix->region = g_strdup (diskref->region ? diskref->region : "disk");
+
+		chd_result = gmameui_chd_verify_romset_disk (romset, diskref);
+		if ((chd_result == CHD_RESULT_OK) || (chd_result == CHD_RESULT_NODUMP)) {
+			aromfix->status = OK;
+		} else {
+			GMAMEUI_DEBUG ("        DISK %s - %s", diskref->name, gmameui_chd_result_to_string (chd_result));
+			aromfix->status = NOK;
+			fixes->status = NOK;
+		}
+
+		fixes->romfixes = g_list_append (fixes->romfixes, aromfix);
+	}
+
+	/* Clean up - the parent's ROMs are freed with the listing */
+	if (mame_rom_entry_is_clone (romset)) {
+		g_list_foreach (zroms,
+				(GFunc) destroy_rom,
+				NULL);
+		g_list_free (zroms);
+	}
 
 	return fixes;
 }
@@ -1526,4 +1688,10 @@ mame_rom_entry_get_roms (MameRomEntry *rom)
 	return rom->priv->roms;
 }
 
+GList *
+mame_rom_entry_get_disks (MameRomEntry *rom)
+{
+	return rom->priv->disks;
+}
+
 
@@ -219,6 +219,8 @@ const gchar * mame_rom_entry_get_parent_romname (MameRomEntry *rom);
 const gchar * mame_rom_entry_get_year (MameRomEntry *rom);
 const gchar * mame_rom_entry_get_driver (MameRomEntry *rom);
 const gchar * mame_rom_entry_get_manufacturer (MameRomEntry *rom);
+const gchar * mame_rom_entry_get_category (MameRomEntry *rom);
+const gchar * mame_rom_entry_get_version_added (MameRomEntry *rom);
 RomStatus mame_rom_entry_get_rom_status (MameRomEntry *rom);
 RomStatus mame_rom_entry_get_sample_status (MameRomEntry *rom);
 gchar* mame_rom_entry_get_resolution (MameRomEntry *rom);
@@ -237,6 +239,7 @@ void mame_rom_entry_add_cpu (MameRomEntry *rom, int i, gchar *name, gint clock);
 void mame_rom_entry_add_soundcpu (MameRomEntry *rom, int i, gchar *name, gint clock);
 /* FIXME TODO Combine this and mame_rom_entry_add_rom above; create equivalent sample function */
 void mame_rom_entry_add_rom_ref (MameRomEntry *rom, individual_rom *rom_ref);
+void mame_rom_entry_add_disk_ref (MameRomEntry *rom, individual_rom *disk_ref);
 
 void mame_rom_entry_rom_played (MameRomEntry *rom, gboolean warning, gboolean error);
 
@@ -257,10 +260,22 @@ GFile *mame_rom_entry_get_disk_location (gchar *romname);
 // AAA FIXME TODO - Once working, make static
 romset_fixes *
 mame_rom_entry_find_fixes (MameRomEntry *rom);
+
+/* ROMs listed from a parent's archive, shared while its clones are checked */
+typedef struct _RomsetFamilyListing RomsetFamilyListing;
+
+RomsetFamilyListing *
+mame_rom_entry_family_listing_new (const gchar *parent);
+void
+mame_rom_entry_family_listing_free (RomsetFamilyListing *listing);
+romset_fixes *
+mame_rom_entry_find_family_fixes (MameRomEntry *rom, RomsetFamilyListing *listing);
 GList *
 mame_rom_entry_get_roms (MameRomEntry *rom);
+GList *
+mame_rom_entry_get_disks (MameRomEntry *rom);
 void
-mame_rom_entry_add_roms_to_hashtable (MameRomEntry *romset);
+mame_rom_entry_add_roms_to_index (MameRomEntry *romset);
 
 G_END_DECLS
 